@@ -612,6 +612,18 @@ vector<shared_ptr<Channel>> Device::channels()
 	return result;
 }
 
+vector<shared_ptr<Channel>> Device::enabled_channels(const ChannelType *type)
+{
+	unsigned int count;
+	auto *const channels = sr_dev_inst_enabled_channels_get(_structure,
+		type ? type->id() : 0, &count);
+	vector<shared_ptr<Channel>> result;
+	result.reserve(count);
+	for (unsigned int i = 0; i < count; i++)
+		result.push_back(_channels[channels[i]]->share_owned_by(get_shared_from_this()));
+	return result;
+}
+
 shared_ptr<Channel> Device::get_channel(struct sr_channel *ptr)
 {
 	return _channels[ptr]->share_owned_by(get_shared_from_this());
@@ -859,15 +871,19 @@ float TriggerMatch::value() const
 }
 
 DatafeedCallbackData::DatafeedCallbackData(Session *session,
-		DatafeedCallbackFunction callback) :
+		DatafeedCallbackFunction callback, unsigned int id) :
 	_callback(move(callback)),
-	_session(session)
+	_session(session),
+	_id(id),
+	_removed(false)
 {
 }
 
 void DatafeedCallbackData::run(const struct sr_dev_inst *sdi,
 	const struct sr_datafeed_packet *pkt)
 {
+	if (_removed)
+		return;
 	auto device = _session->get_device(sdi);
 	shared_ptr<Packet> packet {new Packet{device, pkt}, default_delete<Packet>{}};
 	_callback(move(device), move(packet));
@@ -889,7 +905,8 @@ shared_ptr<Device> SessionDevice::get_shared_from_this()
 
 Session::Session(shared_ptr<Context> context) :
 	_structure(nullptr),
-	_context(move(context))
+	_context(move(context)),
+	_next_datafeed_id(0)
 {
 	check(sr_session_new(_context->_structure, &_structure));
 	_context->_session = this;
@@ -898,6 +915,7 @@ Session::Session(shared_ptr<Context> context) :
 Session::Session(shared_ptr<Context> context, string filename) :
 	_structure(nullptr),
 	_context(move(context)),
+	_next_datafeed_id(0),
 	_filename(move(filename))
 {
 	check(sr_session_load(_context->_structure, _filename.c_str(), &_structure));
@@ -952,8 +970,36 @@ void Session::remove_devices()
 	check(sr_session_dev_remove_all(_structure));
 }
 
+static void datafeed_callback(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *pkt, void *cb_data) noexcept
+{
+	auto callback = static_cast<DatafeedCallbackData *>(cb_data);
+	callback->run(sdi, pkt);
+}
+
 void Session::start()
 {
+	{
+		/*
+		 * Callbacks removed while a previous run was going on are
+		 * still registered with the session, drop them now.
+		 */
+		lock_guard<mutex> lock(_datafeed_mutex);
+		auto removed = [](const unique_ptr<DatafeedCallbackData> &cb) {
+			return cb->_removed.load();
+		};
+		if (any_of(_datafeed_callbacks.begin(),
+				_datafeed_callbacks.end(), removed)) {
+			check(sr_session_datafeed_callback_remove_all(_structure));
+			_datafeed_callbacks.erase(remove_if(
+				_datafeed_callbacks.begin(),
+				_datafeed_callbacks.end(), removed),
+				_datafeed_callbacks.end());
+			for (auto &cb : _datafeed_callbacks)
+				check(sr_session_datafeed_callback_add(_structure,
+					&datafeed_callback, cb.get()));
+		}
+	}
 	check(sr_session_start(_structure));
 }
 
@@ -992,24 +1038,33 @@ void Session::set_stopped_callback(SessionStoppedCallback callback)
 				nullptr, nullptr));
 }
 
-static void datafeed_callback(const struct sr_dev_inst *sdi,
-	const struct sr_datafeed_packet *pkt, void *cb_data) noexcept
-{
-	auto callback = static_cast<DatafeedCallbackData *>(cb_data);
-	callback->run(sdi, pkt);
-}
-
-void Session::add_datafeed_callback(DatafeedCallbackFunction callback)
+unsigned int Session::add_datafeed_callback(DatafeedCallbackFunction callback)
 {
+	lock_guard<mutex> lock(_datafeed_mutex);
+	unsigned int id = ++_next_datafeed_id;
 	unique_ptr<DatafeedCallbackData> cb_data
-		{new DatafeedCallbackData{this, move(callback)}};
+		{new DatafeedCallbackData{this, move(callback), id}};
 	check(sr_session_datafeed_callback_add(_structure,
 			&datafeed_callback, cb_data.get()));
 	_datafeed_callbacks.push_back(move(cb_data));
+	return id;
+}
+
+void Session::remove_datafeed_callback(unsigned int id)
+{
+	/*
+	 * The session may be iterating its callbacks right now, so only
+	 * mark this one; it gets unregistered on the next start().
+	 */
+	lock_guard<mutex> lock(_datafeed_mutex);
+	for (auto &cb : _datafeed_callbacks)
+		if (cb->_id == id)
+			cb->_removed = true;
 }
 
 void Session::remove_datafeed_callbacks()
 {
+	lock_guard<mutex> lock(_datafeed_mutex);
 	check(sr_session_datafeed_callback_remove_all(_structure));
 	_datafeed_callbacks.clear();
 }
@@ -1034,14 +1089,335 @@ string Session::filename() const
 	return _filename;
 }
 
+void Session::set_analog_planar(bool enable)
+{
+	check(sr_session_analog_planar_set(_structure, enable));
+}
+
 shared_ptr<Context> Session::context()
 {
 	return _context;
 }
 
+shared_ptr<PacketStream> Session::stream(size_t capacity, int overflow)
+{
+	if (!capacity || overflow < PacketStream::BLOCK
+			|| overflow > PacketStream::DROP_OLDEST)
+		throw Error(SR_ERR_ARG);
+
+	shared_ptr<PacketStream> stream{
+		new PacketStream{shared_from_this(), capacity, overflow},
+		default_delete<PacketStream>{}};
+
+	/* The session must not keep the stream alive, or neither goes away. */
+	weak_ptr<PacketStream> weak = stream;
+	stream->_weak_this = weak;
+	stream->_callback_id = add_datafeed_callback([weak](shared_ptr<Device> device,
+			shared_ptr<Packet> packet) {
+		if (auto stream = weak.lock())
+			stream->receive(move(device), packet->_structure);
+	});
+
+	return stream;
+}
+
+PacketStream::PacketStream(shared_ptr<Session> session, size_t capacity,
+		int overflow) :
+	_session(move(session)),
+	_capacity(capacity),
+	_overflow(overflow),
+	_queued_data(0),
+	_dropped(0),
+	_closed(false),
+	_result(SR_OK),
+	_callback_id(0)
+{
+}
+
+PacketStream::~PacketStream()
+{
+	/* Only marks the callback, so this is fine on the session thread. */
+	_session->remove_datafeed_callback(_callback_id);
+	close();
+	if (!_thread.joinable())
+		return;
+	if (this_thread::get_id() == _thread.get_id()) {
+		/*
+		 * The last reference went away on the session thread, e.g. in
+		 * a datafeed callback. Neither join it, nor stop the session
+		 * from within its own callback; the thread runs the session
+		 * to its end and then finds the stream gone.
+		 */
+		_thread.detach();
+		return;
+	}
+	if (_session->is_running())
+		_session->stop();
+	_thread.join();
+}
+
+static bool is_data_packet(int type)
+{
+	return type == SR_DF_LOGIC || type == SR_DF_ANALOG
+		|| type == SR_DF_ANALOG_PLANAR;
+}
+
+vector<function<void()>> PacketStream::take_waiters()
+{
+	vector<function<void()>> waiters;
+
+	if (_closed) {
+		waiters.swap(_waiters);
+	} else if (!_waiters.empty()) {
+		waiters.push_back(move(_waiters.front()));
+		_waiters.erase(_waiters.begin());
+	}
+
+	return waiters;
+}
+
+void PacketStream::receive(shared_ptr<Device> device,
+	const struct sr_datafeed_packet *pkt)
+{
+	const bool is_data = is_data_packet(pkt->type);
+	vector<function<void()>> waiters;
+
+	{
+		unique_lock<mutex> lock(_mutex);
+		if (_closed)
+			return;
+		if (is_data && _queued_data >= _capacity) {
+			if (_overflow == BLOCK) {
+				_not_full.wait(lock, [this] {
+					return _closed || _queued_data < _capacity;
+				});
+				if (_closed)
+					return;
+			} else if (_overflow == DROP_NEWEST) {
+				_dropped++;
+				return;
+			} else {
+				for (auto it = _items.begin(); it != _items.end(); ++it) {
+					if (is_data_packet(it->packet->_structure->type)) {
+						_items.erase(it);
+						_queued_data--;
+						_dropped++;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	/* Copy outside of the lock, consumers need not wait for it. */
+	struct sr_datafeed_packet *copy;
+	if (sr_packet_copy(pkt, &copy) != SR_OK) {
+		lock_guard<mutex> lock(_mutex);
+		_dropped++;
+		return;
+	}
+	shared_ptr<Packet> packet{new Packet{device, copy},
+		default_delete<Packet>{}};
+	packet->_copy = copy;
+
+	{
+		lock_guard<mutex> lock(_mutex);
+		if (is_data)
+			_queued_data++;
+		_items.push_back(Item{move(device), move(packet)});
+		waiters = take_waiters();
+	}
+	_not_empty.notify_one();
+
+	for (auto &waiter : waiters)
+		waiter();
+}
+
+void PacketStream::finish(int result)
+{
+	vector<function<void()>> waiters;
+
+	{
+		lock_guard<mutex> lock(_mutex);
+		if (_result == SR_OK)
+			_result = result;
+		_closed = true;
+		waiters = take_waiters();
+	}
+	_not_empty.notify_all();
+	_not_full.notify_all();
+
+	for (auto &waiter : waiters)
+		waiter();
+}
+
+void PacketStream::start()
+{
+	if (_thread.joinable())
+		throw Error(SR_ERR);
+
+	/* The thread may outlive the stream, see ~PacketStream(). */
+	auto session = _session;
+	auto weak = _weak_this;
+	_thread = thread([weak, session] {
+		int result = SR_OK;
+		try {
+			session->start();
+			session->run();
+		} catch (Error &e) {
+			result = e.result;
+		}
+		if (auto stream = weak.lock())
+			stream->finish(result);
+	});
+}
+
+void PacketStream::close()
+{
+	finish(SR_OK);
+}
+
+bool PacketStream::finished()
+{
+	lock_guard<mutex> lock(_mutex);
+	return _closed && _items.empty();
+}
+
+uint64_t PacketStream::dropped()
+{
+	lock_guard<mutex> lock(_mutex);
+	return _dropped;
+}
+
+bool PacketStream::pop(Item &item, chrono::milliseconds timeout)
+{
+	unique_lock<mutex> lock(_mutex);
+	auto ready = [this] { return _closed || !_items.empty(); };
+
+	if (timeout == chrono::milliseconds::max())
+		_not_empty.wait(lock, ready);
+	else if (!_not_empty.wait_for(lock, timeout, ready))
+		return false;
+
+	if (_items.empty()) {
+		if (_result != SR_OK)
+			throw Error(_result);
+		return false;
+	}
+
+	item = move(_items.front());
+	_items.pop_front();
+	if (is_data_packet(item.packet->_structure->type)) {
+		_queued_data--;
+		_not_full.notify_one();
+	}
+
+	return true;
+}
+
+vector<PacketStream::Item> PacketStream::pop_batch(size_t max_items,
+	chrono::milliseconds timeout)
+{
+	vector<Item> result;
+	Item item;
+
+	if (!max_items || !pop(item, timeout))
+		return result;
+	result.push_back(move(item));
+
+	lock_guard<mutex> lock(_mutex);
+	size_t taken = 0;
+	while (result.size() < max_items && !_items.empty()) {
+		if (is_data_packet(_items.front().packet->_structure->type))
+			taken++;
+		result.push_back(move(_items.front()));
+		_items.pop_front();
+	}
+	if (taken) {
+		_queued_data -= taken;
+		_not_full.notify_all();
+	}
+
+	return result;
+}
+
+bool PacketStream::when_ready(function<void()> callback)
+{
+	lock_guard<mutex> lock(_mutex);
+	if (_closed || !_items.empty())
+		return false;
+	_waiters.push_back(move(callback));
+	return true;
+}
+
+void PacketStream::set_executor(function<void(function<void()>)> executor)
+{
+	lock_guard<mutex> lock(_mutex);
+	_executor = move(executor);
+}
+
+void PacketStream::dispatch(function<void()> task)
+{
+	function<void(function<void()>)> executor;
+
+	{
+		lock_guard<mutex> lock(_mutex);
+		executor = _executor;
+	}
+
+	if (executor)
+		executor(move(task));
+	else
+		task();
+}
+
+bool PacketStream::take(Item &item,
+	function<void(Item, exception_ptr)> deliver)
+{
+	/* A packet may arrive between the attempt and the registration. */
+	for (;;) {
+		if (pop(item, chrono::milliseconds::zero()) || finished())
+			return true;
+		if (when_ready([this, deliver] {
+				Item next;
+				try {
+					if (!take(next, deliver))
+						return;
+				} catch (...) {
+					deliver(Item(), current_exception());
+					return;
+				}
+				deliver(move(next), nullptr);
+			}))
+			return false;
+	}
+}
+
+future<PacketStream::Item> PacketStream::next()
+{
+	auto result = make_shared<promise<Item>>();
+	auto value = result->get_future();
+	Item item;
+
+	try {
+		if (take(item, [result](Item next, exception_ptr error) {
+				if (error)
+					result->set_exception(error);
+				else
+					result->set_value(move(next));
+			}))
+			result->set_value(move(item));
+	} catch (...) {
+		result->set_exception(current_exception());
+	}
+
+	return value;
+}
+
 Packet::Packet(shared_ptr<Device> device,
 	const struct sr_datafeed_packet *structure) :
 	_structure(structure),
+	_copy(nullptr),
 	_device(move(device))
 {
 	switch (structure->type)
@@ -1066,11 +1442,18 @@ Packet::Packet(shared_ptr<Device> device,
 				static_cast<const struct sr_datafeed_analog *>(
 					structure->payload)});
 			break;
+		case SR_DF_ANALOG_PLANAR:
+			_payload.reset(new AnalogPlanar{
+				static_cast<const struct sr_datafeed_analog_planar *>(
+					structure->payload)});
+			break;
 	}
 }
 
 Packet::~Packet()
 {
+	if (_copy)
+		sr_packet_free(_copy);
 }
 
 const PacketType *Packet::type() const
@@ -1287,6 +1670,38 @@ vector<const QuantityFlag *> Analog::mq_flags() const
 	return QuantityFlag::flags_from_mask(_structure->meaning->mqflags);
 }
 
+AnalogPlanar::AnalogPlanar(const struct sr_datafeed_analog_planar *structure) :
+	PacketPayload(),
+	_structure(structure)
+{
+	for (unsigned int i = 0; i < _structure->num_planes; i++)
+		_planes.emplace_back(new Analog{&_structure->planes[i]});
+}
+
+AnalogPlanar::~AnalogPlanar()
+{
+}
+
+shared_ptr<PacketPayload> AnalogPlanar::share_owned_by(shared_ptr<Packet> _parent)
+{
+	return static_pointer_cast<PacketPayload>(
+		ParentOwned::share_owned_by(_parent));
+}
+
+unsigned int AnalogPlanar::num_samples() const
+{
+	return _structure->num_samples;
+}
+
+vector<shared_ptr<Analog>> AnalogPlanar::planes()
+{
+	vector<shared_ptr<Analog>> result;
+	for (auto &plane : _planes)
+		result.push_back(static_pointer_cast<Analog>(
+			plane->share_owned_by(_parent)));
+	return result;
+}
+
 Rational::Rational(const struct sr_rational *structure) :
 	_structure(structure)
 {
@@ -1391,10 +1806,14 @@ shared_ptr<InputDevice> Input::device()
 
 void Input::send(void *data, size_t length)
 {
-	auto gstr = g_string_new_len(static_cast<char *>(data), length);
-	auto ret = sr_input_send(_structure, gstr);
-	g_string_free(gstr, true);
-	check(ret);
+	check(sr_input_send_data(_structure, data, length));
+}
+
+bool Input::send_file(int fd)
+{
+	gboolean eof;
+	check(sr_input_send_fd(_structure, fd, &eof));
+	return eof;
 }
 
 void Input::end()
@@ -83,6 +83,22 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 #include <vector>
 #include <map>
 #include <set>
+#include <cstring>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+#if defined(__cpp_impl_coroutine) && !defined(SWIG)
+#include <coroutine>
+#define LIBSIGROKCXX_COROUTINES 1
+#endif
 
 namespace sigrok
 {
@@ -110,6 +126,7 @@ class SR_API TriggerMatch;
 class SR_API TriggerMatchType;
 class SR_API ChannelType;
 class SR_API Packet;
+class SR_API PacketStream;
 class SR_API PacketPayload;
 class SR_API PacketType;
 class SR_API Quantity;
@@ -388,6 +405,11 @@ public:
 	string connection_id() const;
 	/** List of the channels available on this device. */
 	vector<shared_ptr<Channel> > channels();
+	/** List of the enabled channels of this device.
+	 * @param type Only return channels of this type, or all enabled
+	 *             channels if null. */
+	vector<shared_ptr<Channel> > enabled_channels(
+		const ChannelType *type = nullptr);
 	/** Channel groups available on this device, indexed by name. */
 	map<string, shared_ptr<ChannelGroup> > channel_groups();
 	/** Open device. */
@@ -584,8 +606,10 @@ public:
 private:
 	DatafeedCallbackFunction _callback;
 	DatafeedCallbackData(Session *session,
-		DatafeedCallbackFunction callback);
+		DatafeedCallbackFunction callback, unsigned int id);
 	Session *_session;
+	unsigned int _id;
+	atomic<bool> _removed;
 	friend class Session;
 };
 
@@ -615,8 +639,15 @@ public:
 	/** Remove all devices from this session. */
 	void remove_devices();
 	/** Add a datafeed callback to this session.
-	 * @param callback Callback of the form callback(Device, Packet). */
-	void add_datafeed_callback(DatafeedCallbackFunction callback);
+	 * @param callback Callback of the form callback(Device, Packet).
+	 * @return Identifier to pass to remove_datafeed_callback(). */
+	unsigned int add_datafeed_callback(DatafeedCallbackFunction callback);
+	/** Remove a datafeed callback from this session.
+	 * The callback is not invoked again once this returns, unless it is
+	 * running on another thread at that moment. Safe to call from any
+	 * thread, and from within the callback itself.
+	 * @param id Identifier returned by add_datafeed_callback(). */
+	void remove_datafeed_callback(unsigned int id);
 	/** Remove all datafeed callbacks from this session. */
 	void remove_datafeed_callbacks();
 	/** Start the session. */
@@ -638,6 +669,17 @@ public:
 	void set_trigger(shared_ptr<Trigger> trigger);
 	/** Get filename this session was loaded from. */
 	string filename() const;
+	/** Set whether datafeed callbacks receive AnalogPlanar packets.
+	 * Otherwise, each of their planes is delivered as an Analog packet.
+	 * @param enable True to receive AnalogPlanar packets. */
+	void set_analog_planar(bool enable);
+	/** Create a stream of the packets on this session's datafeed.
+	 * @param capacity Maximum number of queued data packets.
+	 * @param overflow What to do when a data packet arrives at a full
+	 * stream; one of PacketStream::BLOCK, PacketStream::DROP_NEWEST and
+	 * PacketStream::DROP_OLDEST. */
+	shared_ptr<PacketStream> stream(size_t capacity = 64,
+		int overflow = 0);
 private:
 	explicit Session(shared_ptr<Context> context);
 	Session(shared_ptr<Context> context, string filename);
@@ -648,6 +690,8 @@ private:
 	map<const struct sr_dev_inst *, unique_ptr<SessionDevice> > _owned_devices;
 	map<const struct sr_dev_inst *, shared_ptr<Device> > _other_devices;
 	vector<unique_ptr<DatafeedCallbackData> > _datafeed_callbacks;
+	mutex _datafeed_mutex;
+	unsigned int _next_datafeed_id;
 	SessionStoppedCallback _stopped_callback;
 	string _filename;
 	shared_ptr<Trigger> _trigger;
@@ -655,9 +699,180 @@ private:
 	friend class Context;
 	friend class DatafeedCallbackData;
 	friend class SessionDevice;
+	friend class PacketStream;
 	friend struct std::default_delete<Session>;
 };
 
+/** A bounded queue of the packets on a session's datafeed.
+ *
+ * Packets are copied off the datafeed and can be pulled from any thread,
+ * one at a time, in batches, through a future, by iterating the stream or,
+ * in C++20 coroutines, with co_await. Only logic and analog packets count
+ * towards the capacity; all other packets are always queued. */
+class SR_API PacketStream
+{
+public:
+	/** Overflow policy. */
+	enum Overflow {
+		/** Hold up the session until there is room. */
+		BLOCK = 0,
+		/** Drop the arriving data packet. */
+		DROP_NEWEST = 1,
+		/** Drop the oldest queued data packet. */
+		DROP_OLDEST = 2,
+	};
+	/** A packet and the device it came from. At the end of the stream,
+	 * both are null. */
+	struct Item
+	{
+		shared_ptr<Device> device;
+		shared_ptr<Packet> packet;
+	};
+	/** Run the session on a background thread. The stream is closed
+	 * when the session has stopped. */
+	void start();
+	/** Close the stream. Packets already queued can still be pulled.
+	 * Producers and consumers waiting on the stream are woken up. */
+	void close();
+	/** Return whether the stream is closed and all packets pulled. */
+	bool finished();
+	/** Number of data packets dropped due to overflow. */
+	uint64_t dropped();
+	/** Pull the next packet.
+	 * @param item Receives the packet.
+	 * @param timeout How long to wait for a packet.
+	 * @return False on timeout or at the end of the stream.
+	 * @throws Error if the session run by start() failed. */
+	bool pop(Item &item,
+		chrono::milliseconds timeout = chrono::milliseconds::max());
+	/** Pull up to max_items packets at once.
+	 * Waits at most timeout for the first packet, then takes whatever
+	 * else is queued. Returns an empty vector on timeout or at the end
+	 * of the stream. */
+	vector<Item> pop_batch(size_t max_items,
+		chrono::milliseconds timeout = chrono::milliseconds::max());
+	/** Get a future for the next packet. */
+	future<Item> next();
+	/** Call callback once a packet is queued or the stream is finished.
+	 * The callback runs on the thread which queues the packet or closes
+	 * the stream and must not block.
+	 * @return False, without calling or keeping the callback, if a
+	 * packet is already queued or the stream is finished. */
+	bool when_ready(function<void()> callback);
+	/** Resume coroutines awaiting the stream through executor, rather
+	 * than on the thread which queues the packet. Set it before the
+	 * first co_await.
+	 * @param executor Called with the task to run, or nullptr to unset. */
+	void set_executor(function<void(function<void()>)> executor);
+
+	/** Input iterator pulling packets until the end of the stream. */
+	class iterator
+	{
+	public:
+		typedef input_iterator_tag iterator_category;
+		typedef Item value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const Item *pointer;
+		typedef const Item &reference;
+
+		iterator() : _stream(nullptr) {}
+		explicit iterator(PacketStream *stream) : _stream(stream)
+		{
+			++*this;
+		}
+		reference operator*() const { return _item; }
+		pointer operator->() const { return &_item; }
+		iterator &operator++()
+		{
+			if (!_stream->pop(_item))
+				_stream = nullptr;
+			return *this;
+		}
+		bool operator==(const iterator &other) const
+		{
+			return _stream == other._stream;
+		}
+		bool operator!=(const iterator &other) const
+		{
+			return _stream != other._stream;
+		}
+	private:
+		PacketStream *_stream;
+		Item _item;
+	};
+	iterator begin() { return iterator(this); }
+	iterator end() { return iterator(); }
+
+#ifdef LIBSIGROKCXX_COROUTINES
+	/** Awaiter returned by co_await on a stream, yielding an Item.
+	 * Unless an executor is set, the coroutine is resumed on the thread
+	 * which queues the packet, with the packet already taken. */
+	class awaiter
+	{
+	public:
+		explicit awaiter(PacketStream *stream) : _stream(stream) {}
+		bool await_ready() { return false; }
+		bool await_suspend(coroutine_handle<> handle)
+		{
+			/* Once deferred, this awaiter belongs to the callback. */
+			return !_stream->take(_item,
+				[this, handle](Item item, exception_ptr error) {
+					_item = move(item);
+					_error = move(error);
+					_stream->dispatch([handle] { handle.resume(); });
+				});
+		}
+		Item await_resume()
+		{
+			if (_error)
+				rethrow_exception(_error);
+			return move(_item);
+		}
+	private:
+		PacketStream *_stream;
+		Item _item;
+		exception_ptr _error;
+	};
+	awaiter operator co_await() { return awaiter(this); }
+#endif
+
+private:
+	PacketStream(shared_ptr<Session> session, size_t capacity,
+		int overflow);
+	~PacketStream();
+	void receive(shared_ptr<Device> device,
+		const struct sr_datafeed_packet *pkt);
+	void finish(int result);
+	/* Take the next packet, or pass it to deliver once there is one.
+	 * Returns true if item was filled in right away. */
+	bool take(Item &item, function<void(Item, exception_ptr)> deliver);
+	/* Run task through the executor, if any. */
+	void dispatch(function<void()> task);
+	/* Called with _mutex held; returns the callbacks to run. */
+	vector<function<void()> > take_waiters();
+
+	shared_ptr<Session> _session;
+	size_t _capacity;
+	int _overflow;
+	mutex _mutex;
+	condition_variable _not_empty;
+	condition_variable _not_full;
+	deque<Item> _items;
+	size_t _queued_data;
+	uint64_t _dropped;
+	bool _closed;
+	int _result;
+	vector<function<void()> > _waiters;
+	function<void(function<void()>)> _executor;
+	thread _thread;
+	weak_ptr<PacketStream> _weak_this;
+	/* The session's datafeed callback feeding this stream. */
+	unsigned int _callback_id;
+
+	friend class Session;
+	friend struct std::default_delete<PacketStream>;
+};
+
 /** A packet on the session datafeed */
 class SR_API Packet : public UserOwned<Packet>
 {
@@ -671,16 +886,20 @@ private:
 		const struct sr_datafeed_packet *structure);
 	~Packet();
 	const struct sr_datafeed_packet *_structure;
+	/* Copy made by sr_packet_copy() and owned by this packet, if any. */
+	struct sr_datafeed_packet *_copy;
 	shared_ptr<Device> _device;
 	unique_ptr<PacketPayload> _payload;
 
 	friend class Session;
+	friend class PacketStream;
 	friend class Output;
 	friend class DatafeedCallbackData;
 	friend class Header;
 	friend class Meta;
 	friend class Logic;
 	friend class Analog;
+	friend class AnalogPlanar;
 	friend class Context;
 	friend struct std::default_delete<Packet>;
 };
@@ -810,6 +1029,29 @@ private:
 
 	const struct sr_datafeed_analog *_structure;
 
+	friend class Packet;
+	friend class AnalogPlanar;
+	friend struct std::default_delete<Analog>;
+};
+
+/** Payload of a datafeed packet with planar analog data */
+class SR_API AnalogPlanar :
+	public ParentOwned<AnalogPlanar, Packet>,
+	public PacketPayload
+{
+public:
+	/** Number of samples in each plane. */
+	unsigned int num_samples() const;
+	/** Planes of this packet, each with its own channels and encoding. */
+	vector<shared_ptr<Analog> > planes();
+private:
+	explicit AnalogPlanar(const struct sr_datafeed_analog_planar *structure);
+	~AnalogPlanar();
+	shared_ptr<PacketPayload> share_owned_by(shared_ptr<Packet> parent);
+
+	const struct sr_datafeed_analog_planar *_structure;
+	vector<unique_ptr<Analog> > _planes;
+
 	friend class Packet;
 };
 
@@ -871,9 +1113,16 @@ public:
 	/** Virtual device associated with this input. */
 	shared_ptr<InputDevice> device();
 	/** Send next stream data.
+	 * The data is not copied, and only needs to stay valid during the call.
 	 * @param data Next stream data.
 	 * @param length Length of data. */
 	void send(void *data, size_t length);
+	/** Send stream data from a file, starting at its current position.
+	 * Regular files are memory-mapped instead of being read. Returns early
+	 * once the device is ready; call again to send the rest.
+	 * @param fd File descriptor to read from. It is not closed.
+	 * @return True once the end of the file has been reached. */
+	bool send_file(int fd);
 	/** Signal end of input data. */
 	void end();
 	void reset();
@@ -1042,6 +1291,437 @@ private:
 	const string _name;
 };
 
+/*
+ * Sample iteration templates.
+ *
+ * These views read packet data in place. The unit size or encoding is
+ * looked at once per packet, by logic_dispatch() or analog_dispatch(),
+ * which pass a view specialized on it to a functor. In C++11 that is a
+ * struct with an operator() template; in C++14 a generic lambda will do.
+ */
+
+/** @cond PRIVATE */
+namespace detail
+{
+
+template <size_t Size> struct UIntOf;
+template <> struct UIntOf<1> { typedef uint8_t type; };
+template <> struct UIntOf<2> { typedef uint16_t type; };
+template <> struct UIntOf<4> { typedef uint32_t type; };
+template <> struct UIntOf<8> { typedef uint64_t type; };
+
+inline uint8_t byteswap(uint8_t v) { return v; }
+inline uint16_t byteswap(uint16_t v) { return GUINT16_SWAP_LE_BE(v); }
+inline uint32_t byteswap(uint32_t v) { return GUINT32_SWAP_LE_BE(v); }
+inline uint64_t byteswap(uint64_t v) { return GUINT64_SWAP_LE_BE(v); }
+
+/* Load a value of type T from unaligned memory. */
+template <typename T, bool Swap> inline T load(const uint8_t *p)
+{
+	typename UIntOf<sizeof(T)>::type raw;
+	T value;
+
+	memcpy(&raw, p, sizeof(raw));
+	if (Swap)
+		raw = byteswap(raw);
+	memcpy(&value, &raw, sizeof(value));
+
+	return value;
+}
+
+/* Logic data is little-endian. */
+static const bool logic_swap = (G_BYTE_ORDER == G_BIG_ENDIAN);
+
+inline unsigned int lowest_bit(uint64_t v)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(v);
+#else
+	unsigned int i = 0;
+	while (!(v & 1)) {
+		v >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+/* The bytes of a sample, repeated over a 64-bit word. */
+template <typename Sample> inline uint64_t replicate(const uint8_t *p)
+{
+	uint64_t word;
+
+	for (size_t i = 0; i < sizeof(word); i += sizeof(Sample))
+		memcpy(reinterpret_cast<uint8_t *>(&word) + i, p, sizeof(Sample));
+
+	return word;
+}
+
+}
+/** @endcond */
+
+/** Range over the channel indices set in a logic channel mask */
+class ChannelBits
+{
+public:
+	class iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef unsigned int value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const unsigned int *pointer;
+		typedef unsigned int reference;
+
+		explicit iterator(uint64_t bits) : _bits(bits) {}
+		unsigned int operator*() const { return detail::lowest_bit(_bits); }
+		iterator &operator++() { _bits &= _bits - 1; return *this; }
+		bool operator==(const iterator &other) const { return _bits == other._bits; }
+		bool operator!=(const iterator &other) const { return _bits != other._bits; }
+	private:
+		uint64_t _bits;
+	};
+
+	explicit ChannelBits(uint64_t mask) : _mask(mask) {}
+	iterator begin() const { return iterator(_mask); }
+	iterator end() const { return iterator(0); }
+private:
+	uint64_t _mask;
+};
+
+/**
+ * View of logic samples, each held in an unsigned integer type Sample
+ * (uint8_t, uint16_t, uint32_t or uint64_t) matching the unit size.
+ */
+template <typename Sample> class LogicView
+{
+public:
+	/** A sample that differs from the one before it */
+	struct Transition
+	{
+		/** Index of the sample. */
+		size_t index;
+		/** The sample. */
+		Sample value;
+		/** The bits that changed, within the mask. */
+		Sample changed;
+	};
+
+	/** Iterator over the samples */
+	class iterator
+	{
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef Sample value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const Sample *pointer;
+		typedef Sample reference;
+
+		iterator() : _view(nullptr), _index(0) {}
+		iterator(const LogicView *view, size_t index) :
+			_view(view), _index(index) {}
+		Sample operator*() const { return (*_view)[_index]; }
+		Sample operator[](difference_type n) const { return (*_view)[_index + n]; }
+		iterator &operator++() { _index++; return *this; }
+		iterator operator++(int) { iterator it(*this); _index++; return it; }
+		iterator &operator--() { _index--; return *this; }
+		iterator operator--(int) { iterator it(*this); _index--; return it; }
+		iterator &operator+=(difference_type n) { _index += n; return *this; }
+		iterator &operator-=(difference_type n) { _index -= n; return *this; }
+		iterator operator+(difference_type n) const { return iterator(_view, _index + n); }
+		friend iterator operator+(difference_type n, const iterator &it) { return it + n; }
+		iterator operator-(difference_type n) const { return iterator(_view, _index - n); }
+		difference_type operator-(const iterator &other) const { return _index - other._index; }
+		bool operator==(const iterator &other) const { return _index == other._index; }
+		bool operator!=(const iterator &other) const { return _index != other._index; }
+		bool operator<(const iterator &other) const { return _index < other._index; }
+		bool operator>(const iterator &other) const { return _index > other._index; }
+		bool operator<=(const iterator &other) const { return _index <= other._index; }
+		bool operator>=(const iterator &other) const { return _index >= other._index; }
+	private:
+		const LogicView *_view;
+		size_t _index;
+	};
+
+	/** Iterator over the transitions within a channel mask */
+	class transition_iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef Transition value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const Transition *pointer;
+		typedef Transition reference;
+
+		transition_iterator(const LogicView *view, Sample mask, size_t index) :
+			_view(view), _mask(mask), _index(index) {}
+		Transition operator*() const
+		{
+			Transition t;
+			t.index = _index;
+			t.value = (*_view)[_index];
+			t.changed = (t.value ^ (*_view)[_index - 1]) & _mask;
+			return t;
+		}
+		transition_iterator &operator++()
+		{
+			_index = _view->next_transition(_index + 1, _mask);
+			return *this;
+		}
+		bool operator==(const transition_iterator &other) const { return _index == other._index; }
+		bool operator!=(const transition_iterator &other) const { return _index != other._index; }
+	private:
+		const LogicView *_view;
+		Sample _mask;
+		size_t _index;
+	};
+
+	/** Range over the transitions within a channel mask */
+	class Transitions
+	{
+	public:
+		Transitions(const LogicView *view, Sample mask) :
+			_view(view), _mask(mask) {}
+		transition_iterator begin() const
+		{
+			return transition_iterator(_view, _mask,
+				_view->next_transition(1, _mask));
+		}
+		transition_iterator end() const
+		{
+			return transition_iterator(_view, _mask, _view->size());
+		}
+	private:
+		const LogicView *_view;
+		Sample _mask;
+	};
+
+	/** View num_samples samples at data. */
+	LogicView(const void *data, size_t num_samples) :
+		_data(static_cast<const uint8_t *>(data)), _size(num_samples) {}
+	/** View a logic payload, whose unit size must match Sample. */
+	explicit LogicView(const shared_ptr<Logic> &logic) :
+		_data(static_cast<const uint8_t *>(logic->data_pointer())),
+		_size(logic->data_length() / sizeof(Sample))
+	{
+		if (logic->unit_size() != sizeof(Sample))
+			throw Error(SR_ERR_ARG);
+	}
+
+	/** Number of samples. */
+	size_t size() const { return _size; }
+	/** Sample at index i. */
+	Sample operator[](size_t i) const
+	{
+		return detail::load<Sample, detail::logic_swap>(_data + i * sizeof(Sample));
+	}
+	/** State of a channel in sample i. */
+	bool bit(size_t i, unsigned int channel) const
+	{
+		return ((*this)[i] >> channel) & 1;
+	}
+	iterator begin() const { return iterator(this, 0); }
+	iterator end() const { return iterator(this, _size); }
+
+	/**
+	 * Index of the first sample from start on that differs from the one
+	 * before it within mask, or size() if there is none. Runs of
+	 * unchanged samples are skipped a 64-bit word at a time.
+	 */
+	size_t next_transition(size_t start, Sample mask = Sample(~Sample(0))) const
+	{
+		const size_t per_word = sizeof(uint64_t) / sizeof(Sample);
+		Sample prev, raw_mask;
+		uint64_t word, pattern, word_mask;
+
+		if (start == 0)
+			start = 1;
+		if (start >= _size)
+			return _size;
+
+		if (per_word > 1) {
+			raw_mask = detail::load<Sample, detail::logic_swap>(
+				reinterpret_cast<const uint8_t *>(&mask));
+			pattern = detail::replicate<Sample>(_data + (start - 1) * sizeof(Sample));
+			word_mask = detail::replicate<Sample>(
+				reinterpret_cast<const uint8_t *>(&raw_mask));
+			while (start + per_word <= _size) {
+				memcpy(&word, _data + start * sizeof(Sample), sizeof(word));
+				if ((word ^ pattern) & word_mask)
+					break;
+				start += per_word;
+			}
+		}
+
+		prev = (*this)[start - 1];
+		for (; start < _size; start++)
+			if (((*this)[start] ^ prev) & mask)
+				break;
+
+		return start;
+	}
+
+	/** Transitions within a channel mask, skipping unchanged runs. */
+	Transitions transitions(Sample mask = Sample(~Sample(0))) const
+	{
+		return Transitions(this, mask);
+	}
+private:
+	const uint8_t *_data;
+	size_t _size;
+};
+
+/**
+ * Call f with a LogicView of the logic payload's unit size.
+ *
+ * @throws Error SR_ERR_NA for unit sizes other than 1, 2, 4 or 8 bytes.
+ */
+template <typename F> void logic_dispatch(const shared_ptr<Logic> &logic, F &&f)
+{
+	switch (logic->unit_size()) {
+	case 1: f(LogicView<uint8_t>(logic)); break;
+	case 2: f(LogicView<uint16_t>(logic)); break;
+	case 4: f(LogicView<uint32_t>(logic)); break;
+	case 8: f(LogicView<uint64_t>(logic)); break;
+	default: throw Error(SR_ERR_NA);
+	}
+}
+
+/**
+ * View of analog samples in their raw encoding, of type T. Swap is set
+ * if they are of the other endianness than the host's. Scale and offset
+ * are applied as samples are read.
+ */
+template <typename T, bool Swap = false> class AnalogView
+{
+public:
+	/** Iterator over the scaled samples */
+	class iterator
+	{
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef float value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const float *pointer;
+		typedef float reference;
+
+		iterator() : _view(nullptr), _index(0) {}
+		iterator(const AnalogView *view, size_t index) :
+			_view(view), _index(index) {}
+		float operator*() const { return (*_view)[_index]; }
+		float operator[](difference_type n) const { return (*_view)[_index + n]; }
+		iterator &operator++() { _index++; return *this; }
+		iterator operator++(int) { iterator it(*this); _index++; return it; }
+		iterator &operator--() { _index--; return *this; }
+		iterator operator--(int) { iterator it(*this); _index--; return it; }
+		iterator &operator+=(difference_type n) { _index += n; return *this; }
+		iterator &operator-=(difference_type n) { _index -= n; return *this; }
+		iterator operator+(difference_type n) const { return iterator(_view, _index + n); }
+		friend iterator operator+(difference_type n, const iterator &it) { return it + n; }
+		iterator operator-(difference_type n) const { return iterator(_view, _index - n); }
+		difference_type operator-(const iterator &other) const { return _index - other._index; }
+		bool operator==(const iterator &other) const { return _index == other._index; }
+		bool operator!=(const iterator &other) const { return _index != other._index; }
+		bool operator<(const iterator &other) const { return _index < other._index; }
+		bool operator>(const iterator &other) const { return _index > other._index; }
+		bool operator<=(const iterator &other) const { return _index <= other._index; }
+		bool operator>=(const iterator &other) const { return _index >= other._index; }
+	private:
+		const AnalogView *_view;
+		size_t _index;
+	};
+
+	/** View size raw values at data. */
+	AnalogView(const void *data, size_t size, float scale = 1, float offset = 0) :
+		_data(static_cast<const uint8_t *>(data)), _size(size),
+		_scale(scale), _offset(offset) {}
+	/** View an analog payload, whose encoding must match T and Swap. */
+	explicit AnalogView(const shared_ptr<Analog> &analog) :
+		_data(static_cast<const uint8_t *>(analog->data_pointer())),
+		_size(analog->num_samples() * std::max<size_t>(analog->channels().size(), 1)),
+		_scale(analog->scale()->value()),
+		_offset(analog->offset()->value())
+	{
+		if (analog->unitsize() != sizeof(T))
+			throw Error(SR_ERR_ARG);
+	}
+
+	/** Number of values, i.e. samples times interleaved channels. */
+	size_t size() const { return _size; }
+	/** Raw value at index i. */
+	T raw(size_t i) const { return detail::load<T, Swap>(_data + i * sizeof(T)); }
+	/** Scaled value at index i. */
+	float operator[](size_t i) const { return _scale * raw(i) + _offset; }
+	float scale() const { return _scale; }
+	float offset() const { return _offset; }
+	iterator begin() const { return iterator(this, 0); }
+	iterator end() const { return iterator(this, _size); }
+private:
+	const uint8_t *_data;
+	size_t _size;
+	float _scale;
+	float _offset;
+};
+
+/** @cond PRIVATE */
+namespace detail
+{
+
+template <typename T, typename F>
+void analog_dispatch_endian(const shared_ptr<Analog> &analog, F &&f)
+{
+	if (analog->is_bigendian() != (G_BYTE_ORDER == G_BIG_ENDIAN))
+		f(AnalogView<T, true>(analog));
+	else
+		f(AnalogView<T, false>(analog));
+}
+
+}
+/** @endcond */
+
+/**
+ * Call f with an AnalogView of the analog payload's raw encoding.
+ *
+ * @throws Error SR_ERR_NA for encodings without a matching C type.
+ */
+template <typename F> void analog_dispatch(const shared_ptr<Analog> &analog, F &&f)
+{
+	const unsigned int unitsize = analog->unitsize();
+
+	if (analog->is_float()) {
+		if (unitsize == sizeof(float))
+			detail::analog_dispatch_endian<float>(analog, f);
+		else if (unitsize == sizeof(double))
+			detail::analog_dispatch_endian<double>(analog, f);
+		else
+			throw Error(SR_ERR_NA);
+		return;
+	}
+
+	switch (unitsize) {
+	case 1:
+		if (analog->is_signed())
+			detail::analog_dispatch_endian<int8_t>(analog, f);
+		else
+			detail::analog_dispatch_endian<uint8_t>(analog, f);
+		break;
+	case 2:
+		if (analog->is_signed())
+			detail::analog_dispatch_endian<int16_t>(analog, f);
+		else
+			detail::analog_dispatch_endian<uint16_t>(analog, f);
+		break;
+	case 4:
+		if (analog->is_signed())
+			detail::analog_dispatch_endian<int32_t>(analog, f);
+		else
+			detail::analog_dispatch_endian<uint32_t>(analog, f);
+		break;
+	default:
+		throw Error(SR_ERR_NA);
+	}
+}
+
 }
 
 #include <libsigrokcxx/enums.hpp>
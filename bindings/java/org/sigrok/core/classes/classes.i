@@ -325,45 +325,258 @@ typedef jobject jdatafeedcallback;
 %typemap(jstype) jdatafeedcallback "DatafeedCallback"
 %typemap(javain) jdatafeedcallback "$javainput"
 
+%inline {
+namespace {
+  class JavaDatafeedCallback
+  {
+    public:
+      JavaDatafeedCallback(JNIEnv *env, jobject obj);
+      void operator() (std::shared_ptr<sigrok::Device> device,
+        std::shared_ptr<sigrok::Packet> packet) const;
+    private:
+      JavaVM *jvm;
+      jmethodID method;
+      GlobalRef<jclass> Device;
+      jmethodID Device_init;
+      GlobalRef<jclass> Packet;
+      jmethodID Packet_init;
+      GlobalRef<jobject> obj_ref;
+  };
+  JavaVM *get_java_vm(JNIEnv *env)
+  {
+    JavaVM *jvm = NULL;
+    env->GetJavaVM(&jvm);
+    return jvm;
+  }
+  JavaDatafeedCallback::JavaDatafeedCallback(JNIEnv *env, jobject obj) :
+    jvm(get_java_vm(env)),
+    method(env->GetMethodID(env->GetObjectClass(obj), "run",
+      "(Lorg/sigrok/core/classes/Device;Lorg/sigrok/core/classes/Packet;)V")),
+    Device(jvm, env->FindClass("org/sigrok/core/classes/Device")),
+    Device_init(env->GetMethodID(Device, "<init>", "(JZ)V")),
+    Packet(jvm, env->FindClass("org/sigrok/core/classes/Packet")),
+    Packet_init(env->GetMethodID(Packet, "<init>", "(JZ)V")),
+    obj_ref(jvm, obj) {}
+  void JavaDatafeedCallback::operator() (
+    std::shared_ptr<sigrok::Device> device,
+    std::shared_ptr<sigrok::Packet> packet) const
+  {
+    ScopedEnv env(jvm);
+    if (!env)
+      throw sigrok::Error(SR_ERR);
+    jlong device_addr = 0;
+    jlong packet_addr = 0;
+    *(std::shared_ptr<sigrok::Device> **) &device_addr =
+      new std::shared_ptr<sigrok::Device>(device);
+    *(std::shared_ptr<sigrok::Packet> **) &packet_addr =
+      new std::shared_ptr<sigrok::Packet>(packet);
+    jobject device_obj = env->NewObject(
+      Device, Device_init, device_addr, true);
+    jobject packet_obj = env->NewObject(
+      Packet, Packet_init, packet_addr, true);
+    env->CallVoidMethod(obj_ref, method, device_obj, packet_obj);
+    env->DeleteLocalRef(device_obj);
+    env->DeleteLocalRef(packet_obj);
+    if (env->ExceptionCheck())
+      throw sigrok::Error(SR_ERR);
+  }
+}
+}
+
 %extend sigrok::Session
 {
   void add_datafeed_callback(JNIEnv *env, jdatafeedcallback obj)
   {
-    JavaVM *jvm = NULL;
-    env->GetJavaVM(&jvm);
-    jclass obj_class = env->GetObjectClass(obj);
-    jmethodID method = env->GetMethodID(obj_class, "run",
-      "(Lorg/sigrok/core/classes/Device;Lorg/sigrok/core/classes/Packet;)V");
-    GlobalRef<jclass> Device(jvm, env->FindClass("org/sigrok/core/classes/Device"));
-    jmethodID Device_init = env->GetMethodID(Device, "<init>", "(JZ)V");
-    GlobalRef<jclass> Packet(jvm, env->FindClass("org/sigrok/core/classes/Packet"));
-    jmethodID Packet_init = env->GetMethodID(Packet, "<init>", "(JZ)V");
-    GlobalRef<jobject> obj_ref(jvm, obj);
+    $self->add_datafeed_callback(JavaDatafeedCallback(env, obj));
+  }
+}
 
-    $self->add_datafeed_callback([=] (
+/* Batched Java datafeed callbacks. */
+
+%inline {
+namespace {
+  /*
+   * Coalesces consecutive logic packets of a device into one packet of
+   * up to batch_bytes bytes of data. Other packets flush the batch and
+   * are passed on in order.
+   *
+   * The data of each packet is copied into the batch: it is only valid
+   * during its own datafeed callback, so a view could not outlive it.
+   * Packets larger than batch_bytes are passed on without a copy.
+   */
+  class DatafeedBatcher
+  {
+    public:
+      DatafeedBatcher(std::shared_ptr<sigrok::Context> context,
+        JavaDatafeedCallback callback, size_t batch_bytes);
+      void receive(std::shared_ptr<sigrok::Device> device,
+        std::shared_ptr<sigrok::Packet> packet);
+    private:
+      void flush();
+      std::shared_ptr<sigrok::Context> context;
+      JavaDatafeedCallback callback;
+      size_t batch_bytes;
+      std::vector<uint8_t> buffer;
+      std::shared_ptr<sigrok::Device> device;
+      unsigned int unit_size;
+  };
+  DatafeedBatcher::DatafeedBatcher(std::shared_ptr<sigrok::Context> context,
+    JavaDatafeedCallback callback, size_t batch_bytes) :
+    context(context), callback(callback), batch_bytes(batch_bytes),
+    unit_size(0)
+  {
+    buffer.reserve(batch_bytes);
+  }
+  void DatafeedBatcher::flush()
+  {
+    if (buffer.empty())
+      return;
+    /* The data is valid during the callback, as with any packet. */
+    callback(device, context->create_logic_packet(
+      buffer.data(), buffer.size(), unit_size));
+    buffer.clear();
+  }
+  void DatafeedBatcher::receive(std::shared_ptr<sigrok::Device> device,
+    std::shared_ptr<sigrok::Packet> packet)
+  {
+    if (packet->type() != sigrok::PacketType::LOGIC) {
+      flush();
+      callback(device, packet);
+      return;
+    }
+    auto logic = std::dynamic_pointer_cast<sigrok::Logic>(packet->payload());
+    const size_t length = logic->data_length();
+    if (this->device != device || unit_size != logic->unit_size()
+        || buffer.size() + length > batch_bytes)
+      flush();
+    if (length > batch_bytes) {
+      /* Too big to be batched, pass it on as is. */
+      callback(device, packet);
+      return;
+    }
+    this->device = device;
+    unit_size = logic->unit_size();
+    auto *const data = static_cast<const uint8_t *>(logic->data_pointer());
+    buffer.insert(buffer.end(), data, data + length);
+  }
+}
+}
+
+%extend sigrok::Session
+{
+  /*
+   * Batched variant: consecutive logic packets are passed to the
+   * callback as one packet of up to batch_bytes bytes. Their data is
+   * copied once into the batch, which saves a JNI transition per packet.
+   */
+  void add_datafeed_callback(JNIEnv *env, jdatafeedcallback obj,
+    size_t batch_bytes)
+  {
+    auto batcher = std::make_shared<DatafeedBatcher>($self->context(),
+      JavaDatafeedCallback(env, obj), batch_bytes);
+    $self->add_datafeed_callback([batcher] (
       std::shared_ptr<sigrok::Device> device,
       std::shared_ptr<sigrok::Packet> packet)
     {
-      ScopedEnv env(jvm);
-      if (!env)
-        throw sigrok::Error(SR_ERR);
-      jlong device_addr = 0;
-      jlong packet_addr = 0;
-      *(std::shared_ptr<sigrok::Device> **) &device_addr =
-        new std::shared_ptr<sigrok::Device>(device);
-      *(std::shared_ptr<sigrok::Packet> **) &packet_addr =
-        new std::shared_ptr<sigrok::Packet>(packet);
-      jobject device_obj = env->NewObject(
-        Device, Device_init, device_addr, true);
-      jobject packet_obj = env->NewObject(
-        Packet, Packet_init, packet_addr, true);
-      env->CallVoidMethod(obj_ref, method, device_obj, packet_obj);
-      if (env->ExceptionCheck())
-        throw sigrok::Error(SR_ERR);
+      batcher->receive(device, packet);
     });
   }
 }
 
+/* Direct buffer access to packet payloads. */
+
+%inline {
+typedef jobject jbytebuffer;
+typedef jobject jfloatbuffer;
+}
+
+%typemap(jni) jbytebuffer "jobject"
+%typemap(jtype) jbytebuffer "java.nio.ByteBuffer"
+%typemap(jstype) jbytebuffer "java.nio.ByteBuffer"
+%typemap(out) jbytebuffer %{ $result = $1; %}
+%typemap(javaout) jbytebuffer {
+    return $jnicall.order(java.nio.ByteOrder.nativeOrder());
+  }
+
+%typemap(jni) jfloatbuffer "jobject"
+%typemap(jtype) jfloatbuffer "java.nio.ByteBuffer"
+%typemap(jstype) jfloatbuffer "java.nio.FloatBuffer"
+%typemap(out) jfloatbuffer %{ $result = $1; %}
+%typemap(javaout) jfloatbuffer {
+    return $jnicall.order(java.nio.ByteOrder.nativeOrder()).asFloatBuffer();
+  }
+
+%extend sigrok::Packet
+{
+  std::shared_ptr<sigrok::Logic> logic_payload()
+  {
+    return std::dynamic_pointer_cast<sigrok::Logic>($self->payload());
+  }
+  std::shared_ptr<sigrok::Analog> analog_payload()
+  {
+    return std::dynamic_pointer_cast<sigrok::Analog>($self->payload());
+  }
+}
+
+%extend sigrok::Logic
+{
+  /*
+   * A direct buffer over the packet's data, without copying it. It is
+   * only valid during the datafeed callback; to keep the data, copy it
+   * with ByteBuffer.allocateDirect(n).put(buffer).
+   */
+  jbytebuffer data_buffer(JNIEnv *env)
+  {
+    return env->NewDirectByteBuffer($self->data_pointer(),
+      $self->data_length());
+  }
+}
+
+%extend sigrok::Analog
+{
+  /*
+   * The packet's samples as floats, interleaved by channel. Data that
+   * already is in native float format is returned as a direct buffer
+   * over the packet's data, valid during the datafeed callback only.
+   * Otherwise it is converted into a newly allocated direct buffer.
+   */
+  jfloatbuffer data_as_float_buffer(JNIEnv *env)
+  {
+    const uint16_t one = 1;
+    const bool host_bigendian = !*(const uint8_t *) &one;
+    const size_t length = (size_t) $self->num_samples()
+      * $self->channels().size() * sizeof(float);
+    auto scale = $self->scale();
+    auto offset = $self->offset();
+
+    if ($self->is_float() && $self->unitsize() == sizeof(float)
+        && $self->is_bigendian() == host_bigendian
+        && scale->numerator() == (int64_t) scale->denominator()
+        && offset->numerator() == 0)
+      return env->NewDirectByteBuffer($self->data_pointer(), length);
+
+    if (length > (size_t) INT32_MAX)
+      throw sigrok::Error(SR_ERR_ARG);
+
+    /* Look the class up once, and keep it across calls. */
+    static const jclass ByteBuffer = [env] {
+      jclass local = env->FindClass("java/nio/ByteBuffer");
+      auto global = static_cast<jclass>(env->NewGlobalRef(local));
+      env->DeleteLocalRef(local);
+      return global;
+    }();
+    static const jmethodID allocateDirect = env->GetStaticMethodID(
+      ByteBuffer, "allocateDirect", "(I)Ljava/nio/ByteBuffer;");
+    jobject buffer = env->CallStaticObjectMethod(ByteBuffer,
+      allocateDirect, (jint) length);
+    if (!buffer)
+      throw sigrok::Error(SR_ERR_MALLOC);
+    $self->get_data_as_float(
+      static_cast<float *>(env->GetDirectBufferAddress(buffer)));
+    return buffer;
+  }
+}
+
 %include "doc.i"
 
 %define %enumextras(Class)
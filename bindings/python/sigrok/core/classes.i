@@ -100,6 +100,32 @@ typedef guint pyg_flags_type;
     $1 = (PyObject_AsFileDescriptor($input) != -1);
 }
 
+%typemap(in) int fd {
+    $1 = PyObject_AsFileDescriptor($input);
+    if ($1 < 0)
+        SWIG_fail;
+}
+
+/* Pass objects supporting the buffer protocol to Input.send() in place. */
+%typemap(arginit) (void *data, size_t length) {
+    view$argnum.obj = nullptr;
+}
+
+%typemap(in) (void *data, size_t length) (Py_buffer view) {
+    if (PyObject_GetBuffer($input, &view, PyBUF_SIMPLE) != 0)
+        SWIG_fail;
+    $1 = view.buf;
+    $2 = view.len;
+}
+
+%typemap(freearg) (void *data, size_t length) {
+    PyBuffer_Release(&view$argnum);
+}
+
+%typecheck(SWIG_TYPECHECK_POINTER) (void *data, size_t length) {
+    $1 = PyObject_CheckBuffer($input);
+}
+
 /* Map from Glib::Variant to native Python types. */
 %typemap(out) Glib::VariantBase {
     GValue *value = g_new0(GValue, 1);
@@ -270,6 +296,10 @@ typedef guint pyg_flags_type;
     {
         return dynamic_pointer_cast<sigrok::Logic>($self->payload());
     }
+    std::shared_ptr<sigrok::AnalogPlanar> _payload_analog_planar()
+    {
+        return dynamic_pointer_cast<sigrok::AnalogPlanar>($self->payload());
+    }
 }
 
 %extend sigrok::Packet
@@ -285,6 +315,8 @@ typedef guint pyg_flags_type;
             return self._payload_logic()
         elif self.type == PacketType.ANALOG:
             return self._payload_analog()
+        elif self.type == PacketType.ANALOG_PLANAR:
+            return self._payload_analog_planar()
         else:
             return None
 
@@ -388,6 +420,13 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
 
 %}
 
+/* These use the Python C API, so they must keep holding the GIL. */
+%nothread sigrok::Driver::_scan_kwargs;
+%nothread sigrok::InputFormat::_create_input_kwargs;
+%nothread sigrok::OutputFormat::_create_output_kwargs;
+%nothread sigrok::Configurable::config_set;
+%nothread sigrok::Analog::_data;
+
 /* Ignore these methods, we will override them below. */
 %ignore sigrok::Analog::data;
 %ignore sigrok::Driver::scan;
@@ -548,4 +587,551 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
 }
 }
 
+/*
+ * Native datafeed stream.
+ *
+ * A datafeed callback written in C++ copies the sample data of each packet
+ * into a bounded queue of chunks, without taking the GIL. Python consumes
+ * whole chunks as NumPy arrays, and can have the session run on a native
+ * thread of the stream, so capture continues while Python is busy.
+ */
+%{
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+enum DatafeedStreamOverflow {
+    DATAFEED_STREAM_BLOCK = 0,
+    DATAFEED_STREAM_DROP_NEWEST = 1,
+    DATAFEED_STREAM_DROP_OLDEST = 2,
+};
+
+struct DatafeedStreamChunk
+{
+    std::shared_ptr<sigrok::Device> device;
+    const sigrok::PacketType *type;
+    /* Analog chunks only. */
+    std::vector<std::shared_ptr<sigrok::Channel> > channels;
+    /*
+     * Logic: samples of unitsize bytes. Analog: one run of capacity
+     * floats per channel.
+     */
+    uint8_t *data;
+    size_t unitsize;
+    size_t samples;
+    size_t capacity;
+};
+
+class DatafeedStreamState
+{
+public:
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<DatafeedStreamChunk> chunks;
+    size_t batch_size;
+    size_t max_samples;
+    int overflow;
+    size_t buffered = 0;
+    uint64_t dropped = 0;
+    std::atomic<bool> closed{false};
+    int error = SR_OK;
+    /* Scratch space for converting analog packets. */
+    std::vector<float> fdata;
+
+    ~DatafeedStreamState()
+    {
+        for (auto &chunk : chunks)
+            g_free(chunk.data);
+    }
+
+    /* Wait for, or make room for n samples. Returns false to drop them. */
+    bool reserve(std::unique_lock<std::mutex> &lock, size_t n)
+    {
+        if (overflow == DATAFEED_STREAM_BLOCK) {
+            not_full.wait(lock, [&] {
+                return closed || !buffered || buffered + n <= max_samples;
+            });
+            return !closed;
+        }
+        if (overflow == DATAFEED_STREAM_DROP_OLDEST) {
+            for (auto it = chunks.begin();
+                    it != chunks.end() && buffered + n > max_samples;) {
+                if (!it->samples) {
+                    ++it;
+                    continue;
+                }
+                buffered -= it->samples;
+                dropped += it->samples;
+                g_free(it->data);
+                it = chunks.erase(it);
+            }
+        }
+        if (buffered + n > max_samples) {
+            dropped += n;
+            return false;
+        }
+        return true;
+    }
+
+    /* Get a chunk with room for more samples of this kind. */
+    DatafeedStreamChunk &tail(std::shared_ptr<sigrok::Device> device,
+        const sigrok::PacketType *type, size_t unitsize,
+        const std::vector<std::shared_ptr<sigrok::Channel> > &channels)
+    {
+        if (!chunks.empty()) {
+            auto &chunk = chunks.back();
+            if (chunk.device == device && chunk.type == type
+                    && chunk.unitsize == unitsize
+                    && chunk.channels == channels
+                    && chunk.samples < chunk.capacity)
+                return chunk;
+        }
+        DatafeedStreamChunk chunk;
+        chunk.device = device;
+        chunk.type = type;
+        chunk.channels = channels;
+        chunk.unitsize = unitsize;
+        chunk.samples = 0;
+        chunk.capacity = batch_size;
+        chunk.data = static_cast<uint8_t *>(g_malloc(batch_size * unitsize));
+        chunks.push_back(std::move(chunk));
+        return chunks.back();
+    }
+
+    void push_marker(std::shared_ptr<sigrok::Device> device,
+        const sigrok::PacketType *type)
+    {
+        DatafeedStreamChunk chunk;
+        chunk.device = device;
+        chunk.type = type;
+        chunk.data = nullptr;
+        chunk.unitsize = chunk.samples = chunk.capacity = 0;
+        chunks.push_back(std::move(chunk));
+    }
+
+    void push_logic(std::shared_ptr<sigrok::Device> device,
+        std::shared_ptr<sigrok::Logic> logic)
+    {
+        const size_t unitsize = logic->unit_size();
+        if (!unitsize)
+            return;
+        auto *src = static_cast<const uint8_t *>(logic->data_pointer());
+        size_t n = logic->data_length() / unitsize;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!reserve(lock, n))
+            return;
+        buffered += n;
+        while (n) {
+            auto &chunk = tail(device, sigrok::PacketType::LOGIC, unitsize, {});
+            const size_t count = std::min(n, chunk.capacity - chunk.samples);
+            memcpy(chunk.data + chunk.samples * unitsize, src, count * unitsize);
+            chunk.samples += count;
+            src += count * unitsize;
+            n -= count;
+        }
+        not_empty.notify_one();
+    }
+
+    void push_analog(std::shared_ptr<sigrok::Device> device,
+        std::shared_ptr<sigrok::Analog> analog)
+    {
+        const auto channels = analog->channels();
+        const size_t num_channels = channels.size();
+        size_t n = analog->num_samples();
+        if (!num_channels || !n)
+            return;
+
+        /* Convert outside of the lock, into interleaved floats. */
+        fdata.resize(n * num_channels);
+        analog->get_data_as_float(fdata.data());
+        const float *src = fdata.data();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!reserve(lock, n))
+            return;
+        buffered += n;
+        while (n) {
+            auto &chunk = tail(device, sigrok::PacketType::ANALOG,
+                num_channels * sizeof(float), channels);
+            const size_t count = std::min(n, chunk.capacity - chunk.samples);
+            auto *dest = reinterpret_cast<float *>(chunk.data);
+            for (size_t i = 0; i < count; i++)
+                for (size_t c = 0; c < num_channels; c++)
+                    dest[c * chunk.capacity + chunk.samples + i] =
+                        src[i * num_channels + c];
+            chunk.samples += count;
+            src += count * num_channels;
+            n -= count;
+        }
+        not_empty.notify_one();
+    }
+
+    void receive(std::shared_ptr<sigrok::Device> device,
+        std::shared_ptr<sigrok::Packet> packet)
+    {
+        if (closed)
+            return;
+
+        const auto type = packet->type();
+        switch (type->id()) {
+        case SR_DF_LOGIC:
+            push_logic(device,
+                dynamic_pointer_cast<sigrok::Logic>(packet->payload()));
+            break;
+        case SR_DF_ANALOG:
+            push_analog(device,
+                dynamic_pointer_cast<sigrok::Analog>(packet->payload()));
+            break;
+        case SR_DF_ANALOG_PLANAR:
+            for (auto &plane : dynamic_pointer_cast<sigrok::AnalogPlanar>(
+                    packet->payload())->planes())
+                push_analog(device, plane);
+            break;
+        case SR_DF_TRIGGER:
+        case SR_DF_FRAME_BEGIN:
+        case SR_DF_FRAME_END:
+        case SR_DF_END: {
+            std::lock_guard<std::mutex> lock(mutex);
+            push_marker(device, type);
+            not_empty.notify_one();
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    void close(int result = SR_OK)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error == SR_OK)
+            error = result;
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+};
+
+class DatafeedStream
+{
+public:
+    DatafeedStream(std::shared_ptr<sigrok::Session> session,
+        size_t batch_size, size_t max_samples, int overflow) :
+        _session(session),
+        _state(std::make_shared<DatafeedStreamState>())
+    {
+        if (!batch_size || overflow < DATAFEED_STREAM_BLOCK
+                || overflow > DATAFEED_STREAM_DROP_OLDEST)
+            throw sigrok::Error(SR_ERR_ARG);
+        _state->batch_size = batch_size;
+        _state->max_samples = max_samples;
+        _state->overflow = overflow;
+        auto state = _state;
+        _callback_id = _session->add_datafeed_callback([state] (
+                std::shared_ptr<sigrok::Device> device,
+                std::shared_ptr<sigrok::Packet> packet) {
+            state->receive(device, packet);
+        });
+    }
+
+    ~DatafeedStream()
+    {
+#if PY_VERSION_HEX >= 0x03040000
+        /* The session thread may need the GIL before it can finish. */
+        PyThreadState *save = PyGILState_Check() ? PyEval_SaveThread() : nullptr;
+#endif
+        close();
+        if (_thread.joinable()) {
+            if (_session->is_running())
+                _session->stop();
+            _thread.join();
+        }
+#if PY_VERSION_HEX >= 0x03040000
+        if (save)
+            PyEval_RestoreThread(save);
+#endif
+    }
+
+    void start()
+    {
+        if (_thread.joinable())
+            throw sigrok::Error(SR_ERR);
+        auto session = _session;
+        auto state = _state;
+        _thread = std::thread([session, state] () {
+            int result = SR_OK;
+            try {
+                session->start();
+                session->run();
+            } catch (sigrok::Error &e) {
+                result = e.result;
+            }
+            state->close(result);
+        });
+    }
+
+    void close()
+    {
+        _state->close();
+        _session->remove_datafeed_callback(_callback_id);
+    }
+
+    unsigned long long dropped() const
+    {
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        return _state->dropped;
+    }
+
+    /*
+     * Wait up to timeout seconds for a chunk or the end of the stream,
+     * without taking it. Returns whether either is there.
+     */
+    bool _wait(double timeout)
+    {
+        std::unique_lock<std::mutex> lock(_state->mutex);
+        return _state->not_empty.wait_for(lock,
+            std::chrono::duration<double>(timeout), [&] {
+                return !_state->chunks.empty() || _state->closed;
+            });
+    }
+
+    /*
+     * Returns (device, packet type, channels, data) for the next chunk,
+     * None at the end of the stream, or () on timeout. Must be called
+     * with the GIL held; it is released while waiting.
+     */
+    PyObject *_get(double timeout)
+    {
+        DatafeedStreamChunk chunk;
+        bool have_chunk = false;
+        bool closed = false;
+        int error = SR_OK;
+
+        Py_BEGIN_ALLOW_THREADS
+        {
+            std::unique_lock<std::mutex> lock(_state->mutex);
+            auto ready = [&] {
+                return !_state->chunks.empty() || _state->closed;
+            };
+            if (timeout < 0)
+                _state->not_empty.wait(lock, ready);
+            else
+                _state->not_empty.wait_for(lock,
+                    std::chrono::duration<double>(timeout), ready);
+            if (!_state->chunks.empty()) {
+                chunk = std::move(_state->chunks.front());
+                _state->chunks.pop_front();
+                _state->buffered -= chunk.samples;
+                _state->not_full.notify_one();
+                have_chunk = true;
+            } else if (_state->closed) {
+                closed = true;
+                error = _state->error;
+            }
+        }
+        Py_END_ALLOW_THREADS
+
+        if (!have_chunk) {
+            if (error != SR_OK)
+                throw sigrok::Error(error);
+            if (closed)
+                Py_RETURN_NONE;
+            return PyTuple_New(0);
+        }
+
+        return chunk_to_python(chunk);
+    }
+
+private:
+    static void free_data(PyObject *capsule)
+    {
+        g_free(PyCapsule_GetPointer(capsule, nullptr));
+    }
+
+    static PyObject *chunk_to_python(DatafeedStreamChunk &chunk)
+    {
+        PyObject *data, *channels;
+
+        if (chunk.data) {
+            npy_intp dims[2], strides[2];
+            int typenum;
+            if (chunk.type == sigrok::PacketType::LOGIC) {
+                dims[0] = chunk.samples;
+                dims[1] = chunk.unitsize;
+                strides[0] = chunk.unitsize;
+                strides[1] = 1;
+                typenum = NPY_UINT8;
+            } else {
+                dims[0] = chunk.channels.size();
+                dims[1] = chunk.samples;
+                strides[0] = chunk.capacity * sizeof(float);
+                strides[1] = sizeof(float);
+                typenum = NPY_FLOAT;
+            }
+            data = PyArray_New(&PyArray_Type, 2, dims, typenum, strides,
+                chunk.data, 0, NPY_ARRAY_ALIGNED | NPY_ARRAY_WRITEABLE,
+                nullptr);
+            if (!data) {
+                g_free(chunk.data);
+                return nullptr;
+            }
+            /* The array owns the chunk's data from here on. */
+            PyArray_SetBaseObject(reinterpret_cast<PyArrayObject *>(data),
+                PyCapsule_New(chunk.data, nullptr, free_data));
+        } else {
+            data = Py_None;
+            Py_INCREF(data);
+        }
+
+        if (chunk.type == sigrok::PacketType::ANALOG) {
+            channels = PyList_New(chunk.channels.size());
+            for (size_t i = 0; i < chunk.channels.size(); i++)
+                PyList_SET_ITEM(channels, i, SWIG_NewPointerObj(
+                    SWIG_as_voidptr(new std::shared_ptr<sigrok::Channel>(
+                        chunk.channels[i])),
+                    SWIGTYPE_p_std__shared_ptrT_sigrok__Channel_t,
+                    SWIG_POINTER_OWN));
+        } else {
+            channels = Py_None;
+            Py_INCREF(channels);
+        }
+
+        auto device_obj = SWIG_NewPointerObj(
+            SWIG_as_voidptr(new std::shared_ptr<sigrok::Device>(chunk.device)),
+            SWIGTYPE_p_std__shared_ptrT_sigrok__Device_t, SWIG_POINTER_OWN);
+        auto type_obj = SWIG_NewPointerObj(
+            SWIG_as_voidptr(chunk.type), SWIGTYPE_p_sigrok__PacketType, 0);
+
+        return Py_BuildValue("(NNNN)", device_obj, type_obj, channels, data);
+    }
+
+    std::shared_ptr<sigrok::Session> _session;
+    std::shared_ptr<DatafeedStreamState> _state;
+    unsigned int _callback_id;
+    std::thread _thread;
+};
+
+%}
+
+/* _get() manages the GIL itself. */
+%nothread DatafeedStream::_get;
+
+class DatafeedStream
+{
+public:
+    DatafeedStream(std::shared_ptr<sigrok::Session> session,
+        size_t batch_size, size_t max_samples, int overflow);
+    ~DatafeedStream();
+    void start();
+    void close();
+    unsigned long long dropped() const;
+    bool _wait(double timeout);
+    PyObject *_get(double timeout);
+};
+
+%pythoncode
+{
+    import collections as _collections
+
+    class StreamOverflow(object):
+        """What a datafeed stream does when its queue is full."""
+        #: Hold up the session until Python has caught up.
+        BLOCK = 0
+        #: Discard the samples that do not fit.
+        DROP_NEWEST = 1
+        #: Discard the oldest queued samples to make room.
+        DROP_OLDEST = 2
+
+    StreamChunk = _collections.namedtuple('StreamChunk',
+        ['device', 'type', 'channels', 'data'])
+    StreamChunk.__doc__ = """A batch of datafeed samples from one device.
+
+    For logic data, data is a uint8 array of shape (samples, unitsize).
+    For analog data, it is a float32 array of shape (channels, samples),
+    and channels lists the corresponding channels. TRIGGER, FRAME_BEGIN,
+    FRAME_END and END packets are passed on in order, with data None."""
+
+    def _DatafeedStream_get(self, timeout=None):
+        """Get the next chunk of the stream.
+
+        Raises StopIteration at the end of the stream, or
+        queue.Empty if no chunk arrived within timeout seconds."""
+        result = self._get(-1.0 if timeout is None else timeout)
+        if result is None:
+            raise StopIteration
+        if not result:
+            try:
+                import queue
+            except ImportError:
+                import Queue as queue
+            raise queue.Empty
+        return StreamChunk(*result)
+
+    def _DatafeedStream_next(self):
+        return self.get()
+
+    def _DatafeedStream_anext(self):
+        import asyncio
+        loop = asyncio.get_running_loop()
+        result = loop.create_future()
+        # Wait in the executor with a timeout, so that no worker thread
+        # is stuck on a stream nobody awaits any more, and take the chunk
+        # on the loop, so that none is lost if the await was cancelled.
+        def poll():
+            loop.run_in_executor(None, self._wait, 0.1).add_done_callback(done)
+        def done(future):
+            if result.done():
+                return
+            if future.cancelled():
+                result.cancel()
+                return
+            if future.exception() is not None:
+                result.set_exception(future.exception())
+                return
+            try:
+                chunk = self._get(0.0)
+            except Exception as e:
+                result.set_exception(e)
+                return
+            if chunk is None:
+                result.set_exception(StopAsyncIteration())
+            elif not chunk:
+                poll()
+            else:
+                result.set_result(StreamChunk(*chunk))
+        poll()
+        return result
+
+    DatafeedStream.get = _DatafeedStream_get
+    DatafeedStream.__iter__ = lambda self: self
+    DatafeedStream.__next__ = _DatafeedStream_next
+    DatafeedStream.next = _DatafeedStream_next
+    DatafeedStream.__aiter__ = lambda self: self
+    DatafeedStream.__anext__ = _DatafeedStream_anext
+    DatafeedStream.__enter__ = lambda self: self
+    DatafeedStream.__exit__ = lambda self, *args: self.close()
+
+    def _Session_stream(self, batch_size=65536, max_samples=1 << 24,
+            overflow=StreamOverflow.BLOCK):
+        """Create a native datafeed stream for this session.
+
+        Packets are queued by a native datafeed callback, without taking
+        the GIL. Iterate over the stream, or await it with async for, to
+        get StreamChunk objects with up to batch_size samples each. At
+        most max_samples samples are queued; see StreamOverflow.
+
+        Call start() on the stream to start the session and run it on a
+        native thread. The stream ends when the session stops. If the
+        session is run otherwise, call close() to end the stream."""
+        return DatafeedStream(self, batch_size, max_samples, overflow)
+
+    Session.stream = _Session_stream
+}
+
 %include "doc_end.i"
@@ -201,6 +201,10 @@ static VALUE variant_to_ruby(Glib::VariantBase variant)
             return SWIG_NewPointerObj(
                 SWIG_as_voidptr(new std::shared_ptr<sigrok::Analog>(dynamic_pointer_cast<sigrok::Analog>($self->payload()))),
                 SWIGTYPE_p_std__shared_ptrT_sigrok__Analog_t, SWIG_POINTER_OWN);
+        } else if ($self->type() == sigrok::PacketType::ANALOG_PLANAR) {
+            return SWIG_NewPointerObj(
+                SWIG_as_voidptr(new std::shared_ptr<sigrok::AnalogPlanar>(dynamic_pointer_cast<sigrok::AnalogPlanar>($self->payload()))),
+                SWIGTYPE_p_std__shared_ptrT_sigrok__AnalogPlanar_t, SWIG_POINTER_OWN);
         } else if ($self->type() == sigrok::PacketType::LOGIC) {
             return SWIG_NewPointerObj(
                 SWIG_as_voidptr(new std::shared_ptr<sigrok::Logic>(dynamic_pointer_cast<sigrok::Logic>($self->payload()))),
@@ -64,6 +64,7 @@ template< class T > class enable_shared_from_this;
 %shared_ptr(sigrok::Header);
 %shared_ptr(sigrok::Meta);
 %shared_ptr(sigrok::Analog);
+%shared_ptr(sigrok::AnalogPlanar);
 %shared_ptr(sigrok::Logic);
 %shared_ptr(sigrok::InputFormat);
 %shared_ptr(sigrok::Input);
@@ -80,6 +81,21 @@ template< class T > class enable_shared_from_this;
 #define SR_PRIV
 
 %ignore sigrok::DatafeedCallbackData;
+/* Language bindings provide their own datafeed streams. */
+%ignore sigrok::PacketStream;
+%ignore sigrok::Session::stream;
+/* The sample iteration templates are for C++ only. */
+%ignore sigrok::ChannelBits;
+%ignore sigrok::detail::byteswap;
+%ignore sigrok::detail::load;
+%ignore sigrok::detail::logic_swap;
+%ignore sigrok::detail::lowest_bit;
+%ignore sigrok::detail::replicate;
+%ignore sigrok::detail::analog_dispatch_endian;
+%ignore sigrok::LogicView;
+%ignore sigrok::AnalogView;
+%ignore sigrok::logic_dispatch;
+%ignore sigrok::analog_dispatch;
 
 #ifndef SWIGJAVA
 
@@ -211,6 +227,10 @@ typedef std::map<const sigrok::ConfigKey *, Glib::VariantBase>
 %attribute(sigrok::Analog, const sigrok::Unit *, unit, unit);
 %attributevector(Analog, std::vector<const sigrok::QuantityFlag *>, mq_flags, mq_flags);
 
+%attribute(sigrok::AnalogPlanar, int, num_samples, num_samples);
+%attributevector(AnalogPlanar,
+    std::vector<std::shared_ptr<sigrok::Analog> >, planes, planes);
+
 #endif
 
 %include <libsigrokcxx/libsigrokcxx.hpp>
@@ -52,6 +52,9 @@ namespace std {
 %template(ChannelVector)
     std::vector<std::shared_ptr<sigrok::Channel> >;
 
+%template(AnalogVector)
+    std::vector<std::shared_ptr<sigrok::Analog> >;
+
 %template(ChannelGroupMap)
     std::map<std::string, std::shared_ptr<sigrok::ChannelGroup> >;
 
@@ -168,6 +168,8 @@ enum sr_packettype {
 	SR_DF_FRAME_END,
 	/** Payload is struct sr_datafeed_analog. */
 	SR_DF_ANALOG,
+	/** Payload is struct sr_datafeed_analog_planar. */
+	SR_DF_ANALOG_PLANAR,
 
 	/* Update datafeed_dump() (session.c) upon changes! */
 };
@@ -505,6 +507,24 @@ struct sr_datafeed_analog {
 	struct sr_analog_spec *spec;
 };
 
+/**
+ * Planar analog datafeed payload for type SR_DF_ANALOG_PLANAR.
+ *
+ * Carries the same number of samples for several channels, taken at the
+ * same points in time. Each plane is a complete analog payload with its
+ * own data buffer, encoding, meaning and spec, so that channels with
+ * different resolutions or quantities can be sent in a single packet.
+ * Each plane's num_samples equals the packet's num_samples.
+ */
+struct sr_datafeed_analog_planar {
+	/** Number of samples in each plane. */
+	uint32_t num_samples;
+	/** Number of entries in planes. */
+	uint32_t num_planes;
+	/** The planes, usually one per channel. */
+	struct sr_datafeed_analog *planes;
+};
+
 struct sr_analog_encoding {
 	uint8_t unitsize;
 	gboolean is_signed;
@@ -627,6 +647,40 @@ struct sr_config {
 	GVariant *data;
 };
 
+/** Channel saved in a session file. */
+struct sr_session_file_channel {
+	/** The index the channel gets when the file is loaded. */
+	int index;
+	/** Channel type (SR_CHANNEL_LOGIC, ...) */
+	int type;
+	/** Name of channel. */
+	char *name;
+};
+
+/** Chunk of sample data in a session file. */
+struct sr_session_file_chunk {
+	/** Name of the archive member holding the chunk. */
+	char *name;
+	/** Number of samples in the chunk. */
+	uint64_t num_samples;
+};
+
+/** Summary of a session file, see sr_session_file_info(). */
+struct sr_session_file_info {
+	/** Samplerate in Hz, 0 if unknown. */
+	uint64_t samplerate;
+	/** Bytes per logic sample, 0 if the file has no logic data. */
+	unsigned int unitsize;
+	/** Number of samples per channel. */
+	uint64_t total_samples;
+	/** Sample number of the trigger, or -1 if none or unknown. */
+	int64_t trigger_pos;
+	/** List of struct sr_session_file_channel, ordered by index. */
+	GSList *channels;
+	/** List of struct sr_session_file_chunk, in file order. */
+	GSList *chunks;
+};
+
 enum sr_keytype {
 	SR_KEY_CONFIG,
 	SR_KEY_MQ,
@@ -30,6 +30,8 @@
 
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		float *buf);
+SR_API int sr_analog_planar_to_float(
+		const struct sr_datafeed_analog_planar *planar, float *buf);
 SR_API const char *sr_analog_si_prefix(float *value, int *digits);
 SR_API gboolean sr_analog_si_prefix_friendly(enum sr_unit unit);
 SR_API int sr_analog_unit_to_string(const struct sr_datafeed_analog *analog,
@@ -45,6 +47,7 @@ SR_API int sr_rational_div(struct sr_rational *res, const struct sr_rational *nu
 
 SR_API int sr_init(struct sr_context **ctx);
 SR_API int sr_exit(struct sr_context *ctx);
+SR_API int sr_sanity_check(const struct sr_context *ctx);
 
 SR_API GSList *sr_buildinfo_libs_get(void);
 SR_API char *sr_buildinfo_host_get(void);
@@ -83,6 +86,12 @@ SR_API const char *sr_dev_inst_version_get(const struct sr_dev_inst *sdi);
 SR_API const char *sr_dev_inst_sernum_get(const struct sr_dev_inst *sdi);
 SR_API const char *sr_dev_inst_connid_get(const struct sr_dev_inst *sdi);
 SR_API GSList *sr_dev_inst_channels_get(const struct sr_dev_inst *sdi);
+SR_API struct sr_channel *const *sr_dev_inst_enabled_channels_get(
+		const struct sr_dev_inst *sdi, int type, unsigned int *count);
+SR_API const int *sr_dev_inst_enabled_logic_indices_get(
+		const struct sr_dev_inst *sdi, unsigned int *count);
+SR_API const uint8_t *sr_dev_inst_enabled_logic_mask_get(
+		const struct sr_dev_inst *sdi, unsigned int *size);
 SR_API GSList *sr_dev_inst_channel_groups_get(const struct sr_dev_inst *sdi);
 
 SR_API struct sr_dev_inst *sr_dev_inst_user_new(const char *vendor,
@@ -94,6 +103,8 @@ SR_API int sr_dev_inst_channel_add(struct sr_dev_inst *sdi, int index, int type,
 SR_API struct sr_dev_driver **sr_driver_list(const struct sr_context *ctx);
 SR_API int sr_driver_init(struct sr_context *ctx,
 		struct sr_dev_driver *driver);
+SR_API struct sr_dev_driver *sr_driver_get(struct sr_context *ctx,
+		const char *name);
 SR_API GArray *sr_driver_scan_options_list(const struct sr_dev_driver *driver);
 SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options);
 SR_API int sr_config_get(const struct sr_dev_driver *driver,
@@ -122,6 +133,9 @@ SR_API struct sr_trigger *sr_session_trigger_get(struct sr_session *session);
 /* Session setup */
 SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	struct sr_session **session);
+SR_API int sr_session_file_info(const char *filename,
+	struct sr_session_file_info **info);
+SR_API void sr_session_file_info_free(struct sr_session_file_info *info);
 SR_API int sr_session_new(struct sr_context *ctx, struct sr_session **session);
 SR_API int sr_session_destroy(struct sr_session *session);
 SR_API int sr_session_dev_remove_all(struct sr_session *session);
@@ -131,11 +145,24 @@ SR_API int sr_session_dev_remove(struct sr_session *session,
 		struct sr_dev_inst *sdi);
 SR_API int sr_session_dev_list(struct sr_session *session, GSList **devlist);
 SR_API int sr_session_trigger_set(struct sr_session *session, struct sr_trigger *trig);
+SR_API int sr_session_analog_planar_set(struct sr_session *session,
+		gboolean enable);
+SR_API int sr_session_memory_budget_set(struct sr_session *session,
+		uint64_t budget);
+SR_API int sr_session_memory_spill_dir_set(struct sr_session *session,
+		const char *dir);
+SR_API int sr_session_memory_usage_get(struct sr_session *session,
+		uint64_t *used, uint64_t *budget);
+SR_API int sr_session_usb_event_thread_set(struct sr_session *session,
+		gboolean enable, int priority, int cpu);
 
 /* Datafeed setup */
 SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session);
 SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 		sr_datafeed_callback cb, void *cb_data);
+SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **copy);
+SR_API void sr_packet_free(struct sr_datafeed_packet *packet);
 
 /* Session control */
 SR_API int sr_session_start(struct sr_session *session);
@@ -145,6 +172,17 @@ SR_API int sr_session_is_running(struct sr_session *session);
 SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 		sr_session_stopped_callback cb, void *cb_data);
 
+/*--- session_recorder.c ----------------------------------------------------*/
+
+SR_API int sr_session_recorder_set(struct sr_session *session,
+		uint64_t max_bytes, uint64_t max_msec);
+SR_API int sr_session_recorder_trigger_save_set(struct sr_session *session,
+		const char *dir, uint64_t post_msec);
+SR_API int sr_session_recorder_snapshot(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data);
+SR_API int sr_session_recorder_save(struct sr_session *session,
+		const char *filename);
+
 /*--- input/input.c ---------------------------------------------------------*/
 
 SR_API const struct sr_input_module **sr_input_list(void);
@@ -164,6 +202,10 @@ SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in);
 SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in);
 SR_API struct sr_dev_inst *sr_input_dev_inst_get(const struct sr_input *in);
 SR_API int sr_input_send(const struct sr_input *in, GString *buf);
+SR_API int sr_input_send_data(const struct sr_input *in,
+		const void *data, size_t len);
+SR_API int sr_input_send_fd(const struct sr_input *in, int fd,
+		gboolean *eof);
 SR_API int sr_input_end(const struct sr_input *in);
 SR_API int sr_input_reset(const struct sr_input *in);
 SR_API void sr_input_free(const struct sr_input *in);
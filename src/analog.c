@@ -199,6 +199,13 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		int16_t *data16 = (int16_t *)(analog->data);
 		int32_t *data32 = (int32_t *)(analog->data);
 
+		/* The vectorized kernels only handle the native byte order. */
+		if ((is_bigendian == bigendian || analog->encoding->unitsize == 1)
+				&& sr_simd_get()->int_to_float(analog->data,
+					analog->encoding->unitsize, is_signed, outbuf,
+					count, scale, offset) == SR_OK)
+			return SR_OK;
+
 		switch (analog->encoding->unitsize) {
 		case 1:
 			if (is_signed) {
@@ -295,6 +302,46 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 	return SR_OK;
 }
 
+/**
+ * Convert a planar analog datafeed payload to an array of floats.
+ *
+ * The planes are stored one after the other in outbuf, each as converted
+ * by sr_analog_to_float(). Sufficient memory for outbuf must have been
+ * pre-allocated by the caller: num_samples floats times the number of
+ * channels, summed over all planes.
+ *
+ * @param[in] planar The planar analog payload to convert. Must not be NULL.
+ * @param[out] outbuf Memory where to store the result. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_analog_planar_to_float(
+		const struct sr_datafeed_analog_planar *planar, float *outbuf)
+{
+	const struct sr_datafeed_analog *plane;
+	unsigned int i;
+	int ret;
+
+	if (!planar || !outbuf || (planar->num_planes && !planar->planes))
+		return SR_ERR_ARG;
+
+	for (i = 0; i < planar->num_planes; i++) {
+		plane = &planar->planes[i];
+		if (plane->num_samples != planar->num_samples)
+			return SR_ERR_ARG;
+		if ((ret = sr_analog_to_float(plane, outbuf)) != SR_OK)
+			return ret;
+		outbuf += plane->num_samples
+			* g_slist_length(plane->meaning->channels);
+	}
+
+	return SR_OK;
+}
+
 /**
  * Scale a float value to the appropriate SI prefix.
  *
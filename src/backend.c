@@ -500,11 +500,57 @@ static int sanity_check_all_transform_modules(void)
 	return ret;
 }
 
+/**
+ * Sanity-check all drivers and input, output and transform modules.
+ *
+ * These checks catch programming errors in libsigrok itself. To keep
+ * startup fast, sr_init() only runs them when the log level is at least
+ * SR_LOG_DBG, or when the SIGROK_SANITY_CHECKS environment variable is set.
+ *
+ * @param ctx Pointer to a libsigrok context struct. Must not be NULL.
+ *
+ * @retval SR_OK All drivers and modules are OK.
+ * @retval SR_ERR One or more drivers or modules have issues.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_sanity_check(const struct sr_context *ctx)
+{
+	if (!ctx)
+		return SR_ERR_ARG;
+
+	if (sanity_check_all_drivers(ctx) < 0) {
+		sr_err("Internal driver error(s).");
+		return SR_ERR;
+	}
+
+	if (sanity_check_all_input_modules() < 0) {
+		sr_err("Internal input module error(s).");
+		return SR_ERR;
+	}
+
+	if (sanity_check_all_output_modules() < 0) {
+		sr_err("Internal output module error(s).");
+		return SR_ERR;
+	}
+
+	if (sanity_check_all_transform_modules() < 0) {
+		sr_err("Internal transform module error(s).");
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
 /**
  * Initialize libsigrok.
  *
  * This function must be called before any other libsigrok function.
  *
+ * Subsystems like libusb are set up on first use, and drivers are only
+ * initialized by sr_driver_init() or sr_driver_get(), so this is cheap.
+ *
  * @param ctx Pointer to a libsigrok context struct pointer. Must not be NULL.
  *            This will be a pointer to a newly allocated libsigrok context
  *            object upon success, and is undefined upon errors.
@@ -524,7 +570,8 @@ SR_API int sr_init(struct sr_context **ctx)
 	WSADATA wsadata;
 #endif
 
-	print_versions();
+	if (sr_log_loglevel_get() >= SR_LOG_DBG)
+		print_versions();
 
 	if (!ctx) {
 		sr_err("%s(): libsigrok context was NULL.", __func__);
@@ -535,24 +582,12 @@ SR_API int sr_init(struct sr_context **ctx)
 
 	sr_drivers_init(context);
 
-	if (sanity_check_all_drivers(context) < 0) {
-		sr_err("Internal driver error(s), aborting.");
-		return ret;
-	}
-
-	if (sanity_check_all_input_modules() < 0) {
-		sr_err("Internal input module error(s), aborting.");
-		return ret;
-	}
-
-	if (sanity_check_all_output_modules() < 0) {
-		sr_err("Internal output module error(s), aborting.");
-		return ret;
-	}
-
-	if (sanity_check_all_transform_modules() < 0) {
-		sr_err("Internal transform module error(s), aborting.");
-		return ret;
+	if (sr_log_loglevel_get() >= SR_LOG_DBG
+			|| g_getenv("SIGROK_SANITY_CHECKS")) {
+		if (sr_sanity_check(context) != SR_OK) {
+			sr_err("Internal error(s), aborting.");
+			goto done;
+		}
 	}
 
 #ifdef _WIN32
@@ -563,23 +598,15 @@ SR_API int sr_init(struct sr_context **ctx)
 	}
 #endif
 
-#ifdef HAVE_LIBUSB_1_0
-	ret = libusb_init(&context->libusb_ctx);
-	if (LIBUSB_SUCCESS != ret) {
-		sr_err("libusb_init() returned %s.", libusb_error_name(ret));
-		ret = SR_ERR;
-		goto done;
-	}
-#endif
 	sr_resource_set_hooks(context, NULL, NULL, NULL, NULL);
 
 	*ctx = context;
 	context = NULL;
 	ret = SR_OK;
 
-#if defined(HAVE_LIBUSB_1_0) || defined(_WIN32)
 done:
-#endif
+	if (context)
+		g_free(context->driver_list);
 	g_free(context);
 	return ret;
 }
@@ -608,7 +635,8 @@ SR_API int sr_exit(struct sr_context *ctx)
 #endif
 
 #ifdef HAVE_LIBUSB_1_0
-	libusb_exit(ctx->libusb_ctx);
+	if (ctx->libusb_ctx)
+		libusb_exit(ctx->libusb_ctx);
 #endif
 
 	g_free(sr_driver_list(ctx));
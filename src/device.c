@@ -69,6 +69,7 @@ SR_PRIV struct sr_channel *sr_channel_new(struct sr_dev_inst *sdi,
 		ch->name = g_strdup(name);
 
 	sdi->channels = g_slist_append(sdi->channels, ch);
+	sr_dev_inst_channels_changed(sdi);
 
 	return ch;
 }
@@ -123,6 +124,8 @@ SR_API int sr_dev_channel_enable(struct sr_channel *channel, gboolean state)
 	sdi = channel->sdi;
 	was_enabled = channel->enabled;
 	channel->enabled = state;
+	if (!state != !was_enabled)
+		sr_dev_inst_channels_changed(sdi);
 	if (!state != !was_enabled && sdi->driver
 			&& sdi->driver->config_channel_set) {
 		ret = sdi->driver->config_channel_set(
@@ -135,25 +138,184 @@ SR_API int sr_dev_channel_enable(struct sr_channel *channel, gboolean state)
 	return SR_OK;
 }
 
-/* Returns the next enabled channel, wrapping around if necessary. */
+/*
+ * Returns the next enabled channel, wrapping around if necessary. Starts
+ * with the first channel when cur_channel is NULL. Returns NULL if no
+ * channel is enabled.
+ */
 /** @private */
 SR_PRIV struct sr_channel *sr_next_enabled_channel(const struct sr_dev_inst *sdi,
-
 		struct sr_channel *cur_channel)
 {
-	struct sr_channel *next_channel;
+	struct sr_dev_channel_cache *cache;
+	struct sr_channel *next;
+	unsigned int i, pos;
+
+	cache = sr_dev_inst_channel_cache_get(sdi);
+	if (!cache->num_enabled) {
+		sr_dev_channel_cache_unref(cache);
+		return NULL;
+	}
+
+	for (pos = 0; pos < cache->num_all; pos++) {
+		if (cache->all[pos] == cur_channel)
+			break;
+	}
+	/* Not a channel of sdi: start with the first one. */
+	if (pos == cache->num_all)
+		pos = cache->num_all - 1;
+
+	for (i = 1; i <= cache->num_all; i++) {
+		if (cache->all[(pos + i) % cache->num_all]->enabled)
+			break;
+	}
+	next = cache->all[(pos + i) % cache->num_all];
+	sr_dev_channel_cache_unref(cache);
+
+	return next;
+}
+
+/**
+ * Tell a device instance that its channel list, or the enabled state of
+ * its channels, has changed.
+ *
+ * This is taken care of by sr_channel_new() and sr_dev_channel_enable().
+ * Drivers that change sr_channel::enabled directly need to call this.
+ *
+ * @param sdi The device instance.
+ *
+ * @private
+ */
+SR_PRIV void sr_dev_inst_channels_changed(struct sr_dev_inst *sdi)
+{
+	if (sdi)
+		g_atomic_int_inc(&sdi->channels_version);
+}
+
+/**
+ * Release a reference to a device instance's channel arrays.
+ *
+ * @param cache The arrays, as returned by sr_dev_inst_channel_cache_get().
+ *              May be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_dev_channel_cache_unref(struct sr_dev_channel_cache *cache)
+{
+	if (!cache || !g_atomic_int_dec_and_test(&cache->refcount))
+		return;
+
+	g_free(cache->all);
+	g_free(cache->enabled);
+	g_free(cache->logic);
+	g_free(cache->logic_index);
+	g_free(cache->analog);
+	g_free(cache->logic_mask);
+	g_free(cache);
+}
+
+static struct sr_dev_channel_cache *channel_cache_new(
+		const struct sr_dev_inst *sdi, int version)
+{
+	struct sr_dev_channel_cache *cache;
+	struct sr_channel *ch;
+	unsigned int n, max_index;
 	GSList *l;
 
-	next_channel = cur_channel;
-	do {
-		l = g_slist_find(sdi->channels, next_channel);
-		if (l && l->next)
-			next_channel = l->next->data;
-		else
-			next_channel = sdi->channels->data;
-	} while (!next_channel->enabled);
+	cache = g_malloc0(sizeof(struct sr_dev_channel_cache));
+	cache->refcount = 1;
+	cache->version = version;
+
+	n = g_slist_length(sdi->channels);
+	cache->all = g_malloc(sizeof(struct sr_channel *) * (n + 1));
+	cache->enabled = g_malloc(sizeof(struct sr_channel *) * (n + 1));
+	cache->logic = g_malloc(sizeof(struct sr_channel *) * (n + 1));
+	cache->logic_index = g_malloc(sizeof(int) * (n + 1));
+	cache->analog = g_malloc(sizeof(struct sr_channel *) * (n + 1));
+
+	max_index = 0;
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		cache->all[cache->num_all++] = ch;
+		if (ch->type == SR_CHANNEL_LOGIC && ch->index >= 0)
+			max_index = MAX(max_index, (unsigned int)ch->index + 1);
+		if (!ch->enabled)
+			continue;
+		cache->enabled[cache->num_enabled++] = ch;
+		if (ch->type == SR_CHANNEL_LOGIC) {
+			cache->logic_index[cache->num_logic] = ch->index;
+			cache->logic[cache->num_logic++] = ch;
+		} else if (ch->type == SR_CHANNEL_ANALOG) {
+			cache->analog[cache->num_analog++] = ch;
+		}
+	}
+
+	cache->logic_mask_size = (max_index + 7) / 8;
+	cache->logic_mask = g_malloc0(cache->logic_mask_size + 1);
+	for (n = 0; n < cache->num_logic; n++) {
+		if (cache->logic_index[n] < 0)
+			continue;
+		cache->logic_mask[cache->logic_index[n] / 8] |=
+			1 << (cache->logic_index[n] % 8);
+	}
+
+	return cache;
+}
+
+/**
+ * Get a device instance's channels as arrays.
+ *
+ * The arrays are a snapshot, which is only rebuilt when the channels
+ * have changed since the last call, so this is cheap enough to be used
+ * for every packet. The snapshot stays valid for as long as the caller
+ * holds the reference, even if the channels change in the meantime.
+ *
+ * @param sdi The device instance. Must not be NULL.
+ *
+ * @return The arrays. Release them with sr_dev_channel_cache_unref().
+ *
+ * @private
+ */
+SR_PRIV struct sr_dev_channel_cache *sr_dev_inst_channel_cache_get(
+		const struct sr_dev_inst *sdi)
+{
+	struct sr_dev_inst *inst;
+	struct sr_dev_channel_cache *cache, *old;
+	int version;
+
+	/* The cache is not part of the device's state, hence the cast. */
+	inst = (struct sr_dev_inst *)sdi;
+
+	g_bit_lock(&inst->channel_cache_lock, 0);
+	version = g_atomic_int_get(&sdi->channels_version);
+	old = NULL;
+	cache = sdi->channel_cache;
+	if (!cache || cache->version != version) {
+		old = cache;
+		cache = inst->channel_cache = channel_cache_new(sdi, version);
+	}
+	g_atomic_int_inc(&cache->refcount);
+	g_bit_unlock(&inst->channel_cache_lock, 0);
+
+	/* Whoever still uses the old snapshot keeps it alive. */
+	sr_dev_channel_cache_unref(old);
+
+	return cache;
+}
+
+/*
+ * The device's current snapshot, for the public accessors below, whose
+ * results remain valid until the channels change.
+ */
+static const struct sr_dev_channel_cache *channel_cache_peek(
+		const struct sr_dev_inst *sdi)
+{
+	struct sr_dev_channel_cache *cache;
+
+	cache = sr_dev_inst_channel_cache_get(sdi);
+	sr_dev_channel_cache_unref(cache);
 
-	return next_channel;
+	return cache;
 }
 
 /**
@@ -371,6 +533,8 @@ SR_PRIV void sr_dev_inst_free(struct sr_dev_inst *sdi)
 	}
 	g_slist_free(sdi->channel_groups);
 
+	sr_dev_channel_cache_unref(sdi->channel_cache);
+
 	if (sdi->session)
 		sr_session_dev_remove(sdi->session, sdi);
 
@@ -700,7 +864,7 @@ SR_API const char *sr_dev_inst_connid_get(const struct sr_dev_inst *sdi)
 		drvc = sdi->driver->context;
 		usb = sdi->conn;
 
-		if ((cnt = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist)) < 0) {
+		if ((cnt = libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist)) < 0) {
 			sr_err("Failed to retrieve device list: %s.",
 			       libusb_error_name(cnt));
 			return NULL;
@@ -740,6 +904,108 @@ SR_API GSList *sr_dev_inst_channels_get(const struct sr_dev_inst *sdi)
 	return sdi->channels;
 }
 
+/**
+ * Queries a device instance's enabled channels.
+ *
+ * The array is owned by the device instance. It remains valid until a
+ * channel gets added, enabled or disabled.
+ *
+ * @param sdi Device instance to use. Must not be NULL.
+ * @param type SR_CHANNEL_LOGIC or SR_CHANNEL_ANALOG to get the enabled
+ *             channels of that type, or 0 to get all enabled channels.
+ * @param count Will be set to the number of channels in the array.
+ *             Must not be NULL.
+ *
+ * @return The enabled channels, in channel list order, or NULL on
+ *         invalid arguments.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_channel *const *sr_dev_inst_enabled_channels_get(
+		const struct sr_dev_inst *sdi, int type, unsigned int *count)
+{
+	const struct sr_dev_channel_cache *cache;
+
+	if (!sdi || !count)
+		return NULL;
+
+	cache = channel_cache_peek(sdi);
+	switch (type) {
+	case 0:
+		*count = cache->num_enabled;
+		return cache->enabled;
+	case SR_CHANNEL_LOGIC:
+		*count = cache->num_logic;
+		return cache->logic;
+	case SR_CHANNEL_ANALOG:
+		*count = cache->num_analog;
+		return cache->analog;
+	default:
+		*count = 0;
+		return NULL;
+	}
+}
+
+/**
+ * Queries the indices of a device instance's enabled logic channels,
+ * i.e. their bit positions within a logic sample.
+ *
+ * The array is owned by the device instance. It remains valid until a
+ * channel gets added, enabled or disabled.
+ *
+ * @param sdi Device instance to use. Must not be NULL.
+ * @param count Will be set to the number of indices in the array.
+ *             Must not be NULL.
+ *
+ * @return The indices, in channel list order, or NULL on invalid
+ *         arguments.
+ *
+ * @since 0.6.0
+ */
+SR_API const int *sr_dev_inst_enabled_logic_indices_get(
+		const struct sr_dev_inst *sdi, unsigned int *count)
+{
+	const struct sr_dev_channel_cache *cache;
+
+	if (!sdi || !count)
+		return NULL;
+
+	cache = channel_cache_peek(sdi);
+	*count = cache->num_logic;
+
+	return cache->logic_index;
+}
+
+/**
+ * Queries the mask of a device instance's enabled logic channels: bit n
+ * of the mask (least significant bit of the first byte first) is set if
+ * the logic channel with index n is enabled.
+ *
+ * The array is owned by the device instance. It remains valid until a
+ * channel gets added, enabled or disabled.
+ *
+ * @param sdi Device instance to use. Must not be NULL.
+ * @param size Will be set to the size of the mask in bytes, which covers
+ *             all logic channels. Must not be NULL.
+ *
+ * @return The mask, or NULL on invalid arguments.
+ *
+ * @since 0.6.0
+ */
+SR_API const uint8_t *sr_dev_inst_enabled_logic_mask_get(
+		const struct sr_dev_inst *sdi, unsigned int *size)
+{
+	const struct sr_dev_channel_cache *cache;
+
+	if (!sdi || !size)
+		return NULL;
+
+	cache = channel_cache_peek(sdi);
+	*size = cache->logic_mask_size;
+
+	return cache->logic_mask;
+}
+
 /**
  * Queries a device instances' channel groups list.
  *
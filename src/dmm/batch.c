@@ -0,0 +1,83 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ *
+ * Decode a buffer of DMM chip packets in one pass.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "dmm-batch"
+
+/**
+ * Decode several packets of a DMM chip into arrays.
+ *
+ * The packets are decoded with the chip's own parser, but the readings
+ * end up in plain arrays rather than in an analog packet each, so the
+ * caller can send readings of the same kind together.
+ *
+ * @param buf The packets, back to back. They must have been validated.
+ * @param packet_size The size of one packet in bytes.
+ * @param count The number of packets in buf.
+ * @param parse The chip's packet parser.
+ * @param details The device specific post-processing, or NULL.
+ * @param info The chip's info struct, for use by the parser.
+ * @param values Will be filled with count values.
+ * @param readings Will be filled with what the count values measure. The
+ *                 mq of packets that held no reading is 0.
+ *
+ * @return The number of packets that held a reading.
+ */
+SR_PRIV unsigned int sr_dmm_parse_batch(const uint8_t *buf, int packet_size,
+		unsigned int count, sr_dmm_parse_func parse,
+		sr_dmm_details_func details, void *info,
+		float *values, struct sr_dmm_reading *readings)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	unsigned int i, num_readings;
+
+	num_readings = 0;
+	for (i = 0; i < count; i++, buf += packet_size) {
+		/* Note: digits/spec_digits will be overridden by the parsers. */
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
+		analog.num_samples = 1;
+		analog.meaning->mq = 0;
+
+		values[i] = 0;
+		parse(buf, &values[i], &analog, info);
+		if (details)
+			details(&analog, info);
+
+		readings[i].mq = analog.meaning->mq;
+		readings[i].unit = analog.meaning->unit;
+		readings[i].mqflags = analog.meaning->mqflags;
+		readings[i].digits = analog.encoding->digits;
+		readings[i].spec_digits = analog.spec->spec_digits;
+		if (readings[i].mq)
+			num_readings++;
+	}
+
+	return num_readings;
+}
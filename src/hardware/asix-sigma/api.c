@@ -150,6 +150,9 @@ static int dev_open(struct sr_dev_inst *sdi)
 		return 0;
 	}
 
+	/* Don't trust whatever setup the hardware was left with. */
+	devc->hw_setup_valid = FALSE;
+
 	sdi->status = SR_ST_ACTIVE;
 
 	return SR_OK;
@@ -287,32 +290,27 @@ static int config_list(uint32_t key, GVariant **data, const struct sr_dev_inst *
 	return SR_OK;
 }
 
-static int dev_acquisition_start(const struct sr_dev_inst *sdi)
+/*
+ * Program the trigger, clock and post trigger registers. The FPGA keeps
+ * them across acquisitions, so this is skipped when neither the trigger
+ * nor the samplerate or capture ratio changed since the last write.
+ */
+static void write_setup(struct dev_context *devc)
 {
-	struct dev_context *devc;
 	struct clockselect_50 clockselect;
-	int triggerpin, ret;
+	int triggerpin;
 	uint8_t triggerselect;
 	struct triggerinout triggerinout_conf;
 	struct triggerlut lut;
-	uint8_t regval;
 	uint8_t clock_bytes[sizeof(clockselect)];
 	size_t clock_idx;
 
-	if (sdi->status != SR_ST_ACTIVE)
-		return SR_ERR_DEV_CLOSED;
-
-	devc = sdi->priv;
-
-	if (sigma_convert_trigger(sdi) != SR_OK) {
-		sr_err("Failed to configure triggers.");
-		return SR_ERR;
-	}
-
-	/* If the samplerate has not been set, default to 200 kHz. */
-	if (devc->cur_firmware == -1) {
-		if ((ret = sigma_set_samplerate(sdi, SR_KHZ(200))) != SR_OK)
-			return ret;
+	if (devc->hw_setup_valid &&
+	    devc->hw_samplerate == devc->cur_samplerate &&
+	    devc->hw_capture_ratio == devc->capture_ratio &&
+	    !memcmp(&devc->hw_trigger, &devc->trigger, sizeof(devc->trigger))) {
+		sr_dbg("Trigger and clock setup unchanged.");
+		return;
 	}
 
 	/* Enter trigger programming mode. */
@@ -388,6 +386,36 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	sigma_set_register(WRITE_POST_TRIGGER,
 			   (devc->capture_ratio * 255) / 100, devc);
 
+	devc->hw_trigger = devc->trigger;
+	devc->hw_samplerate = devc->cur_samplerate;
+	devc->hw_capture_ratio = devc->capture_ratio;
+	devc->hw_setup_valid = TRUE;
+}
+
+static int dev_acquisition_start(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	int ret;
+	uint8_t regval;
+
+	if (sdi->status != SR_ST_ACTIVE)
+		return SR_ERR_DEV_CLOSED;
+
+	devc = sdi->priv;
+
+	if (sigma_convert_trigger(sdi) != SR_OK) {
+		sr_err("Failed to configure triggers.");
+		return SR_ERR;
+	}
+
+	/* If the samplerate has not been set, default to 200 kHz. */
+	if (devc->cur_firmware == -1) {
+		if ((ret = sigma_set_samplerate(sdi, SR_KHZ(200))) != SR_OK)
+			return ret;
+	}
+
+	write_setup(devc);
+
 	/* Start acqusition. */
 	devc->start_time = g_get_monotonic_time();
 	regval =  WMR_TRGRES | WMR_SDRAMWRITEEN;
@@ -454,6 +454,9 @@ static int upload_firmware(struct sr_context *ctx,
 		return SR_OK;
 	}
 
+	/* A fresh bitstream starts out with default registers. */
+	devc->hw_setup_valid = FALSE;
+
 	ret = ftdi_set_bitmode(&devc->ftdic, 0xdf, BITMODE_BITBANG);
 	if (ret < 0) {
 		sr_err("ftdi_set_bitmode failed: %s",
@@ -271,6 +271,11 @@ struct dev_context {
 	struct sigma_trigger trigger;
 	int use_triggers;
 	struct sigma_state state;
+	/* Setup last written to the hardware, see write_setup() in api.c. */
+	gboolean hw_setup_valid;
+	struct sigma_trigger hw_trigger;
+	uint64_t hw_samplerate;
+	int hw_capture_ratio;
 };
 
 extern SR_PRIV const uint64_t samplerates[];
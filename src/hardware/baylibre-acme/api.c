@@ -345,6 +345,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	g_io_channel_set_encoding(devc->channel, NULL, NULL);
 	g_io_channel_set_buffered(devc->channel, FALSE);
 
+	bl_acme_planes_setup(sdi);
+
 	sr_session_source_add_channel(sdi->session, devc->channel,
 		G_IO_IN | G_IO_ERR, 1000, bl_acme_receive_data, (void *)sdi);
 
@@ -370,6 +372,7 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 	devc->channel = NULL;
 
 	std_session_send_df_end(sdi);
+	bl_acme_planes_free(devc);
 
 	if (devc->samples_missed > 0)
 		sr_warn("%" PRIu64 " samples missed", devc->samples_missed);
@@ -647,6 +647,7 @@ static float read_sample(struct sr_channel *ch)
 		sr_err("Error reading from channel %s (hwmon: %d): %s",
 			ch->name, chp->probe->hwmon_num, g_strerror(errno));
 		ch->enabled = FALSE;
+		sr_dev_inst_channels_changed(ch->sdi);
 		return -1.0;
 	}
 
@@ -681,6 +682,7 @@ SR_PRIV int bl_acme_open_channel(struct sr_channel *ch)
 	if (fd < 0) {
 		sr_err("Error opening %s: %s", path, g_strerror(errno));
 		ch->enabled = FALSE;
+		sr_dev_inst_channels_changed(ch->sdi);
 		return SR_ERR;
 	}
 
@@ -698,20 +700,76 @@ SR_PRIV void bl_acme_close_channel(struct sr_channel *ch)
 	chp->fd = -1;
 }
 
+/*
+ * Channels use different units, so each of them gets its own plane in a
+ * single planar packet. The planes are set up once per acquisition,
+ * rather than on every timer tick, and again when a channel fails and
+ * gets disabled.
+ */
+SR_PRIV void bl_acme_planes_setup(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct sr_channel *ch;
+	struct channel_priv *chp;
+	GSList *chl;
+	unsigned int i, num_planes;
+
+	devc = sdi->priv;
+
+	num_planes = g_slist_length(sdi->channels);
+	devc->analog = g_malloc0(num_planes * sizeof(*devc->analog));
+	devc->encoding = g_malloc0(num_planes * sizeof(*devc->encoding));
+	devc->meaning = g_malloc0(num_planes * sizeof(*devc->meaning));
+	devc->spec = g_malloc0(num_planes * sizeof(*devc->spec));
+	devc->chonly = g_malloc0(num_planes * sizeof(*devc->chonly));
+
+	devc->num_planes = 0;
+	for (chl = sdi->channels; chl; chl = chl->next) {
+		ch = chl->data;
+		chp = ch->priv;
+
+		if (!ch->enabled)
+			continue;
+		i = devc->num_planes++;
+		chp->digits = type_digits(chp->ch_type);
+		sr_analog_init(&devc->analog[i], &devc->encoding[i],
+			&devc->meaning[i], &devc->spec[i], chp->digits);
+		devc->chonly[i].data = ch;
+		devc->analog[i].num_samples = 1;
+		devc->analog[i].meaning->channels = &devc->chonly[i];
+		devc->analog[i].meaning->mq = channel_to_mq(ch);
+		devc->analog[i].meaning->unit = channel_to_unit(ch);
+		devc->analog[i].data = &chp->val;
+	}
+}
+
+SR_PRIV void bl_acme_planes_free(struct dev_context *devc)
+{
+	g_free(devc->chonly);
+	g_free(devc->spec);
+	g_free(devc->meaning);
+	g_free(devc->encoding);
+	g_free(devc->analog);
+	devc->chonly = NULL;
+	devc->spec = NULL;
+	devc->meaning = NULL;
+	devc->encoding = NULL;
+	devc->analog = NULL;
+	devc->num_planes = 0;
+}
+
 SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
 {
 	uint64_t nrexpiration;
 	struct sr_datafeed_packet packet, framep;
-	struct sr_datafeed_analog analog;
-	struct sr_analog_encoding encoding;
-	struct sr_analog_meaning meaning;
-	struct sr_analog_spec spec;
+	struct sr_datafeed_analog_planar planar;
 	struct sr_dev_inst *sdi;
 	struct sr_channel *ch;
 	struct channel_priv *chp;
 	struct dev_context *devc;
-	GSList *chl, chonly;
-	unsigned i;
+	GSList *chl;
+	unsigned int i;
+	gboolean disabled;
 
 	(void)fd;
 	(void)revents;
@@ -724,10 +782,6 @@ SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
 	if (!devc)
 		return TRUE;
 
-	packet.type = SR_DF_ANALOG;
-	packet.payload = &analog;
-	sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
-
 	if (read(devc->timer_fd, &nrexpiration, sizeof(nrexpiration)) < 0) {
 		sr_warn("Failed to read timer information");
 		return TRUE;
@@ -760,29 +814,30 @@ SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
 		framep.type = SR_DF_FRAME_BEGIN;
 		sr_session_send(sdi, &framep);
 
-		/*
-		 * Due to different units used in each channel we're sending
-		 * samples one-by-one.
-		 */
-		for (chl = sdi->channels; chl; chl = chl->next) {
-			ch = chl->data;
-			chp = ch->priv;
-
-			if (!ch->enabled)
-				continue;
-			chonly.next = NULL;
-			chonly.data = ch;
-			analog.num_samples = 1;
-			analog.meaning->channels = &chonly;
-			analog.meaning->mq = channel_to_mq(chl->data);
-			analog.meaning->unit = channel_to_unit(ch);
-
-			if (i < 1)
+		if (i < 1) {
+			disabled = FALSE;
+			for (chl = sdi->channels; chl; chl = chl->next) {
+				ch = chl->data;
+				chp = ch->priv;
+				if (!ch->enabled)
+					continue;
 				chp->val = read_sample(ch);
+				if (!ch->enabled)
+					disabled = TRUE;
+			}
+			/* Don't keep sending the plane of a failed channel. */
+			if (disabled) {
+				bl_acme_planes_free(devc);
+				bl_acme_planes_setup(sdi);
+			}
+		}
 
-			analog.encoding->digits  = chp->digits;
-			analog.spec->spec_digits = chp->digits;
-			analog.data = &chp->val;
+		if (devc->num_planes) {
+			planar.num_samples = 1;
+			planar.num_planes = devc->num_planes;
+			planar.planes = devc->analog;
+			packet.type = SR_DF_ANALOG_PLANAR;
+			packet.payload = &planar;
 			sr_session_send(sdi, &packet);
 		}
 
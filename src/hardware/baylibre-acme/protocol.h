@@ -58,6 +58,14 @@ struct dev_context {
 	uint64_t samples_missed;
 	int timer_fd;
 	GIOChannel *channel;
+
+	/* One plane per enabled channel, set up for the whole acquisition. */
+	unsigned int num_planes;
+	struct sr_datafeed_analog *analog;
+	struct sr_analog_encoding *encoding;
+	struct sr_analog_meaning *meaning;
+	struct sr_analog_spec *spec;
+	GSList *chonly;
 };
 
 SR_PRIV uint8_t bl_acme_get_enrg_addr(int index);
@@ -85,6 +93,8 @@ SR_PRIV int bl_acme_read_power_state(const struct sr_channel_group *cg,
 SR_PRIV int bl_acme_set_power_off(const struct sr_channel_group *cg,
 				  gboolean off);
 
+SR_PRIV void bl_acme_planes_setup(const struct sr_dev_inst *sdi);
+SR_PRIV void bl_acme_planes_free(struct dev_context *devc);
 SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data);
 
 SR_PRIV int bl_acme_open_channel(struct sr_channel *ch);
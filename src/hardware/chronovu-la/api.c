@@ -154,12 +154,12 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 		}
 	}
 	if (conn)
-		conn_devices = sr_usb_find(drvc->sr_ctx->libusb_ctx, conn);
+		conn_devices = sr_usb_find(sr_usb_context(drvc->sr_ctx), conn);
 	else
 		conn_devices = NULL;
 
 	devices = NULL;
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 
 	for (i = 0; devlist[i]; i++) {
 		if (conn) {
@@ -452,6 +452,7 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 
 	/* What time span should we send samples for? */
 	elapsed_us = g_get_monotonic_time() - devc->start_us;
+
 	limit_us = 1000 * devc->limit_msec;
 	if (limit_us > 0 && limit_us < elapsed_us)
 		todo_us = MAX(0, limit_us - devc->spent_us);
@@ -146,13 +146,13 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 		}
 	}
 	if (conn)
-		conn_devices = sr_usb_find(drvc->sr_ctx->libusb_ctx, conn);
+		conn_devices = sr_usb_find(sr_usb_context(drvc->sr_ctx), conn);
 	else
 		conn_devices = NULL;
 
 	/* Find all DSLogic compatible devices and upload firmware to them. */
 	devices = NULL;
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	for (i = 0; devlist[i]; i++) {
 		if (conn) {
 			usb = NULL;
@@ -288,6 +288,7 @@ static void clear_dev_context(void *priv)
 	struct dev_context *devc;
 
 	devc = priv;
+	g_free(devc->fpga_cfg);
 	g_free(devc);
 }
 
@@ -257,6 +257,10 @@ SR_PRIV int dslogic_fpga_firmware_upload(const struct sr_dev_inst *sdi)
 
 	sr_dbg("Uploading FPGA firmware '%s'.", name);
 
+	/* A fresh bitstream starts out unconfigured. */
+	g_free(devc->fpga_cfg);
+	devc->fpga_cfg = NULL;
+
 	result = sr_resource_open(drvc->sr_ctx, &bitstream,
 			SR_RESOURCE_FIRMWARE, name);
 	if (result != SR_OK)
@@ -313,23 +317,21 @@ SR_PRIV int dslogic_fpga_firmware_upload(const struct sr_dev_inst *sdi)
 
 static unsigned int enabled_channel_count(const struct sr_dev_inst *sdi)
 {
-	unsigned int count = 0;
-	for (const GSList *l = sdi->channels; l; l = l->next) {
-		const struct sr_channel *const probe = (struct sr_channel *)l->data;
-		if (probe->enabled)
-			count++;
-	}
+	struct sr_dev_channel_cache *const cache =
+		sr_dev_inst_channel_cache_get(sdi);
+	const unsigned int count = cache->num_logic;
+	sr_dev_channel_cache_unref(cache);
 	return count;
 }
 
 static uint16_t enabled_channel_mask(const struct sr_dev_inst *sdi)
 {
-	unsigned int mask = 0;
-	for (const GSList *l = sdi->channels; l; l = l->next) {
-		const struct sr_channel *const probe = (struct sr_channel *)l->data;
-		if (probe->enabled)
-			mask |= 1 << probe->index;
-	}
+	struct sr_dev_channel_cache *const cache =
+		sr_dev_inst_channel_cache_get(sdi);
+	uint16_t mask = 0;
+	for (unsigned int i = 0; i < MIN(cache->logic_mask_size, 2); i++)
+		mask |= cache->logic_mask[i] << (8 * i);
+	sr_dev_channel_cache_unref(cache);
 	return mask;
 }
 
@@ -453,6 +455,8 @@ static int fpga_configure(const struct sr_dev_inst *sdi)
 	usb = sdi->conn;
 	devc = sdi->priv;
 
+	/* Unused trigger stages must not differ between acquisitions. */
+	memset(&cfg, 0, sizeof(cfg));
 	WL32(&cfg.sync, DS_CFG_START);
 	WL16(&cfg.mode_header, DS_CFG_MODE);
 	WL16(&cfg.divider_header, DS_CFG_DIVIDER);
@@ -463,21 +467,6 @@ static int fpga_configure(const struct sr_dev_inst *sdi)
 	WL16(&cfg.trig_header, DS_CFG_TRIG);
 	WL32(&cfg.end_sync, DS_CFG_END);
 
-	/* Pass in the length of a fixed-size struct. Really. */
-	len = sizeof(struct dslogic_fpga_config) / 2;
-	c[0] = len & 0xff;
-	c[1] = (len >> 8) & 0xff;
-	c[2] = (len >> 16) & 0xff;
-
-	ret = libusb_control_transfer(usb->devhdl, LIBUSB_REQUEST_TYPE_VENDOR |
-			LIBUSB_ENDPOINT_OUT, DS_CMD_SETTING, 0x0000, 0x0000,
-			c, sizeof(c), USB_TIMEOUT);
-	if (ret < 0) {
-		sr_err("Failed to send FPGA configure command: %s.",
-			libusb_error_name(ret));
-		return SR_ERR;
-	}
-
 	v16 = 0x0000;
 
 	if (devc->mode == DS_OP_INTERNAL_TEST)
@@ -517,6 +506,29 @@ static int fpga_configure(const struct sr_dev_inst *sdi)
 
 	set_trigger(sdi, &cfg);
 
+	/* The FPGA keeps its configuration, don't send the same one again. */
+	if (devc->fpga_cfg && !memcmp(devc->fpga_cfg, &cfg, sizeof(cfg))) {
+		sr_dbg("FPGA configuration unchanged.");
+		return SR_OK;
+	}
+	g_free(devc->fpga_cfg);
+	devc->fpga_cfg = NULL;
+
+	/* Pass in the length of a fixed-size struct. Really. */
+	len = sizeof(struct dslogic_fpga_config) / 2;
+	c[0] = len & 0xff;
+	c[1] = (len >> 8) & 0xff;
+	c[2] = (len >> 16) & 0xff;
+
+	ret = libusb_control_transfer(usb->devhdl, LIBUSB_REQUEST_TYPE_VENDOR |
+			LIBUSB_ENDPOINT_OUT, DS_CMD_SETTING, 0x0000, 0x0000,
+			c, sizeof(c), USB_TIMEOUT);
+	if (ret < 0) {
+		sr_err("Failed to send FPGA configure command: %s.",
+			libusb_error_name(ret));
+		return SR_ERR;
+	}
+
 	len = sizeof(struct dslogic_fpga_config);
 	ret = libusb_bulk_transfer(usb->devhdl, 2 | LIBUSB_ENDPOINT_OUT,
 			(unsigned char *)&cfg, len, &transferred, USB_TIMEOUT);
@@ -525,6 +537,8 @@ static int fpga_configure(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
+	devc->fpga_cfg = g_memdup(&cfg, sizeof(cfg));
+
 	return SR_OK;
 }
 
@@ -572,7 +586,7 @@ SR_PRIV int dslogic_dev_open(struct sr_dev_inst *sdi, struct sr_dev_driver *di)
 		/* Device is already in use. */
 		return SR_ERR;
 
-	device_count = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	device_count = libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	if (device_count < 0) {
 		sr_err("Failed to get device list: %s.",
 		       libusb_error_name(device_count));
@@ -905,7 +919,7 @@ static int receive_data(int fd, int revents, void *cb_data)
 	drvc = (struct drv_context *)cb_data;
 
 	tv.tv_sec = tv.tv_usec = 0;
-	libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+	usb_handle_events(drvc->sr_ctx, &tv, NULL);
 
 	return TRUE;
 }
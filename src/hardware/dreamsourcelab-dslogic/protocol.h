@@ -140,6 +140,9 @@ struct dev_context {
 	gboolean continuous_mode;
 	int clock_edge;
 	double cur_threshold;
+
+	/* Configuration last sent to the FPGA, NULL if unknown. */
+	uint8_t *fpga_cfg;
 };
 
 SR_PRIV int dslogic_fpga_firmware_upload(const struct sr_dev_inst *sdi);
@@ -159,7 +159,7 @@ SR_PRIV int fx2lafw_dev_open(struct sr_dev_inst *sdi, struct sr_dev_driver *di)
 		/* Device is already in use. */
 		return SR_ERR;
 
-	device_count = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	device_count = libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	if (device_count < 0) {
 		sr_err("Failed to get device list: %s.",
 		       libusb_error_name(device_count));
@@ -259,6 +259,7 @@ SR_PRIV struct dev_context *fx2lafw_dev_new(void)
 	devc->fw_updated = 0;
 	devc->cur_samplerate = 0;
 	devc->limit_samples = 0;
+	devc->limit_frames = 0;
 	devc->capture_ratio = 0;
 	devc->sample_wide = FALSE;
 	devc->stl = NULL;
@@ -278,12 +279,26 @@ SR_PRIV void fx2lafw_abort_acquisition(struct dev_context *devc)
 	}
 }
 
+static void send_frame_packet(const struct sr_dev_inst *sdi, uint16_t type)
+{
+	const struct sr_datafeed_packet packet = {
+		.type = type,
+		.payload = NULL
+	};
+
+	sr_session_send(sdi, &packet);
+}
+
 static void finish_acquisition(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
 
 	devc = sdi->priv;
 
+	/* Close the frame that was cut short. */
+	if (devc->limit_frames && devc->num_frames < devc->limit_frames)
+		send_frame_packet(sdi, SR_DF_FRAME_END);
+
 	std_session_send_df_end(sdi);
 
 	usb_source_remove(sdi->session, devc->ctx);
@@ -409,6 +424,36 @@ static void la_send_data_proc(struct sr_dev_inst *sdi,
 	sr_session_send(sdi, &packet);
 }
 
+/*
+ * Called when a frame got all its samples. With a frame limit set, the
+ * next frame is armed right away: the transfers keep running and the
+ * soft trigger is reset in place, so nothing gets reallocated or sent
+ * to the device between frames. Returns FALSE when the acquisition is
+ * done.
+ */
+static gboolean next_frame(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+
+	if (!devc->limit_frames)
+		return FALSE;
+
+	send_frame_packet(sdi, SR_DF_FRAME_END);
+	if (++devc->num_frames >= devc->limit_frames)
+		return FALSE;
+
+	devc->sent_samples = 0;
+	if (devc->stl) {
+		soft_trigger_logic_reset(devc->stl);
+		devc->trigger_fired = FALSE;
+	}
+	send_frame_packet(sdi, SR_DF_FRAME_BEGIN);
+
+	return TRUE;
+}
+
 static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
@@ -417,6 +462,7 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	unsigned int num_samples;
 	int trigger_offset, cur_sample_count, unitsize;
 	int pre_trigger_samples;
+	uint8_t *data;
 
 	sdi = transfer->user_data;
 	devc = sdi->priv;
@@ -466,35 +512,39 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	} else {
 		devc->empty_transfer_count = 0;
 	}
-	if (devc->trigger_fired) {
-		if (!devc->limit_samples || devc->sent_samples < devc->limit_samples) {
-			/* Send the incoming transfer to the session bus. */
-			if (devc->limit_samples && devc->sent_samples + cur_sample_count > devc->limit_samples)
-				num_samples = devc->limit_samples - devc->sent_samples;
-			else
-				num_samples = cur_sample_count;
-
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer,
+
+	data = transfer->buffer;
+	while (cur_sample_count > 0) {
+		if (!devc->trigger_fired) {
+			trigger_offset = soft_trigger_logic_check(devc->stl,
+				data, cur_sample_count * unitsize,
+				&pre_trigger_samples);
+			if (trigger_offset < 0)
+				break;
+			devc->sent_samples += pre_trigger_samples;
+			data += trigger_offset * unitsize;
+			cur_sample_count -= trigger_offset;
+			devc->trigger_fired = TRUE;
+		}
+
+		/* Send the incoming transfer to the session bus. */
+		num_samples = cur_sample_count;
+		if (devc->limit_samples &&
+				num_samples > devc->limit_samples - devc->sent_samples)
+			num_samples = devc->limit_samples - devc->sent_samples;
+		if (num_samples > 0) {
+			devc->send_data_proc(sdi, data,
 				num_samples * unitsize, unitsize);
 			devc->sent_samples += num_samples;
+			data += num_samples * unitsize;
+			cur_sample_count -= num_samples;
 		}
-	} else {
-		trigger_offset = soft_trigger_logic_check(devc->stl,
-			transfer->buffer, transfer->actual_length, &pre_trigger_samples);
-		if (trigger_offset > -1) {
-			devc->sent_samples += pre_trigger_samples;
-			num_samples = cur_sample_count - trigger_offset;
-			if (devc->limit_samples &&
-					num_samples > devc->limit_samples - devc->sent_samples)
-				num_samples = devc->limit_samples - devc->sent_samples;
-
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer
-					+ trigger_offset * unitsize,
-					num_samples * unitsize, unitsize);
-			devc->sent_samples += num_samples;
 
-			devc->trigger_fired = TRUE;
-		}
+		if (!devc->limit_samples || devc->sent_samples < devc->limit_samples)
+			break;
+		/* The rest of the transfer may already hold the next frame. */
+		if (!next_frame(sdi))
+			break;
 	}
 
 	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples) {
@@ -591,7 +641,7 @@ static int receive_data(int fd, int revents, void *cb_data)
 	drvc = (struct drv_context *)cb_data;
 
 	tv.tv_sec = tv.tv_usec = 0;
-	libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+	usb_handle_events(drvc->sr_ctx, &tv, NULL);
 
 	return TRUE;
 }
@@ -672,6 +722,10 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 
 	std_session_send_df_header(sdi);
 
+	devc->num_frames = 0;
+	if (devc->limit_frames)
+		send_frame_packet(sdi, SR_DF_FRAME_BEGIN);
+
 	return SR_OK;
 }
 
@@ -690,6 +744,12 @@ SR_PRIV int fx2lafw_start_acquisition(const struct sr_dev_inst *sdi)
 	drvc = di->context;
 	devc = sdi->priv;
 
+	/* A frame ends after limit_samples, without one it never would. */
+	if (devc->limit_frames && !devc->limit_samples) {
+		sr_err("A frame limit needs a sample limit.");
+		return SR_ERR_ARG;
+	}
+
 	devc->ctx = drvc->sr_ctx;
 	devc->sent_samples = 0;
 	devc->empty_transfer_count = 0;
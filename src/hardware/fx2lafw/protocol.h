@@ -105,6 +105,7 @@ struct dev_context {
 	/* Device/capture settings */
 	uint64_t cur_samplerate;
 	uint64_t limit_samples;
+	uint64_t limit_frames;
 	uint64_t capture_ratio;
 
 	/* Operational settings */
@@ -114,6 +115,7 @@ struct dev_context {
 	struct soft_trigger_logic *stl;
 
 	unsigned int sent_samples;
+	uint64_t num_frames;
 	int submitted_transfers;
 	int empty_transfer_count;
 
@@ -200,12 +200,12 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 		}
 	}
 	if (conn)
-		conn_devices = sr_usb_find(drvc->sr_ctx->libusb_ctx, conn);
+		conn_devices = sr_usb_find(sr_usb_context(drvc->sr_ctx), conn);
 	else
 		conn_devices = NULL;
 
 	/* Find all Hantek 60xx devices and upload firmware to all of them. */
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	for (i = 0; devlist[i]; i++) {
 		if (conn) {
 			usb = NULL;
@@ -757,7 +757,7 @@ static int handle_event(int fd, int revents, void *cb_data)
 
 	/* Always handle pending libusb events. */
 	tv.tv_sec = tv.tv_usec = 0;
-	libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+	usb_handle_events(drvc->sr_ctx, &tv, NULL);
 
 	if (devc->dev_state == STOPPING) {
 		/* We've been told to wind up the acquisition. */
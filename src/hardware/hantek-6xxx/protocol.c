@@ -37,7 +37,7 @@ SR_PRIV int hantek_6xxx_open(struct sr_dev_inst *sdi)
 		/* Already in use. */
 		return SR_ERR;
 
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	for (i = 0; devlist[i]; i++) {
 		libusb_get_device_descriptor(devlist[i], &des);
 
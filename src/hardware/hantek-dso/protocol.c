@@ -123,7 +123,7 @@ SR_PRIV int dso_open(struct sr_dev_inst *sdi)
 		/* already in use */
 		return SR_ERR;
 
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	for (i = 0; devlist[i]; i++) {
 		libusb_get_device_descriptor(devlist[i], &des);
 
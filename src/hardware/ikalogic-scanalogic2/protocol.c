@@ -235,8 +235,7 @@ SR_PRIV int ikalogic_scanalogic2_receive_data(int fd, int revents, void *cb_data
 	tv.tv_sec = 0;
 	tv.tv_usec = 0;
 
-	libusb_handle_events_timeout_completed(drvc->sr_ctx->libusb_ctx, &tv,
-		NULL);
+	usb_handle_events(drvc->sr_ctx, &tv, NULL);
 
 	/* Check if an error occurred on a transfer. */
 	if (devc->transfer_error)
@@ -637,7 +636,7 @@ SR_PRIV int sl2_get_device_info(struct sr_dev_driver *di,
 	if (!dev_info)
 		return SR_ERR_ARG;
 
-	if (sr_usb_open(drvc->sr_ctx->libusb_ctx, &usb) != SR_OK)
+	if (sr_usb_open(sr_usb_context(drvc->sr_ctx), &usb) != SR_OK)
 		return SR_ERR;
 
 	/*
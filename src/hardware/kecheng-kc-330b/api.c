@@ -69,7 +69,7 @@ static int scan_kecheng(struct sr_dev_driver *di,
 	unsigned char cmd, buf[32];
 
 	drvc = di->context;
-	if (sr_usb_open(drvc->sr_ctx->libusb_ctx, usb) != SR_OK)
+	if (sr_usb_open(sr_usb_context(drvc->sr_ctx), usb) != SR_OK)
 		return SR_ERR;
 
 	cmd = CMD_IDENTIFY;
@@ -114,7 +114,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	drvc = di->context;
 
 	devices = NULL;
-	if ((usb_devices = sr_usb_find(drvc->sr_ctx->libusb_ctx, USB_CONN))) {
+	if ((usb_devices = sr_usb_find(sr_usb_context(drvc->sr_ctx), USB_CONN))) {
 		/* We have a list of sr_usb_dev_inst matching the connection
 		 * string. Wrap them in sr_dev_inst and we're done. */
 		for (l = usb_devices; l; l = l->next) {
@@ -159,7 +159,7 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 	usb = sdi->conn;
 
-	if (sr_usb_open(drvc->sr_ctx->libusb_ctx, usb) != SR_OK)
+	if (sr_usb_open(sr_usb_context(drvc->sr_ctx), usb) != SR_OK)
 		return SR_ERR;
 
 	if ((ret = libusb_set_configuration(usb->devhdl, 1))) {
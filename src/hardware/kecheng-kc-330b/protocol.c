@@ -45,8 +45,7 @@ SR_PRIV int kecheng_kc_330b_handle_events(int fd, int revents, void *cb_data)
 	drvc = di->context;
 
 	memset(&tv, 0, sizeof(struct timeval));
-	libusb_handle_events_timeout_completed(drvc->sr_ctx->libusb_ctx, &tv,
-					       NULL);
+	usb_handle_events(drvc->sr_ctx, &tv, NULL);
 
 	if (sdi->status == SR_ST_STOPPING) {
 		libusb_free_transfer(devc->xfer);
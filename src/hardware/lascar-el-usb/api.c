@@ -60,7 +60,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 		return NULL;
 
 	devices = NULL;
-	if ((usb_devices = sr_usb_find(drvc->sr_ctx->libusb_ctx, conn))) {
+	if ((usb_devices = sr_usb_find(sr_usb_context(drvc->sr_ctx), conn))) {
 		/* We have a list of sr_usb_dev_inst matching the connection
 		 * string. Wrap them in sr_dev_inst and we're done. */
 		for (l = usb_devices; l; l = l->next) {
@@ -90,7 +90,7 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 	usb = sdi->conn;
 
-	if (sr_usb_open(drvc->sr_ctx->libusb_ctx, usb) != SR_OK)
+	if (sr_usb_open(sr_usb_context(drvc->sr_ctx), usb) != SR_OK)
 		return SR_ERR;
 
 	if ((ret = libusb_claim_interface(usb->devhdl, LASCAR_INTERFACE))) {
@@ -360,7 +360,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	tv.tv_usec = 0;
 	while (!xfer_in->user_data || !xfer_out->user_data) {
 		g_usleep(SLEEP_US_LONG);
-		libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+		libusb_handle_events_timeout(sr_usb_context(drvc->sr_ctx), &tv);
 	}
 	if (xfer_in->user_data != GINT_TO_POINTER(1) ||
 			xfer_out->user_data != GINT_TO_POINTER(1)) {
@@ -134,7 +134,7 @@ SR_PRIV int lascar_get_config(libusb_device_handle *dev_hdl,
 			break;
 		}
 		g_usleep(SLEEP_US_LONG);
-		libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+		libusb_handle_events_timeout(sr_usb_context(drvc->sr_ctx), &tv);
 	}
 	if (!start) {
 		sr_dbg("no response");
@@ -167,7 +167,7 @@ SR_PRIV int lascar_get_config(libusb_device_handle *dev_hdl,
 			break;
 		}
 		g_usleep(SLEEP_US_LONG);
-		libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+		libusb_handle_events_timeout(sr_usb_context(drvc->sr_ctx), &tv);
 	}
 	if (!start) {
 		sr_dbg("Timeout waiting for configuration structure.");
@@ -193,7 +193,7 @@ cleanup:
 			if (g_get_monotonic_time() - start > EVENTS_TIMEOUT)
 				break;
 			g_usleep(SLEEP_US_SHORT);
-			libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+			libusb_handle_events_timeout(sr_usb_context(drvc->sr_ctx), &tv);
 		}
 	}
 	libusb_free_transfer(xfer_in);
@@ -249,7 +249,7 @@ static int lascar_save_config(libusb_device_handle *dev_hdl,
 	tv.tv_usec = 0;
 	while (!xfer_out->user_data) {
 		g_usleep(SLEEP_US_LONG);
-		libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+		libusb_handle_events_timeout(sr_usb_context(drvc->sr_ctx), &tv);
 	}
 
 	libusb_fill_bulk_transfer(xfer_out, dev_hdl, LASCAR_EP_OUT,
@@ -260,7 +260,7 @@ static int lascar_save_config(libusb_device_handle *dev_hdl,
 	}
 	while (!xfer_in->user_data || !xfer_out->user_data) {
 		g_usleep(SLEEP_US_LONG);
-		libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+		libusb_handle_events_timeout(sr_usb_context(drvc->sr_ctx), &tv);
 	}
 
 	if (xfer_in->actual_length != 1 || buf[0] != 0xff) {
@@ -279,7 +279,7 @@ cleanup:
 			if (g_get_monotonic_time() - start > EVENTS_TIMEOUT)
 				break;
 			g_usleep(SLEEP_US_SHORT);
-			libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+			libusb_handle_events_timeout(sr_usb_context(drvc->sr_ctx), &tv);
 		}
 	}
 	libusb_free_transfer(xfer_in);
@@ -359,7 +359,7 @@ SR_PRIV struct sr_dev_inst *lascar_scan(int bus, int address)
 	drvc = di->context;
 	sdi = NULL;
 
-	ret = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	ret = libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	if (ret < 0)
 		return NULL;
 
@@ -508,8 +508,7 @@ SR_PRIV int lascar_el_usb_handle_events(int fd, int revents, void *cb_data)
 	}
 
 	memset(&tv, 0, sizeof(struct timeval));
-	libusb_handle_events_timeout_completed(drvc->sr_ctx->libusb_ctx, &tv,
-					       NULL);
+	usb_handle_events(drvc->sr_ctx, &tv, NULL);
 
 	return TRUE;
 }
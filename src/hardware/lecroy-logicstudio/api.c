@@ -121,7 +121,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 
 	devices = NULL;
 
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 
 	for (i = 0; devlist[i]; i++) {
 		libusb_get_device_descriptor(devlist[i], &des);
@@ -199,7 +199,7 @@ static int open_device(struct sr_dev_inst *sdi)
 
 	is_opened = FALSE;
 
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 
 	for (i = 0; devlist[i]; i++) {
 		libusb_get_device_descriptor(devlist[i], &des);
@@ -461,8 +461,7 @@ static int receive_usb_data(int fd, int revents, void *cb_data)
 	tv.tv_sec = 0;
 	tv.tv_usec = 0;
 
-	libusb_handle_events_timeout_completed(drvc->sr_ctx->libusb_ctx,
-		&tv, NULL);
+	usb_handle_events(drvc->sr_ctx, &tv, NULL);
 
 	return TRUE;
 }
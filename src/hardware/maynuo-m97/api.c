@@ -160,6 +160,9 @@ static struct sr_dev_inst *probe_device(struct sr_modbus_dev_inst *modbus)
 
 	sdi->priv = devc;
 
+	/* The connection gets opened again by dev_open(). */
+	sr_modbus_close(modbus);
+
 	return sdi;
 }
 
@@ -204,6 +207,7 @@ static int dev_open(struct sr_dev_inst *sdi)
 		return SR_ERR;
 
 	sdi->status = SR_ST_ACTIVE;
+	maynuo_m97_cache_invalidate(sdi);
 
 	maynuo_m97_set_bit(modbus, PC1, 1);
 
@@ -272,19 +276,19 @@ static int config_get(uint32_t key, GVariant **data, const struct sr_dev_inst *s
 			*data = g_variant_new_string(maynuo_m97_mode_to_str(mode));
 		break;
 	case SR_CONF_VOLTAGE:
-		if ((ret = maynuo_m97_get_float(modbus, U, &fvalue)) == SR_OK)
+		if ((ret = maynuo_m97_get_float_cached(sdi, U, &fvalue)) == SR_OK)
 			*data = g_variant_new_double(fvalue);
 		break;
 	case SR_CONF_VOLTAGE_TARGET:
-		if ((ret = maynuo_m97_get_float(modbus, UFIX, &fvalue)) == SR_OK)
+		if ((ret = maynuo_m97_get_float_cached(sdi, UFIX, &fvalue)) == SR_OK)
 			*data = g_variant_new_double(fvalue);
 		break;
 	case SR_CONF_CURRENT:
-		if ((ret = maynuo_m97_get_float(modbus, I, &fvalue)) == SR_OK)
+		if ((ret = maynuo_m97_get_float_cached(sdi, I, &fvalue)) == SR_OK)
 			*data = g_variant_new_double(fvalue);
 		break;
 	case SR_CONF_CURRENT_LIMIT:
-		if ((ret = maynuo_m97_get_float(modbus, IFIX, &fvalue)) == SR_OK)
+		if ((ret = maynuo_m97_get_float_cached(sdi, IFIX, &fvalue)) == SR_OK)
 			*data = g_variant_new_double(fvalue);
 		break;
 	case SR_CONF_OVER_VOLTAGE_PROTECTION_ENABLED:
@@ -295,7 +299,7 @@ static int config_get(uint32_t key, GVariant **data, const struct sr_dev_inst *s
 			*data = g_variant_new_boolean(ivalue);
 		break;
 	case SR_CONF_OVER_VOLTAGE_PROTECTION_THRESHOLD:
-		if ((ret = maynuo_m97_get_float(modbus, UMAX, &fvalue)) == SR_OK)
+		if ((ret = maynuo_m97_get_float_cached(sdi, UMAX, &fvalue)) == SR_OK)
 			*data = g_variant_new_double(fvalue);
 		break;
 	case SR_CONF_OVER_CURRENT_PROTECTION_ENABLED:
@@ -306,7 +310,7 @@ static int config_get(uint32_t key, GVariant **data, const struct sr_dev_inst *s
 			*data = g_variant_new_boolean(ivalue);
 		break;
 	case SR_CONF_OVER_CURRENT_PROTECTION_THRESHOLD:
-		if ((ret = maynuo_m97_get_float(modbus, IMAX, &fvalue)) == SR_OK)
+		if ((ret = maynuo_m97_get_float_cached(sdi, IMAX, &fvalue)) == SR_OK)
 			*data = g_variant_new_double(fvalue);
 		break;
 	case SR_CONF_OVER_TEMPERATURE_PROTECTION:
@@ -337,6 +341,7 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 
 	modbus = sdi->conn;
 	devc = sdi->priv;
+	maynuo_m97_cache_invalidate(sdi);
 
 	ret = SR_OK;
 	switch (key) {
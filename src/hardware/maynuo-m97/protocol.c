@@ -45,6 +45,78 @@ SR_PRIV int maynuo_m97_get_float(struct sr_modbus_dev_inst *modbus,
 	return ret;
 }
 
+SR_PRIV int maynuo_m97_get_floats(struct sr_modbus_dev_inst *modbus,
+		const enum maynuo_m97_register *addresses, float *values,
+		int count)
+{
+	struct sr_modbus_register_map *map;
+	uint16_t *registers;
+	int i, ret;
+
+	map = g_new(struct sr_modbus_register_map, count);
+	registers = g_new(uint16_t, 2 * count);
+	for (i = 0; i < count; i++) {
+		map[i].address = addresses[i];
+		map[i].nb_registers = 2;
+		map[i].registers = registers + 2 * i;
+	}
+	/* Registers are mostly laid out back to back, a small gap is cheap. */
+	ret = sr_modbus_read_register_map(modbus, map, count, 8);
+	if (ret == SR_OK)
+		for (i = 0; i < count; i++)
+			values[i] = RBFL(registers + 2 * i);
+	g_free(registers);
+	g_free(map);
+	return ret;
+}
+
+/*
+ * Frontends query the settings one key after the other. Read all of
+ * them in one go on the first query, and answer the others from that
+ * for a short while.
+ */
+static const enum maynuo_m97_register cached_registers[NUM_CACHED_REGISTERS] = {
+	U, I, UFIX, IFIX, UMAX, IMAX,
+};
+
+SR_PRIV int maynuo_m97_get_float_cached(const struct sr_dev_inst *sdi,
+		enum maynuo_m97_register address, float *value)
+{
+	struct dev_context *devc;
+	struct sr_modbus_dev_inst *modbus;
+	int64_t now;
+	unsigned int i;
+
+	devc = sdi->priv;
+	modbus = sdi->conn;
+
+	for (i = 0; i < ARRAY_SIZE(cached_registers); i++)
+		if (cached_registers[i] == address)
+			break;
+	if (i == ARRAY_SIZE(cached_registers))
+		return maynuo_m97_get_float(modbus, address, value);
+
+	now = g_get_monotonic_time();
+	if (!devc->cache_time || now - devc->cache_time > CACHE_TIMEOUT_US) {
+		devc->cache_time = 0;
+		if (maynuo_m97_get_floats(modbus, cached_registers,
+				devc->cache, ARRAY_SIZE(cached_registers)) != SR_OK)
+			return maynuo_m97_get_float(modbus, address, value);
+		devc->cache_time = now;
+	}
+	*value = devc->cache[i];
+
+	return SR_OK;
+}
+
+SR_PRIV void maynuo_m97_cache_invalidate(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+	devc->cache_time = 0;
+}
+
 SR_PRIV int maynuo_m97_set_float(struct sr_modbus_dev_inst *modbus,
 		enum maynuo_m97_register address, float value)
 {
@@ -26,6 +26,10 @@
 
 #define LOG_PREFIX "maynuo-m97"
 
+/* How long values read for config_get() are considered current. */
+#define CACHE_TIMEOUT_US (200 * 1000)
+#define NUM_CACHED_REGISTERS 6
+
 struct maynuo_m97_model {
 	unsigned int id;
 	const char *name;
@@ -44,6 +48,9 @@ struct dev_context {
 
 	/* Operational state */
 	int expecting_registers;
+	/* Values read by maynuo_m97_get_float_cached(), and when. */
+	float cache[NUM_CACHED_REGISTERS];
+	int64_t cache_time;
 };
 
 enum maynuo_m97_coil {
@@ -142,6 +149,12 @@ SR_PRIV int maynuo_m97_set_bit(struct sr_modbus_dev_inst *modbus,
 		enum maynuo_m97_coil address, int value);
 SR_PRIV int maynuo_m97_get_float(struct sr_modbus_dev_inst *modbus,
 		enum maynuo_m97_register address, float *value);
+SR_PRIV int maynuo_m97_get_floats(struct sr_modbus_dev_inst *modbus,
+		const enum maynuo_m97_register *addresses, float *values,
+		int count);
+SR_PRIV int maynuo_m97_get_float_cached(const struct sr_dev_inst *sdi,
+		enum maynuo_m97_register address, float *value);
+SR_PRIV void maynuo_m97_cache_invalidate(const struct sr_dev_inst *sdi);
 SR_PRIV int maynuo_m97_set_float(struct sr_modbus_dev_inst *modbus,
 		enum maynuo_m97_register address, float value);
 
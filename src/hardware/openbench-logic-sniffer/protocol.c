@@ -356,7 +356,8 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 	}
 
 	if (devc->num_transfers++ == 0) {
-		devc->raw_sample_buf = g_try_malloc(devc->limit_samples * 4);
+		devc->raw_sample_buf = sr_session_malloc(sdi->session,
+			devc->limit_samples * 4);
 		if (!devc->raw_sample_buf) {
 			sr_err("Sample buffer malloc failed.");
 			return FALSE;
@@ -506,7 +507,7 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 				(devc->limit_samples - devc->num_samples) * 4;
 			sr_session_send(sdi, &packet);
 		}
-		g_free(devc->raw_sample_buf);
+		sr_session_free(sdi->session, devc->raw_sample_buf);
 
 		serial_flush(serial);
 		abort_acquisition(sdi);
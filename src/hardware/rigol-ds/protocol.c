@@ -800,6 +800,7 @@ SR_PRIV int rigol_ds_get_dev_cfg(const struct sr_dev_inst *sdi)
 			return SR_ERR;
 		ch = g_slist_nth_data(sdi->channels, i);
 		ch->enabled = devc->analog_channels[i];
+		sr_dev_inst_channels_changed(ch->sdi);
 	}
 	sr_dbg("Current analog channel state:");
 	for (i = 0; i < devc->model->analog_channels; i++)
@@ -824,6 +825,7 @@ SR_PRIV int rigol_ds_get_dev_cfg(const struct sr_dev_inst *sdi)
 				return SR_ERR;
 			ch = g_slist_nth_data(sdi->channels, i + devc->model->analog_channels);
 			ch->enabled = devc->digital_channels[i];
+			sr_dev_inst_channels_changed(ch->sdi);
 			sr_dbg("D%d: %s", i, devc->digital_channels[i] ? "on" : "off");
 		}
 	}
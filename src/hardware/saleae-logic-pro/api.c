@@ -119,11 +119,11 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	}
 
 	if (conn)
-		conn_devices = sr_usb_find(drvc->sr_ctx->libusb_ctx, conn);
+		conn_devices = sr_usb_find(sr_usb_context(drvc->sr_ctx), conn);
 	else
 		conn_devices = NULL;
 
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	for (unsigned int i = 0; devlist[i]; i++) {
 		if (conn) {
 			struct sr_usb_dev_inst *usb = NULL;
@@ -193,7 +193,7 @@ static int dev_open(struct sr_dev_inst *sdi)
 	struct sr_usb_dev_inst *usb = sdi->conn;
 	int ret;
 
-	if (sr_usb_open(drvc->sr_ctx->libusb_ctx, usb) != SR_OK)
+	if (sr_usb_open(sr_usb_context(drvc->sr_ctx), usb) != SR_OK)
 		return SR_ERR;
 
 	if ((ret = libusb_claim_interface(usb->devhdl, 0))) {
@@ -334,7 +334,7 @@ static int dev_acquisition_handle(int fd, int revents, void *cb_data)
 	(void)fd;
 	(void)revents;
 
-	libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+	usb_handle_events(drvc->sr_ctx, &tv, NULL);
 
 	return TRUE;
 }
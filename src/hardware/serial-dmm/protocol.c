@@ -38,44 +38,67 @@ static void log_dmm_packet(const uint8_t *buf)
 	       buf[21], buf[22]);
 }
 
-static void handle_packet(const uint8_t *buf, struct sr_dev_inst *sdi,
-			  void *info)
-{
-	struct dmm_info *dmm;
-	float floatval;
-	struct sr_datafeed_packet packet;
+/*
+ * Readings of the same kind (quantity, unit, flags and digits) that were
+ * decoded in one go. They are sent as one multi-sample analog packet.
+ */
+struct reading_run {
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
+	float values[DMM_BUFSIZE];
+};
+
+static void send_run(struct sr_dev_inst *sdi, struct reading_run *run)
+{
 	struct dev_context *devc;
+	struct sr_datafeed_packet packet;
 
-	dmm = (struct dmm_info *)sdi->driver;
+	if (!run->analog.num_samples)
+		return;
 
-	log_dmm_packet(buf);
 	devc = sdi->priv;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &run->analog;
+	sr_session_send(sdi, &packet);
+	sr_sw_limits_update_samples_read(&devc->limits, run->analog.num_samples);
+	run->analog.num_samples = 0;
+}
 
-	/* Note: digits/spec_digits will be overridden by the DMM parsers. */
-	sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
-
-	analog.meaning->channels = sdi->channels;
-	analog.num_samples = 1;
-	analog.meaning->mq = 0;
+static gboolean run_matches(const struct reading_run *run,
+		const struct sr_dmm_reading *reading)
+{
+	return run->analog.num_samples
+		&& run->meaning.mq == reading->mq
+		&& run->meaning.unit == reading->unit
+		&& run->meaning.mqflags == reading->mqflags
+		&& run->encoding.digits == reading->digits
+		&& run->spec.spec_digits == reading->spec_digits;
+}
 
-	dmm->packet_parse(buf, &floatval, &analog, info);
-	analog.data = &floatval;
+static void start_run(struct sr_dev_inst *sdi, struct reading_run *run,
+		const struct sr_dmm_reading *reading)
+{
+	sr_analog_init(&run->analog, &run->encoding, &run->meaning,
+		&run->spec, reading->digits);
+	run->spec.spec_digits = reading->spec_digits;
+	run->meaning.mq = reading->mq;
+	run->meaning.unit = reading->unit;
+	run->meaning.mqflags = reading->mqflags;
+	run->meaning.channels = sdi->channels;
+	run->analog.data = run->values;
+	run->analog.num_samples = 0;
+}
 
-	/* If this DMM needs additional handling, call the resp. function. */
-	if (dmm->dmm_details)
-		dmm->dmm_details(&analog, info);
+/* How many more samples may be sent before the sample limit is reached. */
+static uint64_t samples_left(const struct dev_context *devc)
+{
+	if (!devc->limits.limit_samples)
+		return G_MAXUINT64;
 
-	if (analog.meaning->mq != 0) {
-		/* Got a measurement. */
-		packet.type = SR_DF_ANALOG;
-		packet.payload = &analog;
-		sr_session_send(sdi, &packet);
-		sr_sw_limits_update_samples_read(&devc->limits, 1);
-	}
+	return devc->limits.limit_samples -
+		MIN(devc->limits.samples_read, devc->limits.limit_samples);
 }
 
 /** Request packet, if required. */
@@ -118,6 +141,12 @@ static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 	struct dev_context *devc;
 	int len, i, offset = 0;
 	struct sr_serial_dev_inst *serial;
+	struct reading_run run;
+	uint8_t packets[DMM_BUFSIZE];
+	float values[DMM_BUFSIZE];
+	struct sr_dmm_reading readings[DMM_BUFSIZE];
+	unsigned int count, n;
+	uint64_t remaining;
 
 	dmm = (struct dmm_info *)sdi->driver;
 
@@ -135,21 +164,25 @@ static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 	}
 	devc->buflen += len;
 
-	/* Now look for packets in that data. */
+	/* Now look for packets in that data, and gather them. */
+	count = 0;
 	while ((devc->buflen - offset) >= dmm->packet_size) {
-		if (dmm->packet_valid(devc->buf + offset)) {
-			handle_packet(devc->buf + offset, sdi, info);
-			offset += dmm->packet_size;
-
-			/* Request next packet, if required. */
-			if (!dmm->packet_request)
-				break;
+		if (!dmm->packet_valid(devc->buf + offset)) {
+			offset++;
+			continue;
+		}
+		log_dmm_packet(devc->buf + offset);
+		memcpy(packets + count * dmm->packet_size, devc->buf + offset,
+			dmm->packet_size);
+		count++;
+		offset += dmm->packet_size;
+
+		/* Request next packet, if required. */
+		if (dmm->packet_request) {
 			if (dmm->req_timeout_ms || dmm->req_delay_ms)
 				devc->req_next_at = g_get_monotonic_time() +
 					dmm->req_delay_ms * 1000;
 			req_packet(sdi);
-		} else {
-			offset++;
 		}
 	}
 
@@ -157,6 +190,35 @@ static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 	for (i = 0; i < devc->buflen - offset; i++)
 		devc->buf[i] = devc->buf[offset + i];
 	devc->buflen -= offset;
+
+	if (!count)
+		return;
+
+	/*
+	 * Decode all packets in one pass, and send consecutive readings of
+	 * the same kind together. Readings past the sample limit are dropped.
+	 */
+	sr_dmm_parse_batch(packets, dmm->packet_size, count, dmm->packet_parse,
+		dmm->dmm_details, info, values, readings);
+	run.analog.num_samples = 0;
+	remaining = samples_left(devc);
+	for (n = 0; n < count && remaining; n++) {
+		if (!readings[n].mq)
+			continue;
+		if (!run_matches(&run, &readings[n])) {
+			send_run(sdi, &run);
+			if (!(remaining = samples_left(devc)))
+				break;
+			start_run(sdi, &run, &readings[n]);
+		}
+		run.values[run.analog.num_samples++] = values[n];
+		if (run.analog.num_samples >= remaining) {
+			send_run(sdi, &run);
+			remaining = samples_left(devc);
+		}
+	}
+
+	send_run(sdi, &run);
 }
 
 int receive_data(int fd, int revents, void *cb_data)
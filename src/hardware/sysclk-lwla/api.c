@@ -174,11 +174,11 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	}
 	if (conn) {
 		/* Find devices matching the connection specification. */
-		conn_devices = sr_usb_find(drvc->sr_ctx->libusb_ctx, conn);
+		conn_devices = sr_usb_find(sr_usb_context(drvc->sr_ctx), conn);
 	}
 
 	/* List all libusb devices. */
-	num_devs = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	num_devs = libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	if (num_devs < 0) {
 		sr_err("Failed to list USB devices: %s.",
 			libusb_error_name(num_devs));
@@ -280,7 +280,7 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 	/* Try the whole shebang three times, fingers crossed. */
 	for (i = 0; i < 3; i++) {
-		ret = sr_usb_open(drvc->sr_ctx->libusb_ctx, usb);
+		ret = sr_usb_open(sr_usb_context(drvc->sr_ctx), usb);
 		if (ret != SR_OK)
 			return ret;
 
@@ -65,10 +65,10 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 		if (src->key != SR_CONF_CONN)
 			continue;
 		str = g_variant_get_string(src->data, NULL);
-		conn_devices = sr_usb_find(drvc->sr_ctx->libusb_ctx, str);
+		conn_devices = sr_usb_find(sr_usb_context(drvc->sr_ctx), str);
 	}
 
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	for (i = 0; devlist[i]; i++) {
 		if (conn_devices) {
 			usb = NULL;
@@ -145,7 +145,7 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 	usb = sdi->conn;
 
-	ret = sr_usb_open(drvc->sr_ctx->libusb_ctx, usb);
+	ret = sr_usb_open(sr_usb_context(drvc->sr_ctx), usb);
 	if (ret != SR_OK)
 		return ret;
 
@@ -356,8 +356,7 @@ static int handle_events(int fd, int revents, void *cb_data)
 	}
 
 	memset(&tv, 0, sizeof(struct timeval));
-	libusb_handle_events_timeout_completed(drvc->sr_ctx->libusb_ctx, &tv,
-			NULL);
+	usb_handle_events(drvc->sr_ctx, &tv, NULL);
 
 	return TRUE;
 }
@@ -70,7 +70,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 		return NULL;
 
 	devices = NULL;
-	if (!(usb_devices = sr_usb_find(drvc->sr_ctx->libusb_ctx, conn))) {
+	if (!(usb_devices = sr_usb_find(sr_usb_context(drvc->sr_ctx), conn))) {
 		g_slist_free_full(usb_devices, g_free);
 		return NULL;
 	}
@@ -104,7 +104,7 @@ static int dev_open(struct sr_dev_inst *sdi)
 	drvc = di->context;
 	usb = sdi->conn;
 
-	if ((ret = sr_usb_open(drvc->sr_ctx->libusb_ctx, usb)) == SR_OK)
+	if ((ret = sr_usb_open(sr_usb_context(drvc->sr_ctx), usb)) == SR_OK)
 		sdi->status = SR_ST_ACTIVE;
 
 	return ret;
@@ -65,7 +65,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	drvc = di->context;
 
 	devices = NULL;
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	for (i = 0; devlist[i]; i++) {
 		libusb_get_device_descriptor(devlist[i], &des);
 
@@ -103,7 +103,7 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 	usb = sdi->conn;
 
-	ret = sr_usb_open(drvc->sr_ctx->libusb_ctx, usb);
+	ret = sr_usb_open(sr_usb_context(drvc->sr_ctx), usb);
 	if (ret != SR_OK)
 		return ret;
 
@@ -278,8 +278,7 @@ static int handle_events(int fd, int revents, void *cb_data)
 	}
 
 	memset(&tv, 0, sizeof(struct timeval));
-	libusb_handle_events_timeout_completed(drvc->sr_ctx->libusb_ctx, &tv,
-					       NULL);
+	usb_handle_events(drvc->sr_ctx, &tv, NULL);
 
 	return TRUE;
 }
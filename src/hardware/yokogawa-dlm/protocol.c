@@ -454,6 +454,7 @@ static int analog_channel_state_get(const struct sr_dev_inst *sdi,
 			ch = l->data;
 			if (ch->index == i) {
 				ch->enabled = state->analog_states[i].state;
+				sr_dev_inst_channels_changed(ch->sdi);
 				break;
 			}
 		}
@@ -535,6 +536,7 @@ static int digital_channel_state_get(const struct sr_dev_inst *sdi,
 			ch = l->data;
 			if (ch->index == i + DLM_DIG_CHAN_INDEX_OFFS) {
 				ch->enabled = state->digital_states[i];
+				sr_dev_inst_channels_changed(ch->sdi);
 				break;
 			}
 		}
@@ -589,6 +591,7 @@ SR_PRIV int dlm_channel_state_set(const struct sr_dev_inst *sdi,
 				}
 
 				ch->enabled = ch_state;
+				sr_dev_inst_channels_changed(ch->sdi);
 				state->analog_states[ch->index].state = ch_state;
 				chan_found = TRUE;
 				break;
@@ -604,6 +607,7 @@ SR_PRIV int dlm_channel_state_set(const struct sr_dev_inst *sdi,
 				}
 
 				ch->enabled = ch_state;
+				sr_dev_inst_channels_changed(ch->sdi);
 				state->digital_states[i] = ch_state;
 				chan_found = TRUE;
 
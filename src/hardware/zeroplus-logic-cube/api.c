@@ -176,7 +176,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	devices = NULL;
 
 	/* Find all ZEROPLUS analyzers and add them to device list. */
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist); /* TODO: Errors. */
+	libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist); /* TODO: Errors. */
 
 	for (i = 0; devlist[i]; i++) {
 		libusb_get_device_descriptor(devlist[i], &des);
@@ -262,7 +262,7 @@ static int dev_open(struct sr_dev_inst *sdi)
 	usb = sdi->conn;
 	devc = sdi->priv;
 
-	ret = sr_usb_open(drvc->sr_ctx->libusb_ctx, usb);
+	ret = sr_usb_open(sr_usb_context(drvc->sr_ctx), usb);
 	if (ret != SR_OK)
 		return ret;
 
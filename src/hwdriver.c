@@ -400,6 +400,44 @@ SR_API int sr_driver_init(struct sr_context *ctx, struct sr_dev_driver *driver)
 	return ret;
 }
 
+/**
+ * Get a hardware driver by name, and initialize it if necessary.
+ *
+ * Frontends which only need one driver can use this instead of calling
+ * sr_driver_init() on every driver in sr_driver_list() up front.
+ *
+ * @param ctx A libsigrok context object allocated by a previous call to
+ *            sr_init(). Must not be NULL.
+ * @param name The name of the driver. Must not be NULL.
+ *
+ * @return The initialized driver, or NULL if there is no such driver or
+ *         it failed to initialize.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_dev_driver *sr_driver_get(struct sr_context *ctx,
+		const char *name)
+{
+	struct sr_dev_driver **drivers;
+	int i;
+
+	if (!ctx || !name)
+		return NULL;
+
+	drivers = sr_driver_list(ctx);
+	for (i = 0; drivers[i]; i++) {
+		if (strcmp(drivers[i]->name, name))
+			continue;
+		if (!drivers[i]->context && sr_driver_init(ctx, drivers[i]) < 0)
+			return NULL;
+		return drivers[i];
+	}
+
+	sr_dbg("No driver named '%s'.", name);
+
+	return NULL;
+}
+
 /**
  * Enumerate scan options supported by this driver.
  *
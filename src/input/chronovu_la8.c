@@ -29,12 +29,13 @@
 
 #define DEFAULT_NUM_CHANNELS    8
 #define DEFAULT_SAMPLERATE      SR_MHZ(100)
-#define MAX_CHUNK_SIZE          (4 * 1024)
+#define MAX_CHUNK_SIZE          (1024 * 1024)
 #define CHRONOVU_LA8_FILESIZE   ((8 * 1024 * 1024) + 5)
 
 struct context {
 	gboolean started;
 	uint64_t samplerate;
+	unsigned int unitsize;
 };
 
 static int format_match(GHashTable *metadata)
@@ -70,19 +71,21 @@ static int init(struct sr_input *in, GHashTable *options)
 		snprintf(name, 16, "%d", i);
 		sr_channel_new(in->sdi, i, SR_CHANNEL_LOGIC, TRUE, name);
 	}
+	inc->unitsize = (num_channels + 7) / 8;
 
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static int process_buffer(struct sr_input *in, GString *buf)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_datafeed_logic logic;
 	struct sr_config *src;
 	struct context *inc;
-	gsize chunk_size, i;
+	gsize chunk_size, len, i;
 	int chunk;
+	char *data;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -103,37 +106,33 @@ static int process_buffer(struct sr_input *in)
 
 	packet.type = SR_DF_LOGIC;
 	packet.payload = &logic;
-	logic.unitsize = (g_slist_length(in->sdi->channels) + 7) / 8;
+	logic.unitsize = inc->unitsize;
 
 	/* Cut off at multiple of unitsize. */
-	chunk_size = in->buf->len / logic.unitsize * logic.unitsize;
+	data = sr_input_buf_begin(in, buf, &len);
+	chunk_size = len / logic.unitsize * logic.unitsize;
 
 	for (i = 0; i < chunk_size; i += chunk) {
-		logic.data = in->buf->str + i;
+		logic.data = data + i;
 		chunk = MIN(MAX_CHUNK_SIZE, chunk_size - i);
 		logic.length = chunk;
 		sr_session_send(in->sdi, &packet);
 	}
-	g_string_erase(in->buf, 0, chunk_size);
+	sr_input_buf_end(in, buf, chunk_size);
 
 	return SR_OK;
 }
 
 static int receive(struct sr_input *in, GString *buf)
 {
-	int ret;
-
-	g_string_append_len(in->buf, buf->str, buf->len);
-
 	if (!in->sdi_ready) {
+		sr_input_buf_append(in, buf->str, buf->len);
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
-
-	return ret;
+	return process_buffer(in, buf);
 }
 
 static int end(struct sr_input *in)
@@ -142,7 +141,7 @@ static int end(struct sr_input *in)
 	int ret;
 
 	if (in->sdi_ready)
-		ret = process_buffer(in);
+		ret = process_buffer(in, NULL);
 	else
 		ret = SR_OK;
 
@@ -158,7 +157,7 @@ static int reset(struct sr_input *in)
 	struct context *inc = in->priv;
 
 	inc->started = FALSE;
-	g_string_truncate(in->buf, 0);
+	sr_input_buf_clear(in);
 
 	return SR_OK;
 }
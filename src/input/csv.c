@@ -506,16 +506,16 @@ static int init(struct sr_input *in, GHashTable *options)
 
 static const char *delim_set = "\r\n";
 
-static const char *get_line_termination(GString *buf)
+static const char *get_line_termination(const char *buf, size_t len)
 {
 	const char *term;
 
 	term = NULL;
-	if (g_strstr_len(buf->str, buf->len, "\r\n"))
+	if (g_strstr_len(buf, len, "\r\n"))
 		term = "\r\n";
-	else if (memchr(buf->str, '\n', buf->len))
+	else if (memchr(buf, '\n', len))
 		term = "\n";
-	else if (memchr(buf->str, '\r', buf->len))
+	else if (memchr(buf, '\r', len))
 		term = "\r";
 
 	return term;
@@ -648,45 +648,50 @@ out:
  * against multiple execution or dropping the BOM multiple times --
  * there should be at most one in the input stream.
  */
-static void initial_bom_check(const struct sr_input *in)
+static void initial_bom_check(struct sr_input *in)
 {
 	static const char *utf8_bom = "\xef\xbb\xbf";
+	size_t len;
+	char *data;
 
-	if (in->buf->len < strlen(utf8_bom))
+	data = sr_input_buf_data(in, &len);
+	if (len < strlen(utf8_bom))
 		return;
-	if (strncmp(in->buf->str, utf8_bom, strlen(utf8_bom)) != 0)
+	if (strncmp(data, utf8_bom, strlen(utf8_bom)) != 0)
 		return;
-	g_string_erase(in->buf, 0, strlen(utf8_bom));
+	sr_input_buf_skip(in, strlen(utf8_bom));
 }
 
-static int initial_receive(const struct sr_input *in)
+static int initial_receive(struct sr_input *in)
 {
 	struct context *inc;
 	GString *new_buf;
 	int len, ret;
-	char *p;
+	size_t data_len;
+	char *data, *p;
 	const char *termination;
 
 	initial_bom_check(in);
 
 	inc = in->priv;
 
-	termination = get_line_termination(in->buf);
+	data = sr_input_buf_data(in, &data_len);
+	termination = get_line_termination(data, data_len);
 	if (!termination)
 		/* Don't have a full line yet. */
 		return SR_ERR_NA;
 
-	p = g_strrstr_len(in->buf->str, in->buf->len, termination);
+	p = g_strrstr_len(data, data_len, termination);
 	if (!p)
 		/* Don't have a full line yet. */
 		return SR_ERR_NA;
-	len = p - in->buf->str - 1;
-	new_buf = g_string_new_len(in->buf->str, len);
+	len = p - data - 1;
+	new_buf = g_string_new_len(data, len);
 	g_string_append_c(new_buf, '\0');
 
 	inc->termination = g_strdup(termination);
 
-	if (in->buf->str[0] != '\0')
+	if (data[0] != '\0')
 		ret = initial_parse(in, new_buf);
 	else
 		ret = SR_OK;
@@ -705,7 +710,8 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 	gsize num_columns;
 	uint64_t samplerate;
 	int max_columns, ret, l;
-	char *p, **lines, *line, **columns;
+	size_t len;
+	char *data, *p, **lines, *line, **columns;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -744,21 +750,22 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 	 * on Windows). A present termination sequence will just result
 	 * in the "execution of an empty line", and does not harm.
 	 */
-	if (!in->buf->len)
+	data = sr_input_buf_data(in, &len);
+	if (!len)
 		return SR_OK;
 	if (is_eof) {
-		p = in->buf->str + in->buf->len;
+		p = data + len;
 	} else {
-		p = g_strrstr_len(in->buf->str, in->buf->len, inc->termination);
+		p = g_strrstr_len(data, len, inc->termination);
 		if (!p)
 			return SR_ERR;
 		*p = '\0';
 		p += strlen(inc->termination);
 	}
-	g_strstrip(in->buf->str);
+	g_strstrip(data);
 
 	ret = SR_OK;
-	lines = g_strsplit_set(in->buf->str, delim_set, 0);
+	lines = g_strsplit_set(data, delim_set, 0);
 	for (l = 0; lines[l]; l++) {
 		inc->line_number++;
 		line = lines[l];
@@ -829,7 +836,7 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 		g_strfreev(columns);
 	}
 	g_strfreev(lines);
-	g_string_erase(in->buf, 0, p - in->buf->str);
+	sr_input_buf_skip(in, p - data);
 
 	return ret;
 }
@@ -839,7 +846,7 @@ static int receive(struct sr_input *in, GString *buf)
 	struct context *inc;
 	int ret;
 
-	g_string_append_len(in->buf, buf->str, buf->len);
+	sr_input_buf_append(in, buf->str, buf->len);
 
 	inc = in->priv;
 	if (!inc->termination) {
@@ -905,7 +912,7 @@ static int reset(struct sr_input *in)
 
 	cleanup(in);
 	inc->started = FALSE;
-	g_string_truncate(in->buf, 0);
+	sr_input_buf_clear(in);
 
 	return SR_OK;
 }
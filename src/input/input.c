@@ -20,6 +20,7 @@
 #include <config.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
@@ -27,6 +28,9 @@
 
 /** @cond PRIVATE */
 #define LOG_PREFIX "input"
+
+/* Size of the pieces in which sr_input_send_fd() passes on a file. */
+#define SEND_FD_CHUNK_SIZE (4 * 1024 * 1024)
 /** @endcond */
 
 /**
@@ -66,6 +70,7 @@ extern SR_PRIV struct sr_input_module input_trace32_ad;
 extern SR_PRIV struct sr_input_module input_vcd;
 extern SR_PRIV struct sr_input_module input_wav;
 extern SR_PRIV struct sr_input_module input_raw_analog;
+extern SR_PRIV struct sr_input_module input_stream;
 /* @endcond */
 
 static const struct sr_input_module *input_module_list[] = {
@@ -76,6 +81,7 @@ static const struct sr_input_module *input_module_list[] = {
 	&input_vcd,
 	&input_wav,
 	&input_raw_analog,
+	&input_stream,
 	NULL,
 };
 
@@ -545,6 +551,182 @@ SR_API int sr_input_send(const struct sr_input *in, GString *buf)
 	return in->module->receive((struct sr_input *)in, buf);
 }
 
+/*
+ * Send data which transform modules may modify in place, without copying
+ * it. Input modules themselves only ever read the buffer passed to them.
+ */
+static int send_writable(const struct sr_input *in, char *data, size_t len)
+{
+	GString buf;
+
+	buf.str = data;
+	buf.len = len;
+	buf.allocated_len = len;
+
+	return sr_input_send(in, &buf);
+}
+
+/**
+ * Send data to the specified input instance, without copying it.
+ *
+ * This works like sr_input_send(), for data in a buffer owned by the
+ * caller. Input modules parse the data in place where they can, and only
+ * copy the part they have to keep until more data arrives.
+ *
+ * Transform modules modify packets in place, so if any are attached to
+ * the session, the data is copied after all and the caller's buffer is
+ * left alone.
+ *
+ * @param in The input instance.
+ * @param data The data to send. Only needs to stay valid during the call.
+ * @param len The number of bytes in data.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other Error code returned by the input module.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_input_send_data(const struct sr_input *in,
+		const void *data, size_t len)
+{
+	GString *copy;
+	int ret;
+
+	if (!in || (!data && len))
+		return SR_ERR_ARG;
+
+	if (!in->sdi || !in->sdi->session || !in->sdi->session->transforms)
+		return send_writable(in, (char *)data, len);
+
+	copy = g_string_new_len(data, len);
+	ret = sr_input_send(in, copy);
+	g_string_free(copy, TRUE);
+
+	return ret;
+}
+
+static int send_mapped(const struct sr_input *in, GMappedFile *file,
+		int fd, gboolean *eof)
+{
+	char *data;
+	off_t pos;
+	size_t len, count;
+	gboolean was_ready;
+	int ret;
+
+	pos = lseek(fd, 0, SEEK_CUR);
+	if (pos < 0)
+		return SR_ERR;
+	len = g_mapped_file_get_length(file);
+	data = g_mapped_file_get_contents(file);
+	if ((uint64_t)pos >= len) {
+		*eof = TRUE;
+		return SR_OK;
+	}
+	data += pos;
+	len -= pos;
+
+	was_ready = in->sdi_ready;
+	ret = SR_OK;
+	while (len) {
+		count = MIN(len, SEND_FD_CHUNK_SIZE);
+		ret = send_writable(in, data, count);
+		data += count;
+		len -= count;
+		pos += count;
+		if (ret != SR_OK || (!was_ready && in->sdi_ready))
+			break;
+	}
+	if (lseek(fd, pos, SEEK_SET) < 0) {
+		sr_err("Failed to seek: %s", g_strerror(errno));
+		return SR_ERR;
+	}
+	*eof = (len == 0);
+
+	return ret;
+}
+
+static int send_read(const struct sr_input *in, int fd, gboolean *eof)
+{
+	char *buf;
+	ssize_t count;
+	gboolean was_ready;
+	int ret;
+
+	buf = g_malloc(SEND_FD_CHUNK_SIZE);
+	was_ready = in->sdi_ready;
+	ret = SR_OK;
+	while (1) {
+		count = read(fd, buf, SEND_FD_CHUNK_SIZE);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count < 0) {
+			sr_err("Failed to read: %s", g_strerror(errno));
+			ret = SR_ERR;
+			break;
+		}
+		if (count == 0) {
+			*eof = TRUE;
+			break;
+		}
+		ret = send_writable(in, buf, count);
+		if (ret != SR_OK || (!was_ready && in->sdi_ready))
+			break;
+	}
+	g_free(buf);
+
+	return ret;
+}
+
+/**
+ * Send the contents of a file to the specified input instance.
+ *
+ * Data is taken from the file descriptor's current position on. Regular
+ * files are memory-mapped copy-on-write, so they are not copied unless a
+ * transform module modifies the data, and the file itself never is.
+ * Other files, like pipes, are read in chunks.
+ *
+ * Like sr_input_send(), this returns as soon as the input instance's
+ * device instance is ready, with the file position just past the data
+ * sent. Call it again to send the rest.
+ *
+ * @param in The input instance.
+ * @param fd The file descriptor to read from. It is not closed.
+ * @param eof Will be set to TRUE when the end of the file was reached,
+ *            FALSE otherwise. Can be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR Error reading the file.
+ * @retval other Error code returned by the input module.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_input_send_fd(const struct sr_input *in, int fd, gboolean *eof)
+{
+	GMappedFile *file;
+	gboolean at_end;
+	int ret;
+
+	if (!in || fd < 0)
+		return SR_ERR_ARG;
+
+	at_end = FALSE;
+	/* Writable, for transforms. The mapping is private to the process. */
+	file = g_mapped_file_new_from_fd(fd, TRUE, NULL);
+	if (file) {
+		ret = send_mapped(in, file, fd, &at_end);
+		g_mapped_file_unref(file);
+	} else {
+		ret = send_read(in, fd, &at_end);
+	}
+	if (eof)
+		*eof = at_end;
+
+	return ret;
+}
+
 /**
  * Signal the input module no more data will come.
  *
@@ -593,14 +775,155 @@ SR_API void sr_input_free(const struct sr_input *in)
 	if (in->module->cleanup)
 		in->module->cleanup((struct sr_input *)in);
 	sr_dev_inst_free(in->sdi);
-	if (in->buf->len > 64) {
+	if (in->buf->len - in->buf_pos > 64) {
 		/* That seems more than just some sub-unitsize leftover... */
-		sr_warn("Found %" G_GSIZE_FORMAT
-			" unprocessed bytes at free time.", in->buf->len);
+		sr_warn("Found %" G_GSIZE_FORMAT " unprocessed bytes at free time.",
+			in->buf->len - in->buf_pos);
 	}
 	g_string_free(in->buf, TRUE);
 	g_free(in->priv);
 	g_free((gpointer)in);
 }
 
+/*
+ * Input modules receive their data in pieces of arbitrary size, and may
+ * have to keep some of it until more arrives (a partial sample, line or
+ * record). That leftover is kept in in->buf, where in->buf_pos is the
+ * read cursor: everything before it has been consumed already.
+ *
+ * Consuming data only moves the cursor. The consumed space is reclaimed
+ * when more data gets appended, and only once it is at least as large as
+ * the unread data, so every byte gets moved a bounded number of times
+ * however small the pieces are.
+ */
+
+/**
+ * Append data to an input instance's buffer.
+ *
+ * @param in The input instance.
+ * @param data The data to append.
+ * @param len The number of bytes in data.
+ *
+ * @private
+ */
+SR_PRIV void sr_input_buf_append(struct sr_input *in,
+		const char *data, size_t len)
+{
+	size_t unread;
+
+	unread = in->buf->len - in->buf_pos;
+	if (in->buf_pos && in->buf_pos >= unread) {
+		memmove(in->buf->str, in->buf->str + in->buf_pos, unread);
+		g_string_truncate(in->buf, unread);
+		in->buf_pos = 0;
+	}
+	g_string_append_len(in->buf, data, len);
+}
+
+/**
+ * Get the unread data in an input instance's buffer.
+ *
+ * The data is followed by a NUL byte, and may be modified in place.
+ *
+ * @param in The input instance.
+ * @param len Will be set to the number of unread bytes.
+ *
+ * @return A pointer to the first unread byte.
+ *
+ * @private
+ */
+SR_PRIV char *sr_input_buf_data(const struct sr_input *in, size_t *len)
+{
+	*len = in->buf->len - in->buf_pos;
+
+	return in->buf->str + in->buf_pos;
+}
+
+/**
+ * Mark data at the start of an input instance's buffer as consumed.
+ *
+ * @param in The input instance.
+ * @param len The number of bytes consumed.
+ *
+ * @private
+ */
+SR_PRIV void sr_input_buf_skip(struct sr_input *in, size_t len)
+{
+	in->buf_pos += MIN(len, in->buf->len - in->buf_pos);
+	if (in->buf_pos == in->buf->len)
+		sr_input_buf_clear(in);
+}
+
+/**
+ * Discard all data in an input instance's buffer.
+ *
+ * @param in The input instance.
+ *
+ * @private
+ */
+SR_PRIV void sr_input_buf_clear(struct sr_input *in)
+{
+	g_string_truncate(in->buf, 0);
+	in->buf_pos = 0;
+}
+
+/**
+ * Start parsing a piece of data passed to an input module.
+ *
+ * When there is no leftover from earlier pieces, the data is parsed
+ * straight from the caller's buffer. Otherwise it is appended to the
+ * leftover. Must be followed by a call to sr_input_buf_end().
+ *
+ * This is meant for binary data: unlike with sr_input_buf_data(), the
+ * data is not guaranteed to be followed by a NUL byte, and must not be
+ * modified.
+ *
+ * @param in The input instance.
+ * @param buf The data passed to the module. Can be NULL, to parse just
+ *            what is in the input instance's buffer.
+ * @param len Will be set to the number of bytes available.
+ *
+ * @return A pointer to the first byte available.
+ *
+ * @private
+ */
+SR_PRIV char *sr_input_buf_begin(struct sr_input *in, GString *buf,
+		size_t *len)
+{
+	if (buf && in->buf_pos == in->buf->len) {
+		*len = buf->len;
+		return buf->str;
+	}
+
+	if (buf)
+		sr_input_buf_append(in, buf->str, buf->len);
+
+	return sr_input_buf_data(in, len);
+}
+
+/**
+ * Finish parsing a piece of data passed to an input module.
+ *
+ * Whatever was not consumed is kept in the input instance's buffer, to be
+ * parsed along with the next piece.
+ *
+ * @param in The input instance.
+ * @param buf The data passed to sr_input_buf_begin().
+ * @param used The number of bytes consumed, counting from the pointer
+ *             returned by sr_input_buf_begin().
+ *
+ * @private
+ */
+SR_PRIV void sr_input_buf_end(struct sr_input *in, GString *buf, size_t used)
+{
+	/* An empty buffer means the data was parsed in place. */
+	if (buf && in->buf_pos == in->buf->len) {
+		if (used < buf->len)
+			sr_input_buf_append(in, buf->str + used, buf->len - used);
+		return;
+	}
+
+	sr_input_buf_skip(in, used);
+}
+
 /** @} */
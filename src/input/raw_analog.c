@@ -141,13 +141,15 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static int process_buffer(struct sr_input *in, GString *buf)
 {
 	struct context *inc;
 	struct sr_datafeed_meta meta;
 	struct sr_datafeed_packet packet;
 	struct sr_config *src;
 	unsigned int offset, chunk_size;
+	size_t len;
+	char *data;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -170,49 +172,38 @@ static int process_buffer(struct sr_input *in)
 	inc->analog.num_samples = CHUNK_SIZE / inc->samplesize;
 	chunk_size = inc->analog.num_samples * inc->samplesize;
 	offset = 0;
+	data = sr_input_buf_begin(in, buf, &len);
 
-	while ((offset + chunk_size) < in->buf->len) {
-		inc->analog.data = in->buf->str + offset;
+	while ((offset + chunk_size) < len) {
+		inc->analog.data = data + offset;
 		sr_session_send(in->sdi, &inc->packet);
 		offset += chunk_size;
 	}
 
-	inc->analog.num_samples = (in->buf->len - offset) / inc->samplesize;
+	inc->analog.num_samples = (len - offset) / inc->samplesize;
 	chunk_size = inc->analog.num_samples * inc->samplesize;
 	if (chunk_size > 0) {
-		inc->analog.data = in->buf->str + offset;
+		inc->analog.data = data + offset;
 		sr_session_send(in->sdi, &inc->packet);
 		offset += chunk_size;
 	}
 
-	if ((unsigned int)offset < in->buf->len) {
-		/*
-		 * The incoming buffer wasn't processed completely. Stash
-		 * the leftover data for next time.
-		 */
-		g_string_erase(in->buf, 0, offset);
-	} else {
-		g_string_truncate(in->buf, 0);
-	}
+	/* Stash any leftover data for next time. */
+	sr_input_buf_end(in, buf, offset);
 
 	return SR_OK;
 }
 
 static int receive(struct sr_input *in, GString *buf)
 {
-	int ret;
-
-	g_string_append_len(in->buf, buf->str, buf->len);
-
 	if (!in->sdi_ready) {
+		sr_input_buf_append(in, buf->str, buf->len);
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
-
-	return ret;
+	return process_buffer(in, buf);
 }
 
 static int end(struct sr_input *in)
@@ -221,7 +212,7 @@ static int end(struct sr_input *in)
 	int ret;
 
 	if (in->sdi_ready)
-		ret = process_buffer(in);
+		ret = process_buffer(in, NULL);
 	else
 		ret = SR_OK;
 
@@ -273,7 +264,7 @@ static int reset(struct sr_input *in)
 
 	cleanup(in);
 	inc->started = FALSE;
-	g_string_truncate(in->buf, 0);
+	sr_input_buf_clear(in);
 
 	return SR_OK;
 }
@@ -0,0 +1,472 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reads the binary datafeed stream written by the "stream" output module
+ * (see libsigrok-internal.h for the format), and replays its packets into
+ * the session. The caller feeds data from wherever it comes from: a file,
+ * a pipe, or a socket the frontend reads from.
+ *
+ * Logic and analog payloads are passed on straight from the input buffer,
+ * without copying them into separate packet buffers.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "input/stream"
+
+#define ANALOG_HDR_SIZE		60
+
+struct context {
+	gboolean magic_done;
+	gboolean device_done;
+	gboolean started;
+	gboolean ended;
+	/* Channels of in->sdi, indexed by channel index. */
+	GPtrArray *channels;
+	/* Aligned copy of analog data, for unaligned frames only. */
+	void *scratch;
+	size_t scratch_size;
+};
+
+static int format_match(GHashTable *metadata)
+{
+	GString *buf;
+
+	buf = g_hash_table_lookup(metadata, GINT_TO_POINTER(SR_INPUT_META_HEADER));
+	if (buf->len < SR_STREAM_MAGIC_SIZE)
+		return SR_ERR;
+	if (memcmp(buf->str, SR_STREAM_MAGIC, SR_STREAM_MAGIC_SIZE))
+		return SR_ERR;
+
+	return SR_OK;
+}
+
+static int init(struct sr_input *in, GHashTable *options)
+{
+	struct context *inc;
+
+	(void)options;
+
+	in->sdi = g_malloc0(sizeof(struct sr_dev_inst));
+	in->priv = inc = g_malloc0(sizeof(struct context));
+	inc->channels = g_ptr_array_new();
+
+	return SR_OK;
+}
+
+/* Check the channel list before anything gets added to the device. */
+static int check_channels(const uint8_t *p, const uint8_t *end,
+		uint32_t num_channels)
+{
+	GHashTable *seen;
+	uint32_t i, index;
+	int ret;
+
+	seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+	ret = SR_OK;
+	for (i = 0; i < num_channels; i++) {
+		if (end - p < 10 || end - p < 10 + p[9]) {
+			ret = SR_ERR_DATA;
+			break;
+		}
+		index = RL32(&p[0]);
+		if (index > G_MAXUINT16) {
+			sr_err("Invalid channel index %u.", index);
+			ret = SR_ERR_DATA;
+			break;
+		}
+		if (g_hash_table_contains(seen, GUINT_TO_POINTER(index + 1))) {
+			sr_err("Duplicate channel index %u.", index);
+			ret = SR_ERR_DATA;
+			break;
+		}
+		g_hash_table_add(seen, GUINT_TO_POINTER(index + 1));
+		p += 10 + p[9];
+	}
+	g_hash_table_destroy(seen);
+
+	return ret;
+}
+
+static int process_device(struct sr_input *in, const uint8_t *p, uint32_t len)
+{
+	struct context *inc;
+	struct sr_channel *ch;
+	const uint8_t *end;
+	uint32_t num_channels, i, index;
+	int type, ret;
+	gboolean enabled;
+	char *name;
+
+	inc = in->priv;
+	if (inc->device_done) {
+		sr_err("Duplicate device description in stream.");
+		return SR_ERR_DATA;
+	}
+	inc->device_done = TRUE;
+	if (in->sdi_ready) {
+		/* Re-sent after a reset, the channels already exist. */
+		return SR_OK;
+	}
+	if (len < 4)
+		return SR_ERR_DATA;
+
+	end = p + len;
+	num_channels = RL32(p);
+	p += 4;
+	if ((ret = check_channels(p, end, num_channels)) != SR_OK)
+		return ret;
+
+	for (i = 0; i < num_channels; i++) {
+		index = RL32(&p[0]);
+		type = RL32(&p[4]);
+		enabled = p[8] ? TRUE : FALSE;
+		name = g_strndup((const char *)&p[10], p[9]);
+		ch = sr_channel_new(in->sdi, index, type, enabled, name);
+		g_free(name);
+		if (index >= inc->channels->len)
+			g_ptr_array_set_size(inc->channels, index + 1);
+		g_ptr_array_index(inc->channels, index) = ch;
+		p += 10 + p[9];
+	}
+	in->sdi_ready = TRUE;
+
+	return SR_OK;
+}
+
+static int send_header(struct sr_input *in, const uint8_t *p, uint32_t len)
+{
+	struct context *inc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_header header;
+
+	inc = in->priv;
+	if (len < 20)
+		return SR_ERR_DATA;
+
+	header.feed_version = RL32(&p[0]);
+	header.starttime.tv_sec = RL64(&p[4]);
+	header.starttime.tv_usec = RL64(&p[12]);
+	packet.type = SR_DF_HEADER;
+	packet.payload = &header;
+	inc->started = TRUE;
+
+	return sr_session_send(in->sdi, &packet);
+}
+
+static int send_meta(struct sr_input *in, const uint8_t *p, uint32_t len)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	GVariant *gvar, *tmp, *value;
+	GVariantIter iter;
+	uint32_t key;
+	int ret;
+
+	gvar = g_variant_new_from_data(G_VARIANT_TYPE("a(uv)"),
+			g_memdup(p, len), len, FALSE, g_free, NULL);
+	g_variant_ref_sink(gvar);
+	if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+		tmp = gvar;
+		gvar = g_variant_ref_sink(g_variant_byteswap(tmp));
+		g_variant_unref(tmp);
+	}
+	if (!g_variant_is_normal_form(gvar)) {
+		g_variant_unref(gvar);
+		return SR_ERR_DATA;
+	}
+
+	meta.config = NULL;
+	g_variant_iter_init(&iter, gvar);
+	while (g_variant_iter_next(&iter, "(uv)", &key, &value)) {
+		meta.config = g_slist_append(meta.config, sr_config_new(key, value));
+		g_variant_unref(value);
+	}
+	g_variant_unref(gvar);
+
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	ret = sr_session_send(in->sdi, &packet);
+	g_slist_free_full(meta.config, (GDestroyNotify)sr_config_free);
+
+	return ret;
+}
+
+static int send_logic(struct sr_input *in, const uint8_t *p, uint32_t len)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+
+	if (len < 2)
+		return SR_ERR_DATA;
+
+	logic.unitsize = RL16(p);
+	logic.length = len - 2;
+	logic.data = (void *)(p + 2);
+	if (!logic.unitsize || logic.length % logic.unitsize)
+		return SR_ERR_DATA;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	return sr_session_send(in->sdi, &packet);
+}
+
+static int send_analog(struct sr_input *in, const uint8_t *p, uint32_t len)
+{
+	struct context *inc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_channel *ch;
+	uint32_t num_channels, i, index;
+	size_t hdr_len, data_len;
+	const uint8_t *data;
+	int ret;
+
+	inc = in->priv;
+	if (len < ANALOG_HDR_SIZE)
+		return SR_ERR_DATA;
+	num_channels = RL32(&p[56]);
+	hdr_len = ANALOG_HDR_SIZE + 4 * (size_t)num_channels;
+	if (num_channels > inc->channels->len || len < hdr_len)
+		return SR_ERR_DATA;
+
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	analog.num_samples = RL32(&p[0]);
+	encoding.unitsize = p[4];
+	encoding.is_signed = p[5] ? TRUE : FALSE;
+	encoding.is_float = p[6] ? TRUE : FALSE;
+	encoding.is_bigendian = p[7] ? TRUE : FALSE;
+	encoding.digits = (int8_t)p[8];
+	encoding.is_digits_decimal = p[9] ? TRUE : FALSE;
+	spec.spec_digits = (int8_t)p[10];
+	encoding.scale.p = RL64S(&p[12]);
+	encoding.scale.q = RL64(&p[20]);
+	encoding.offset.p = RL64S(&p[28]);
+	encoding.offset.q = RL64(&p[36]);
+	meaning.mq = RL32(&p[44]);
+	meaning.unit = RL32(&p[48]);
+	meaning.mqflags = RL32(&p[52]);
+
+	for (i = 0; i < num_channels; i++) {
+		index = RL32(&p[ANALOG_HDR_SIZE + 4 * i]);
+		if (index >= inc->channels->len
+				|| !(ch = g_ptr_array_index(inc->channels, index))) {
+			g_slist_free(meaning.channels);
+			return SR_ERR_DATA;
+		}
+		meaning.channels = g_slist_append(meaning.channels, ch);
+	}
+
+	data = p + hdr_len;
+	data_len = len - hdr_len;
+	if (data_len != (size_t)analog.num_samples * MAX(num_channels, 1)
+			* encoding.unitsize) {
+		g_slist_free(meaning.channels);
+		return SR_ERR_DATA;
+	}
+	/* Frames are packed, so the data may be misaligned for its type. */
+	if (encoding.unitsize > 1 && (uintptr_t)data % encoding.unitsize) {
+		if (inc->scratch_size < data_len) {
+			g_free(inc->scratch);
+			inc->scratch = g_malloc(data_len);
+			inc->scratch_size = data_len;
+		}
+		memcpy(inc->scratch, data, data_len);
+		data = inc->scratch;
+	}
+
+	analog.data = (void *)data;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	ret = sr_session_send(in->sdi, &packet);
+	g_slist_free(meaning.channels);
+
+	return ret;
+}
+
+static int process_frame(struct sr_input *in, uint16_t type,
+		const uint8_t *p, uint32_t len)
+{
+	struct context *inc;
+	struct sr_datafeed_packet packet;
+
+	inc = in->priv;
+	if (type == SR_STREAM_FRAME_DEVICE)
+		return process_device(in, p, len);
+	if (!in->sdi_ready) {
+		sr_err("Stream data before device description.");
+		return SR_ERR_DATA;
+	}
+
+	switch (type) {
+	case SR_DF_HEADER:
+		return send_header(in, p, len);
+	case SR_DF_META:
+		return send_meta(in, p, len);
+	case SR_DF_LOGIC:
+		return send_logic(in, p, len);
+	case SR_DF_ANALOG:
+		return send_analog(in, p, len);
+	case SR_DF_END:
+		inc->ended = TRUE;
+		/* Fall through. */
+	case SR_DF_TRIGGER:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
+		packet.type = type;
+		packet.payload = NULL;
+		return sr_session_send(in->sdi, &packet);
+	default:
+		sr_dbg("Skipping unknown frame type %d.", type);
+		return SR_OK;
+	}
+}
+
+/*
+ * Process all complete frames in the input buffer. Before the device
+ * instance is ready, stop right after the device description, so that
+ * the frontend gets a chance to set up the session first.
+ */
+static int process_buffer(struct sr_input *in, GString *buf)
+{
+	struct context *inc;
+	const uint8_t *p;
+	uint32_t len;
+	uint16_t type;
+	gsize offset, size;
+	gboolean was_ready;
+	int ret;
+
+	inc = in->priv;
+	p = (const uint8_t *)sr_input_buf_begin(in, buf, &size);
+	offset = 0;
+
+	if (!inc->magic_done) {
+		if (size < SR_STREAM_MAGIC_SIZE) {
+			sr_input_buf_end(in, buf, 0);
+			return SR_OK;
+		}
+		if (memcmp(p, SR_STREAM_MAGIC, SR_STREAM_MAGIC_SIZE)) {
+			sr_err("Not a sigrok datafeed stream.");
+			sr_input_buf_end(in, buf, 0);
+			return SR_ERR_DATA;
+		}
+		inc->magic_done = TRUE;
+		offset = SR_STREAM_MAGIC_SIZE;
+	}
+
+	ret = SR_OK;
+	was_ready = in->sdi_ready;
+	while (size - offset >= SR_STREAM_FRAME_HDR_SIZE) {
+		len = RL32(p + offset);
+		type = RL16(p + offset + 4);
+		if (len > SR_STREAM_MAX_FRAME_SIZE) {
+			sr_err("Invalid frame length %u.", len);
+			ret = SR_ERR_DATA;
+			break;
+		}
+		if (size - offset - SR_STREAM_FRAME_HDR_SIZE < len)
+			break;
+		offset += SR_STREAM_FRAME_HDR_SIZE;
+		ret = process_frame(in, type, p + offset, len);
+		offset += len;
+		if (ret != SR_OK) {
+			sr_err("Invalid frame of type %d.", type);
+			break;
+		}
+		if (!was_ready && in->sdi_ready)
+			break;
+	}
+	sr_input_buf_end(in, buf, offset);
+
+	return ret;
+}
+
+static int receive(struct sr_input *in, GString *buf)
+{
+	return process_buffer(in, buf);
+}
+
+static int end(struct sr_input *in)
+{
+	struct context *inc;
+	int ret;
+
+	inc = in->priv;
+	if (!in->sdi_ready)
+		return SR_OK;
+
+	/* The device description may have stopped the previous run early. */
+	ret = process_buffer(in, NULL);
+
+	/* Terminate a stream that was cut off. */
+	if (inc->started && !inc->ended)
+		std_session_send_df_end(in->sdi);
+
+	return ret;
+}
+
+static void cleanup(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	g_ptr_array_free(inc->channels, TRUE);
+	g_free(inc->scratch);
+}
+
+static int reset(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	inc->magic_done = FALSE;
+	inc->device_done = FALSE;
+	inc->started = FALSE;
+	inc->ended = FALSE;
+	sr_input_buf_clear(in);
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_input_module input_stream = {
+	.id = "stream",
+	.name = "Stream",
+	.desc = "Binary datafeed stream",
+	.exts = (const char*[]){"srs", NULL},
+	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	.format_match = format_match,
+	.init = init,
+	.receive = receive,
+	.end = end,
+	.reset = reset,
+	.cleanup = cleanup,
+};
@@ -45,8 +45,7 @@
 
 #define LOG_PREFIX "input/trace32_ad"
 
-#define MAX_CHUNK_SIZE    4096
-#define OUTBUF_FLUSH_SIZE 10240
+#define OUTBUF_SIZE       (1024 * 1024)
 #define MAX_POD_COUNT     12
 #define HEADER_SIZE       80
 
@@ -93,10 +92,12 @@ struct context {
 	int32_t last_record;
 	uint64_t samplerate;
 	double timestamp_scale;
-	GString *out_buf;
+	unsigned int unitsize;
+	uint8_t *out_buf;
+	size_t out_len, out_size;
 };
 
-static int process_header(GString *buf, struct context *inc);
+static int process_header(const char *buf, struct context *inc);
 static void create_channels(struct sr_input *in);
 
 static char get_pod_name_from_id(int id)
@@ -123,6 +124,7 @@ static char get_pod_name_from_id(int id)
 static int init(struct sr_input *in, GHashTable *options)
 {
 	struct context *inc;
+	struct sr_dev_channel_cache *cache;
 	int pod;
 	char id[17];
 
@@ -152,7 +154,12 @@ static int init(struct sr_input *in, GHashTable *options)
 		return SR_ERR;
 	}
 
-	inc->out_buf = g_string_sized_new(OUTBUF_FLUSH_SIZE);
+	/* The output buffer holds a whole number of samples. */
+	cache = sr_dev_inst_channel_cache_get(in->sdi);
+	inc->unitsize = (cache->num_all + 7) / 8;
+	sr_dev_channel_cache_unref(cache);
+	inc->out_size = OUTBUF_SIZE / inc->unitsize * inc->unitsize;
+	inc->out_buf = g_malloc(inc->out_size);
 
 	return SR_OK;
 }
@@ -163,10 +170,10 @@ static int format_match(GHashTable *metadata)
 
 	buf = g_hash_table_lookup(metadata, GINT_TO_POINTER(SR_INPUT_META_HEADER));
 
-	return process_header(buf, NULL);
+	return process_header(buf->str, NULL);
 }
 
-static int process_header(GString *buf, struct context *inc)
+static int process_header(const char *buf, struct context *inc)
 {
 	char *format_name, *format_name_sig;
 	int i, record_size, device_id;
@@ -192,7 +199,7 @@ static int process_header(GString *buf, struct context *inc)
 
 	/* Note: inc is off-limits until we check whether it's a valid pointer. */
 
-	format_name = g_strndup(buf->str, 32);
+	format_name = g_strndup(buf, 32);
 
 	/* File format name ends on 0x20/0x1A, let's remove both. */
 	for (i = 1; i < 31; i++) {
@@ -225,7 +232,7 @@ static int process_header(GString *buf, struct context *inc)
 
 	sr_dbg("File says it's \"%s\"", format_name);
 
-	record_size = R8(buf->str + 56);
+	record_size = R8(buf + 56);
 	device_id = 0;
 
 	if (g_strcmp0(format_name, "trace32 power integrator data") == 0) {
@@ -252,12 +259,12 @@ static int process_header(GString *buf, struct context *inc)
 		return SR_OK;
 
 	inc->device       = device_id;
-	inc->trigger_timestamp = RL64(buf->str + 32);
-	inc->compression  = R8(buf->str + 48); /* Maps to the enum. */
-	inc->record_mode  = R8(buf->str + 55); /* Maps to the enum. */
+	inc->trigger_timestamp = RL64(buf + 32);
+	inc->compression  = R8(buf + 48); /* Maps to the enum. */
+	inc->record_mode  = R8(buf + 55); /* Maps to the enum. */
 	inc->record_size  = record_size;
-	inc->record_count = RL32(buf->str + 60);
-	inc->last_record  = RL32S(buf->str + 64);
+	inc->record_count = RL32(buf + 60);
+	inc->last_record  = RL32S(buf + 64);
 
 	sr_dbg("Trigger occured at %lf s.",
 		inc->trigger_timestamp * TIMESTAMP_RESOLUTION);
@@ -332,31 +339,133 @@ static void flush_output_buffer(struct sr_input *in)
 
 	inc = in->priv;
 
-	if (inc->out_buf->len) {
+	if (inc->out_len) {
 		packet.type = SR_DF_LOGIC;
 		packet.payload = &logic;
-		logic.unitsize = (g_slist_length(in->sdi->channels) + 7) / 8;
-		logic.data = inc->out_buf->str;
-		logic.length = inc->out_buf->len;
+		logic.unitsize = inc->unitsize;
+		logic.data = inc->out_buf;
+		logic.length = inc->out_len;
 		sr_session_send(in->sdi, &packet);
 
-		g_string_truncate(inc->out_buf, 0);
+		inc->out_len = 0;
 	}
 }
 
-static void process_record_pi(struct sr_input *in, gsize start)
+/* Fill dst with count copies of a sample, doubling up what's written. */
+static void fill_samples(uint8_t *dst, const uint8_t *sample,
+		unsigned int unitsize, uint64_t count)
+{
+	size_t done, total, len;
+
+	if (!count)
+		return;
+
+	total = count * unitsize;
+	memcpy(dst, sample, unitsize);
+	for (done = unitsize; done < total; done += len) {
+		len = MIN(done, total - done);
+		memcpy(dst + done, dst, len);
+	}
+}
+
+static void append_samples(struct sr_input *in, const uint8_t *sample,
+		uint64_t count)
+{
+	struct context *inc;
+	uint64_t len, per_buf;
+
+	inc = in->priv;
+	per_buf = inc->out_size / inc->unitsize;
+
+	while (count) {
+		len = MIN(count, (inc->out_size - inc->out_len) / inc->unitsize);
+		fill_samples(inc->out_buf + inc->out_len, sample, inc->unitsize, len);
+		inc->out_len += len * inc->unitsize;
+		count -= len;
+		if (inc->out_len < inc->out_size)
+			break;
+		flush_output_buffer(in);
+
+		/* Long gaps send a buffer full of this sample repeatedly. */
+		if (count >= per_buf) {
+			fill_samples(inc->out_buf, sample, inc->unitsize, per_buf);
+			inc->out_len = inc->out_size;
+			while (count >= per_buf) {
+				flush_output_buffer(in);
+				inc->out_len = inc->out_size;
+				count -= per_buf;
+			}
+			inc->out_len = 0;
+		}
+	}
+}
+
+/*
+ * Send a record's sample, repeated until the next record's timestamp
+ * (once only for the last record).
+ */
+static void append_record(struct sr_input *in, const char *record,
+		const uint8_t *payload)
 {
 	struct sr_datafeed_packet packet;
 	struct context *inc;
-	uint64_t timestamp, next_timestamp;
-	uint32_t pod_data;
-	char single_payload[12 * 3];
-	GString *buf;
-	int i, pod_count, clk_offset, packet_count, pod;
-	int payload_bit, payload_len, value;
+	uint64_t timestamp, next_timestamp, count;
+
+	inc = in->priv;
+	timestamp = RL64(record);
+
+	if (timestamp == inc->trigger_timestamp && !inc->trigger_sent) {
+		sr_dbg("Trigger @%lf s, record #%d.",
+			timestamp * TIMESTAMP_RESOLUTION, inc->cur_record);
+
+		/* Samples up to here go out before the trigger. */
+		flush_output_buffer(in);
+		packet.type = SR_DF_TRIGGER;
+		packet.payload = NULL;
+		sr_session_send(in->sdi, &packet);
+		inc->trigger_sent = TRUE;
+	}
+
+	/* Is this the last record in the file? */
+	if (inc->cur_record == inc->record_count - 1) {
+		/* It is, so send the last sample data only once. */
+		count = 1;
+	} else {
+		/* It's not, so fill the time gap by sending lots of data. */
+		next_timestamp = RL64(record + inc->record_size);
+
+		/*
+		 * A timestamp that doesn't increase would wrap around in the
+		 * subtraction. Send the data set once in that case.
+		 */
+		if (next_timestamp <= timestamp)
+			count = 1;
+		else
+			count = (uint64_t)((next_timestamp - timestamp) /
+				inc->timestamp_scale);
+
+		/* Make sure we send at least one data set. */
+		if (count == 0)
+			count = 1;
+	}
+
+	append_samples(in, payload, count);
+}
+
+static void process_record_pi(struct sr_input *in, const char *record)
+{
+	/* Offsets of the pods' data, in pod ID order. */
+	static const int pod_offsets[MAX_POD_COUNT] = {
+		8, 10, 12, 14, 16, 18, 24, 26, 28, 30, 32, 34,
+	};
+	struct context *inc;
+	uint32_t pod_data, clk_data, clk_data_jo;
+	uint64_t bits;
+	uint8_t single_payload[12 * 3];
+	int pod_count, clk_offset, pod;
+	unsigned int nbits, payload_len;
 
 	inc = in->priv;
-	buf = in->buf;
 
 	/*
 	 * 00-07 timestamp
@@ -381,8 +490,6 @@ static void process_record_pi(struct sr_input *in, gsize start)
 	 * 44/27    ??
 	 */
 
-	timestamp = RL64(buf->str + start);
-
 	if (inc->record_mode == AD_MODE_500MHZ) {
 		pod_count = 6;
 		clk_offset = 24;
@@ -390,129 +497,47 @@ static void process_record_pi(struct sr_input *in, gsize start)
 		pod_count = 12;
 		clk_offset = 40;
 	}
+	clk_data = RL16(record + clk_offset);
+	clk_data_jo = pod_count > 6 ? RL16(record + 41) : 0;
 
-	payload_bit = 0;
+	/* Pack each enabled pod's 16 data bits and clock, 17 bits per pod. */
+	bits = 0;
+	nbits = 0;
 	payload_len = 0;
-	single_payload[0] = 0;
-
 	for (pod = 0; pod < pod_count; pod++) {
 		if (!inc->pod_status[pod])
 			continue;
 
-		switch (pod) {
-		case 0: /* A */
-			pod_data = RL16(buf->str + start + 8);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 1) << 16;
-			break;
-		case 1: /* B */
-			pod_data = RL16(buf->str + start + 10);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 2) << 15;
-			break;
-		case 2: /* C */
-			pod_data = RL16(buf->str + start + 12);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 4) << 14;
-			break;
-		case 3: /* D */
-			pod_data = RL16(buf->str + start + 14);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 8) << 13;
-			break;
-		case 4: /* E */
-			pod_data = RL16(buf->str + start + 16);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 16) << 12;
-			break;
-		case 5: /* F */
-			pod_data = RL16(buf->str + start + 18);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 32) << 11;
-			break;
-		case 6: /* J */
-			pod_data = RL16(buf->str + start + 24);
-			pod_data |= (RL16(buf->str + start + 41) & 1) << 16;
-			break;
-		case 7: /* K */
-			pod_data = RL16(buf->str + start + 26);
-			pod_data |= (RL16(buf->str + start + 41) & 2) << 15;
-			break;
-		case 8: /* L */
-			pod_data = RL16(buf->str + start + 28);
-			pod_data |= (RL16(buf->str + start + 41) & 4) << 14;
-			break;
-		case 9: /* M */
-			pod_data = RL16(buf->str + start + 30);
-			pod_data |= (RL16(buf->str + start + 41) & 8) << 13;
-			break;
-		case 10: /* N */
-			pod_data = RL16(buf->str + start + 32);
-			pod_data |= (RL16(buf->str + start + 41) & 16) << 12;
-			break;
-		case 11: /* O */
-			pod_data = RL16(buf->str + start + 34);
-			pod_data |= (RL16(buf->str + start + 41) & 32) << 11;
-			break;
-		default:
-			sr_err("Don't know how to obtain data for pod %d.", pod);
-		}
-
-		for (i = 0; i < 17; i++) {
-			value = (pod_data >> i) & 1;
-			single_payload[payload_len] |= value << payload_bit;
+		pod_data = RL16(record + pod_offsets[pod]);
+		if (pod < 6)
+			pod_data |= ((clk_data >> pod) & 1) << 16;
+		else
+			pod_data |= ((clk_data_jo >> (pod - 6)) & 1) << 16;
 
-			payload_bit++;
-			if (payload_bit > 7) {
-				payload_bit = 0;
-				payload_len++;
-				single_payload[payload_len] = 0;
-			}
+		bits |= (uint64_t)pod_data << nbits;
+		for (nbits += 17; nbits >= 8; nbits -= 8) {
+			single_payload[payload_len++] = bits & 0xff;
+			bits >>= 8;
 		}
 	}
 
 	/* Make sure that payload_len accounts for any incomplete bytes used. */
-	if (payload_bit)
-		payload_len++;
+	if (nbits)
+		single_payload[payload_len++] = bits & 0xff;
 
-	i = (g_slist_length(in->sdi->channels) + 7) / 8;
-	if (payload_len != i) {
-		sr_err("Payload unit size is %d but should be %d!", payload_len, i);
+	if (payload_len != inc->unitsize) {
+		sr_err("Payload unit size is %d but should be %d!",
+			payload_len, inc->unitsize);
 		return;
 	}
 
-	if (timestamp == inc->trigger_timestamp && !inc->trigger_sent) {
-		sr_dbg("Trigger @%lf s, record #%d.",
-			timestamp * TIMESTAMP_RESOLUTION, inc->cur_record);
-
-		packet.type = SR_DF_TRIGGER;
-		packet.payload = NULL;
-		sr_session_send(in->sdi, &packet);
-		inc->trigger_sent = TRUE;
-	}
-
-	/* Is this the last record in the file? */
-	if (inc->cur_record == inc->record_count - 1) {
-		/* It is, so send the last sample data only once. */
-		g_string_append_len(inc->out_buf, single_payload, payload_len);
-	} else {
-		/* It's not, so fill the time gap by sending lots of data. */
-		next_timestamp = RL64(buf->str + start + inc->record_size);
-		packet_count = (int)(next_timestamp - timestamp) / inc->timestamp_scale;
-
-		/* Make sure we send at least one data set. */
-		if (packet_count == 0)
-			packet_count = 1;
-
-		for (i = 0; i < packet_count; i++)
-			g_string_append_len(inc->out_buf, single_payload, payload_len);
-	}
-
-	if (inc->out_buf->len >= OUTBUF_FLUSH_SIZE)
-		flush_output_buffer(in);
+	append_record(in, record, single_payload);
 }
 
-static void process_record_iprobe(struct sr_input *in, gsize start)
+static void process_record_iprobe(struct sr_input *in, const char *record)
 {
-	struct sr_datafeed_packet packet;
 	struct context *inc;
-	uint64_t timestamp, next_timestamp;
-	char single_payload[3];
-	int i, payload_len, packet_count;
+	uint8_t single_payload[3];
 
 	inc = in->priv;
 
@@ -522,41 +547,17 @@ static void process_record_iprobe(struct sr_input *in, gsize start)
 	 * 10    CLK
 	 */
 
-	timestamp = RL64(in->buf->str + start);
-	single_payload[0] = R8(in->buf->str + start + 8);
-	single_payload[1] = R8(in->buf->str + start + 9);
-	single_payload[2] = R8(in->buf->str + start + 10) & 1;
-	payload_len = 3;
-
-	if (timestamp == inc->trigger_timestamp && !inc->trigger_sent) {
-		sr_dbg("Trigger @%lf s, record #%d.",
-			timestamp * TIMESTAMP_RESOLUTION, inc->cur_record);
+	single_payload[0] = R8(record + 8);
+	single_payload[1] = R8(record + 9);
+	single_payload[2] = R8(record + 10) & 1;
 
-		packet.type = SR_DF_TRIGGER;
-		packet.payload = NULL;
-		sr_session_send(in->sdi, &packet);
-		inc->trigger_sent = TRUE;
-	}
-
-	/* Is this the last record in the file? */
-	if (inc->cur_record == inc->record_count - 1) {
-		/* It is, so send the last sample data only once. */
-		g_string_append_len(inc->out_buf, single_payload, payload_len);
-	} else {
-		/* It's not, so fill the time gap by sending lots of data. */
-		next_timestamp = RL64(in->buf->str + start + inc->record_size);
-		packet_count = (int)(next_timestamp - timestamp) / inc->timestamp_scale;
-
-		/* Make sure we send at least one data set. */
-		if (packet_count == 0)
-			packet_count = 1;
-
-		for (i = 0; i < packet_count; i++)
-			g_string_append_len(inc->out_buf, single_payload, payload_len);
+	if (inc->unitsize != sizeof(single_payload)) {
+		sr_err("Payload unit size is %d but should be %d!",
+			(int)sizeof(single_payload), inc->unitsize);
+		return;
 	}
 
-	if (inc->out_buf->len >= OUTBUF_FLUSH_SIZE)
-		flush_output_buffer(in);
+	append_record(in, record, single_payload);
 }
 
 static void process_practice_token(struct sr_input *in, char *cmd_token)
@@ -640,18 +641,20 @@ static void process_practice_token(struct sr_input *in, char *cmd_token)
 static void process_practice(struct sr_input *in)
 {
 	char delimiter[3];
-	char **tokens, *token;
+	char **tokens, *token, *data;
+	size_t len;
 	int i;
 
 	/* Gather all input data until we see the end marker. */
-	if (in->buf->str[in->buf->len - 1] != 0x29)
+	data = sr_input_buf_data(in, &len);
+	if (!len || data[len - 1] != 0x29)
 		return;
 
 	delimiter[0] = 0x0A;
 	delimiter[1] = ' ';
 	delimiter[2] = 0;
 
-	tokens = g_strsplit(in->buf->str, delimiter, 0);
+	tokens = g_strsplit(data, delimiter, 0);
 
 	/* Special case: first token contains the start marker, too. Skip it. */
 	token = tokens[0];
@@ -665,21 +668,27 @@ static void process_practice(struct sr_input *in)
 
 	g_strfreev(tokens);
 
-	g_string_erase(in->buf, 0, in->buf->len);
+	sr_input_buf_clear(in);
 }
 
-static int process_buffer(struct sr_input *in)
+static int process_buffer(struct sr_input *in, GString *buf)
 {
 	struct context *inc;
 	int i, chunk_size, res;
+	size_t len, used;
+	char *data;
 
 	inc = in->priv;
+	data = sr_input_buf_begin(in, buf, &len);
+	used = 0;
 
 	if (!inc->header_read) {
-		res = process_header(in->buf, inc);
-		g_string_erase(in->buf, 0, HEADER_SIZE);
-		if (res != SR_OK)
+		res = process_header(data, inc);
+		used = HEADER_SIZE;
+		if (res != SR_OK) {
+			sr_input_buf_end(in, buf, used);
 			return res;
+		}
 	}
 
 	if (!inc->meta_sent) {
@@ -689,7 +698,7 @@ static int process_buffer(struct sr_input *in)
 
 	if (!inc->records_read) {
 		/* Cut off at a multiple of the record size. */
-		chunk_size = ((in->buf->len) / inc->record_size) * inc->record_size;
+		chunk_size = ((len - used) / inc->record_size) * inc->record_size;
 
 		/* There needs to be at least one more record process_record() can peek into. */
 		chunk_size -= inc->record_size;
@@ -697,13 +706,14 @@ static int process_buffer(struct sr_input *in)
 		for (i = 0; (i < chunk_size) && (!inc->records_read); i += inc->record_size) {
 			switch (inc->device) {
 			case AD_DEVICE_PI:
-				process_record_pi(in, i);
+				process_record_pi(in, data + used + i);
 				break;
 			case AD_DEVICE_IPROBE:
-				process_record_iprobe(in, i);
+				process_record_iprobe(in, data + used + i);
 				break;
 			default:
 				sr_err("Trying to process records for unknown device!");
+				sr_input_buf_end(in, buf, used);
 				return SR_ERR;
 			}
 
@@ -712,9 +722,12 @@ static int process_buffer(struct sr_input *in)
 				inc->records_read = TRUE;
 		}
 
-		g_string_erase(in->buf, 0, i);
+		used += i;
 	}
 
+	/* Whatever is left over is kept until there's more. */
+	sr_input_buf_end(in, buf, used);
+
 	if (inc->records_read) {
 		/* Read practice commands that configure the setup. */
 		process_practice(in);
@@ -725,15 +738,14 @@ static int process_buffer(struct sr_input *in)
 
 static int receive(struct sr_input *in, GString *buf)
 {
-	g_string_append_len(in->buf, buf->str, buf->len);
-
 	if (!in->sdi_ready) {
+		sr_input_buf_append(in, buf->str, buf->len);
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
 		return SR_OK;
 	}
 
-	return process_buffer(in);
+	return process_buffer(in, buf);
 }
 
 static int end(struct sr_input *in)
@@ -744,7 +756,7 @@ static int end(struct sr_input *in)
 	inc = in->priv;
 
 	if (in->sdi_ready)
-		ret = process_buffer(in);
+		ret = process_buffer(in, NULL);
 	else
 		ret = SR_OK;
 
@@ -765,12 +777,20 @@ static int reset(struct sr_input *in)
 	inc->records_read = FALSE;
 	inc->trigger_sent = FALSE;
 	inc->cur_record = 0;
+	inc->out_len = 0;
 
-	g_string_truncate(in->buf, 0);
+	sr_input_buf_clear(in);
 
 	return SR_OK;
 }
 
+static void cleanup(struct sr_input *in)
+{
+	struct context *inc = in->priv;
+
+	g_free(inc->out_buf);
+}
+
 static struct sr_option options[] = {
 	{ "podA", "Import pod A / iprobe",
 		"Create channels and data for pod A / iprobe", NULL, NULL },
@@ -825,4 +845,5 @@ SR_PRIV struct sr_input_module input_trace32_ad = {
 	.receive = receive,
 	.end = end,
 	.reset = reset,
+	.cleanup = cleanup,
 };
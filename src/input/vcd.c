@@ -94,8 +94,11 @@ struct vcd_channel {
 /*
  * Reads a single VCD section from input file and parses it to name/contents.
  * e.g. $timescale 1ps $end => "timescale" "1ps"
+ * Returns the number of bytes the section took up, or 0 if there wasn't a
+ * complete section at the start of buf.
  */
-static gboolean parse_section(GString *buf, gchar **name, gchar **contents)
+static size_t parse_section(const char *buf, size_t len,
+		gchar **name, gchar **contents)
 {
 	GString *sname, *scontent;
 	gboolean status;
@@ -106,38 +109,37 @@ static gboolean parse_section(GString *buf, gchar **name, gchar **contents)
 	pos = 0;
 
 	/* Skip UTF8 BOM */
-	if (buf->len >= 3 && !strncmp(buf->str, "\xef\xbb\xbf", 3))
+	if (len >= 3 && !strncmp(buf, "\xef\xbb\xbf", 3))
 		pos = 3;
 
 	/* Skip any initial white-space. */
-	while (pos < buf->len && g_ascii_isspace(buf->str[pos]))
+	while (pos < len && g_ascii_isspace(buf[pos]))
 		pos++;
 
 	/* Section tag should start with $. */
-	if (buf->str[pos++] != '$')
+	if (buf[pos++] != '$')
 		return FALSE;
 
 	sname = g_string_sized_new(32);
 	scontent = g_string_sized_new(128);
 
 	/* Read the section tag. */
-	while (pos < buf->len && !g_ascii_isspace(buf->str[pos]))
-		g_string_append_c(sname, buf->str[pos++]);
+	while (pos < len && !g_ascii_isspace(buf[pos]))
+		g_string_append_c(sname, buf[pos++]);
 
 	/* Skip whitespace before content. */
-	while (pos < buf->len && g_ascii_isspace(buf->str[pos]))
+	while (pos < len && g_ascii_isspace(buf[pos]))
 		pos++;
 
 	/* Read the content. */
-	while (pos < buf->len - 4 && strncmp(buf->str + pos, "$end", 4))
-		g_string_append_c(scontent, buf->str[pos++]);
+	while (pos < len - 4 && strncmp(buf + pos, "$end", 4))
+		g_string_append_c(scontent, buf[pos++]);
 
-	if (sname->len && pos < buf->len - 4 && !strncmp(buf->str + pos, "$end", 4)) {
+	if (sname->len && pos < len - 4 && !strncmp(buf + pos, "$end", 4)) {
 		status = TRUE;
 		pos += 4;
-		while (pos < buf->len && g_ascii_isspace(buf->str[pos]))
+		while (pos < len && g_ascii_isspace(buf[pos]))
 			pos++;
-		g_string_erase(buf, 0, pos);
 	}
 
 	*name = g_string_free(sname, !status);
@@ -145,7 +147,22 @@ static gboolean parse_section(GString *buf, gchar **name, gchar **contents)
 	if (*contents)
 		g_strchomp(*contents);
 
-	return status;
+	return status ? pos : 0;
+}
+
+/* Parse the next section from the input buffer, consuming it. */
+static gboolean next_section(struct sr_input *in,
+		gchar **name, gchar **contents)
+{
+	size_t len, used;
+	char *buf;
+
+	buf = sr_input_buf_data(in, &len);
+	if (!(used = parse_section(buf, len, name, contents)))
+		return FALSE;
+	sr_input_buf_skip(in, used);
+
+	return TRUE;
 }
 
 static void free_channel(void *data)
@@ -174,7 +191,7 @@ static void remove_empty_parts(gchar **parts)
  * Parse VCD header to get values for context structure.
  * The context structure should be zeroed before calling this.
  */
-static gboolean parse_header(const struct sr_input *in, GString *buf)
+static gboolean parse_header(struct sr_input *in)
 {
 	struct vcd_channel *vcd_ch;
 	uint64_t p, q;
@@ -185,7 +202,7 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 	inc = in->priv;
 	name = contents = NULL;
 	status = FALSE;
-	while (parse_section(buf, &name, &contents)) {
+	while (next_section(in, &name, &contents)) {
 		sr_dbg("Section '%s', contents '%s'.", name, contents);
 
 		if (g_strcmp0(name, "enddefinitions") == 0) {
@@ -266,19 +283,17 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 
 static int format_match(GHashTable *metadata)
 {
-	GString *buf, *tmpbuf;
+	GString *buf;
 	gboolean status;
 	gchar *name, *contents;
 
 	buf = g_hash_table_lookup(metadata, GINT_TO_POINTER(SR_INPUT_META_HEADER));
-	tmpbuf = g_string_new_len(buf->str, buf->len);
 
 	/*
 	 * If we can parse the first section correctly,
 	 * then it is assumed to be a VCD file.
 	 */
-	status = parse_section(tmpbuf, &name, &contents);
-	g_string_free(tmpbuf, TRUE);
+	status = parse_section(buf->str, buf->len, &name, &contents) > 0;
 	g_free(name);
 	g_free(contents);
 
@@ -503,17 +518,17 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static gboolean have_header(GString *buf)
+static gboolean have_header(const char *buf, size_t len)
 {
 	unsigned int pos;
 	char *p;
 
-	if (!(p = g_strstr_len(buf->str, buf->len, "$enddefinitions")))
+	if (!(p = g_strstr_len(buf, len, "$enddefinitions")))
 		return FALSE;
-	pos = p - buf->str + 15;
-	while (pos < buf->len - 4 && g_ascii_isspace(buf->str[pos]))
+	pos = p - buf + 15;
+	while (pos < len - 4 && g_ascii_isspace(buf[pos]))
 		pos++;
-	if (!strncmp(buf->str + pos, "$end", 4))
+	if (!strncmp(buf + pos, "$end", 4))
 		return TRUE;
 
 	return FALSE;
@@ -526,7 +541,8 @@ static int process_buffer(struct sr_input *in)
 	struct sr_config *src;
 	struct context *inc;
 	uint64_t samplerate;
-	char *p;
+	size_t len;
+	char *data, *p;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -544,12 +560,14 @@ static int process_buffer(struct sr_input *in)
 		inc->started = TRUE;
 	}
 
-	while ((p = g_strrstr_len(in->buf->str, in->buf->len, "\n"))) {
+	/* Parse all complete lines, in place. */
+	data = sr_input_buf_data(in, &len);
+	if ((p = g_strrstr_len(data, len, "\n"))) {
 		*p = '\0';
-		g_strstrip(in->buf->str);
-		if (in->buf->str[0] != '\0')
-			parse_contents(in, in->buf->str);
-		g_string_erase(in->buf, 0, p - in->buf->str + 1);
+		g_strstrip(data);
+		if (data[0] != '\0')
+			parse_contents(in, data);
+		sr_input_buf_skip(in, p - data + 1);
 	}
 
 	return SR_OK;
@@ -558,15 +576,17 @@ static int process_buffer(struct sr_input *in)
 static int receive(struct sr_input *in, GString *buf)
 {
 	struct context *inc;
-	int ret;
+	char *data;
+	size_t len;
 
-	g_string_append_len(in->buf, buf->str, buf->len);
+	sr_input_buf_append(in, buf->str, buf->len);
 
 	inc = in->priv;
 	if (!inc->got_header) {
-		if (!have_header(in->buf))
+		data = sr_input_buf_data(in, &len);
+		if (!have_header(data, len))
 			return SR_OK;
-		if (!parse_header(in, in->buf))
+		if (!parse_header(in))
 			/* There was a header in there, but it was malformed. */
 			return SR_ERR;
 
@@ -575,9 +595,7 @@ static int receive(struct sr_input *in, GString *buf)
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
-
-	return ret;
+	return process_buffer(in);
 }
 
 static int end(struct sr_input *in)
@@ -619,7 +637,7 @@ static int reset(struct sr_input *in)
 
 	cleanup(in);
 	inc->started = FALSE;
-	g_string_truncate(in->buf, 0);
+	sr_input_buf_clear(in);
 
 	return SR_OK;
 }
@@ -156,23 +156,22 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int find_data_chunk(GString *buf, int initial_offset)
+static int find_data_chunk(const char *buf, size_t len, int initial_offset)
 {
 	unsigned int offset, i;
 
 	offset = initial_offset;
-	while (offset < MIN(MAX_DATA_CHUNK_OFFSET, buf->len)) {
-		if (!memcmp(buf->str + offset, "data", 4))
+	while (offset < MIN(MAX_DATA_CHUNK_OFFSET, len)) {
+		if (!memcmp(buf + offset, "data", 4))
 			/* Skip into the samples. */
 			return offset + 8;
 		for (i = 0; i < 4; i++) {
-			if (!isalnum(buf->str[offset + i])
-					&& !isblank(buf->str[offset + i]))
+			if (!isalnum(buf[offset + i]) && !isblank(buf[offset + i]))
 				/* Doesn't look like a chunk ID. */
 				return -1;
 		}
 		/* Skip past this chunk. */
-		offset += 8 + RL32(buf->str + offset + 4);
+		offset += 8 + RL32(buf + offset + 4);
 	}
 
 	if (offset > MAX_DATA_CHUNK_OFFSET)
@@ -181,7 +180,7 @@ static int find_data_chunk(GString *buf, int initial_offset)
 	return offset;
 }
 
-static void send_chunk(const struct sr_input *in, int offset, int num_samples)
+static void send_chunk(const struct sr_input *in, const char *s, int num_samples)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
@@ -191,11 +190,10 @@ static void send_chunk(const struct sr_input *in, int offset, int num_samples)
 	struct context *inc;
 	float fdata[CHUNK_SIZE];
 	int total_samples, samplenum;
-	char *s, *d;
+	char *d;
 
 	inc = in->priv;
 
-	s = in->buf->str + offset;
 	d = (char *)fdata;
 	memset(fdata, 0, CHUNK_SIZE * sizeof(float));
 	total_samples = num_samples * inc->num_channels;
@@ -240,7 +238,7 @@ static void send_chunk(const struct sr_input *in, int offset, int num_samples)
 	sr_session_send(in->sdi, &packet);
 }
 
-static int process_buffer(struct sr_input *in)
+static int process_buffer(struct sr_input *in, GString *buf)
 {
 	struct context *inc;
 	struct sr_datafeed_packet packet;
@@ -248,6 +246,8 @@ static int process_buffer(struct sr_input *in)
 	struct sr_config *src;
 	int offset, chunk_samples, total_samples, processed, max_chunk_samples;
 	int num_samples, i;
+	size_t len;
+	char *data;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -264,12 +264,15 @@ static int process_buffer(struct sr_input *in)
 		inc->started = TRUE;
 	}
 
+	data = sr_input_buf_begin(in, buf, &len);
+
 	if (!inc->found_data) {
 		/* Skip past size of 'fmt ' chunk. */
-		i = 20 + RL32(in->buf->str + 16);
-		offset = find_data_chunk(in->buf, i);
+		i = 20 + RL32(data + 16);
+		offset = find_data_chunk(data, len, i);
 		if (offset < 0) {
-			if (in->buf->len > MAX_DATA_CHUNK_OFFSET) {
+			if (len > MAX_DATA_CHUNK_OFFSET) {
+				sr_input_buf_end(in, buf, 0);
 				sr_err("Couldn't find data chunk.");
 				return SR_ERR;
 			}
@@ -279,7 +282,7 @@ static int process_buffer(struct sr_input *in)
 		offset = 0;
 
 	/* Round off up to the last channels * unitsize boundary. */
-	chunk_samples = (in->buf->len - offset) / inc->samplesize;
+	chunk_samples = (len - offset) / inc->samplesize;
 	max_chunk_samples = CHUNK_SIZE / inc->samplesize;
 	processed = 0;
 	total_samples = chunk_samples;
@@ -288,20 +291,14 @@ static int process_buffer(struct sr_input *in)
 			num_samples = max_chunk_samples;
 		else
 			num_samples = chunk_samples;
-		send_chunk(in, offset, num_samples);
+		send_chunk(in, data + offset, num_samples);
 		offset += num_samples * inc->samplesize;
 		chunk_samples -= num_samples;
 		processed += num_samples;
 	}
 
-	if ((unsigned int)offset < in->buf->len) {
-		/*
-		 * The incoming buffer wasn't processed completely. Stash
-		 * the leftover data for next time.
-		 */
-		g_string_erase(in->buf, 0, offset);
-	} else
-		g_string_truncate(in->buf, 0);
+	/* Stash any leftover data for next time. */
+	sr_input_buf_end(in, buf, offset);
 
 	return SR_OK;
 }
@@ -312,18 +309,17 @@ static int receive(struct sr_input *in, GString *buf)
 	int ret;
 	char channelname[8];
 
-	g_string_append_len(in->buf, buf->str, buf->len);
-
-	if (in->buf->len < MIN_DATA_CHUNK_OFFSET) {
-		/*
-		 * Don't even try until there's enough room
-		 * for the data segment to start.
-		 */
-		return SR_OK;
-	}
-
 	inc = in->priv;
 	if (!in->sdi_ready) {
+		sr_input_buf_append(in, buf->str, buf->len);
+		if (in->buf->len < MIN_DATA_CHUNK_OFFSET) {
+			/*
+			 * Don't even try until there's enough room
+			 * for the data segment to start.
+			 */
+			return SR_OK;
+		}
+
 		if ((ret = parse_wav_header(in->buf, inc)) == SR_ERR_NA)
 			/* Not enough data yet. */
 			return SR_OK;
@@ -340,9 +336,7 @@ static int receive(struct sr_input *in, GString *buf)
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
-
-	return ret;
+	return process_buffer(in, buf);
 }
 
 static int end(struct sr_input *in)
@@ -351,7 +345,7 @@ static int end(struct sr_input *in)
 	int ret;
 
 	if (in->sdi_ready)
-		ret = process_buffer(in);
+		ret = process_buffer(in, NULL);
 	else
 		ret = SR_OK;
 
@@ -367,7 +361,7 @@ static int reset(struct sr_input *in)
 	struct context *inc = in->priv;
 
 	inc->started = FALSE;
-	g_string_truncate(in->buf, 0);
+	sr_input_buf_clear(in);
 
 	return SR_OK;
 }
@@ -238,6 +238,14 @@ struct zip_stat;
                          ((uint8_t*)(p))[2] = (uint8_t)((x)>>16); \
                          ((uint8_t*)(p))[3] = (uint8_t)((x)>>24); } while (0)
 
+/**
+ * Write a 64 bits unsigned integer to memory stored as little endian.
+ * @param p a pointer to the output memory
+ * @param x the input unsigned integer
+ */
+#define WL64(p, x)  do { WL32(p, (uint64_t)(x));                   \
+                         WL32((uint8_t*)(p) + 4, (uint64_t)(x) >> 32); } while (0)
+
 /**
  * Write a 32 bits float to memory stored as big endian.
  * @param p a pointer to the output memory
@@ -339,7 +347,10 @@ SR_API void sr_drivers_init(struct sr_context *context);
 struct sr_context {
 	struct sr_dev_driver **driver_list;
 #ifdef HAVE_LIBUSB_1_0
+	/* Initialized on first use, see sr_usb_context(). */
 	libusb_context *libusb_ctx;
+	/* Running libusb event threads, see usb_handle_events(). */
+	int usb_event_threads;
 #endif
 	sr_resource_open_callback resource_open_cb;
 	sr_resource_close_callback resource_close_cb;
@@ -366,7 +377,10 @@ struct sr_input {
 	 * A pointer to this input module's 'struct sr_input_module'.
 	 */
 	const struct sr_input_module *module;
+	/** Data received but not processed yet, see sr_input_buf_append(). */
 	GString *buf;
+	/** Read cursor into buf: the bytes before it were processed. */
+	size_t buf_pos;
 	struct sr_dev_inst *sdi;
 	gboolean sdi_ready;
 	void *priv;
@@ -798,6 +812,12 @@ struct sr_dev_inst {
 	GSList *channels;
 	/** List of sr_channel_group structs */
 	GSList *channel_groups;
+	/** Incremented whenever channels are added, enabled or disabled. */
+	int channels_version;
+	/** Arrays derived from the channels, see sr_dev_inst_channel_cache_get(). */
+	struct sr_dev_channel_cache *channel_cache;
+	/** Bit lock for replacing channel_cache. */
+	gint channel_cache_lock;
 	/** Device instance connection data (used?) */
 	void *conn;
 	/** Device instance private data (used?) */
@@ -806,8 +826,40 @@ struct sr_dev_inst {
 	struct sr_session *session;
 };
 
+/**
+ * A snapshot of a device instance's channels, as arrays. A new one is
+ * built on demand when the channel list or the channels' enabled state
+ * changed. Each snapshot is reference counted and never modified.
+ */
+struct sr_dev_channel_cache {
+	gint refcount;
+	/** The sr_dev_inst::channels_version this was built for. */
+	int version;
+	/** All channels, in list order. */
+	struct sr_channel **all;
+	unsigned int num_all;
+	/** The enabled channels, in list order. */
+	struct sr_channel **enabled;
+	unsigned int num_enabled;
+	/** The enabled logic channels, and their indices. */
+	struct sr_channel **logic;
+	int *logic_index;
+	unsigned int num_logic;
+	/** The enabled analog channels. */
+	struct sr_channel **analog;
+	unsigned int num_analog;
+	/** Bit n (LSB first) is set when logic channel index n is enabled. */
+	uint8_t *logic_mask;
+	/** Size of logic_mask in bytes: enough for the highest logic index. */
+	unsigned int logic_mask_size;
+};
+
 /* Generic device instances */
 SR_PRIV void sr_dev_inst_free(struct sr_dev_inst *sdi);
+SR_PRIV void sr_dev_inst_channels_changed(struct sr_dev_inst *sdi);
+SR_PRIV struct sr_dev_channel_cache *sr_dev_inst_channel_cache_get(
+		const struct sr_dev_inst *sdi);
+SR_PRIV void sr_dev_channel_cache_unref(struct sr_dev_channel_cache *cache);
 
 #ifdef HAVE_LIBUSB_1_0
 /* USB-specific instances */
@@ -867,6 +919,31 @@ struct sr_session {
 	unsigned int stop_check_id;
 	/** Whether the session has been started. */
 	gboolean running;
+	/** Whether datafeed callbacks accept SR_DF_ANALOG_PLANAR packets. */
+	gboolean analog_planar;
+
+	/** Mutex protecting the memory budget fields. */
+	GMutex mem_mutex;
+	/** Memory budget in bytes, 0 for no limit. */
+	uint64_t mem_budget;
+	/** Bytes accounted against the memory budget. */
+	uint64_t mem_used;
+	/** Directory for buffers exceeding the budget, or NULL. */
+	char *mem_spill_dir;
+	/** Buffers allocated by sr_session_malloc(), by address. */
+	GHashTable *mem_buffers;
+
+	/** Whether to service libusb events on a thread of their own. */
+	gboolean usb_thread_enabled;
+	/** SCHED_FIFO priority of the libusb event thread, 0 for none. */
+	int usb_thread_priority;
+	/** CPU to pin the libusb event thread to, or -1. */
+	int usb_thread_cpu;
+	/** The running libusb event thread, or NULL. */
+	struct usb_event_thread *usb_thread;
+
+	/** Flight recorder, or NULL if disabled. */
+	struct session_recorder *recorder;
 };
 
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
@@ -895,12 +972,21 @@ SR_PRIV int sr_session_source_remove_channel(struct sr_session *session,
 
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+SR_PRIV void *sr_session_malloc(struct sr_session *session, size_t size);
+SR_PRIV void sr_session_free(struct sr_session *session, void *ptr);
+SR_PRIV void sr_session_memory_account(struct sr_session *session,
+		int64_t delta);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename,
 		struct sr_session **session);
-SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
-		struct sr_datafeed_packet **copy);
-SR_PRIV void sr_packet_free(struct sr_datafeed_packet *packet);
+
+/*--- session_recorder.c ----------------------------------------------------*/
+
+SR_PRIV void sr_session_recorder_add(struct session_recorder *rec,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet);
+SR_PRIV void sr_session_recorder_reset(struct session_recorder *rec);
+SR_PRIV void sr_session_recorder_free(struct session_recorder *rec);
 
 /*--- session_file.c --------------------------------------------------------*/
 
@@ -913,6 +999,64 @@ SR_PRIV void sr_zip_discard(struct zip *archive);
 SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 			const struct zip_stat *entry);
 
+/*
+ * Optional "index" member of a session archive, written by the srzip
+ * output module when the acquisition ends. It lets sr_session_file_info()
+ * summarize a file without parsing the metadata or listing the chunks.
+ *
+ * All fields are little endian. The SR_SESSIONFILE_INDEX_HDR_SIZE bytes
+ * header holds SR_SESSIONFILE_INDEX_MAGIC, samplerate (uint64), total
+ * samples (uint64), trigger position (uint64, all ones if none), unitsize
+ * (uint32), number of channels (uint32) and number of chunks (uint32).
+ * Each channel follows as index (uint32), type (uint32), name length
+ * (uint32) and name, then each chunk as number of samples (uint64), name
+ * length (uint32) and archive member name. Names aren't NUL terminated.
+ */
+#define SR_SESSIONFILE_INDEX_MAGIC	"SRINDEX\x01"
+#define SR_SESSIONFILE_INDEX_MAGIC_SIZE	8
+#define SR_SESSIONFILE_INDEX_HDR_SIZE	44
+
+/*--- input/stream.c, output/stream.c ---------------------------------------*/
+
+/*
+ * Binary datafeed stream format, as written by the "stream" output module
+ * and read back by the "stream" input module.
+ *
+ * The stream starts with SR_STREAM_MAGIC, followed by a sequence of
+ * frames. Every frame starts with a header of SR_STREAM_FRAME_HDR_SIZE
+ * bytes: payload length (uint32), frame type (uint16) and flags (uint16),
+ * all little endian. Frame types are either one of the SR_DF_* packet
+ * types, or one of the stream-specific types below.
+ */
+#define SR_STREAM_MAGIC			"SRSTREAM\x01\x00\x00\x00"
+#define SR_STREAM_MAGIC_SIZE		12
+#define SR_STREAM_FRAME_HDR_SIZE	8
+/* Upper bound for a single frame's payload, as a sanity check. */
+#define SR_STREAM_MAX_FRAME_SIZE	(256 * 1024 * 1024)
+
+enum sr_stream_frame_type {
+	/* Channel table of the sending device. Precedes all SR_DF_* frames. */
+	SR_STREAM_FRAME_DEVICE = 1,
+};
+
+/*--- input/input.c ---------------------------------------------------------*/
+
+SR_PRIV void sr_input_buf_append(struct sr_input *in,
+		const char *data, size_t len);
+SR_PRIV char *sr_input_buf_data(const struct sr_input *in, size_t *len);
+SR_PRIV void sr_input_buf_skip(struct sr_input *in, size_t len);
+SR_PRIV void sr_input_buf_clear(struct sr_input *in);
+SR_PRIV char *sr_input_buf_begin(struct sr_input *in, GString *buf,
+		size_t *len);
+SR_PRIV void sr_input_buf_end(struct sr_input *in, GString *buf, size_t used);
+
+/*--- output/output.c -------------------------------------------------------*/
+
+SR_PRIV void sr_output_logic_to_planes(const uint8_t *data,
+		unsigned int unitsize, uint64_t num_samples,
+		const int *channel_index, unsigned int num_channels,
+		uint8_t *planes, size_t stride);
+
 /*--- analog.c --------------------------------------------------------------*/
 
 SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
@@ -964,6 +1108,40 @@ SR_PRIV int sr_atod(const char *str, double *ret);
 SR_PRIV int sr_atof(const char *str, float *ret);
 SR_PRIV int sr_atof_ascii(const char *str, float *ret);
 
+/*--- simd/simd.c, simd/kernels.c ------------------------------------------*/
+
+/*
+ * Hot-path kernels, built once per supported vector ISA. All variants
+ * produce identical results, see sr_simd_get().
+ */
+struct sr_simd_kernels {
+	const char *name;
+	/* Native endian integers of 1, 2 or 4 bytes to scale * v + offset. */
+	int (*int_to_float)(const void *src, unsigned int unitsize,
+			gboolean is_signed, float *dst, size_t count,
+			float scale, float offset);
+	/* See sr_output_logic_to_planes(). */
+	void (*logic_to_planes)(const uint8_t *data, unsigned int unitsize,
+			uint64_t num_samples, const int *channel_index,
+			unsigned int num_channels, uint8_t *planes, size_t stride);
+	/* Index of the first sample with (sample & mask) == value, or count. */
+	size_t (*logic_find)(const uint8_t *data, unsigned int unitsize,
+			size_t count, uint64_t mask, uint64_t value);
+};
+
+SR_PRIV extern const struct sr_simd_kernels sr_simd_kernels_baseline;
+#ifdef HAVE_SIMD_SSE42
+SR_PRIV extern const struct sr_simd_kernels sr_simd_kernels_sse42;
+#endif
+#ifdef HAVE_SIMD_AVX2
+SR_PRIV extern const struct sr_simd_kernels sr_simd_kernels_avx2;
+#endif
+#ifdef HAVE_SIMD_NEON
+SR_PRIV extern const struct sr_simd_kernels sr_simd_kernels_neon;
+#endif
+
+SR_PRIV const struct sr_simd_kernels *sr_simd_get(void);
+
 /*--- soft-trigger.c --------------------------------------------------------*/
 
 struct soft_trigger_logic {
@@ -975,6 +1153,8 @@ struct soft_trigger_logic {
 	uint8_t *prev_sample;
 	uint8_t *pre_trigger_buffer;
 	uint8_t *pre_trigger_head;
+	/* The session pre_trigger_buffer was allocated for. */
+	struct sr_session *session;
 	int pre_trigger_size;
 	int pre_trigger_fill;
 };
@@ -983,6 +1163,7 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples);
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *st);
+SR_PRIV void soft_trigger_logic_reset(struct soft_trigger_logic *st);
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *st, uint8_t *buf,
 		int len, int *pre_trigger_samples);
 
@@ -1043,12 +1224,18 @@ SR_PRIV int ezusb_upload_firmware(struct sr_context *ctx, libusb_device *dev,
 /*--- hardware/usb.c --------------------------------------------------------*/
 
 #ifdef HAVE_LIBUSB_1_0
+SR_PRIV libusb_context *sr_usb_context(struct sr_context *ctx);
 SR_PRIV GSList *sr_usb_find(libusb_context *usb_ctx, const char *conn);
 SR_PRIV int sr_usb_open(libusb_context *usb_ctx, struct sr_usb_dev_inst *usb);
 SR_PRIV void sr_usb_close(struct sr_usb_dev_inst *usb);
 SR_PRIV int usb_source_add(struct sr_session *session, struct sr_context *ctx,
 		int timeout, sr_receive_data_callback cb, void *cb_data);
 SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx);
+SR_PRIV int usb_handle_events(struct sr_context *ctx, struct timeval *tv,
+		int *completed);
+SR_PRIV gboolean usb_event_thread_defer(struct sr_session *session,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet);
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len);
 SR_PRIV gboolean usb_match_manuf_prod(libusb_device *dev,
 		const char *manufacturer, const char *product);
@@ -1061,6 +1248,8 @@ struct sr_modbus_dev_inst {
 	const char *name;
 	const char *prefix;
 	int priv_size;
+	/* Requests that may be sent before reading replies, 0 means 1. */
+	int max_pending;
 	GSList *(*scan)(int modbusaddr);
 	int (*dev_inst_new)(void *priv, const char *resource,
 		char **params, const char *serialcomm, int modbusaddr);
@@ -1072,12 +1261,24 @@ struct sr_modbus_dev_inst {
 	int (*read_begin)(void *priv, uint8_t *function_code);
 	int (*read_data)(void *priv, uint8_t *buf, int maxlen);
 	int (*read_end)(void *priv);
+	/* Forget requests still awaiting a reply, optional. */
+	int (*flush)(void *priv);
 	int (*close)(void *priv);
 	void (*free)(void *priv);
 	unsigned int read_timeout_ms;
 	void *priv;
 };
 
+/** A block of holding registers to read with sr_modbus_read_register_map(). */
+struct sr_modbus_register_map {
+	/** Modbus address of the first register. */
+	int address;
+	/** Number of registers, at most 125. */
+	int nb_registers;
+	/** Buffer to store the registers values. */
+	uint16_t *registers;
+};
+
 SR_PRIV GSList *sr_modbus_scan(struct drv_context *drvc, GSList *options,
 		struct sr_dev_inst *(*probe_device)(struct sr_modbus_dev_inst *modbus));
 SR_PRIV struct sr_modbus_dev_inst *modbus_dev_inst_new(const char *resource,
@@ -1100,6 +1301,9 @@ SR_PRIV int sr_modbus_read_coils(struct sr_modbus_dev_inst *modbus,
 SR_PRIV int sr_modbus_read_holding_registers(struct sr_modbus_dev_inst *modbus,
                                              int address, int nb_registers,
                                              uint16_t *registers);
+SR_PRIV int sr_modbus_read_register_map(struct sr_modbus_dev_inst *modbus,
+                                        struct sr_modbus_register_map *map,
+                                        int nb_entries, int max_gap);
 SR_PRIV int sr_modbus_write_coil(struct sr_modbus_dev_inst *modbus,
                                  int address, int value);
 SR_PRIV int sr_modbus_write_multiple_registers(struct sr_modbus_dev_inst*modbus,
@@ -1108,6 +1312,28 @@ SR_PRIV int sr_modbus_write_multiple_registers(struct sr_modbus_dev_inst*modbus,
 SR_PRIV int sr_modbus_close(struct sr_modbus_dev_inst *modbus);
 SR_PRIV void sr_modbus_free(struct sr_modbus_dev_inst *modbus);
 
+/*--- hardware/dmm/batch.c --------------------------------------------------*/
+
+/** What a reading decoded by sr_dmm_parse_batch() measures. */
+struct sr_dmm_reading {
+	/** The measured quantity, 0 if the packet held no reading. */
+	enum sr_mq mq;
+	enum sr_unit unit;
+	enum sr_mqflag mqflags;
+	int8_t digits;
+	int8_t spec_digits;
+};
+
+typedef int (*sr_dmm_parse_func)(const uint8_t *buf, float *floatval,
+		struct sr_datafeed_analog *analog, void *info);
+typedef void (*sr_dmm_details_func)(struct sr_datafeed_analog *analog,
+		void *info);
+
+SR_PRIV unsigned int sr_dmm_parse_batch(const uint8_t *buf, int packet_size,
+		unsigned int count, sr_dmm_parse_func parse,
+		sr_dmm_details_func details, void *info,
+		float *values, struct sr_dmm_reading *readings);
+
 /*--- hardware/dmm/es519xx.c ------------------------------------------------*/
 
 /**
@@ -19,15 +19,18 @@
 
 #include <config.h>
 #include <glib.h>
+#include <stdlib.h>
 #include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "modbus"
 
+SR_PRIV extern const struct sr_modbus_dev_inst modbus_tcp_dev;
 SR_PRIV extern const struct sr_modbus_dev_inst modbus_serial_rtu_dev;
 
 static const struct sr_modbus_dev_inst *modbus_devs[] = {
+	&modbus_tcp_dev,
 #ifdef HAVE_LIBSERIALPORT
 	&modbus_serial_rtu_dev, /* Must be last as it matches any resource. */
 #endif
@@ -477,6 +480,144 @@ SR_PRIV int sr_modbus_read_holding_registers(struct sr_modbus_dev_inst *modbus,
 	return SR_OK;
 }
 
+static int sr_modbus_register_map_compare(const void *a, const void *b)
+{
+	const struct sr_modbus_register_map *ea, *eb;
+
+	ea = *(const struct sr_modbus_register_map * const *)a;
+	eb = *(const struct sr_modbus_register_map * const *)b;
+
+	return ea->address - eb->address;
+}
+
+/**
+ * Read several blocks of holding registers, as few requests as possible.
+ *
+ * Blocks which are adjacent, overlapping, or separated by no more than
+ * max_gap unused registers are coalesced into a single read holding
+ * registers command. On transports that allow it, the commands are then
+ * pipelined: the next ones are sent before the previous replies are read.
+ *
+ * @param modbus Previously initialized Modbus device structure.
+ * @param map The register blocks to read, in any order.
+ * @param nb_entries The number of entries in map.
+ * @param max_gap The maximum number of unused registers to read in order
+ *                to merge two blocks.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments,
+ *         SR_ERR_DATA upon invalid data, or SR_ERR on failure.
+ */
+SR_PRIV int sr_modbus_read_register_map(struct sr_modbus_dev_inst *modbus,
+		struct sr_modbus_register_map *map, int nb_entries, int max_gap)
+{
+	struct sr_modbus_register_map **sorted, *entry;
+	int *block_start, *block_size, *entry_block;
+	uint16_t **block_regs, *regs;
+	int nb_blocks, total, max_pending, sent, received, end, i, ret;
+
+	if (!map || nb_entries < 1 || max_gap < 0)
+		return SR_ERR_ARG;
+
+	for (i = 0; i < nb_entries; i++) {
+		if (map[i].address < 0 || map[i].nb_registers < 1
+		    || map[i].nb_registers > 125
+		    || map[i].address + map[i].nb_registers > 0x10000
+		    || !map[i].registers)
+			return SR_ERR_ARG;
+	}
+
+	sorted = g_malloc(nb_entries * sizeof(*sorted));
+	for (i = 0; i < nb_entries; i++)
+		sorted[i] = &map[i];
+	qsort(sorted, nb_entries, sizeof(*sorted),
+	      sr_modbus_register_map_compare);
+
+	/* Coalesce the entries into blocks of at most 125 registers. */
+	block_start = g_malloc(nb_entries * sizeof(int));
+	block_size = g_malloc(nb_entries * sizeof(int));
+	entry_block = g_malloc(nb_entries * sizeof(int));
+	nb_blocks = 0;
+	total = 0;
+	for (i = 0; i < nb_entries; i++) {
+		entry = sorted[i];
+		end = entry->address + entry->nb_registers;
+		if (nb_blocks > 0
+		    && entry->address <= block_start[nb_blocks - 1]
+		                         + block_size[nb_blocks - 1] + max_gap
+		    && end - block_start[nb_blocks - 1] <= 125) {
+			end = MAX(end, block_start[nb_blocks - 1]
+			               + block_size[nb_blocks - 1]);
+			total += end - block_start[nb_blocks - 1]
+			         - block_size[nb_blocks - 1];
+			block_size[nb_blocks - 1] = end - block_start[nb_blocks - 1];
+		} else {
+			block_start[nb_blocks] = entry->address;
+			block_size[nb_blocks] = entry->nb_registers;
+			total += entry->nb_registers;
+			nb_blocks++;
+		}
+		entry_block[i] = nb_blocks - 1;
+	}
+
+	sr_spew("Reading %d register blocks with %d requests.",
+		nb_entries, nb_blocks);
+
+	regs = g_malloc(total * sizeof(uint16_t));
+	block_regs = g_malloc(nb_blocks * sizeof(*block_regs));
+	for (i = 0, end = 0; i < nb_blocks; i++) {
+		block_regs[i] = regs + end;
+		end += block_size[i];
+	}
+
+	/* Keep up to max_pending requests in flight. */
+	max_pending = MAX(modbus->max_pending, 1);
+	sent = received = 0;
+	ret = SR_OK;
+	while (received < nb_blocks) {
+		while (sent < nb_blocks && sent - received < max_pending) {
+			ret = sr_modbus_read_holding_registers(modbus,
+				block_start[sent], block_size[sent], NULL);
+			if (ret != SR_OK)
+				break;
+			sent++;
+		}
+		if (ret != SR_OK)
+			break;
+		ret = sr_modbus_read_holding_registers(modbus, -1,
+			block_size[received], block_regs[received]);
+		if (ret != SR_OK)
+			break;
+		received++;
+	}
+
+	/*
+	 * Don't leave the replies to the requests still in flight for the
+	 * next read to pick up as its own.
+	 */
+	if (ret != SR_OK && sent > received && modbus->flush) {
+		sr_dbg("Dropping %d outstanding requests.", sent - received);
+		modbus->flush(modbus->priv);
+	}
+
+	if (ret == SR_OK) {
+		for (i = 0; i < nb_entries; i++) {
+			entry = sorted[i];
+			memcpy(entry->registers, block_regs[entry_block[i]]
+			       + entry->address - block_start[entry_block[i]],
+			       entry->nb_registers * sizeof(uint16_t));
+		}
+	}
+
+	g_free(block_regs);
+	g_free(regs);
+	g_free(entry_block);
+	g_free(block_size);
+	g_free(block_start);
+	g_free(sorted);
+
+	return ret;
+}
+
 /**
  * Send a Modbus write coil command.
  *
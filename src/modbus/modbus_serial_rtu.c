@@ -177,6 +177,13 @@ static int modbus_serial_rtu_read_end(void *priv)
 	return SR_OK;
 }
 
+static int modbus_serial_rtu_flush(void *priv)
+{
+	struct modbus_serial_rtu *modbus = priv;
+
+	return serial_flush(modbus->serial);
+}
+
 static int modbus_serial_rtu_close(void *priv)
 {
 	struct modbus_serial_rtu *modbus = priv;
@@ -204,6 +211,7 @@ SR_PRIV const struct sr_modbus_dev_inst modbus_serial_rtu_dev = {
 	.read_begin    = modbus_serial_rtu_read_begin,
 	.read_data     = modbus_serial_rtu_read_data,
 	.read_end      = modbus_serial_rtu_read_end,
+	.flush         = modbus_serial_rtu_flush,
 	.close         = modbus_serial_rtu_close,
 	.free          = modbus_serial_rtu_free,
 };
@@ -0,0 +1,408 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#ifdef _WIN32
+#define _WIN32_WINNT 0x0501
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#endif
+#include <errno.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "modbus_tcp"
+
+/* Modbus application protocol (MBAP) header size, including the unit ID. */
+#define MBAP_SIZE 7
+/* Maximum PDU size, as per the Modbus specification. */
+#define PDU_MAX_SIZE 253
+/* Number of requests that may be outstanding at the same time. */
+#define MAX_PENDING 16
+
+#define READ_TIMEOUT_MS 1000
+
+struct modbus_tcp {
+	char *address;
+	char *port;
+	int socket;
+	uint8_t unit_id;
+	uint16_t transaction_id;
+	/* IDs of the transactions awaiting a reply, oldest first. */
+	GQueue pending;
+	/* Replies that were received ahead of an older transaction's. */
+	GHashTable *early_replies;
+	/* The reply currently being read. */
+	GByteArray *reply;
+	unsigned int reply_pos;
+};
+
+static int modbus_tcp_dev_inst_new(void *priv, const char *resource,
+		char **params, const char *serialcomm, int modbusaddr)
+{
+	struct modbus_tcp *modbus = priv;
+
+	(void)resource;
+	(void)serialcomm;
+
+	if (!params || !params[1] || !params[2]) {
+		sr_err("Invalid parameters.");
+		return SR_ERR;
+	}
+
+	modbus->address = g_strdup(params[1]);
+	modbus->port = g_strdup(params[2]);
+	modbus->socket = -1;
+	modbus->unit_id = modbusaddr;
+	g_queue_init(&modbus->pending);
+	modbus->early_replies = g_hash_table_new_full(g_direct_hash,
+			g_direct_equal, NULL, (GDestroyNotify)g_byte_array_unref);
+
+	return SR_OK;
+}
+
+static int modbus_tcp_open(void *priv)
+{
+	struct modbus_tcp *modbus = priv;
+	struct addrinfo hints;
+	struct addrinfo *results, *res;
+	int err;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	err = getaddrinfo(modbus->address, modbus->port, &hints, &results);
+
+	if (err) {
+		sr_err("Address lookup failed: %s:%s: %s", modbus->address,
+			modbus->port, gai_strerror(err));
+		return SR_ERR;
+	}
+
+	for (res = results; res; res = res->ai_next) {
+		if ((modbus->socket = socket(res->ai_family, res->ai_socktype,
+						res->ai_protocol)) < 0)
+			continue;
+		if (connect(modbus->socket, res->ai_addr, res->ai_addrlen) != 0) {
+			close(modbus->socket);
+			modbus->socket = -1;
+			continue;
+		}
+		break;
+	}
+
+	freeaddrinfo(results);
+
+	if (modbus->socket < 0) {
+		sr_err("Failed to connect to %s:%s: %s", modbus->address,
+				modbus->port, g_strerror(errno));
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+static int modbus_tcp_source_add(struct sr_session *session, void *priv,
+		int events, int timeout, sr_receive_data_callback cb, void *cb_data)
+{
+	struct modbus_tcp *modbus = priv;
+
+	return sr_session_source_add(session, modbus->socket, events, timeout,
+			cb, cb_data);
+}
+
+static int modbus_tcp_source_remove(struct sr_session *session, void *priv)
+{
+	struct modbus_tcp *modbus = priv;
+
+	return sr_session_source_remove(session, modbus->socket);
+}
+
+static int modbus_tcp_send(void *priv, const uint8_t *buffer, int buffer_size)
+{
+	struct modbus_tcp *modbus = priv;
+	uint8_t request[MBAP_SIZE + PDU_MAX_SIZE];
+	int len, out;
+
+	if (buffer_size > PDU_MAX_SIZE)
+		return SR_ERR_ARG;
+
+	if (g_queue_get_length(&modbus->pending) >= MAX_PENDING) {
+		sr_err("Too many outstanding Modbus requests.");
+		return SR_ERR;
+	}
+
+	/* ID 0 can't be told apart from a NULL key in the queue and table. */
+	if (++modbus->transaction_id == 0)
+		modbus->transaction_id++;
+	WB16(request + 0, modbus->transaction_id);
+	WB16(request + 2, 0); /* Protocol ID: Modbus. */
+	WB16(request + 4, buffer_size + 1);
+	W8(request + 6, modbus->unit_id);
+	memcpy(request + MBAP_SIZE, buffer, buffer_size);
+
+	/* Send the header and PDU in one go, to end up in one segment. */
+	len = MBAP_SIZE + buffer_size;
+	out = send(modbus->socket, (const char *)request, len, 0);
+
+	if (out < 0) {
+		sr_err("Send error: %s", g_strerror(errno));
+		return SR_ERR;
+	}
+
+	if (out < len) {
+		sr_err("Only sent %d/%d bytes of Modbus request.", out, len);
+		return SR_ERR;
+	}
+
+	g_queue_push_tail(&modbus->pending,
+			GUINT_TO_POINTER(modbus->transaction_id));
+
+	return SR_OK;
+}
+
+static int modbus_tcp_recv(struct modbus_tcp *modbus, uint8_t *buf, int len)
+{
+	struct timeval tv;
+	fd_set fds;
+	gint64 deadline, remaining;
+	int ret;
+
+	deadline = g_get_monotonic_time() + READ_TIMEOUT_MS * 1000;
+
+	while (len > 0) {
+		remaining = deadline - g_get_monotonic_time();
+		if (remaining <= 0) {
+			sr_err("Timed out waiting for Modbus response.");
+			return SR_ERR;
+		}
+		tv.tv_sec = remaining / 1000000;
+		tv.tv_usec = remaining % 1000000;
+		FD_ZERO(&fds);
+		FD_SET(modbus->socket, &fds);
+		ret = select(modbus->socket + 1, &fds, NULL, NULL, &tv);
+		if (ret < 0 && errno != EINTR) {
+			sr_err("Select error: %s", g_strerror(errno));
+			return SR_ERR;
+		}
+		if (ret <= 0)
+			continue;
+
+		ret = recv(modbus->socket, (char *)buf, len, 0);
+		if (ret < 0) {
+			sr_err("Receive error: %s", g_strerror(errno));
+			return SR_ERR;
+		}
+		if (ret == 0) {
+			sr_err("Connection closed by Modbus server.");
+			return SR_ERR;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Read the next reply frame from the socket. Returns its transaction ID
+ * and stores its PDU (without the unit ID) in reply.
+ */
+static int modbus_tcp_recv_frame(struct modbus_tcp *modbus,
+		uint16_t *transaction_id, GByteArray **reply)
+{
+	uint8_t header[MBAP_SIZE];
+	unsigned int len;
+	int ret;
+
+	if ((ret = modbus_tcp_recv(modbus, header, sizeof(header))) != SR_OK)
+		return ret;
+
+	len = RB16(header + 4);
+	if (RB16(header + 2) != 0 || len < 2 || len > PDU_MAX_SIZE + 1) {
+		sr_err("Invalid Modbus TCP frame header.");
+		return SR_ERR_DATA;
+	}
+	len--;
+
+	*transaction_id = RB16(header + 0);
+	*reply = g_byte_array_sized_new(len);
+	g_byte_array_set_size(*reply, len);
+	if ((ret = modbus_tcp_recv(modbus, (*reply)->data, len)) != SR_OK) {
+		g_byte_array_unref(*reply);
+		*reply = NULL;
+		return ret;
+	}
+
+	if (R8(header + 6) != modbus->unit_id)
+		sr_dbg("Reply from unexpected unit ID %d.", R8(header + 6));
+
+	return SR_OK;
+}
+
+static int modbus_tcp_read_begin(void *priv, uint8_t *function_code)
+{
+	struct modbus_tcp *modbus = priv;
+	GByteArray *reply;
+	gpointer expected;
+	uint16_t transaction_id;
+	int ret;
+
+	if (g_queue_is_empty(&modbus->pending)) {
+		sr_err("No outstanding Modbus request to read a reply for.");
+		return SR_ERR;
+	}
+	expected = g_queue_peek_head(&modbus->pending);
+
+	/*
+	 * Replies are consumed in request order. A reply to a later request
+	 * that overtakes the expected one (as some gateways allow) is put
+	 * aside until its turn comes.
+	 */
+	reply = g_hash_table_lookup(modbus->early_replies, expected);
+	if (reply) {
+		g_hash_table_steal(modbus->early_replies, expected);
+	} else {
+		while (TRUE) {
+			ret = modbus_tcp_recv_frame(modbus, &transaction_id, &reply);
+			if (ret != SR_OK) {
+				/* Give up on this one, a late reply gets discarded. */
+				g_queue_pop_head(&modbus->pending);
+				return ret;
+			}
+			if (GUINT_TO_POINTER(transaction_id) == expected)
+				break;
+			if (g_queue_find(&modbus->pending,
+					GUINT_TO_POINTER(transaction_id))) {
+				g_hash_table_insert(modbus->early_replies,
+					GUINT_TO_POINTER(transaction_id), reply);
+			} else {
+				sr_dbg("Discarding reply to unknown transaction %d.",
+					transaction_id);
+				g_byte_array_unref(reply);
+			}
+		}
+	}
+	g_queue_pop_head(&modbus->pending);
+
+	if (modbus->reply)
+		g_byte_array_unref(modbus->reply);
+	modbus->reply = reply;
+	*function_code = reply->data[0];
+	modbus->reply_pos = 1;
+
+	return SR_OK;
+}
+
+static int modbus_tcp_read_data(void *priv, uint8_t *buf, int maxlen)
+{
+	struct modbus_tcp *modbus = priv;
+	int len;
+
+	if (!modbus->reply || modbus->reply_pos >= modbus->reply->len)
+		return SR_ERR;
+
+	len = MIN((unsigned int)maxlen, modbus->reply->len - modbus->reply_pos);
+	memcpy(buf, modbus->reply->data + modbus->reply_pos, len);
+	modbus->reply_pos += len;
+
+	return len;
+}
+
+static int modbus_tcp_read_end(void *priv)
+{
+	struct modbus_tcp *modbus = priv;
+
+	if (modbus->reply) {
+		g_byte_array_unref(modbus->reply);
+		modbus->reply = NULL;
+	}
+
+	return SR_OK;
+}
+
+static int modbus_tcp_flush(void *priv)
+{
+	struct modbus_tcp *modbus = priv;
+
+	/* Replies that still arrive are then discarded as unknown. */
+	g_queue_clear(&modbus->pending);
+	g_hash_table_remove_all(modbus->early_replies);
+	if (modbus->reply) {
+		g_byte_array_unref(modbus->reply);
+		modbus->reply = NULL;
+	}
+
+	return SR_OK;
+}
+
+static int modbus_tcp_close(void *priv)
+{
+	struct modbus_tcp *modbus = priv;
+
+	modbus_tcp_flush(modbus);
+
+	if (close(modbus->socket) < 0)
+		return SR_ERR;
+	modbus->socket = -1;
+
+	return SR_OK;
+}
+
+static void modbus_tcp_free(void *priv)
+{
+	struct modbus_tcp *modbus = priv;
+
+	g_free(modbus->address);
+	g_free(modbus->port);
+	g_queue_clear(&modbus->pending);
+	if (modbus->early_replies)
+		g_hash_table_destroy(modbus->early_replies);
+	if (modbus->reply)
+		g_byte_array_unref(modbus->reply);
+}
+
+SR_PRIV const struct sr_modbus_dev_inst modbus_tcp_dev = {
+	.name          = "tcp",
+	.prefix        = "tcp",
+	.priv_size     = sizeof(struct modbus_tcp),
+	.max_pending   = MAX_PENDING,
+	.scan          = NULL,
+	.dev_inst_new  = modbus_tcp_dev_inst_new,
+	.open          = modbus_tcp_open,
+	.source_add    = modbus_tcp_source_add,
+	.source_remove = modbus_tcp_source_remove,
+	.send          = modbus_tcp_send,
+	.read_begin    = modbus_tcp_read_begin,
+	.read_data     = modbus_tcp_read_data,
+	.read_end      = modbus_tcp_read_end,
+	.flush         = modbus_tcp_flush,
+	.close         = modbus_tcp_close,
+	.free          = modbus_tcp_free,
+};
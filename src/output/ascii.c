@@ -46,14 +46,37 @@ struct context {
 	int *channel_index;
 	char **channel_names;
 	char **line_values;
-	uint8_t *prev_sample;
+	/* Each channel's value in the last sample of the previous packet. */
+	uint8_t *prev_bits;
 	gboolean header_done;
 	GString **lines;
 	GString *header;
 	const char *charset;
 	gboolean edges;
+	/*
+	 * Characters for 4 samples, indexed by their values (low nibble)
+	 * and their edge flags (high nibble), earliest sample first.
+	 */
+	char lut[256][4];
+	/* Per-channel bit planes of the current packet. */
+	uint8_t *planes;
+	size_t planes_size;
 };
 
+static void lut_init(struct context *ctx)
+{
+	unsigned int i, n, charidx;
+
+	for (i = 0; i < 256; i++) {
+		for (n = 0; n < 4; n++) {
+			charidx = (i >> n) & 1;
+			if (ctx->edges && (i >> (4 + n)) & 1)
+				charidx += 2;
+			ctx->lut[i][n] = ctx->charset[charidx];
+		}
+	}
+}
+
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
@@ -75,6 +98,7 @@ static int init(struct sr_output *o, GHashTable *options)
 		ctx->charset = g_strdup(DEFAULT_ASCII_CHARS);
 	}
 	ctx->edges = (strlen(ctx->charset) >= 4) ? TRUE : FALSE;
+	lut_init(ctx);
 
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
@@ -87,7 +111,7 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->channel_index = g_malloc(sizeof(int) * ctx->num_enabled_channels);
 	ctx->channel_names = g_malloc(sizeof(char *) * ctx->num_enabled_channels);
 	ctx->lines = g_malloc(sizeof(GString *) * ctx->num_enabled_channels);
-	ctx->prev_sample = g_malloc(g_slist_length(o->sdi->channels));
+	ctx->prev_bits = g_malloc0(ctx->num_enabled_channels);
 
 	j = 0;
 	for (i = 0, l = o->sdi->channels; l; l = l->next, i++) {
@@ -98,7 +122,7 @@ static int init(struct sr_output *o, GHashTable *options)
 			continue;
 		ctx->channel_index[j] = ch->index;
 		ctx->channel_names[j] = ch->name;
-		ctx->lines[j] = g_string_sized_new(80);
+		ctx->lines[j] = g_string_sized_new(strlen(ch->name) + 2 + ctx->spl);
 		g_string_printf(ctx->lines[j], "%s:", ch->name);
 		j++;
 	}
@@ -138,6 +162,94 @@ static GString *gen_header(const struct sr_output *o)
 	return header;
 }
 
+/* Get the 8 bits of a bit plane starting at sample s. */
+static inline unsigned int window(const uint8_t *plane, uint64_t s)
+{
+	plane += s / 8;
+
+	return ((plane[0] | (plane[1] << 8)) >> (s % 8)) & 0xff;
+}
+
+static void process_logic(struct context *ctx,
+		const struct sr_datafeed_logic *logic, GString *out)
+{
+	uint64_t num_samples, s, last;
+	size_t stride;
+	unsigned int j, n, cur, prev, edge;
+	int offset;
+	const uint8_t *plane;
+	char buf[8];
+
+	num_samples = logic->length / logic->unitsize;
+	if (!num_samples || !ctx->num_enabled_channels)
+		return;
+
+	/* One spare byte per plane, for reading 16-bit windows. */
+	stride = (num_samples + 7) / 8 + 1;
+	if (ctx->planes_size < stride * ctx->num_enabled_channels) {
+		g_free(ctx->planes);
+		ctx->planes_size = stride * ctx->num_enabled_channels;
+		ctx->planes = g_malloc(ctx->planes_size);
+	}
+	sr_output_logic_to_planes(logic->data, logic->unitsize, num_samples,
+		ctx->channel_index, ctx->num_enabled_channels,
+		ctx->planes, stride);
+	for (j = 0; j < ctx->num_enabled_channels; j++)
+		ctx->planes[j * stride + stride - 1] = 0;
+
+	/*
+	 * Render up to 8 samples at a time. Edges are where a sample differs
+	 * from the one before it, i.e. the XOR of the plane with itself
+	 * shifted by one sample. The first sample of a line never shows an
+	 * edge.
+	 */
+	for (s = 0; s < num_samples; s += n) {
+		n = 8;
+		if (ctx->spl)
+			n = MIN(n, (unsigned int)(ctx->spl - ctx->spl_cnt));
+		n = MIN(n, num_samples - s);
+		for (j = 0; j < ctx->num_enabled_channels; j++) {
+			plane = ctx->planes + j * stride;
+			cur = window(plane, s);
+			if (s == 0)
+				prev = (cur << 1) | ctx->prev_bits[j];
+			else
+				prev = window(plane, s - 1);
+			edge = 0;
+			if (ctx->edges) {
+				edge = (cur ^ prev) & 0xff;
+				if (ctx->spl_cnt == 0)
+					edge &= ~1;
+			}
+			memcpy(buf, ctx->lut[(cur & 0x0f) | ((edge & 0x0f) << 4)], 4);
+			memcpy(buf + 4, ctx->lut[(cur >> 4) | (edge & 0xf0)], 4);
+			g_string_append_len(ctx->lines[j], buf, n);
+		}
+		ctx->spl_cnt += n;
+
+		if (ctx->spl_cnt == ctx->spl) {
+			/* Flush line buffers. */
+			for (j = 0; j < ctx->num_enabled_channels; j++) {
+				g_string_append_len(out, ctx->lines[j]->str, ctx->lines[j]->len);
+				g_string_append_c(out, '\n');
+				/* Keep the "name:" prefix. */
+				g_string_truncate(ctx->lines[j],
+					strlen(ctx->channel_names[j]) + 1);
+			}
+			if (ctx->trigger > -1) {
+				offset = ctx->trigger + ctx->trigger / 8;
+				g_string_append_printf(out, "T:%*s^ %d\n", offset, "", ctx->trigger);
+				ctx->trigger = -1;
+			}
+			ctx->spl_cnt = 0;
+		}
+	}
+
+	last = num_samples - 1;
+	for (j = 0; j < ctx->num_enabled_channels; j++)
+		ctx->prev_bits[j] = (ctx->planes[j * stride + last / 8] >> (last % 8)) & 1;
+}
+
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
 		GString **out)
 {
@@ -146,10 +258,8 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	int idx, offset, curbit, prevbit;
-	uint64_t i, j;
-	gchar *p, c;
-	size_t charidx;
+	uint64_t i;
+	size_t size;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -171,46 +281,19 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		ctx->trigger = ctx->spl_cnt;
 		break;
 	case SR_DF_LOGIC:
+		logic = packet->payload;
+		/* Make room for the lines this packet completes. */
+		size = 512;
+		if (ctx->spl)
+			size += (logic->length / logic->unitsize / ctx->spl + 1)
+				* ctx->num_enabled_channels
+				* (ctx->spl + ctx->spl / 8 + 16);
 		if (!ctx->header_done) {
 			*out = gen_header(o);
 			ctx->header_done = TRUE;
 		} else
-			*out = g_string_sized_new(512);
-
-		logic = packet->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			ctx->spl_cnt++;
-			for (j = 0; j < ctx->num_enabled_channels; j++) {
-				idx = ctx->channel_index[j];
-				p = logic->data + i + idx / 8;
-				curbit = *p & (1 << (idx % 8));
-				prevbit = (ctx->prev_sample[idx / 8] & ((uint8_t) 1 << (idx % 8)));
-
-				charidx = curbit ? 1 : 0;
-				if (ctx->edges && ctx->spl_cnt > 1) {
-					if (curbit != prevbit)
-						charidx += 2;
-				}
-				c = ctx->charset[charidx];
-				g_string_append_c(ctx->lines[j], c);
-
-				if (ctx->spl_cnt == ctx->spl) {
-					/* Flush line buffers. */
-					g_string_append_len(*out, ctx->lines[j]->str, ctx->lines[j]->len);
-					g_string_append_c(*out, '\n');
-					if (j == ctx->num_enabled_channels - 1 && ctx->trigger > -1) {
-						offset = ctx->trigger + ctx->trigger / 8;
-						g_string_append_printf(*out, "T:%*s^ %d\n", offset, "", ctx->trigger);
-						ctx->trigger = -1;
-					}
-					g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
-				}
-			}
-			if (ctx->spl_cnt == ctx->spl)
-				/* Line buffers were already flushed. */
-				ctx->spl_cnt = 0;
-			memcpy(ctx->prev_sample, logic->data + i, logic->unitsize);
-		}
+			*out = g_string_sized_new(size);
+		process_logic(ctx, logic, *out);
 		break;
 	case SR_DF_END:
 		if (ctx->spl_cnt) {
@@ -239,7 +322,8 @@ static int cleanup(struct sr_output *o)
 		return SR_OK;
 
 	g_free(ctx->channel_index);
-	g_free(ctx->prev_sample);
+	g_free(ctx->prev_bits);
+	g_free(ctx->planes);
 	g_free(ctx->channel_names);
 	for (i = 0; i < ctx->num_enabled_channels; i++)
 		g_string_free(ctx->lines[i], TRUE);
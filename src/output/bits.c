@@ -38,8 +38,28 @@ struct context {
 	char **channel_names;
 	gboolean header_done;
 	GString **lines;
+	/* Per-channel bit planes of the current packet. */
+	uint8_t *planes;
+	size_t planes_size;
 };
 
+/* The 8 digits for each value of a bit plane byte, earliest sample first. */
+static char bits_lut[256][8];
+
+static void bits_lut_init(void)
+{
+	static gsize done = 0;
+	unsigned int i, n;
+
+	/* Output instances may get set up on several threads at once. */
+	if (!g_once_init_enter(&done))
+		return;
+	for (i = 0; i < 256; i++)
+		for (n = 0; n < 8; n++)
+			bits_lut[i][n] = (i & (1 << n)) ? '1' : '0';
+	g_once_init_leave(&done, 1);
+}
+
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
@@ -54,6 +74,7 @@ static int init(struct sr_output *o, GHashTable *options)
 	o->priv = ctx;
 	ctx->trigger = -1;
 	ctx->spl = g_variant_get_uint32(g_hash_table_lookup(options, "width"));
+	bits_lut_init();
 
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
@@ -76,7 +97,8 @@ static int init(struct sr_output *o, GHashTable *options)
 			continue;
 		ctx->channel_index[j] = ch->index;
 		ctx->channel_names[j] = ch->name;
-		ctx->lines[j] = g_string_sized_new(80);
+		ctx->lines[j] = g_string_sized_new(strlen(ch->name) + 2
+				+ ctx->spl + ctx->spl / 8);
 		g_string_printf(ctx->lines[j], "%s:", ch->name);
 		j++;
 	}
@@ -116,6 +138,76 @@ static GString *gen_header(const struct sr_output *o)
 	return header;
 }
 
+static void flush_lines(struct context *ctx, GString *out)
+{
+	unsigned int j;
+	int offset;
+
+	for (j = 0; j < ctx->num_enabled_channels; j++) {
+		g_string_append_len(out, ctx->lines[j]->str, ctx->lines[j]->len);
+		g_string_append_c(out, '\n');
+		/* Keep the "name:" prefix. */
+		g_string_truncate(ctx->lines[j], strlen(ctx->channel_names[j]) + 1);
+	}
+	if (ctx->trigger > -1) {
+		offset = ctx->trigger + ctx->trigger / 8;
+		g_string_append_printf(out, "T:%*s^ %d\n", offset, "", ctx->trigger);
+		ctx->trigger = -1;
+	}
+}
+
+static void process_logic(struct context *ctx,
+		const struct sr_datafeed_logic *logic, GString *out)
+{
+	uint64_t num_samples, s;
+	size_t stride;
+	unsigned int j, n, bits;
+	const uint8_t *plane;
+
+	num_samples = logic->length / logic->unitsize;
+	if (!num_samples || !ctx->num_enabled_channels)
+		return;
+
+	/* One spare byte per plane, for reading 16-bit windows. */
+	stride = (num_samples + 7) / 8 + 1;
+	if (ctx->planes_size < stride * ctx->num_enabled_channels) {
+		g_free(ctx->planes);
+		ctx->planes_size = stride * ctx->num_enabled_channels;
+		ctx->planes = g_malloc(ctx->planes_size);
+	}
+	sr_output_logic_to_planes(logic->data, logic->unitsize, num_samples,
+		ctx->channel_index, ctx->num_enabled_channels,
+		ctx->planes, stride);
+	for (j = 0; j < ctx->num_enabled_channels; j++)
+		ctx->planes[j * stride + stride - 1] = 0;
+
+	/*
+	 * Render up to the next group of 8 digits in the line (or the end
+	 * of the line) at a time, through the lookup table.
+	 */
+	for (s = 0; s < num_samples; s += n) {
+		n = 8 - (ctx->spl_cnt & 7);
+		if (ctx->spl)
+			n = MIN(n, (unsigned int)(ctx->spl - ctx->spl_cnt));
+		n = MIN(n, num_samples - s);
+		for (j = 0; j < ctx->num_enabled_channels; j++) {
+			plane = ctx->planes + j * stride + s / 8;
+			bits = ((plane[0] | (plane[1] << 8)) >> (s % 8)) & 0xff;
+			g_string_append_len(ctx->lines[j], bits_lut[bits], n);
+		}
+		ctx->spl_cnt += n;
+
+		if (ctx->spl_cnt == ctx->spl) {
+			flush_lines(ctx, out);
+			ctx->spl_cnt = 0;
+		} else if ((ctx->spl_cnt & 7) == 0) {
+			/* Add a space every 8th bit. */
+			for (j = 0; j < ctx->num_enabled_channels; j++)
+				g_string_append_c(ctx->lines[j], ' ');
+		}
+	}
+}
+
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
 		GString **out)
 {
@@ -124,9 +216,8 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	const struct sr_config *src;
 	struct context *ctx;
 	GSList *l;
-	int idx, offset;
-	uint64_t i, j;
-	gchar *p, c;
+	uint64_t i;
+	size_t size;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -148,40 +239,19 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		ctx->trigger = ctx->spl_cnt;
 		break;
 	case SR_DF_LOGIC:
+		logic = packet->payload;
+		/* Make room for the lines this packet completes. */
+		size = 512;
+		if (ctx->spl)
+			size += (logic->length / logic->unitsize / ctx->spl + 1)
+				* ctx->num_enabled_channels
+				* (ctx->spl + ctx->spl / 8 + 16);
 		if (!ctx->header_done) {
 			*out = gen_header(o);
 			ctx->header_done = TRUE;
 		} else
-			*out = g_string_sized_new(512);
-
-		logic = packet->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			ctx->spl_cnt++;
-			for (j = 0; j < ctx->num_enabled_channels; j++) {
-				idx = ctx->channel_index[j];
-				p = logic->data + i + idx / 8;
-				c = (*p & (1 << (idx % 8))) ? '1' : '0';
-				g_string_append_c(ctx->lines[j], c);
-
-				if (ctx->spl_cnt == ctx->spl) {
-					/* Flush line buffers. */
-					g_string_append_len(*out, ctx->lines[j]->str, ctx->lines[j]->len);
-					g_string_append_c(*out, '\n');
-					if (j == ctx->num_enabled_channels - 1 && ctx->trigger > -1) {
-						offset = ctx->trigger + ctx->trigger / 8;
-						g_string_append_printf(*out, "T:%*s^ %d\n", offset, "", ctx->trigger);
-						ctx->trigger = -1;
-					}
-					g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
-				} else if ((ctx->spl_cnt & 7) == 0) {
-					/* Add a space every 8th bit. */
-					g_string_append_c(ctx->lines[j], ' ');
-				}
-			}
-			if (ctx->spl_cnt == ctx->spl)
-				/* Line buffers were already flushed. */
-				ctx->spl_cnt = 0;
-		}
+			*out = g_string_sized_new(size);
+		process_logic(ctx, logic, *out);
 		break;
 	case SR_DF_END:
 		if (ctx->spl_cnt) {
@@ -214,6 +284,7 @@ static int cleanup(struct sr_output *o)
 	for (i = 0; i < ctx->num_enabled_channels; i++)
 		g_string_free(ctx->lines[i], TRUE);
 	g_free(ctx->lines);
+	g_free(ctx->planes);
 	g_free(ctx);
 	o->priv = NULL;
 
@@ -55,6 +55,7 @@
 
 #include <math.h>
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <glib.h>
@@ -63,10 +64,28 @@
 
 #define LOG_PREFIX "output/csv"
 
+/*
+ * Worst case length of a formatted analog value ("%g" never needs more
+ * than "-1.23456e-308"), and of the time column.
+ */
+#define ANALOG_CELL_MAX 16
+#define TIME_CELL_MAX 20
+
+/*
+ * Number of rows a column may run ahead of the others before the rows
+ * are written out with the missing values left empty.
+ */
+#define REORDER_MAX_ROWS (1 << 20)
+
 struct ctx_channel {
 	struct sr_channel *ch;
 	char *label;
 	float min, max;
+	/* Logic: location of the channel's bit within a sample. */
+	unsigned int byte;
+	uint8_t mask;
+	/* Analog: values waiting for the other columns of their rows. */
+	GArray *pending;
 };
 
 struct context {
@@ -86,18 +105,30 @@ struct context {
 	/* Plot data */
 	unsigned int num_analog_channels;
 	unsigned int num_logic_channels;
+	unsigned int num_columns;
 	struct ctx_channel *channels;
 
+	/* Row formatting */
+	size_t value_len, record_len;
+	size_t max_row_len;
+	float *row, *prev_row;
+	gboolean have_prev_row;
+
+	/* Logic samples waiting for the analog columns of their rows. */
+	GByteArray *logic_pending;
+	unsigned int logic_unitsize;
+	/* Size of the queued values, as accounted to the session. */
+	size_t accounted;
+	/* Scratch space for converting analog packets. */
+	float *fdata;
+	size_t fdata_size;
+
 	/* Metadata */
 	gboolean trigger;
-	uint32_t num_samples;
-	uint32_t channel_count, logic_channel_count;
-	uint32_t channels_seen;
+	uint64_t trigger_row;
+	uint64_t rows_out;
 	uint64_t period;
 	uint64_t sample_time;
-	uint8_t *previous_sample;
-	float *analog_samples;
-	uint8_t *logic_samples;
 	const char *xlabel;	/* Don't free: will point to a static string. */
 	const char *title;	/* Don't free: will point into the driver struct. */
 };
@@ -162,12 +193,11 @@ static int init(struct sr_output *o, GHashTable *options)
 	/* Get the number of channels, and the unitsize. */
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
-		if (ch->type == SR_CHANNEL_LOGIC) {
-			ctx->logic_channel_count++;
-			if (ch->enabled)
-				logic_channels++;
-		}
-		if (ch->type == SR_CHANNEL_ANALOG && ch->enabled)
+		if (!ch->enabled)
+			continue;
+		if (ch->type == SR_CHANNEL_LOGIC)
+			logic_channels++;
+		else if (ch->type == SR_CHANNEL_ANALOG)
 			analog_channels++;
 	}
 	if (analog_channels) {
@@ -178,28 +208,48 @@ static int init(struct sr_output *o, GHashTable *options)
 		sr_info("Outputting %d logic values", logic_channels);
 		ctx->num_logic_channels = logic_channels;
 	}
-	ctx->channels = g_malloc(sizeof(struct ctx_channel)
-		* (ctx->num_analog_channels + ctx->num_logic_channels));
+	ctx->num_columns = ctx->num_analog_channels + ctx->num_logic_channels;
+	ctx->channels = g_malloc0(sizeof(struct ctx_channel) * ctx->num_columns);
 
 	/* Once more to map the enabled channels. */
-	ctx->channel_count = g_slist_length(o->sdi->channels);
 	for (i = 0, l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
-		if (ch->enabled) {
-			if (ch->type == SR_CHANNEL_ANALOG) {
-				ctx->channels[i].min = FLT_MAX;
-				ctx->channels[i].max = FLT_MIN;
-			} else if (ch->type == SR_CHANNEL_LOGIC) {
-				ctx->channels[i].min = 0;
-				ctx->channels[i].max = 1;
-			} else {
-				sr_warn("Unknown channel type %d.", ch->type);
-			}
-			if (ctx->label_do && ctx->label_names)
-				ctx->channels[i].label = ch->name;
-			ctx->channels[i++].ch = ch;
+		if (!ch->enabled)
+			continue;
+		if (ch->type == SR_CHANNEL_ANALOG) {
+			ctx->channels[i].min = FLT_MAX;
+			ctx->channels[i].max = FLT_MIN;
+			ctx->channels[i].pending = g_array_new(FALSE,
+					FALSE, sizeof(float));
+		} else if (ch->type == SR_CHANNEL_LOGIC) {
+			ctx->channels[i].min = 0;
+			ctx->channels[i].max = 1;
+			if (ctx->label_do && !ctx->label_names)
+				ctx->channels[i].label = "logic";
+		} else {
+			sr_warn("Unknown channel type %d.", ch->type);
+			continue;
 		}
+		if (ctx->label_do && ctx->label_names)
+			ctx->channels[i].label = ch->name;
+		ctx->channels[i++].ch = ch;
 	}
+	ctx->num_columns = i;
+
+	/*
+	 * Every row has the same layout, so the space it can take up is
+	 * known in advance. That lets rows be written straight into the
+	 * output buffer.
+	 */
+	ctx->value_len = strlen(ctx->value);
+	ctx->record_len = strlen(ctx->record);
+	ctx->max_row_len = ctx->num_logic_channels
+		+ ctx->num_analog_channels * ANALOG_CELL_MAX
+		+ (ctx->time ? TIME_CELL_MAX : 0) + (ctx->do_trigger ? 1 : 0)
+		+ (ctx->num_columns + 2) * ctx->value_len + ctx->record_len;
+	ctx->row = g_malloc0(sizeof(float) * ctx->num_columns);
+	ctx->prev_row = g_malloc0(sizeof(float) * ctx->num_columns);
+	ctx->logic_pending = g_byte_array_new();
 
 	return SR_OK;
 }
@@ -281,222 +331,339 @@ static GString *gen_header(const struct sr_output *o,
 	return header;
 }
 
+static char *append_u64(char *p, uint64_t value)
+{
+	char digits[TIME_CELL_MAX];
+	unsigned int n;
+
+	n = 0;
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	while (n)
+		*p++ = digits[--n];
+
+	return p;
+}
+
+static void append_labels(struct context *ctx, GString *out)
+{
+	unsigned int i;
+
+	if (ctx->time) {
+		g_string_append(out, ctx->label_names ? "Time" :
+			(ctx->xlabel ? ctx->xlabel : ""));
+		g_string_append(out, ctx->value);
+	}
+	for (i = 0; i < ctx->num_columns; i++) {
+		g_string_append(out, ctx->channels[i].label ?
+			ctx->channels[i].label : ctx->channels[i].ch->name);
+		g_string_append(out, ctx->value);
+	}
+	if (ctx->do_trigger) {
+		g_string_append(out, "Trigger");
+		g_string_append(out, ctx->value);
+	}
+	/* Drop last separator. */
+	g_string_truncate(out, out->len - ctx->value_len);
+	g_string_append(out, ctx->record);
+
+	ctx->label_do = FALSE;
+}
+
+/*
+ * Write out rows [0, count) of the pending data. Columns that have run
+ * out of values (only when flushing at the end of a frame or when the
+ * reorder buffer overflows) are left empty.
+ */
+static void emit_rows(struct context *ctx, GString **out,
+		const uint8_t *logic, size_t logic_rows, size_t count)
+{
+	struct ctx_channel *col;
+	size_t i, base;
+	unsigned int j;
+	gboolean trigger;
+	float value;
+	char *p;
+
+	if (!count || !ctx->num_columns)
+		return;
+
+	if (!*out)
+		*out = g_string_sized_new(512);
+	if (ctx->label_do)
+		append_labels(ctx, *out);
+
+	base = (*out)->len;
+	g_string_set_size(*out, base + count * ctx->max_row_len);
+	p = (*out)->str + base;
+
+	for (i = 0; i < count; i++) {
+		ctx->sample_time += ctx->period;
+
+		for (j = 0; j < ctx->num_columns; j++) {
+			col = &ctx->channels[j];
+			if (col->pending) {
+				ctx->row[j] = (i < col->pending->len) ?
+					g_array_index(col->pending, float, i) : NAN;
+			} else if (i < logic_rows) {
+				ctx->row[j] = (logic[i * ctx->logic_unitsize
+					+ col->byte] & col->mask) ? 1 : 0;
+			} else {
+				ctx->row[j] = NAN;
+			}
+		}
+
+		trigger = ctx->trigger && ctx->rows_out + i >= ctx->trigger_row;
+
+		/* Always keep the first and last rows, for the time axis. */
+		if (ctx->dedup) {
+			if (ctx->have_prev_row && i > 0 && i < count - 1 &&
+			    !trigger && !memcmp(ctx->row, ctx->prev_row,
+					sizeof(float) * ctx->num_columns))
+				continue;
+			memcpy(ctx->prev_row, ctx->row,
+				sizeof(float) * ctx->num_columns);
+			ctx->have_prev_row = TRUE;
+		}
+
+		if (ctx->time) {
+			p = append_u64(p, ctx->sample_time);
+			memcpy(p, ctx->value, ctx->value_len);
+			p += ctx->value_len;
+		}
+
+		for (j = 0; j < ctx->num_columns; j++) {
+			col = &ctx->channels[j];
+			value = ctx->row[j];
+			if (col->pending) {
+				if (i < col->pending->len) {
+					col->max = fmax(value, col->max);
+					col->min = fmin(value, col->min);
+					p += snprintf(p, ANALOG_CELL_MAX, "%g", value);
+				}
+			} else if (i < logic_rows) {
+				*p++ = value ? '1' : '0';
+			}
+			memcpy(p, ctx->value, ctx->value_len);
+			p += ctx->value_len;
+		}
+
+		if (ctx->do_trigger) {
+			*p++ = trigger ? '1' : '0';
+			memcpy(p, ctx->value, ctx->value_len);
+			p += ctx->value_len;
+		}
+		if (trigger)
+			ctx->trigger = FALSE;
+
+		/* Drop last separator. */
+		p -= ctx->value_len;
+		memcpy(p, ctx->record, ctx->record_len);
+		p += ctx->record_len;
+	}
+
+	g_string_truncate(*out, p - (*out)->str);
+	ctx->rows_out += count;
+}
+
+/* Drop rows [0, count) from the reorder buffer. */
+static void consume_rows(struct context *ctx, size_t count)
+{
+	unsigned int i;
+	size_t len;
+
+	len = MIN(count * ctx->logic_unitsize, ctx->logic_pending->len);
+	if (len)
+		g_byte_array_remove_range(ctx->logic_pending, 0, len);
+
+	for (i = 0; i < ctx->num_columns; i++) {
+		if (!ctx->channels[i].pending)
+			continue;
+		len = MIN(count, ctx->channels[i].pending->len);
+		if (len)
+			g_array_remove_range(ctx->channels[i].pending, 0, len);
+	}
+}
+
+static size_t logic_pending_rows(const struct context *ctx)
+{
+	if (!ctx->logic_unitsize)
+		return 0;
+
+	return ctx->logic_pending->len / ctx->logic_unitsize;
+}
+
+/*
+ * Number of rows for which the reorder buffer holds values: rows that
+ * are complete (the shortest column), or rows that have any value at
+ * all (the longest column).
+ */
+static size_t pending_rows(const struct context *ctx, gboolean complete)
+{
+	size_t rows, len;
+	unsigned int i;
+	gboolean first;
+
+	rows = 0;
+	first = TRUE;
+	if (ctx->num_logic_channels) {
+		rows = logic_pending_rows(ctx);
+		first = FALSE;
+	}
+	for (i = 0; i < ctx->num_columns; i++) {
+		if (!ctx->channels[i].pending)
+			continue;
+		len = ctx->channels[i].pending->len;
+		if (first)
+			rows = len;
+		else
+			rows = complete ? MIN(rows, len) : MAX(rows, len);
+		first = FALSE;
+	}
+
+	return rows;
+}
+
+static void flush_rows(struct context *ctx, GString **out, size_t count)
+{
+	emit_rows(ctx, out, ctx->logic_pending->data,
+		logic_pending_rows(ctx), count);
+	consume_rows(ctx, count);
+}
+
+/* Write out whatever rows are complete, or everything when flushing. */
+static void dump_rows(struct context *ctx, GString **out, gboolean all)
+{
+	size_t rows;
+
+	rows = pending_rows(ctx, TRUE);
+	if (rows)
+		flush_rows(ctx, out, rows);
+
+	rows = pending_rows(ctx, FALSE);
+	if (rows && (all || rows > REORDER_MAX_ROWS)) {
+		if (!all)
+			sr_warn("Channels out of step, padding %zu rows.", rows);
+		flush_rows(ctx, out, rows);
+	}
+}
+
 /*
  * Analog devices can have samples of different types. Since each
  * packet has only one meaning, it is restricted to having at most one
  * type of data. So they can send multiple packets for a single sample.
  * To further complicate things, they can send multiple samples in a
- * single packet.
- *
- * So we need to pull any channels of interest out of a packet and save
- * them until we have complete samples to output. Some devices make this
- * simple by sending DF_FRAME_BEGIN/DF_FRAME_END packets, the latter of which
- * signals the end of a set of samples, so we can dump things there.
- *
- * At least one driver (the demo driver) sends packets that contain parts of
- * multiple samples without wrapping them in DF_FRAME. Possibly this driver
- * is buggy, but it's also the standard for testing, so it has to be supported
- * as is.
+ * single packet, and logic and analog packets need not be of the same
+ * size.
  *
- * Many assumptions about the "shape" of the data here:
- *
- * All of the data for a channel is assumed to be in one frame;
- * otherwise the data in the second packet will overwrite the data in
- * the first packet.
+ * So the values of each column are queued separately, and a row is
+ * written out as soon as all of its columns have arrived. Anything left
+ * over is written out at the end of a frame or of the session, with the
+ * missing values left empty.
  */
 static void process_analog(struct context *ctx,
 			   const struct sr_datafeed_analog *analog)
 {
-	int ret;
 	unsigned int i, j, c, num_channels;
+	struct ctx_channel *col;
 	struct sr_analog_meaning *meaning;
 	GSList *l;
-	float *fdata = NULL;
-
-	if (!ctx->analog_samples) {
-		ctx->analog_samples = g_malloc(analog->num_samples
-			* sizeof(float) * ctx->num_analog_channels);
-		if (!ctx->num_samples)
-			ctx->num_samples = analog->num_samples;
-	}
-	if (ctx->num_samples != analog->num_samples)
-		sr_warn("Expecting %u analog samples, got %u.",
-			ctx->num_samples, analog->num_samples);
+	size_t size, len;
 
 	meaning = analog->meaning;
 	num_channels = g_slist_length(meaning->channels);
-	ctx->channels_seen += num_channels;
 	sr_dbg("Processing packet of %u analog channels", num_channels);
-	fdata = g_malloc(analog->num_samples * num_channels * sizeof(float));
-	if ((ret = sr_analog_to_float(analog, fdata)) != SR_OK)
+
+	size = analog->num_samples * num_channels;
+	if (size > ctx->fdata_size) {
+		ctx->fdata = g_realloc(ctx->fdata, size * sizeof(float));
+		ctx->fdata_size = size;
+	}
+	if (sr_analog_to_float(analog, ctx->fdata) != SR_OK)
 		sr_warn("Problems converting data to floating point values.");
 
-	for (i = 0; i < ctx->num_analog_channels + ctx->num_logic_channels; i++) {
-		if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG) {
-			sr_dbg("Looking for channel %s",
-			       ctx->channels[i].ch->name);
-			for (l = meaning->channels, c = 0; l; l = l->next, c++) {
-				struct sr_channel *ch = l->data;
-				sr_dbg("Checking %s", ch->name);
-				if (ctx->channels[i].ch == l->data) {
-					if (ctx->label_do && !ctx->label_names) {
-						sr_analog_unit_to_string(analog,
-							&ctx->channels[i].label);
-					}
-					for (j = 0; j < analog->num_samples; j++)
-						ctx->analog_samples[j * ctx->num_analog_channels + i] = fdata[j * num_channels + c];
-					break;
-				}
-			}
+	for (l = meaning->channels, c = 0; l; l = l->next, c++) {
+		for (i = 0; i < ctx->num_columns; i++) {
+			col = &ctx->channels[i];
+			if (col->ch == l->data && col->pending)
+				break;
+		}
+		if (i == ctx->num_columns)
+			continue;
+		if (ctx->label_do && !ctx->label_names && !col->label)
+			sr_analog_unit_to_string(analog, &col->label);
+
+		len = col->pending->len;
+		g_array_set_size(col->pending, len + analog->num_samples);
+		if (num_channels == 1) {
+			memcpy(&g_array_index(col->pending, float, len),
+				ctx->fdata, analog->num_samples * sizeof(float));
+		} else {
+			for (j = 0; j < analog->num_samples; j++)
+				g_array_index(col->pending, float, len + j) =
+					ctx->fdata[j * num_channels + c];
 		}
 	}
-	g_free(fdata);
 }
 
-/*
- * We treat logic packets the same as analog packets, though it's not
- * strictly required. This allows us to process mixed signals properly.
- */
-static void process_logic(struct context *ctx,
+static void process_logic(struct context *ctx, GString **out,
 			  const struct sr_datafeed_logic *logic)
 {
-	unsigned int i, j, ch, num_samples;
-	int idx;
-	uint8_t *sample;
+	struct ctx_channel *col;
+	unsigned int i, idx;
+	size_t num_samples;
+
+	if (!ctx->num_logic_channels || !logic->unitsize)
+		return;
 
 	num_samples = logic->length / logic->unitsize;
-	ctx->channels_seen += ctx->logic_channel_count;
 	sr_dbg("Logic packet had %d channels", logic->unitsize * 8);
-	if (!ctx->logic_samples) {
-		ctx->logic_samples = g_malloc(num_samples * ctx->num_logic_channels);
-		if (!ctx->num_samples)
-			ctx->num_samples = num_samples;
-	}
-	if (ctx->num_samples != num_samples)
-		sr_warn("Expecting %u samples, got %u",
-			ctx->num_samples, num_samples);
-
-	for (j = ch = 0; ch < ctx->num_logic_channels; j++) {
-		if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-			for (i = 0; i < num_samples; i++) {
-				sample = logic->data + i * logic->unitsize;
-				idx = ctx->channels[j].ch->index;
-				if (ctx->label_do && !ctx->label_names)
-					ctx->channels[j].label = "logic";
-				ctx->logic_samples[i * ctx->num_logic_channels + ch] = sample[idx / 8] & (1 << (idx % 8));
-			}
-			ch++;
+
+	if (logic->unitsize != ctx->logic_unitsize) {
+		/* Finish what's queued up in the old layout first. */
+		dump_rows(ctx, out, TRUE);
+		ctx->logic_unitsize = logic->unitsize;
+		for (i = 0; i < ctx->num_columns; i++) {
+			col = &ctx->channels[i];
+			if (col->pending)
+				continue;
+			idx = col->ch->index;
+			col->byte = idx / 8;
+			col->mask = 1 << (idx % 8);
+			if (col->byte >= logic->unitsize)
+				col->byte = col->mask = 0;
 		}
 	}
-}
-
-static void dump_saved_values(struct context *ctx, GString **out)
-{
-	unsigned int i, j, analog_size, num_channels;
-	float *analog_sample, value;
-	uint8_t *logic_sample;
 
-	/* If we haven't seen samples we're expecting, skip them. */
-	if ((ctx->num_analog_channels && !ctx->analog_samples) ||
-	    (ctx->num_logic_channels && !ctx->logic_samples)) {
-		sr_warn("Discarding partial packet");
-	} else {
-		sr_info("Dumping %u samples", ctx->num_samples);
-
-		*out = g_string_sized_new(512);
-		num_channels =
-		    ctx->num_logic_channels + ctx->num_analog_channels;
-
-		if (ctx->label_do) {
-			if (ctx->time)
-				g_string_append_printf(*out, "%s%s",
-					ctx->label_names ? "Time" :
-					ctx->xlabel, ctx->value);
-			for (i = 0; i < num_channels; i++) {
-				g_string_append_printf(*out, "%s%s",
-					ctx->channels[i].label, ctx->value);
-				if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG
-						&& ctx->label_names)
-					g_free(ctx->channels[i].label);
-			}
-			if (ctx->do_trigger)
-				g_string_append_printf(*out, "Trigger%s",
-						       ctx->value);
-			/* Drop last separator. */
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
-
-			ctx->label_do = FALSE;
-		}
+	/* Without analog columns there is nothing to wait for. */
+	if (!ctx->num_analog_channels) {
+		emit_rows(ctx, out, logic->data, num_samples, num_samples);
+		return;
+	}
 
-		analog_size = ctx->num_analog_channels * sizeof(float);
-		if (ctx->dedup && !ctx->previous_sample)
-			ctx->previous_sample = g_malloc0(analog_size + ctx->num_logic_channels);
-
-		for (i = 0; i < ctx->num_samples; i++) {
-			ctx->sample_time += ctx->period;
-			analog_sample =
-			    &ctx->analog_samples[i * ctx->num_analog_channels];
-			logic_sample =
-			    &ctx->logic_samples[i * ctx->num_logic_channels];
-
-			if (ctx->dedup) {
-				if (i > 0 && i < ctx->num_samples - 1 &&
-				    !memcmp(logic_sample, ctx->previous_sample,
-					    ctx->num_logic_channels) &&
-				    !memcmp(analog_sample,
-					    ctx->previous_sample +
-					    ctx->num_logic_channels,
-					    analog_size))
-					continue;
-				memcpy(ctx->previous_sample, logic_sample,
-				       ctx->num_logic_channels);
-				memcpy(ctx->previous_sample
-				       + ctx->num_logic_channels,
-				       analog_sample, analog_size);
-			}
+	g_byte_array_append(ctx->logic_pending, logic->data,
+		num_samples * logic->unitsize);
+}
 
-			if (ctx->time)
-				g_string_append_printf(*out, "%" PRIu64 "%s",
-					ctx->sample_time, ctx->value);
-
-			for (j = 0; j < num_channels; j++) {
-				if (ctx->channels[j].ch->type == SR_CHANNEL_ANALOG) {
-					value = ctx->analog_samples[i * ctx->num_analog_channels + j];
-					ctx->channels[j].max =
-					    fmax(value, ctx->channels[j].max);
-					ctx->channels[j].min =
-					    fmin(value, ctx->channels[j].min);
-					g_string_append_printf(*out, "%g%s",
-						value, ctx->value);
-				} else if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-					g_string_append_printf(*out, "%c%s",
-							       ctx->logic_samples[i * ctx->num_logic_channels + j] ? '1' : '0', ctx->value);
-				} else {
-					sr_warn("Unexpected channel type: %d",
-						ctx->channels[i].ch->type);
-				}
-			}
+/*
+ * Account the reorder buffer against the session's memory budget. It is
+ * bounded by REORDER_MAX_ROWS, rows are never cut short to save memory.
+ */
+static void account_pending(const struct sr_output *o, struct context *ctx)
+{
+	size_t size;
+	unsigned int i;
 
-			if (ctx->do_trigger) {
-				g_string_append_printf(*out, "%d%s",
-					ctx->trigger, ctx->value);
-				ctx->trigger = FALSE;
-			}
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
-		}
+	size = ctx->logic_pending->len;
+	for (i = 0; i < ctx->num_columns; i++) {
+		if (ctx->channels[i].pending)
+			size += ctx->channels[i].pending->len * sizeof(float);
 	}
-
-	/* Discard all of the working space. */
-	g_free(ctx->previous_sample);
-	g_free(ctx->analog_samples);
-	g_free(ctx->logic_samples);
-	ctx->channels_seen = 0;
-	ctx->num_samples = 0;
-	ctx->previous_sample = NULL;
-	ctx->analog_samples = NULL;
-	ctx->logic_samples = NULL;
+	sr_session_memory_account(o->sdi->session,
+		(int64_t)size - (int64_t)ctx->accounted);
+	ctx->accounted = size;
 }
 
 static void save_gnuplot(struct context *ctx)
@@ -568,29 +735,34 @@ static int receive(const struct sr_output *o,
 		*out = gen_header(o, packet->payload);
 		break;
 	case SR_DF_TRIGGER:
+		/* The trigger applies to the next sample that comes in. */
 		ctx->trigger = TRUE;
+		ctx->trigger_row = ctx->rows_out + (ctx->num_logic_channels ?
+			logic_pending_rows(ctx) : pending_rows(ctx, FALSE));
 		break;
 	case SR_DF_LOGIC:
-		process_logic(ctx, packet->payload);
+		process_logic(ctx, out, packet->payload);
+		dump_rows(ctx, out, FALSE);
 		break;
 	case SR_DF_ANALOG:
 		process_analog(ctx, packet->payload);
+		dump_rows(ctx, out, FALSE);
 		break;
 	case SR_DF_FRAME_BEGIN:
-		*out = g_string_new(ctx->frame);
-		/* Fallthrough */
+		/* Got to end of frame with part of the data. */
+		dump_rows(ctx, out, TRUE);
+		if (!*out)
+			*out = g_string_sized_new(512);
+		g_string_append(*out, ctx->frame);
+		break;
 	case SR_DF_END:
-		/* Got to end of frame/session with part of the data. */
-		if (ctx->channels_seen)
-			ctx->channels_seen = ctx->channel_count;
+		/* Got to end of session with part of the data. */
+		dump_rows(ctx, out, TRUE);
 		if (*ctx->gnuplot)
 			save_gnuplot(ctx);
 		break;
 	}
-
-	/* If we've got them all, dump the values. */
-	if (ctx->channels_seen >= ctx->channel_count)
-		dump_saved_values(ctx, out);
+	account_pending(o, ctx);
 
 	return SR_OK;
 }
@@ -598,18 +770,32 @@ static int receive(const struct sr_output *o,
 static int cleanup(struct sr_output *o)
 {
 	struct context *ctx;
+	unsigned int i;
 
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 
 	if (o->priv) {
 		ctx = o->priv;
+		sr_session_memory_account(o->sdi->session,
+			-(int64_t)ctx->accounted);
 		g_free((gpointer)ctx->record);
 		g_free((gpointer)ctx->frame);
 		g_free((gpointer)ctx->comment);
 		g_free((gpointer)ctx->gnuplot);
 		g_free((gpointer)ctx->value);
-		g_free(ctx->previous_sample);
+		for (i = 0; i < ctx->num_columns; i++) {
+			if (!ctx->channels[i].pending)
+				continue;
+			g_array_free(ctx->channels[i].pending, TRUE);
+			/* Unit labels are allocated, channel names are not. */
+			if (!ctx->label_names)
+				g_free(ctx->channels[i].label);
+		}
+		g_byte_array_free(ctx->logic_pending, TRUE);
+		g_free(ctx->fdata);
+		g_free(ctx->row);
+		g_free(ctx->prev_row);
 		g_free(ctx->channels);
 		g_free(o->priv);
 		o->priv = NULL;
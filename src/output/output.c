@@ -64,6 +64,7 @@ extern SR_PRIV struct sr_output_module output_csv;
 extern SR_PRIV struct sr_output_module output_analog;
 extern SR_PRIV struct sr_output_module output_srzip;
 extern SR_PRIV struct sr_output_module output_wav;
+extern SR_PRIV struct sr_output_module output_stream;
 /* @endcond */
 
 static const struct sr_output_module *output_module_list[] = {
@@ -78,6 +79,7 @@ static const struct sr_output_module *output_module_list[] = {
 	&output_analog,
 	&output_srzip,
 	&output_wav,
+	&output_stream,
 	NULL,
 };
 
@@ -321,17 +323,60 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 	return op;
 }
 
+/*
+ * Hand the planes of an SR_DF_ANALOG_PLANAR packet to the module as
+ * separate SR_DF_ANALOG packets. Each plane already is a complete analog
+ * payload, so this does not touch the sample data.
+ */
+static int output_send_planar(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, GString **out)
+{
+	const struct sr_datafeed_analog_planar *planar;
+	struct sr_datafeed_packet plane_packet;
+	GString *plane_out;
+	unsigned int i;
+	int ret;
+
+	planar = packet->payload;
+	plane_packet.type = SR_DF_ANALOG;
+	*out = NULL;
+	for (i = 0; i < planar->num_planes; i++) {
+		plane_packet.payload = &planar->planes[i];
+		plane_out = NULL;
+		ret = o->module->receive(o, &plane_packet, &plane_out);
+		if (plane_out) {
+			if (*out) {
+				g_string_append_len(*out, plane_out->str,
+						plane_out->len);
+				g_string_free(plane_out, TRUE);
+			} else {
+				*out = plane_out;
+			}
+		}
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
 /**
  * Send a packet to the specified output instance.
  *
  * The instance's output is returned as a newly allocated GString,
  * which must be freed by the caller.
  *
+ * SR_DF_ANALOG_PLANAR packets are passed to the output module one plane
+ * at a time, as SR_DF_ANALOG packets.
+ *
  * @since 0.4.0
  */
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out)
 {
+	if (packet->type == SR_DF_ANALOG_PLANAR)
+		return output_send_planar(o, packet, out);
+
 	return o->module->receive(o, packet, out);
 }
 
@@ -356,4 +401,33 @@ SR_API int sr_output_free(const struct sr_output *o)
 	return ret;
 }
 
+/**
+ * Transpose packed logic samples into one bit plane per channel.
+ *
+ * Byte k of a channel's plane holds the channel's values in samples
+ * 8k to 8k+7, with the earliest sample in the least significant bit.
+ * Full groups of 8 samples are transposed 8x8 bits at a time; the unused
+ * bits of a partial last group are cleared.
+ *
+ * @param data The packed samples.
+ * @param unitsize The size of one sample in bytes.
+ * @param num_samples The number of samples in data.
+ * @param channel_index The channel indices (bit positions within a
+ *                      sample) of the planes to generate.
+ * @param num_channels The number of entries in channel_index.
+ * @param planes Memory for num_channels planes of stride bytes each.
+ * @param stride The distance between planes, at least
+ *               (num_samples + 7) / 8 bytes.
+ *
+ * @private
+ */
+SR_PRIV void sr_output_logic_to_planes(const uint8_t *data,
+		unsigned int unitsize, uint64_t num_samples,
+		const int *channel_index, unsigned int num_channels,
+		uint8_t *planes, size_t stride)
+{
+	sr_simd_get()->logic_to_planes(data, unitsize, num_samples,
+		channel_index, num_channels, planes, stride);
+}
+
 /** @} */
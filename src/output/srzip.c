@@ -35,6 +35,17 @@ struct out_context {
 	char *filename;
 	gint first_analog_index;
 	gint *analog_index_map;
+	/* Summary for the "index" archive member. */
+	gboolean has_logic;
+	unsigned int unitsize;
+	uint64_t logic_samples;
+	uint64_t analog_samples;
+	int64_t trigger_pos;
+	GByteArray *index_channels;
+	uint32_t num_index_channels;
+	GByteArray *index_chunks;
+	uint32_t num_index_chunks;
+	gboolean index_written;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -50,11 +61,121 @@ static int init(struct sr_output *o, GHashTable *options)
 
 	outc = g_malloc0(sizeof(struct out_context));
 	outc->filename = g_strdup(o->filename);
+	outc->trigger_pos = -1;
+	outc->index_channels = g_byte_array_new();
+	outc->index_chunks = g_byte_array_new();
 	o->priv = outc;
 
 	return SR_OK;
 }
 
+static void index_add_name(GByteArray *a, const char *name)
+{
+	uint8_t buf[4];
+	size_t len;
+
+	len = strlen(name);
+	WL32(buf, len);
+	g_byte_array_append(a, buf, sizeof(buf));
+	g_byte_array_append(a, (const guint8 *)name, len);
+}
+
+static void index_add_channel(struct out_context *outc, int index,
+		int type, const char *name)
+{
+	uint8_t buf[8];
+
+	WL32(buf, index);
+	WL32(buf + 4, type);
+	g_byte_array_append(outc->index_channels, buf, sizeof(buf));
+	index_add_name(outc->index_channels, name);
+	outc->num_index_channels++;
+}
+
+static void index_add_chunk(struct out_context *outc, const char *basename,
+		unsigned int chunk_num, uint64_t num_samples)
+{
+	uint8_t buf[8];
+	char *name;
+
+	WL64(buf, num_samples);
+	g_byte_array_append(outc->index_chunks, buf, sizeof(buf));
+	name = g_strdup_printf("%s-%u", basename, chunk_num);
+	index_add_name(outc->index_chunks, name);
+	g_free(name);
+	outc->num_index_chunks++;
+}
+
+/* Data added after the index was written makes it stale. */
+static void index_invalidate(struct out_context *outc, struct zip *archive)
+{
+	zip_int64_t idx;
+
+	if (!outc->index_written)
+		return;
+	if ((idx = zip_name_locate(archive, "index", 0)) >= 0)
+		zip_delete(archive, idx);
+	outc->index_written = FALSE;
+}
+
+static int zip_write_index(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct zip *archive;
+	struct zip_source *indexsrc;
+	zip_int64_t idx;
+	uint8_t *buf, *p;
+	size_t len;
+	int ret;
+
+	outc = o->priv;
+
+	len = SR_SESSIONFILE_INDEX_HDR_SIZE + outc->index_channels->len
+		+ outc->index_chunks->len;
+	p = buf = g_malloc(len);
+	memcpy(p, SR_SESSIONFILE_INDEX_MAGIC, SR_SESSIONFILE_INDEX_MAGIC_SIZE);
+	p += SR_SESSIONFILE_INDEX_MAGIC_SIZE;
+	WL64(p, outc->samplerate);
+	WL64(p + 8, outc->has_logic ? outc->logic_samples : outc->analog_samples);
+	WL64(p + 16, outc->trigger_pos < 0 ? UINT64_MAX :
+		(uint64_t)outc->trigger_pos);
+	WL32(p + 24, outc->unitsize);
+	WL32(p + 28, outc->num_index_channels);
+	WL32(p + 32, outc->num_index_chunks);
+	p = buf + SR_SESSIONFILE_INDEX_HDR_SIZE;
+	memcpy(p, outc->index_channels->data, outc->index_channels->len);
+	p += outc->index_channels->len;
+	memcpy(p, outc->index_chunks->data, outc->index_chunks->len);
+
+	if (!(archive = zip_open(outc->filename, 0, NULL))) {
+		g_free(buf);
+		return SR_ERR;
+	}
+
+	indexsrc = zip_source_buffer(archive, buf, len, FALSE);
+	if ((idx = zip_name_locate(archive, "index", 0)) >= 0)
+		ret = zip_replace(archive, idx, indexsrc);
+	else
+		ret = zip_add(archive, "index", indexsrc);
+	if (ret < 0) {
+		sr_err("Failed to add index: %s", zip_strerror(archive));
+		zip_source_free(indexsrc);
+		zip_discard(archive);
+		g_free(buf);
+		return SR_ERR;
+	}
+	if (zip_close(archive) < 0) {
+		sr_err("Error saving session file: %s", zip_strerror(archive));
+		zip_discard(archive);
+		g_free(buf);
+		return SR_ERR;
+	}
+	g_free(buf);
+	outc->index_written = TRUE;
+
+	return SR_OK;
+}
+
 static int zip_create(const struct sr_output *o)
 {
 	struct out_context *outc;
@@ -128,6 +249,7 @@ static int zip_create(const struct sr_output *o)
 		outc->first_analog_index = 1;
 
 	/* Only set capturefile and probes if we will actually save logic data. */
+	outc->has_logic = enabled_logic_channels > 0;
 	if (enabled_logic_channels > 0) {
 		g_key_file_set_string(meta, devgroup, "capturefile", "logic-1");
 		g_key_file_set_integer(meta, devgroup, "total probes", logic_channels);
@@ -153,10 +275,13 @@ static int zip_create(const struct sr_output *o)
 		switch (ch->type) {
 		case SR_CHANNEL_LOGIC:
 			s = g_strdup_printf("probe%d", ch->index + 1);
+			index_add_channel(outc, ch->index, ch->type, ch->name);
 			break;
 		case SR_CHANNEL_ANALOG:
 			outc->analog_index_map[index] = ch->index;
 			s = g_strdup_printf("analog%d", outc->first_analog_index + index);
+			index_add_channel(outc, outc->first_analog_index + index - 1,
+				ch->type, ch->name);
 			index++;
 			break;
 		}
@@ -253,6 +378,8 @@ static int zip_append(const struct sr_output *o, unsigned char *buf,
 	}
 	g_key_file_free(kf);
 
+	index_invalidate(outc, archive);
+
 	next_chunk_num = 1;
 	num_files = zip_get_num_entries(archive, 0);
 	for (i = 0; i < num_files; i++) {
@@ -305,6 +432,10 @@ static int zip_append(const struct sr_output *o, unsigned char *buf,
 	}
 	g_free(metabuf);
 
+	outc->unitsize = unitsize;
+	outc->logic_samples += length / unitsize;
+	index_add_chunk(outc, "logic-1", next_chunk_num, length / unitsize);
+
 	return SR_OK;
 }
 
@@ -354,6 +485,8 @@ static int zip_append_analog(const struct sr_output *o,
 		goto err_zip_discard;
 	}
 
+	index_invalidate(outc, archive);
+
 	basename = g_strdup_printf("analog-1-%u", index);
 	baselen = strlen(basename);
 	next_chunk_num = 1;
@@ -390,6 +523,10 @@ static int zip_append_analog(const struct sr_output *o,
 		goto err_free_chunkbuf;
 	}
 
+	if (index == (unsigned int)outc->first_analog_index)
+		outc->analog_samples += analog->num_samples;
+	index_add_chunk(outc, basename, next_chunk_num, analog->num_samples);
+
 	g_free(basename);
 	g_free(chunkbuf);
 
@@ -453,6 +590,15 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		if (ret != SR_OK)
 			return ret;
 		break;
+	case SR_DF_TRIGGER:
+		if (outc->trigger_pos < 0)
+			outc->trigger_pos = outc->has_logic ?
+				outc->logic_samples : outc->analog_samples;
+		break;
+	case SR_DF_END:
+		if (outc->zip_created)
+			return zip_write_index(o);
+		break;
 	}
 
 	return SR_OK;
@@ -477,6 +623,8 @@ static int cleanup(struct sr_output *o)
 	outc = o->priv;
 	g_variant_unref(options[0].def);
 	g_free(outc->analog_index_map);
+	g_byte_array_free(outc->index_channels, TRUE);
+	g_byte_array_free(outc->index_chunks, TRUE);
 	g_free(outc->filename);
 	g_free(outc);
 	o->priv = NULL;
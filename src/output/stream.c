@@ -0,0 +1,493 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Serializes the complete datafeed into the binary stream format described
+ * in libsigrok-internal.h, so that a live acquisition can be forwarded to
+ * another process or host and fed into the "stream" input module there.
+ *
+ * Without the "socket" option the framed data is returned to the caller
+ * like any other output module's text. With "unix/<path>" or
+ * "tcp/<host>/<port>" the module connects by itself, batches small frames
+ * and passes large sample payloads to the kernel straight from the packet
+ * buffers (scatter/gather I/O), without copying them first.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <glib.h>
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "output/stream"
+
+#define DEFAULT_BATCH_SIZE	(64 * 1024)
+
+/* Payloads smaller than this are copied into the batch buffer. */
+#define COPY_THRESHOLD		4096
+
+#define ANALOG_HDR_SIZE		60
+
+struct context {
+	int fd;
+	uint64_t batch_size;
+	gboolean header_done;
+	GString *pending;
+};
+
+#ifndef _WIN32
+static int connect_unix(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		sr_err("Socket path too long: %s", path);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int connect_tcp(const char *address, const char *port)
+{
+	struct addrinfo hints;
+	struct addrinfo *results, *res;
+	int fd, err;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	err = getaddrinfo(address, port, &hints, &results);
+	if (err) {
+		sr_err("Address lookup failed: %s:%s: %s", address, port,
+			gai_strerror(err));
+		return -1;
+	}
+
+	fd = -1;
+	for (res = results; res; res = res->ai_next) {
+		if ((fd = socket(res->ai_family, res->ai_socktype,
+				res->ai_protocol)) < 0)
+			continue;
+		if (connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+			close(fd);
+			fd = -1;
+			continue;
+		}
+		break;
+	}
+	freeaddrinfo(results);
+
+	return fd;
+}
+#endif
+
+static int open_socket(const char *spec)
+{
+#ifndef _WIN32
+	char **params, **hostport;
+	int fd;
+
+	params = g_strsplit(spec, "/", 2);
+	fd = -1;
+	if (!params[0] || !params[1]) {
+		sr_err("Invalid socket specification '%s'.", spec);
+	} else if (!strcmp(params[0], "unix")) {
+		fd = connect_unix(params[1]);
+	} else if (!strcmp(params[0], "tcp")) {
+		hostport = g_strsplit(params[1], "/", 2);
+		if (hostport[0] && hostport[1])
+			fd = connect_tcp(hostport[0], hostport[1]);
+		else
+			sr_err("Invalid socket specification '%s'.", spec);
+		g_strfreev(hostport);
+	} else {
+		sr_err("Unknown socket type '%s'.", params[0]);
+	}
+	g_strfreev(params);
+
+	if (fd < 0)
+		sr_err("Failed to connect to %s: %s", spec, g_strerror(errno));
+
+	return fd;
+#else
+	sr_err("Socket output is not supported on this platform.");
+	(void)spec;
+	return -1;
+#endif
+}
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct context *ctx;
+	const char *spec;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+
+	ctx = g_malloc0(sizeof(struct context));
+	ctx->fd = -1;
+	ctx->batch_size = g_variant_get_uint64(
+			g_hash_table_lookup(options, "batchsize"));
+
+	spec = g_variant_get_string(g_hash_table_lookup(options, "socket"), NULL);
+	if (spec && spec[0]) {
+		if ((ctx->fd = open_socket(spec)) < 0) {
+			g_free(ctx);
+			return SR_ERR_IO;
+		}
+	}
+	ctx->pending = g_string_sized_new(MAX(ctx->batch_size, COPY_THRESHOLD) * 2);
+	o->priv = ctx;
+
+	return SR_OK;
+}
+
+/*
+ * Write the pending batch and an optional extra buffer to the socket,
+ * in a single system call where possible.
+ */
+static int flush_pending(struct context *ctx, const void *extra, size_t extra_len)
+{
+#ifndef _WIN32
+	struct iovec iov[2];
+	struct msghdr msg;
+	ssize_t ret;
+	int iovcnt, flags;
+
+	iov[0].iov_base = ctx->pending->str;
+	iov[0].iov_len = ctx->pending->len;
+	iov[1].iov_base = (void *)extra;
+	iov[1].iov_len = extra_len;
+	iovcnt = 2;
+
+	memset(&msg, 0, sizeof(msg));
+	flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+	while (iov[0].iov_len + iov[1].iov_len > 0) {
+		msg.msg_iov = (iov[0].iov_len > 0) ? &iov[0] : &iov[1];
+		msg.msg_iovlen = (iov[0].iov_len > 0) ? iovcnt : 1;
+		ret = sendmsg(ctx->fd, &msg, flags);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			sr_err("Failed to send data: %s", g_strerror(errno));
+			g_string_truncate(ctx->pending, 0);
+			return SR_ERR_IO;
+		}
+		/* Advance over whatever was written, possibly partially. */
+		if ((size_t)ret >= iov[0].iov_len) {
+			ret -= iov[0].iov_len;
+			iov[0].iov_len = 0;
+			iov[1].iov_base = (uint8_t *)iov[1].iov_base + ret;
+			iov[1].iov_len -= ret;
+		} else {
+			iov[0].iov_base = (uint8_t *)iov[0].iov_base + ret;
+			iov[0].iov_len -= ret;
+		}
+	}
+	g_string_truncate(ctx->pending, 0);
+
+	return SR_OK;
+#else
+	(void)ctx;
+	(void)extra;
+	(void)extra_len;
+	return SR_ERR_NA;
+#endif
+}
+
+/*
+ * Queue a frame consisting of a small, fixed part and an optional bulk
+ * data part. Bulk data is only copied if it is small, or if the output is
+ * returned as a string.
+ */
+static int queue_frame(struct context *ctx, uint16_t type,
+		const void *hdr, size_t hdr_len, const void *data, size_t data_len)
+{
+	uint8_t fhdr[SR_STREAM_FRAME_HDR_SIZE];
+
+	WL32(&fhdr[0], hdr_len + data_len);
+	WL16(&fhdr[4], type);
+	WL16(&fhdr[6], 0);
+	g_string_append_len(ctx->pending, (const char *)fhdr, sizeof(fhdr));
+	if (hdr_len)
+		g_string_append_len(ctx->pending, hdr, hdr_len);
+	if (!data_len)
+		return SR_OK;
+
+	if (ctx->fd < 0 || data_len < COPY_THRESHOLD) {
+		g_string_append_len(ctx->pending, data, data_len);
+		return SR_OK;
+	}
+
+	return flush_pending(ctx, data, data_len);
+}
+
+static void queue_device(const struct sr_output *o)
+{
+	struct context *ctx;
+	struct sr_channel *ch;
+	GString *table;
+	GSList *l;
+	uint8_t buf[10];
+	size_t namelen;
+
+	ctx = o->priv;
+	table = g_string_sized_new(256);
+	WL32(buf, g_slist_length(o->sdi->channels));
+	g_string_append_len(table, (const char *)buf, 4);
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		namelen = MIN(strlen(ch->name), 255);
+		WL32(&buf[0], ch->index);
+		WL32(&buf[4], ch->type);
+		buf[8] = ch->enabled ? 1 : 0;
+		buf[9] = namelen;
+		g_string_append_len(table, (const char *)buf, 10);
+		g_string_append_len(table, ch->name, namelen);
+	}
+
+	g_string_append_len(ctx->pending, SR_STREAM_MAGIC, SR_STREAM_MAGIC_SIZE);
+	queue_frame(ctx, SR_STREAM_FRAME_DEVICE, table->str, table->len, NULL, 0);
+	g_string_free(table, TRUE);
+}
+
+static int queue_meta(struct context *ctx, const struct sr_datafeed_meta *meta)
+{
+	const struct sr_config *src;
+	GVariantBuilder gvb;
+	GVariant *gvar, *normal;
+	GSList *l;
+	gsize len;
+	uint8_t *buf;
+	int ret;
+
+	g_variant_builder_init(&gvb, G_VARIANT_TYPE("a(uv)"));
+	for (l = meta->config; l; l = l->next) {
+		src = l->data;
+		g_variant_builder_add(&gvb, "(uv)", src->key, src->data);
+	}
+	gvar = g_variant_ref_sink(g_variant_builder_end(&gvb));
+	normal = g_variant_get_normal_form(gvar);
+	g_variant_unref(gvar);
+	/* The wire format is little endian. */
+	if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+		gvar = normal;
+		normal = g_variant_byteswap(gvar);
+		g_variant_unref(gvar);
+	}
+	len = g_variant_get_size(normal);
+	buf = g_malloc(len);
+	g_variant_store(normal, buf);
+	g_variant_unref(normal);
+
+	ret = queue_frame(ctx, SR_DF_META, buf, len, NULL, 0);
+	g_free(buf);
+
+	return ret;
+}
+
+static int queue_analog(struct context *ctx,
+		const struct sr_datafeed_analog *analog)
+{
+	const struct sr_analog_encoding *enc;
+	const struct sr_analog_meaning *meaning;
+	const struct sr_channel *ch;
+	uint8_t *hdr, *p;
+	GSList *l;
+	size_t hdr_len;
+	guint num_channels;
+	int ret;
+
+	enc = analog->encoding;
+	meaning = analog->meaning;
+	num_channels = g_slist_length(meaning->channels);
+	hdr_len = ANALOG_HDR_SIZE + 4 * num_channels;
+	hdr = g_malloc(hdr_len);
+
+	WL32(&hdr[0], analog->num_samples);
+	hdr[4] = enc->unitsize;
+	hdr[5] = enc->is_signed ? 1 : 0;
+	hdr[6] = enc->is_float ? 1 : 0;
+	hdr[7] = enc->is_bigendian ? 1 : 0;
+	hdr[8] = (uint8_t)enc->digits;
+	hdr[9] = enc->is_digits_decimal ? 1 : 0;
+	hdr[10] = analog->spec ? (uint8_t)analog->spec->spec_digits : 0;
+	hdr[11] = 0;
+	WL64(&hdr[12], enc->scale.p);
+	WL64(&hdr[20], enc->scale.q);
+	WL64(&hdr[28], enc->offset.p);
+	WL64(&hdr[36], enc->offset.q);
+	WL32(&hdr[44], meaning->mq);
+	WL32(&hdr[48], meaning->unit);
+	WL32(&hdr[52], meaning->mqflags);
+	WL32(&hdr[56], num_channels);
+	p = &hdr[ANALOG_HDR_SIZE];
+	for (l = meaning->channels; l; l = l->next) {
+		ch = l->data;
+		WL32(p, ch->index);
+		p += 4;
+	}
+
+	ret = queue_frame(ctx, SR_DF_ANALOG, hdr, hdr_len, analog->data,
+			(size_t)analog->num_samples * MAX(num_channels, 1) * enc->unitsize);
+	g_free(hdr);
+
+	return ret;
+}
+
+static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
+		GString **out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_header *header;
+	const struct sr_datafeed_logic *logic;
+	uint8_t buf[20];
+	int ret;
+
+	*out = NULL;
+	if (!o || !o->sdi || !(ctx = o->priv))
+		return SR_ERR_ARG;
+
+	if (!ctx->header_done) {
+		queue_device(o);
+		ctx->header_done = TRUE;
+	}
+
+	ret = SR_OK;
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		header = packet->payload;
+		WL32(&buf[0], header->feed_version);
+		WL64(&buf[4], header->starttime.tv_sec);
+		WL64(&buf[12], header->starttime.tv_usec);
+		ret = queue_frame(ctx, packet->type, buf, 20, NULL, 0);
+		break;
+	case SR_DF_META:
+		ret = queue_meta(ctx, packet->payload);
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		WL16(&buf[0], logic->unitsize);
+		ret = queue_frame(ctx, packet->type, buf, 2,
+				logic->data, logic->length);
+		break;
+	case SR_DF_ANALOG:
+		ret = queue_analog(ctx, packet->payload);
+		break;
+	case SR_DF_END:
+	case SR_DF_TRIGGER:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
+		ret = queue_frame(ctx, packet->type, NULL, 0, NULL, 0);
+		break;
+	default:
+		sr_dbg("Not forwarding unknown packet type %d.", packet->type);
+		break;
+	}
+	if (ret != SR_OK)
+		return ret;
+
+	if (ctx->fd < 0) {
+		if (ctx->pending->len) {
+			*out = ctx->pending;
+			ctx->pending = g_string_sized_new(COPY_THRESHOLD * 2);
+		}
+	} else if (ctx->pending->len >= ctx->batch_size
+			|| packet->type == SR_DF_END) {
+		ret = flush_pending(ctx, NULL, 0);
+	}
+
+	return ret;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct context *ctx;
+
+	if (!o)
+		return SR_ERR_ARG;
+
+	if (!(ctx = o->priv))
+		return SR_OK;
+
+	if (ctx->fd >= 0) {
+		if (ctx->pending->len)
+			flush_pending(ctx, NULL, 0);
+		close(ctx->fd);
+	}
+	g_string_free(ctx->pending, TRUE);
+	g_free(ctx);
+	o->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "socket", "Socket", "Socket to send to (unix/<path> or tcp/<host>/<port>)", NULL, NULL },
+	{ "batchsize", "Batch size", "Number of bytes to collect before sending (0 sends every packet)", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_string(""));
+		options[1].def = g_variant_ref_sink(g_variant_new_uint64(DEFAULT_BATCH_SIZE));
+	}
+
+	return options;
+}
+
+SR_PRIV struct sr_output_module output_stream = {
+	.id = "stream",
+	.name = "Stream",
+	.desc = "Binary datafeed stream (to a file or socket)",
+	.exts = (const char*[]){"srs", NULL},
+	.flags = 0,
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
@@ -120,7 +120,7 @@ static GSList *scpi_usbtmc_libusb_scan(struct drv_context *drvc)
 	int confidx, intfidx, ret, i;
 	char *res;
 
-	ret = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	ret = libusb_get_device_list(sr_usb_context(drvc->sr_ctx), &devlist);
 	if (ret < 0) {
 		sr_err("Failed to get device list: %s.",
 		       libusb_error_name(ret));
@@ -175,7 +175,7 @@ static int scpi_usbtmc_libusb_dev_inst_new(void *priv, struct drv_context *drvc,
 	}
 
 	uscpi->ctx = drvc->sr_ctx;
-	devices = sr_usb_find(uscpi->ctx->libusb_ctx, params[1]);
+	devices = sr_usb_find(sr_usb_context(uscpi->ctx), params[1]);
 	if (g_slist_length(devices) != 1) {
 		sr_err("Failed to find USB device '%s'.", params[1]);
 		g_slist_free_full(devices, (GDestroyNotify)sr_usb_dev_inst_free);
@@ -294,7 +294,7 @@ static int scpi_usbtmc_libusb_open(struct sr_scpi_dev_inst *scpi)
 	if (usb->devhdl)
 		return SR_OK;
 
-	if (sr_usb_open(uscpi->ctx->libusb_ctx, usb) != SR_OK)
+	if (sr_usb_open(sr_usb_context(uscpi->ctx), usb) != SR_OK)
 		return SR_ERR;
 
 	dev = libusb_get_device(usb->devhdl);
@@ -24,7 +24,11 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -51,6 +55,14 @@ struct datafeed_callback {
 	void *cb_data;
 };
 
+/* A buffer allocated by sr_session_malloc(). */
+struct session_buffer {
+	void *ptr;
+	size_t size;
+	/* Backed by a temporary file, not accounted against the budget. */
+	gboolean spilled;
+};
+
 /** Custom GLib event source for generic descriptor I/O.
  * @see https://developer.gnome.org/glib/stable/glib-The-Main-Event-Loop.html
  * @internal
@@ -224,6 +236,8 @@ SR_API int sr_session_new(struct sr_context *ctx,
 	session->ctx = ctx;
 
 	g_mutex_init(&session->main_mutex);
+	g_mutex_init(&session->mem_mutex);
+	session->usb_thread_cpu = -1;
 
 	/* To maintain API compatibility, we need a lookup table
 	 * which maps poll_object IDs to GSource* pointers.
@@ -258,9 +272,21 @@ SR_API int sr_session_destroy(struct sr_session *session)
 
 	sr_session_datafeed_callback_remove_all(session);
 
+	/* The recorder's buffers are session buffers. */
+	sr_session_recorder_free(session->recorder);
+
 	g_hash_table_unref(session->event_sources);
 
+	if (session->mem_buffers) {
+		if (g_hash_table_size(session->mem_buffers))
+			sr_warn("%u session buffers were not freed.",
+				g_hash_table_size(session->mem_buffers));
+		g_hash_table_unref(session->mem_buffers);
+	}
+	g_free(session->mem_spill_dir);
+
 	g_mutex_clear(&session->main_mutex);
+	g_mutex_clear(&session->mem_mutex);
 
 	g_free(session);
 
@@ -543,6 +569,337 @@ SR_API int sr_session_trigger_set(struct sr_session *session, struct sr_trigger
 	return SR_OK;
 }
 
+/**
+ * Set whether the datafeed callbacks of this session accept planar analog
+ * packets.
+ *
+ * If enabled, SR_DF_ANALOG_PLANAR packets are passed on to the datafeed
+ * callbacks as they are. Otherwise (the default), each plane of such a
+ * packet is passed on as a separate SR_DF_ANALOG packet.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param enable TRUE if the datafeed callbacks handle SR_DF_ANALOG_PLANAR.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_analog_planar_set(struct sr_session *session,
+		gboolean enable)
+{
+	if (!session)
+		return SR_ERR_ARG;
+
+	session->analog_planar = enable;
+
+	return SR_OK;
+}
+
+/**
+ * Set a memory budget for the acquisition buffers of this session.
+ *
+ * Drivers, triggers and output modules allocate or account their large
+ * buffers against the session's budget.
+ * Allocations that would exceed the budget fail, unless a spill directory
+ * is set, see sr_session_memory_spill_dir_set().
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param budget The budget in bytes, or 0 for no limit (the default).
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_memory_budget_set(struct sr_session *session,
+		uint64_t budget)
+{
+	if (!session)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&session->mem_mutex);
+	session->mem_budget = budget;
+	g_mutex_unlock(&session->mem_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Set a directory for buffers that do not fit into the memory budget.
+ *
+ * Buffer allocations that would exceed the session's memory budget are
+ * then backed by a memory mapped temporary file in this directory, and
+ * are not accounted against the budget. The file is removed right away,
+ * so it does not outlive the buffer. This is not supported on Windows.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param dir The directory, or NULL to not spill buffers (the default).
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA Not supported on this platform.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_memory_spill_dir_set(struct sr_session *session,
+		const char *dir)
+{
+	if (!session)
+		return SR_ERR_ARG;
+
+#ifdef _WIN32
+	if (dir)
+		return SR_ERR_NA;
+#endif
+
+	g_mutex_lock(&session->mem_mutex);
+	g_free(session->mem_spill_dir);
+	session->mem_spill_dir = g_strdup(dir);
+	g_mutex_unlock(&session->mem_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Get the memory budget of this session and the memory accounted
+ * against it.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param used Will be set to the number of bytes in use. May be NULL.
+ * @param budget Will be set to the budget in bytes, 0 for no limit.
+ *               May be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_memory_usage_get(struct sr_session *session,
+		uint64_t *used, uint64_t *budget)
+{
+	if (!session)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&session->mem_mutex);
+	if (used)
+		*used = session->mem_used;
+	if (budget)
+		*budget = session->mem_budget;
+	g_mutex_unlock(&session->mem_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Service libusb events on a thread of their own during acquisitions.
+ *
+ * USB transfers then complete and get resubmitted without waiting for
+ * the session's other event sources and datafeed callbacks. The data
+ * is handed over to the session's main loop, which still runs all
+ * datafeed callbacks, in order. The setting takes effect for
+ * acquisitions started afterwards.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param enable TRUE to use an event thread for USB devices.
+ * @param priority SCHED_FIFO priority (1-99) of the thread, or 0 to keep
+ *                 the default scheduling. May need privileges.
+ * @param cpu The CPU to pin the thread to, or -1 for any CPU.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA libsigrok was built without USB support.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_usb_event_thread_set(struct sr_session *session,
+		gboolean enable, int priority, int cpu)
+{
+	if (!session || priority < 0 || priority > 99 || cpu < -1)
+		return SR_ERR_ARG;
+
+#ifndef HAVE_LIBUSB_1_0
+	if (enable)
+		return SR_ERR_NA;
+#endif
+
+	session->usb_thread_enabled = enable;
+	session->usb_thread_priority = priority;
+	session->usb_thread_cpu = cpu;
+
+	return SR_OK;
+}
+
+static void *spill_alloc(const char *dir, size_t size)
+{
+#ifdef _WIN32
+	(void)dir;
+	(void)size;
+
+	return NULL;
+#else
+	char *path;
+	void *ptr;
+	int fd;
+
+	path = g_build_filename(dir, "sigrok-XXXXXX", NULL);
+	fd = g_mkstemp(path);
+	if (fd < 0) {
+		sr_err("Failed to create spill file %s: %s", path,
+			g_strerror(errno));
+		g_free(path);
+		return NULL;
+	}
+	unlink(path);
+	g_free(path);
+
+	ptr = NULL;
+	if (ftruncate(fd, size) == 0) {
+		ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (ptr == MAP_FAILED)
+			ptr = NULL;
+	}
+	if (!ptr)
+		sr_err("Failed to map spill file: %s", g_strerror(errno));
+	close(fd);
+
+	return ptr;
+#endif
+}
+
+static void session_buffer_free(struct session_buffer *buf)
+{
+#ifndef _WIN32
+	if (buf->spilled)
+		munmap(buf->ptr, buf->size);
+	else
+#endif
+		g_free(buf->ptr);
+	g_free(buf);
+}
+
+/**
+ * Allocate a buffer, accounting it against the session's memory budget.
+ *
+ * If the buffer does not fit into the budget and the session has a spill
+ * directory, the buffer is backed by a temporary file instead.
+ *
+ * @param session The session, or NULL for a plain allocation.
+ * @param size The size of the buffer in bytes.
+ *
+ * @return The buffer, or NULL if it could not be allocated or does not
+ *         fit into the budget. It must be freed with sr_session_free()
+ *         for the same session.
+ *
+ * @private
+ */
+SR_PRIV void *sr_session_malloc(struct sr_session *session, size_t size)
+{
+	struct session_buffer *buf;
+	void *ptr;
+
+	if (!session)
+		return g_try_malloc(size);
+	if (!size)
+		return NULL;
+
+	g_mutex_lock(&session->mem_mutex);
+
+	ptr = NULL;
+	buf = g_malloc0(sizeof(*buf));
+	buf->size = size;
+	if (!session->mem_budget
+			|| session->mem_used + size <= session->mem_budget) {
+		if ((ptr = g_try_malloc(size)))
+			session->mem_used += size;
+	} else if (session->mem_spill_dir) {
+		sr_dbg("Spilling %zu byte buffer to %s.", size,
+			session->mem_spill_dir);
+		ptr = spill_alloc(session->mem_spill_dir, size);
+		buf->spilled = TRUE;
+	} else {
+		sr_err("Allocating %zu bytes exceeds the memory budget "
+			"(%" PRIu64 " of %" PRIu64 " bytes in use).", size,
+			session->mem_used, session->mem_budget);
+	}
+
+	if (ptr) {
+		buf->ptr = ptr;
+		if (!session->mem_buffers)
+			session->mem_buffers = g_hash_table_new_full(NULL, NULL,
+				NULL, (GDestroyNotify)session_buffer_free);
+		g_hash_table_insert(session->mem_buffers, ptr, buf);
+	} else {
+		g_free(buf);
+	}
+
+	g_mutex_unlock(&session->mem_mutex);
+
+	return ptr;
+}
+
+/**
+ * Free a buffer allocated with sr_session_malloc().
+ *
+ * @param session The session the buffer was allocated for, or NULL.
+ * @param ptr The buffer. May be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_free(struct sr_session *session, void *ptr)
+{
+	struct session_buffer *buf;
+
+	if (!ptr)
+		return;
+	if (!session) {
+		g_free(ptr);
+		return;
+	}
+
+	g_mutex_lock(&session->mem_mutex);
+	buf = session->mem_buffers
+		? g_hash_table_lookup(session->mem_buffers, ptr) : NULL;
+	if (buf) {
+		if (!buf->spilled)
+			session->mem_used -= buf->size;
+		g_hash_table_remove(session->mem_buffers, ptr);
+	} else {
+		sr_err("BUG: Freeing unknown session buffer.");
+	}
+	g_mutex_unlock(&session->mem_mutex);
+}
+
+static void memory_account(uint64_t *counter, int64_t delta)
+{
+	if (delta < 0 && (uint64_t)-delta > *counter)
+		*counter = 0;
+	else
+		*counter += delta;
+}
+
+/**
+ * Account memory that is not allocated with sr_session_malloc(), such
+ * as buffers that grow during an acquisition, against the session's
+ * memory budget.
+ *
+ * @param session The session, or NULL to do nothing.
+ * @param delta The number of bytes that were allocated (positive) or
+ *              released (negative).
+ *
+ * @private
+ */
+SR_PRIV void sr_session_memory_account(struct sr_session *session,
+		int64_t delta)
+{
+	if (!session || !delta)
+		return;
+
+	g_mutex_lock(&session->mem_mutex);
+	memory_account(&session->mem_used, delta);
+	g_mutex_unlock(&session->mem_mutex);
+}
+
 static int verify_trigger(struct sr_trigger *trigger)
 {
 	struct sr_trigger_stage *stage;
@@ -807,6 +1164,9 @@ SR_API int sr_session_start(struct sr_session *session)
 
 	sr_info("Starting.");
 
+	if (session->recorder)
+		sr_session_recorder_reset(session->recorder);
+
 	session->running = TRUE;
 
 	/* Have all devices start acquisition. */
@@ -1035,6 +1395,7 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 {
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_planar *planar;
 
 	/* Please use the same order as in libsigrok.h. */
 	switch (packet->type) {
@@ -1066,12 +1427,34 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 		sr_dbg("bus: Received SR_DF_ANALOG packet (%d samples).",
 		       analog->num_samples);
 		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet->payload;
+		sr_dbg("bus: Received SR_DF_ANALOG_PLANAR packet (%d planes, "
+		       "%d samples).", planar->num_planes, planar->num_samples);
+		break;
 	default:
 		sr_dbg("bus: Received unknown packet type: %d.", packet->type);
 		break;
 	}
 }
 
+static void datafeed_callbacks_run(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	GSList *l;
+	struct datafeed_callback *cb_struct;
+
+	if (sdi->session->recorder)
+		sr_session_recorder_add(sdi->session->recorder, sdi, packet);
+
+	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
+		if (sr_log_loglevel_get() >= SR_LOG_DBG)
+			datafeed_dump(packet);
+		cb_struct = l->data;
+		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+	}
+}
+
 /**
  * Send a packet to whatever is listening on the datafeed bus.
  *
@@ -1089,9 +1472,11 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet)
 {
 	GSList *l;
-	struct datafeed_callback *cb_struct;
 	struct sr_datafeed_packet *packet_in, *packet_out;
+	struct sr_datafeed_packet plane_packet;
+	const struct sr_datafeed_analog_planar *planar;
 	struct sr_transform *t;
+	unsigned int i;
 	int ret;
 
 	if (!sdi) {
@@ -1109,6 +1494,13 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		return SR_ERR_BUG;
 	}
 
+#ifdef HAVE_LIBUSB_1_0
+	/* Packets go through the libusb event thread's queue, if any. */
+	if (sdi->session->usb_thread
+			&& usb_event_thread_defer(sdi->session, sdi, packet))
+		return SR_OK;
+#endif
+
 	/*
 	 * Pass the packet to the first transform module. If that returns
 	 * another packet (instead of NULL), pass that packet to the next
@@ -1142,13 +1534,18 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 
 	/*
 	 * If the last transform did output a packet, pass it to all datafeed
-	 * callbacks.
+	 * callbacks. Planar analog packets are split up into their planes,
+	 * unless the callbacks can take them as they are.
 	 */
-	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
-		if (sr_log_loglevel_get() >= SR_LOG_DBG)
-			datafeed_dump(packet);
-		cb_struct = l->data;
-		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+	if (packet->type == SR_DF_ANALOG_PLANAR && !sdi->session->analog_planar) {
+		planar = packet->payload;
+		plane_packet.type = SR_DF_ANALOG;
+		for (i = 0; i < planar->num_planes; i++) {
+			plane_packet.payload = &planar->planes[i];
+			datafeed_callbacks_run(sdi, &plane_packet);
+		}
+	} else {
+		datafeed_callbacks_run(sdi, packet);
 	}
 
 	return SR_OK;
@@ -1451,8 +1848,52 @@ static void copy_src(struct sr_config *src, struct sr_datafeed_meta *meta_copy)
 	                                   g_memdup(src, sizeof(struct sr_config)));
 }
 
-/** @private */
-SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
+static void copy_analog(const struct sr_datafeed_analog *analog,
+		struct sr_datafeed_analog *analog_copy)
+{
+	size_t size;
+
+	size = analog->encoding->unitsize * analog->num_samples
+		* MAX(g_slist_length(analog->meaning->channels), 1);
+	analog_copy->data = g_malloc(size);
+	memcpy(analog_copy->data, analog->data, size);
+	analog_copy->num_samples = analog->num_samples;
+	analog_copy->encoding = g_memdup(analog->encoding,
+			sizeof(struct sr_analog_encoding));
+	analog_copy->meaning = g_memdup(analog->meaning,
+			sizeof(struct sr_analog_meaning));
+	analog_copy->meaning->channels = g_slist_copy(
+			analog->meaning->channels);
+	analog_copy->spec = g_memdup(analog->spec,
+			sizeof(struct sr_analog_spec));
+}
+
+static void free_analog(const struct sr_datafeed_analog *analog)
+{
+	g_free(analog->data);
+	g_free(analog->encoding);
+	g_slist_free(analog->meaning->channels);
+	g_free(analog->meaning);
+	g_free(analog->spec);
+}
+
+/**
+ * Create a deep copy of a datafeed packet.
+ *
+ * The copy owns all of its payload and stays valid after the datafeed
+ * callback which received the original has returned.
+ *
+ * @param packet The packet to copy. Must not be NULL.
+ * @param copy Pointer which receives the copy. Must not be NULL. Release
+ *             the copy with sr_packet_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR Unknown packet type.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		struct sr_datafeed_packet **copy)
 {
 	const struct sr_datafeed_meta *meta;
@@ -1461,7 +1902,13 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	struct sr_datafeed_logic *logic_copy;
 	const struct sr_datafeed_analog *analog;
 	struct sr_datafeed_analog *analog_copy;
+	const struct sr_datafeed_analog_planar *planar;
+	struct sr_datafeed_analog_planar *planar_copy;
 	uint8_t *payload;
+	unsigned int i;
+
+	if (!packet || !copy)
+		return SR_ERR_ARG;
 
 	*copy = g_malloc0(sizeof(struct sr_datafeed_packet));
 	(*copy)->type = packet->type;
@@ -1469,6 +1916,8 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1479,7 +1928,7 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	case SR_DF_META:
 		meta = packet->payload;
 		meta_copy = g_malloc0(sizeof(struct sr_datafeed_meta));
-		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy->config);
+		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy);
 		(*copy)->payload = meta_copy;
 		break;
 	case SR_DF_LOGIC:
@@ -1487,46 +1936,62 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		logic_copy = g_malloc(sizeof(*logic_copy));
 		logic_copy->length = logic->length;
 		logic_copy->unitsize = logic->unitsize;
-		memcpy(logic_copy->data, logic->data, logic->length * logic->unitsize);
+		logic_copy->data = g_malloc(logic->length);
+		memcpy(logic_copy->data, logic->data, logic->length);
 		(*copy)->payload = logic_copy;
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
 		analog_copy = g_malloc(sizeof(*analog_copy));
-		analog_copy->data = g_malloc(
-				analog->encoding->unitsize * analog->num_samples);
-		memcpy(analog_copy->data, analog->data,
-				analog->encoding->unitsize * analog->num_samples);
-		analog_copy->num_samples = analog->num_samples;
-		analog_copy->encoding = g_memdup(analog->encoding,
-				sizeof(struct sr_analog_encoding));
-		analog_copy->meaning = g_memdup(analog->meaning,
-				sizeof(struct sr_analog_meaning));
-		analog_copy->meaning->channels = g_slist_copy(
-				analog->meaning->channels);
-		analog_copy->spec = g_memdup(analog->spec,
-				sizeof(struct sr_analog_spec));
+		copy_analog(analog, analog_copy);
 		(*copy)->payload = analog_copy;
 		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet->payload;
+		planar_copy = g_malloc(sizeof(*planar_copy));
+		planar_copy->num_samples = planar->num_samples;
+		planar_copy->num_planes = planar->num_planes;
+		planar_copy->planes = g_malloc(planar->num_planes
+				* sizeof(struct sr_datafeed_analog));
+		for (i = 0; i < planar->num_planes; i++)
+			copy_analog(&planar->planes[i], &planar_copy->planes[i]);
+		(*copy)->payload = planar_copy;
+		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
+		g_free(*copy);
+		*copy = NULL;
 		return SR_ERR;
 	}
 
 	return SR_OK;
 }
 
-void sr_packet_free(struct sr_datafeed_packet *packet)
+/**
+ * Release a packet copy created by sr_packet_copy().
+ *
+ * @param packet The packet to release. NULL is ignored.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_planar *planar;
 	struct sr_config *src;
 	GSList *l;
+	unsigned int i;
+
+	if (!packet)
+		return;
 
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1550,11 +2015,14 @@ void sr_packet_free(struct sr_datafeed_packet *packet)
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
-		g_free(analog->data);
-		g_free(analog->encoding);
-		g_slist_free(analog->meaning->channels);
-		g_free(analog->meaning);
-		g_free(analog->spec);
+		free_analog(analog);
+		g_free((void *)packet->payload);
+		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet->payload;
+		for (i = 0; i < planar->num_planes; i++)
+			free_analog(&planar->planes[i]);
+		g_free(planar->planes);
 		g_free((void *)packet->payload);
 		break;
 	default:
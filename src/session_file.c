@@ -56,6 +56,34 @@ SR_PRIV void sr_zip_discard(struct zip *archive)
 }
 #endif
 
+static char *read_member(struct zip *archive, const struct zip_stat *entry,
+		const char *what, int *len)
+{
+	struct zip_file *zf;
+	char *buf;
+
+	if (entry->size > G_MAXINT || !(buf = g_try_malloc(entry->size))) {
+		sr_err("Failed to allocate %s buffer.", what);
+		return NULL;
+	}
+	zf = zip_fopen_index(archive, entry->index, 0);
+	if (!zf) {
+		sr_err("Failed to open %s: %s", what, zip_strerror(archive));
+		g_free(buf);
+		return NULL;
+	}
+	*len = zip_fread(zf, buf, entry->size);
+	if (*len < 0) {
+		sr_err("Failed to read %s: %s", what, zip_file_strerror(zf));
+		zip_fclose(zf);
+		g_free(buf);
+		return NULL;
+	}
+	zip_fclose(zf);
+
+	return buf;
+}
+
 /**
  * Read metadata entries from a session archive.
  *
@@ -71,28 +99,11 @@ SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 {
 	GKeyFile *keyfile;
 	GError *error;
-	struct zip_file *zf;
 	char *metabuf;
 	int metalen;
 
-	if (entry->size > G_MAXINT || !(metabuf = g_try_malloc(entry->size))) {
-		sr_err("Metadata buffer allocation failed.");
-		return NULL;
-	}
-	zf = zip_fopen_index(archive, entry->index, 0);
-	if (!zf) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		g_free(metabuf);
+	if (!(metabuf = read_member(archive, entry, "metadata", &metalen)))
 		return NULL;
-	}
-	metalen = zip_fread(zf, metabuf, entry->size);
-	if (metalen < 0) {
-		sr_err("Failed to read metadata: %s", zip_file_strerror(zf));
-		zip_fclose(zf);
-		g_free(metabuf);
-		return NULL;
-	}
-	zip_fclose(zf);
 
 	keyfile = g_key_file_new();
 	error = NULL;
@@ -109,8 +120,12 @@ SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 	return keyfile;
 }
 
-/** @private */
-SR_PRIV int sr_sessionfile_check(const char *filename)
+/*
+ * Open a session archive and check that it's one we can handle. On
+ * success the archive is left open for the caller, so that reading the
+ * metadata doesn't need to open it again.
+ */
+static int sessionfile_open(const char *filename, struct zip **archive_out)
 {
 	struct zip *archive;
 	struct zip_file *zf;
@@ -163,6 +178,20 @@ SR_PRIV int sr_sessionfile_check(const char *filename)
 		zip_discard(archive);
 		return SR_ERR;
 	}
+
+	*archive_out = archive;
+
+	return SR_OK;
+}
+
+/** @private */
+SR_PRIV int sr_sessionfile_check(const char *filename)
+{
+	struct zip *archive;
+	int ret;
+
+	if ((ret = sessionfile_open(filename, &archive)) != SR_OK)
+		return ret;
 	zip_discard(archive);
 
 	return SR_OK;
@@ -220,12 +249,9 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	char channelname[SR_MAX_CHANNELNAME_LEN + 1];
 	gboolean file_has_logic;
 
-	if ((ret = sr_sessionfile_check(filename)) != SR_OK)
+	if ((ret = sessionfile_open(filename, &archive)) != SR_OK)
 		return ret;
 
-	if (!(archive = zip_open(filename, 0, NULL)))
-		return SR_ERR;
-
 	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
 		zip_discard(archive);
 		return SR_ERR;
@@ -391,4 +417,350 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	return ret;
 }
 
+static void file_channel_free(void *data)
+{
+	struct sr_session_file_channel *ch;
+
+	ch = data;
+	g_free(ch->name);
+	g_free(ch);
+}
+
+static void file_chunk_free(void *data)
+{
+	struct sr_session_file_chunk *chunk;
+
+	chunk = data;
+	g_free(chunk->name);
+	g_free(chunk);
+}
+
+/**
+ * Free a session file summary.
+ *
+ * @param info The summary, as returned by sr_session_file_info(). May be
+ *             NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_session_file_info_free(struct sr_session_file_info *info)
+{
+	if (!info)
+		return;
+
+	g_slist_free_full(info->channels, file_channel_free);
+	g_slist_free_full(info->chunks, file_chunk_free);
+	g_free(info);
+}
+
+/* Read a length prefixed name from the index, NULL if it's truncated. */
+static char *index_name(const uint8_t **p, const uint8_t *end)
+{
+	uint32_t len;
+	char *name;
+
+	if (end - *p < 4)
+		return NULL;
+	len = RL32(*p);
+	*p += 4;
+	if ((uint64_t)(end - *p) < len)
+		return NULL;
+	name = g_strndup((const char *)*p, len);
+	*p += len;
+
+	return name;
+}
+
+static int info_from_index(struct zip *archive, const struct zip_stat *zs,
+		struct sr_session_file_info *info)
+{
+	struct sr_session_file_channel *ch;
+	struct sr_session_file_chunk *chunk;
+	const uint8_t *p, *end;
+	uint8_t *buf;
+	uint64_t trigger_pos;
+	uint32_t num_channels, num_chunks, i;
+	int len;
+
+	if (!(buf = (uint8_t *)read_member(archive, zs, "index", &len)))
+		return SR_ERR;
+
+	if (len < SR_SESSIONFILE_INDEX_HDR_SIZE || memcmp(buf,
+			SR_SESSIONFILE_INDEX_MAGIC, SR_SESSIONFILE_INDEX_MAGIC_SIZE)) {
+		sr_dbg("Unknown session file index format.");
+		g_free(buf);
+		return SR_ERR_DATA;
+	}
+
+	p = buf + SR_SESSIONFILE_INDEX_MAGIC_SIZE;
+	end = buf + len;
+	info->samplerate = RL64(p);
+	info->total_samples = RL64(p + 8);
+	trigger_pos = RL64(p + 16);
+	info->trigger_pos = trigger_pos > G_MAXINT64 ? -1 : (int64_t)trigger_pos;
+	info->unitsize = RL32(p + 24);
+	num_channels = RL32(p + 28);
+	num_chunks = RL32(p + 32);
+	p = buf + SR_SESSIONFILE_INDEX_HDR_SIZE;
+
+	for (i = 0; i < num_channels; i++) {
+		if (end - p < 8)
+			break;
+		ch = g_malloc0(sizeof(*ch));
+		ch->index = RL32(p);
+		ch->type = RL32(p + 4);
+		p += 8;
+		if (!(ch->name = index_name(&p, end))) {
+			g_free(ch);
+			break;
+		}
+		info->channels = g_slist_prepend(info->channels, ch);
+	}
+	info->channels = g_slist_reverse(info->channels);
+	for (i = 0; i < num_chunks; i++) {
+		if (end - p < 8)
+			break;
+		chunk = g_malloc0(sizeof(*chunk));
+		chunk->num_samples = RL64(p);
+		p += 8;
+		if (!(chunk->name = index_name(&p, end))) {
+			g_free(chunk);
+			break;
+		}
+		info->chunks = g_slist_prepend(info->chunks, chunk);
+	}
+	info->chunks = g_slist_reverse(info->chunks);
+	g_free(buf);
+
+	if (g_slist_length(info->channels) != num_channels ||
+			g_slist_length(info->chunks) != num_chunks) {
+		sr_err("Truncated session file index.");
+		return SR_ERR_DATA;
+	}
+
+	return SR_OK;
+}
+
+struct chunk_entry {
+	int type;
+	uint64_t channel;
+	uint64_t num;
+	struct sr_session_file_chunk *chunk;
+};
+
+/* Parse "logic-1", "logic-1-<num>" and "analog-1-<channel>-<num>". */
+static gboolean parse_chunk_name(const char *name, struct chunk_entry *e)
+{
+	const char *p;
+	char *end;
+
+	if (!strcmp(name, "logic-1")) {
+		e->type = SR_CHANNEL_LOGIC;
+		e->channel = 0;
+		e->num = 1;
+		return TRUE;
+	}
+	if (g_str_has_prefix(name, "logic-1-")) {
+		p = name + 8;
+		e->type = SR_CHANNEL_LOGIC;
+		e->channel = 0;
+		e->num = g_ascii_strtoull(p, &end, 10);
+		return end != p && *end == '\0';
+	}
+	if (g_str_has_prefix(name, "analog-1-")) {
+		p = name + 9;
+		e->type = SR_CHANNEL_ANALOG;
+		e->channel = g_ascii_strtoull(p, &end, 10);
+		if (end == p || *end != '-')
+			return FALSE;
+		p = end + 1;
+		e->num = g_ascii_strtoull(p, &end, 10);
+		return end != p && *end == '\0';
+	}
+
+	return FALSE;
+}
+
+static gint chunk_entry_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct chunk_entry *ea, *eb;
+
+	ea = a;
+	eb = b;
+	if (ea->type != eb->type)
+		return ea->type < eb->type ? -1 : 1;
+	if (ea->channel != eb->channel)
+		return ea->channel < eb->channel ? -1 : 1;
+	if (ea->num != eb->num)
+		return ea->num < eb->num ? -1 : 1;
+
+	return 0;
+}
+
+static gint file_channel_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct sr_session_file_channel *ca, *cb;
+
+	ca = a;
+	cb = b;
+
+	return ca->index - cb->index;
+}
+
+/*
+ * Put the summary together for files without an index. Chunk sizes come
+ * from the archive directory, so no sample data gets read.
+ */
+static int info_from_metadata(struct zip *archive,
+		struct sr_session_file_info *info)
+{
+	struct sr_session_file_channel *ch;
+	struct chunk_entry e;
+	struct zip_stat zs;
+	GArray *entries;
+	GKeyFile *kf;
+	const char *group, *name;
+	char **keys, *val;
+	int64_t num_files, i;
+	uint64_t idx, analog_channel;
+	int type;
+	guint j;
+
+	if (zip_stat(archive, "metadata", 0, &zs) < 0)
+		return SR_ERR;
+	if (!(kf = sr_sessionfile_read_metadata(archive, &zs)))
+		return SR_ERR_DATA;
+
+	/* The srzip output module only ever writes one device. */
+	group = "device 1";
+	val = g_key_file_get_string(kf, group, "samplerate", NULL);
+	if (val && sr_parse_sizestring(val, &info->samplerate) != SR_OK)
+		info->samplerate = 0;
+	g_free(val);
+	if (g_key_file_has_key(kf, group, "capturefile", NULL))
+		info->unitsize = MAX(g_key_file_get_integer(kf, group,
+				"unitsize", NULL), 0);
+
+	keys = g_key_file_get_keys(kf, group, NULL, NULL);
+	for (i = 0; keys && keys[i]; i++) {
+		if (!strncmp(keys[i], "probe", 5)) {
+			type = SR_CHANNEL_LOGIC;
+			idx = g_ascii_strtoull(keys[i] + 5, NULL, 10);
+		} else if (!strncmp(keys[i], "analog", 6)) {
+			type = SR_CHANNEL_ANALOG;
+			idx = g_ascii_strtoull(keys[i] + 6, NULL, 10);
+		} else {
+			continue;
+		}
+		if (idx == 0 || idx > G_MAXINT)
+			continue;
+		ch = g_malloc0(sizeof(*ch));
+		ch->index = idx - 1;
+		ch->type = type;
+		ch->name = g_key_file_get_string(kf, group, keys[i], NULL);
+		info->channels = g_slist_prepend(info->channels, ch);
+	}
+	g_strfreev(keys);
+	g_key_file_free(kf);
+	info->channels = g_slist_sort(info->channels, file_channel_cmp);
+
+	entries = g_array_new(FALSE, FALSE, sizeof(struct chunk_entry));
+	num_files = zip_get_num_entries(archive, 0);
+	for (i = 0; i < num_files; i++) {
+		name = zip_get_name(archive, i, 0);
+		if (!name || !parse_chunk_name(name, &e))
+			continue;
+		if (zip_stat_index(archive, i, 0, &zs) < 0)
+			continue;
+		e.chunk = g_malloc0(sizeof(*e.chunk));
+		e.chunk->name = g_strdup(name);
+		if (e.type == SR_CHANNEL_ANALOG)
+			e.chunk->num_samples = zs.size / sizeof(float);
+		else if (info->unitsize)
+			e.chunk->num_samples = zs.size / info->unitsize;
+		g_array_append_val(entries, e);
+	}
+	g_array_sort(entries, chunk_entry_cmp);
+
+	/* Count logic samples, or those of the first analog channel. */
+	analog_channel = 0;
+	for (j = 0; j < entries->len; j++) {
+		e = g_array_index(entries, struct chunk_entry, j);
+		if (e.type == SR_CHANNEL_ANALOG) {
+			if (info->unitsize)
+				continue;
+			if (!analog_channel)
+				analog_channel = e.channel;
+			if (e.channel != analog_channel)
+				continue;
+		}
+		info->total_samples += e.chunk->num_samples;
+	}
+	for (j = entries->len; j > 0; j--) {
+		e = g_array_index(entries, struct chunk_entry, j - 1);
+		info->chunks = g_slist_prepend(info->chunks, e.chunk);
+	}
+	g_array_free(entries, TRUE);
+
+	info->trigger_pos = -1;
+
+	return SR_OK;
+}
+
+/**
+ * Get a summary of a session file without loading it.
+ *
+ * Files written by the srzip output module carry an index, which is all
+ * that gets read. For other files the summary is put together from the
+ * metadata and the sizes of the data chunks, and the trigger position
+ * is unknown. Sample data is never read.
+ *
+ * @param[in] filename The name of the session file.
+ * @param[out] info The summary. Must be freed by the caller using
+ *                  sr_session_file_info_free().
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid argument
+ * @retval SR_ERR_DATA Malformed session file
+ * @retval SR_ERR This is not a session file
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_file_info(const char *filename,
+		struct sr_session_file_info **info)
+{
+	struct sr_session_file_info *fi;
+	struct zip *archive;
+	struct zip_stat zs;
+	int ret;
+
+	if (!info)
+		return SR_ERR_ARG;
+
+	if ((ret = sessionfile_open(filename, &archive)) != SR_OK)
+		return ret;
+
+	fi = g_malloc0(sizeof(*fi));
+	ret = SR_ERR;
+	if (zip_stat(archive, "index", 0, &zs) == 0) {
+		ret = info_from_index(archive, &zs, fi);
+		if (ret != SR_OK) {
+			/* Don't give up on the file, the index is optional. */
+			sr_session_file_info_free(fi);
+			fi = g_malloc0(sizeof(*fi));
+		}
+	}
+	if (ret != SR_OK)
+		ret = info_from_metadata(archive, fi);
+	zip_discard(archive);
+
+	if (ret != SR_OK) {
+		sr_session_file_info_free(fi);
+		return ret;
+	}
+	*info = fi;
+
+	return SR_OK;
+}
+
 /** @} */
@@ -0,0 +1,867 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "recorder"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Session flight recorder: keep the most recent data of an acquisition
+ * in memory, and save it on demand.
+ */
+
+/**
+ * @addtogroup grp_session
+ *
+ * @{
+ */
+
+/* Logic data is kept in segments of this size. */
+#define SEGMENT_SIZE (1024 * 1024)
+
+struct segment {
+	struct sr_session *session;
+	uint8_t *data;
+	size_t used;
+	gint refcount;
+};
+
+/* One packet in the ring. */
+struct record {
+	gint refcount;
+	struct sr_session *session;
+	const struct sr_dev_inst *sdi;
+	int64_t time;
+	/* Bytes counted against the recorder's size limit. */
+	size_t size;
+	/* Logic data lives in a segment... */
+	struct segment *segment;
+	size_t offset;
+	uint16_t unitsize;
+	/* ...everything else is a packet copy. */
+	struct sr_datafeed_packet *packet;
+};
+
+struct device_state {
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_header header;
+	gboolean have_header;
+	/* Settings from META packets which dropped out of the ring. */
+	GSList *config;
+};
+
+/* Records of one device, taken from the ring at one point in time. */
+struct snapshot_device {
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_header header;
+	GSList *config;
+	GPtrArray *records;
+};
+
+struct save_job {
+	GThread *thread;
+	GSList *devices;
+	char *filename;
+	gint done;
+};
+
+struct session_recorder {
+	struct sr_session *session;
+	GMutex mutex;
+	uint64_t max_bytes;
+	uint64_t max_usec;
+	/* struct record, oldest first. */
+	GQueue records;
+	uint64_t bytes;
+	/* The segment being filled. */
+	struct segment *head;
+	GSList *devices;
+	gboolean alloc_failed;
+
+	/* Saving on triggers. */
+	char *trigger_dir;
+	uint64_t post_trigger_usec;
+	int64_t trigger_time;
+	gboolean trigger_pending;
+	unsigned int trigger_count;
+	GSList *jobs;
+};
+
+static struct segment *segment_new(struct sr_session *session)
+{
+	struct segment *seg;
+	uint8_t *data;
+
+	/* Large buffers may be backed by a spill file, see sr_session_malloc(). */
+	if (!(data = sr_session_malloc(session, SEGMENT_SIZE)))
+		return NULL;
+
+	seg = g_malloc0(sizeof(*seg));
+	seg->session = session;
+	seg->data = data;
+	seg->refcount = 1;
+
+	return seg;
+}
+
+static void segment_unref(struct segment *seg)
+{
+	if (!g_atomic_int_dec_and_test(&seg->refcount))
+		return;
+
+	sr_session_free(seg->session, seg->data);
+	g_free(seg);
+}
+
+static void record_unref(struct record *r)
+{
+	if (!g_atomic_int_dec_and_test(&r->refcount))
+		return;
+
+	if (r->segment) {
+		segment_unref(r->segment);
+	} else {
+		sr_session_memory_account(r->session, -(int64_t)r->size);
+		sr_packet_free(r->packet);
+	}
+	g_free(r);
+}
+
+static size_t analog_size(const struct sr_datafeed_analog *analog)
+{
+	return analog->encoding->unitsize * analog->num_samples
+		* MAX(g_slist_length(analog->meaning->channels), 1);
+}
+
+/* Rough size of a packet copy, for the recorder's size limit. */
+static size_t packet_size(const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_analog_planar *planar;
+	size_t size;
+	unsigned int i;
+
+	size = sizeof(struct sr_datafeed_packet);
+	switch (packet->type) {
+	case SR_DF_ANALOG:
+		size += sizeof(struct sr_datafeed_analog)
+			+ analog_size(packet->payload);
+		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet->payload;
+		for (i = 0; i < planar->num_planes; i++)
+			size += sizeof(struct sr_datafeed_analog)
+				+ analog_size(&planar->planes[i]);
+		break;
+	case SR_DF_META:
+		size += sizeof(struct sr_datafeed_meta);
+		break;
+	}
+
+	return size;
+}
+
+static struct device_state *device_get(struct session_recorder *rec,
+		const struct sr_dev_inst *sdi)
+{
+	struct device_state *dev;
+	GSList *l;
+
+	for (l = rec->devices; l; l = l->next) {
+		dev = l->data;
+		if (dev->sdi == sdi)
+			return dev;
+	}
+
+	dev = g_malloc0(sizeof(*dev));
+	dev->sdi = sdi;
+	rec->devices = g_slist_append(rec->devices, dev);
+
+	return dev;
+}
+
+static void config_free(struct sr_config *src)
+{
+	g_variant_unref(src->data);
+	g_free(src);
+}
+
+/* Merge settings into a list of settings, newer values replacing older. */
+static GSList *config_merge(GSList *config, GSList *update)
+{
+	struct sr_config *src, *dst;
+	GSList *l, *m;
+
+	for (l = update; l; l = l->next) {
+		src = l->data;
+		for (m = config; m; m = m->next) {
+			dst = m->data;
+			if (dst->key == src->key)
+				break;
+		}
+		if (m) {
+			g_variant_unref(dst->data);
+		} else {
+			dst = g_malloc0(sizeof(*dst));
+			dst->key = src->key;
+			config = g_slist_append(config, dst);
+		}
+		dst->data = g_variant_ref(src->data);
+	}
+
+	return config;
+}
+
+static void device_state_free(struct device_state *dev)
+{
+	g_slist_free_full(dev->config, (GDestroyNotify)config_free);
+	g_free(dev);
+}
+
+/* Drop the oldest record. The caller must hold the recorder's mutex. */
+static void evict_oldest(struct session_recorder *rec)
+{
+	struct record *r;
+	struct device_state *dev;
+
+	r = g_queue_pop_head(&rec->records);
+	rec->bytes -= r->size;
+	if (r->packet && r->packet->type == SR_DF_META) {
+		/* Keep the settings, saved data must still make sense. */
+		dev = device_get(rec, r->sdi);
+		dev->config = config_merge(dev->config,
+			((const struct sr_datafeed_meta *)r->packet->payload)->config);
+	}
+	record_unref(r);
+}
+
+static void evict(struct session_recorder *rec, int64_t now)
+{
+	struct record *r;
+
+	while ((r = g_queue_peek_head(&rec->records))) {
+		if (rec->max_bytes && rec->bytes > rec->max_bytes)
+			evict_oldest(rec);
+		else if (rec->max_usec && now - r->time > (int64_t)rec->max_usec)
+			evict_oldest(rec);
+		else
+			break;
+	}
+}
+
+static void record_push(struct session_recorder *rec, struct record *r)
+{
+	r->refcount = 1;
+	g_queue_push_tail(&rec->records, r);
+	rec->bytes += r->size;
+}
+
+static void add_logic(struct session_recorder *rec,
+		const struct sr_dev_inst *sdi, int64_t now,
+		const struct sr_datafeed_logic *logic)
+{
+	struct record *r;
+	const uint8_t *data;
+	size_t left, len;
+
+	if (!logic->unitsize)
+		return;
+
+	data = logic->data;
+	left = logic->length - logic->length % logic->unitsize;
+	while (left > 0) {
+		if (!rec->head || SEGMENT_SIZE - rec->head->used < logic->unitsize) {
+			if (rec->head)
+				segment_unref(rec->head);
+			/*
+			 * Out of memory or over the session's budget: make room
+			 * by dropping the oldest data, as the ring would anyway.
+			 * Segments are freed once their last record is gone.
+			 */
+			while (!(rec->head = segment_new(rec->session))) {
+				if (g_queue_is_empty(&rec->records)) {
+					if (!rec->alloc_failed)
+						sr_warn("Out of memory, dropping data.");
+					rec->alloc_failed = TRUE;
+					return;
+				}
+				evict_oldest(rec);
+			}
+			rec->alloc_failed = FALSE;
+		}
+		len = MIN(left, SEGMENT_SIZE - rec->head->used);
+		len -= len % logic->unitsize;
+		memcpy(rec->head->data + rec->head->used, data, len);
+
+		r = g_malloc0(sizeof(*r));
+		r->sdi = sdi;
+		r->time = now;
+		r->size = len;
+		r->segment = rec->head;
+		g_atomic_int_inc(&rec->head->refcount);
+		r->offset = rec->head->used;
+		r->unitsize = logic->unitsize;
+		record_push(rec, r);
+
+		rec->head->used += len;
+		data += len;
+		left -= len;
+	}
+}
+
+static void add_packet(struct session_recorder *rec,
+		const struct sr_dev_inst *sdi, int64_t now,
+		const struct sr_datafeed_packet *packet)
+{
+	struct record *r;
+
+	r = g_malloc0(sizeof(*r));
+	if (sr_packet_copy(packet, &r->packet) != SR_OK) {
+		g_free(r);
+		return;
+	}
+	r->session = rec->session;
+	r->sdi = sdi;
+	r->time = now;
+	r->size = packet_size(packet);
+	sr_session_memory_account(rec->session, r->size);
+	record_push(rec, r);
+}
+
+/* Take references to what is in the ring. Caller must hold the mutex. */
+static GSList *snapshot_take(struct session_recorder *rec)
+{
+	struct snapshot_device *sd;
+	struct device_state *dev;
+	struct record *r;
+	GSList *devices, *l, *m;
+	GList *e;
+
+	devices = NULL;
+	for (l = rec->devices; l; l = l->next) {
+		dev = l->data;
+		sd = g_malloc0(sizeof(*sd));
+		sd->sdi = dev->sdi;
+		if (dev->have_header) {
+			sd->header = dev->header;
+		} else {
+			/* The recorder was enabled during the acquisition. */
+			sd->header.feed_version = 1;
+			gettimeofday(&sd->header.starttime, NULL);
+		}
+		sd->config = config_merge(NULL, dev->config);
+		sd->records = g_ptr_array_new_with_free_func(
+			(GDestroyNotify)record_unref);
+		devices = g_slist_append(devices, sd);
+	}
+
+	for (e = rec->records.head; e; e = e->next) {
+		r = e->data;
+		for (m = devices; m; m = m->next) {
+			sd = m->data;
+			if (sd->sdi == r->sdi)
+				break;
+		}
+		g_atomic_int_inc(&r->refcount);
+		g_ptr_array_add(((struct snapshot_device *)m->data)->records, r);
+	}
+
+	return devices;
+}
+
+static void snapshot_device_free(struct snapshot_device *sd)
+{
+	g_slist_free_full(sd->config, (GDestroyNotify)config_free);
+	g_ptr_array_free(sd->records, TRUE);
+	g_free(sd);
+}
+
+static void snapshot_free(GSList *devices)
+{
+	g_slist_free_full(devices, (GDestroyNotify)snapshot_device_free);
+}
+
+/* Send one device's data as a complete datafeed, header to end. */
+static void snapshot_replay(const struct snapshot_device *sd,
+		sr_datafeed_callback cb, void *cb_data)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	const struct record *r;
+	unsigned int i;
+
+	packet.type = SR_DF_HEADER;
+	packet.payload = &sd->header;
+	cb(sd->sdi, &packet, cb_data);
+
+	if (sd->config) {
+		meta.config = sd->config;
+		packet.type = SR_DF_META;
+		packet.payload = &meta;
+		cb(sd->sdi, &packet, cb_data);
+	}
+
+	for (i = 0; i < sd->records->len; i++) {
+		r = g_ptr_array_index(sd->records, i);
+		if (r->packet) {
+			cb(sd->sdi, r->packet, cb_data);
+			continue;
+		}
+		logic.length = r->size;
+		logic.unitsize = r->unitsize;
+		logic.data = r->segment->data + r->offset;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		cb(sd->sdi, &packet, cb_data);
+	}
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	cb(sd->sdi, &packet, cb_data);
+}
+
+struct output_data {
+	const struct sr_output *o;
+	int ret;
+};
+
+static void output_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct output_data *od;
+	GString *out;
+
+	(void)sdi;
+
+	od = cb_data;
+	if (od->ret != SR_OK)
+		return;
+	out = NULL;
+	od->ret = sr_output_send(od->o, packet, &out);
+	if (out)
+		g_string_free(out, TRUE);
+}
+
+/* "name.sr" becomes "name-2.sr" for the second of several devices. */
+static char *device_filename(const char *filename, unsigned int index,
+		unsigned int count)
+{
+	char *base, *name;
+
+	if (count == 1)
+		return g_strdup(filename);
+
+	if (g_str_has_suffix(filename, ".sr")) {
+		base = g_strndup(filename, strlen(filename) - 3);
+		name = g_strdup_printf("%s-%u.sr", base, index + 1);
+		g_free(base);
+	} else {
+		name = g_strdup_printf("%s-%u", filename, index + 1);
+	}
+
+	return name;
+}
+
+static int snapshot_save(GSList *devices, const char *filename)
+{
+	const struct sr_output_module *omod;
+	const struct snapshot_device *sd;
+	struct output_data od;
+	unsigned int i, count;
+	char *name;
+	GSList *l;
+	int ret;
+
+	if (!(omod = sr_output_find((char *)"srzip")))
+		return SR_ERR_NA;
+
+	count = g_slist_length(devices);
+	ret = SR_OK;
+	for (l = devices, i = 0; l && ret == SR_OK; l = l->next, i++) {
+		sd = l->data;
+		name = device_filename(filename, i, count);
+		if ((od.o = sr_output_new(omod, NULL, sd->sdi, name))) {
+			od.ret = SR_OK;
+			snapshot_replay(sd, output_cb, &od);
+			sr_output_free(od.o);
+			ret = od.ret;
+		} else {
+			ret = SR_ERR;
+		}
+		if (ret == SR_OK)
+			sr_info("Saved recorded data to %s.", name);
+		else
+			sr_err("Failed to save recorded data to %s.", name);
+		g_free(name);
+	}
+
+	return ret;
+}
+
+static gpointer save_job_run(gpointer data)
+{
+	struct save_job *job;
+
+	job = data;
+	snapshot_save(job->devices, job->filename);
+	snapshot_free(job->devices);
+	job->devices = NULL;
+	g_atomic_int_set(&job->done, 1);
+
+	return NULL;
+}
+
+static void save_job_free(struct save_job *job)
+{
+	g_thread_join(job->thread);
+	g_free(job->filename);
+	g_free(job);
+}
+
+/* Join the save jobs which have finished, or all of them. */
+static void save_jobs_reap(struct session_recorder *rec, gboolean all)
+{
+	struct save_job *job;
+	GSList *l, *next;
+
+	for (l = rec->jobs; l; l = next) {
+		next = l->next;
+		job = l->data;
+		if (!all && !g_atomic_int_get(&job->done))
+			continue;
+		rec->jobs = g_slist_delete_link(rec->jobs, l);
+		save_job_free(job);
+	}
+}
+
+/* Save the ring in the background. The caller must hold the mutex. */
+static void trigger_save(struct session_recorder *rec)
+{
+	struct save_job *job;
+	GDateTime *now;
+	char *name, *stamp;
+
+	rec->trigger_pending = FALSE;
+	save_jobs_reap(rec, FALSE);
+
+	now = g_date_time_new_now_local();
+	stamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+	g_date_time_unref(now);
+	name = g_strdup_printf("recorder-%s-%u.sr", stamp,
+		++rec->trigger_count);
+	g_free(stamp);
+
+	job = g_malloc0(sizeof(*job));
+	job->devices = snapshot_take(rec);
+	job->filename = g_build_filename(rec->trigger_dir, name, NULL);
+	g_free(name);
+	job->thread = g_thread_new("sr-recorder", save_job_run, job);
+	rec->jobs = g_slist_prepend(rec->jobs, job);
+}
+
+/**
+ * Add a packet to a session's flight recorder.
+ *
+ * Called for every packet passed to the session's datafeed callbacks.
+ *
+ * @param rec The recorder. Must not be NULL.
+ * @param sdi The device which sent the packet.
+ * @param packet The packet.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_recorder_add(struct session_recorder *rec,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct device_state *dev;
+	int64_t now;
+
+	now = g_get_monotonic_time();
+
+	g_mutex_lock(&rec->mutex);
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		dev = device_get(rec, sdi);
+		dev->header = *(const struct sr_datafeed_header *)packet->payload;
+		dev->have_header = TRUE;
+		break;
+	case SR_DF_END:
+		/* Don't wait for post-trigger data that will never come. */
+		if (rec->trigger_pending)
+			trigger_save(rec);
+		break;
+	case SR_DF_LOGIC:
+		device_get(rec, sdi);
+		add_logic(rec, sdi, now, packet->payload);
+		break;
+	case SR_DF_TRIGGER:
+		device_get(rec, sdi);
+		add_packet(rec, sdi, now, packet);
+		if (rec->trigger_dir && !rec->trigger_pending) {
+			rec->trigger_pending = TRUE;
+			rec->trigger_time = now;
+		}
+		break;
+	default:
+		device_get(rec, sdi);
+		add_packet(rec, sdi, now, packet);
+		break;
+	}
+
+	evict(rec, now);
+
+	if (rec->trigger_pending && now - rec->trigger_time
+			>= (int64_t)rec->post_trigger_usec)
+		trigger_save(rec);
+
+	g_mutex_unlock(&rec->mutex);
+}
+
+/**
+ * Drop all recorded data, before a new acquisition starts.
+ *
+ * @param rec The recorder. Must not be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_recorder_reset(struct session_recorder *rec)
+{
+	g_mutex_lock(&rec->mutex);
+	while (!g_queue_is_empty(&rec->records))
+		evict_oldest(rec);
+	if (rec->head) {
+		segment_unref(rec->head);
+		rec->head = NULL;
+	}
+	g_slist_free_full(rec->devices, (GDestroyNotify)device_state_free);
+	rec->devices = NULL;
+	rec->trigger_pending = FALSE;
+	g_mutex_unlock(&rec->mutex);
+}
+
+/**
+ * Free a session's flight recorder, waiting for pending saves.
+ *
+ * @param rec The recorder. May be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_recorder_free(struct session_recorder *rec)
+{
+	if (!rec)
+		return;
+
+	sr_session_recorder_reset(rec);
+	save_jobs_reap(rec, TRUE);
+	g_free(rec->trigger_dir);
+	g_mutex_clear(&rec->mutex);
+	g_free(rec);
+}
+
+/**
+ * Keep the most recent data of the session's acquisitions in memory.
+ *
+ * Logic and analog data, triggers and frame markers are kept in a ring
+ * of memory segments, from which data is dropped once it exceeds
+ * @a max_bytes or is older than @a max_msec. The ring is accounted against
+ * the session's memory budget, and backed by the spill directory if one is
+ * set, see sr_session_memory_budget_set(). Use
+ * sr_session_recorder_snapshot() or sr_session_recorder_save() to get at
+ * the data while the acquisition keeps running. Recorded data is dropped
+ * when the session is started again.
+ *
+ * The limits of an enabled recorder can be changed at any time. Enabling
+ * or disabling the recorder is only possible while the session is not
+ * running.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param max_bytes The maximum amount of data to keep, or 0 for no limit.
+ * @param max_msec The time span of data to keep in milliseconds, or 0 for
+ *                 no limit. If both limits are 0, the recorder is disabled.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_recorder_set(struct sr_session *session,
+		uint64_t max_bytes, uint64_t max_msec)
+{
+	struct session_recorder *rec;
+
+	if (!session)
+		return SR_ERR_ARG;
+
+	rec = session->recorder;
+	if (!max_bytes && !max_msec) {
+		if (!rec)
+			return SR_OK;
+		if (session->running)
+			return SR_ERR;
+		sr_session_recorder_free(rec);
+		session->recorder = NULL;
+		return SR_OK;
+	}
+
+	if (!rec) {
+		if (session->running)
+			return SR_ERR;
+		rec = g_malloc0(sizeof(*rec));
+		rec->session = session;
+		g_mutex_init(&rec->mutex);
+		g_queue_init(&rec->records);
+		session->recorder = rec;
+	}
+
+	g_mutex_lock(&rec->mutex);
+	rec->max_bytes = max_bytes;
+	rec->max_usec = max_msec * 1000;
+	evict(rec, g_get_monotonic_time());
+	g_mutex_unlock(&rec->mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Save the recorder's data after each trigger.
+ *
+ * When a trigger fires, the recorder waits for @a post_msec more of data,
+ * and then writes what it holds to a new session file in @a dir, in the
+ * background. Triggers which fire while waiting are part of the same file.
+ *
+ * @param session The session to use. Must not be NULL, and must have the
+ *                recorder enabled.
+ * @param dir The directory to save to, or NULL to not save on triggers.
+ * @param post_msec The time to keep recording after the trigger.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The recorder is not enabled.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_recorder_trigger_save_set(struct sr_session *session,
+		const char *dir, uint64_t post_msec)
+{
+	struct session_recorder *rec;
+
+	if (!session)
+		return SR_ERR_ARG;
+	if (!(rec = session->recorder))
+		return SR_ERR_NA;
+
+	g_mutex_lock(&rec->mutex);
+	g_free(rec->trigger_dir);
+	rec->trigger_dir = g_strdup(dir);
+	rec->post_trigger_usec = post_msec * 1000;
+	if (!dir)
+		rec->trigger_pending = FALSE;
+	g_mutex_unlock(&rec->mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Pass the data held by the session's recorder to a callback.
+ *
+ * Each device's data is sent as a complete datafeed, from SR_DF_HEADER
+ * to SR_DF_END, so it can be passed to an output module as it is. The
+ * acquisition keeps running meanwhile, and may be called from any thread.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param cb The callback. Must not be NULL.
+ * @param cb_data Opaque pointer passed to the callback.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The recorder is not enabled.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_recorder_snapshot(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data)
+{
+	struct session_recorder *rec;
+	GSList *devices, *l;
+
+	if (!session || !cb)
+		return SR_ERR_ARG;
+	if (!(rec = session->recorder))
+		return SR_ERR_NA;
+
+	g_mutex_lock(&rec->mutex);
+	devices = snapshot_take(rec);
+	g_mutex_unlock(&rec->mutex);
+
+	for (l = devices; l; l = l->next)
+		snapshot_replay(l->data, cb, cb_data);
+	snapshot_free(devices);
+
+	return SR_OK;
+}
+
+/**
+ * Save the data held by the session's recorder to a session file.
+ *
+ * The acquisition keeps running meanwhile. With several devices, each is
+ * saved to a file of its own, with the device number appended to the
+ * file name.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param filename The file to save to. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The recorder is not enabled.
+ * @retval SR_ERR Saving failed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_recorder_save(struct sr_session *session,
+		const char *filename)
+{
+	struct session_recorder *rec;
+	GSList *devices;
+	int ret;
+
+	if (!session || !filename)
+		return SR_ERR_ARG;
+	if (!(rec = session->recorder))
+		return SR_ERR_NA;
+
+	g_mutex_lock(&rec->mutex);
+	devices = snapshot_take(rec);
+	g_mutex_unlock(&rec->mutex);
+
+	ret = snapshot_save(devices, filename);
+	snapshot_free(devices);
+
+	return ret;
+}
+
+/** @} */
@@ -0,0 +1,309 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Hot-path kernels. This file is compiled once for the baseline ISA, and
+ * once more for each wider vector ISA configure found compiler support for,
+ * with SR_SIMD_VARIANT set to the name of the variant. Every build defines
+ * its own sr_simd_kernels_<variant> table; simd.c picks one at runtime.
+ *
+ * The loops are written so the compiler can vectorize them for whatever
+ * ISA it targets. Where that doesn't happen by itself, x86 intrinsics are
+ * used as far as the ISA of the variant allows. All variants must produce
+ * exactly the same results.
+ */
+
+#include <config.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#ifndef SR_SIMD_VARIANT
+#define SR_SIMD_VARIANT baseline
+#endif
+
+#define SIMD_CONCAT(a, b) a ## b
+#define SIMD_NAME(a, b) SIMD_CONCAT(a, b)
+
+#define DEFINE_INT_TO_FLOAT(name, type) \
+static void name(const uint8_t *src, float *dst, size_t count, \
+		float scale, float offset) \
+{ \
+	type v; \
+	size_t i; \
+\
+	for (i = 0; i < count; i++) { \
+		memcpy(&v, src + i * sizeof(type), sizeof(type)); \
+		dst[i] = scale * v; \
+		dst[i] += offset; \
+	} \
+}
+
+DEFINE_INT_TO_FLOAT(s8_to_float, int8_t)
+DEFINE_INT_TO_FLOAT(u8_to_float, uint8_t)
+DEFINE_INT_TO_FLOAT(s16_to_float, int16_t)
+DEFINE_INT_TO_FLOAT(u16_to_float, uint16_t)
+DEFINE_INT_TO_FLOAT(s32_to_float, int32_t)
+DEFINE_INT_TO_FLOAT(u32_to_float, uint32_t)
+
+static int int_to_float(const void *src, unsigned int unitsize,
+		gboolean is_signed, float *dst, size_t count,
+		float scale, float offset)
+{
+	switch (unitsize) {
+	case 1:
+		if (is_signed)
+			s8_to_float(src, dst, count, scale, offset);
+		else
+			u8_to_float(src, dst, count, scale, offset);
+		return SR_OK;
+	case 2:
+		if (is_signed)
+			s16_to_float(src, dst, count, scale, offset);
+		else
+			u16_to_float(src, dst, count, scale, offset);
+		return SR_OK;
+	case 4:
+		if (is_signed)
+			s32_to_float(src, dst, count, scale, offset);
+		else
+			u32_to_float(src, dst, count, scale, offset);
+		return SR_OK;
+	}
+
+	return SR_ERR_ARG;
+}
+
+/*
+ * Gather byte b of 8 consecutive samples into one word (sample n in byte n),
+ * then transpose the 8x8 bit matrix so that byte m holds bit m of all 8
+ * samples.
+ */
+static uint64_t transpose8(const uint8_t *data, unsigned int unitsize,
+		unsigned int b)
+{
+	uint64_t x, t;
+	unsigned int n;
+
+	x = 0;
+	for (n = 0; n < 8; n++)
+		x |= (uint64_t)data[n * unitsize + b] << (8 * n);
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+	x = x ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+	x = x ^ t ^ (t << 28);
+
+	return x;
+}
+
+/*
+ * With one byte per sample, the bits of one channel can be collected
+ * 16 or 32 samples at a time: shift the channel's bit up to the top of
+ * each byte, then gather the top bits.
+ */
+static uint64_t planes_unitsize1(const uint8_t *data, uint64_t num_samples,
+		const int *channel_index, unsigned int num_channels,
+		uint8_t *planes, size_t stride)
+{
+	uint64_t s;
+
+	s = 0;
+#if defined(__AVX2__)
+	for (; s + 32 <= num_samples; s += 32) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(data + s));
+		uint8_t *p = planes + s / 8;
+		unsigned int j;
+		uint32_t bits;
+
+		for (j = 0; j < num_channels; j++, p += stride) {
+			bits = _mm256_movemask_epi8(_mm256_sll_epi16(x,
+				_mm_cvtsi32_si128(7 - channel_index[j])));
+			p[0] = bits;
+			p[1] = bits >> 8;
+			p[2] = bits >> 16;
+			p[3] = bits >> 24;
+		}
+	}
+#endif
+#if defined(__SSE2__)
+	for (; s + 16 <= num_samples; s += 16) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(data + s));
+		uint8_t *p = planes + s / 8;
+		unsigned int j;
+		uint32_t bits;
+
+		for (j = 0; j < num_channels; j++, p += stride) {
+			bits = _mm_movemask_epi8(_mm_sll_epi16(x,
+				_mm_cvtsi32_si128(7 - channel_index[j])));
+			p[0] = bits;
+			p[1] = bits >> 8;
+		}
+	}
+#else
+	(void)data;
+	(void)num_samples;
+	(void)channel_index;
+	(void)num_channels;
+	(void)planes;
+	(void)stride;
+#endif
+
+	return s;
+}
+
+static void logic_to_planes(const uint8_t *data, unsigned int unitsize,
+		uint64_t num_samples, const int *channel_index,
+		unsigned int num_channels, uint8_t *planes, size_t stride)
+{
+	uint64_t s, x;
+	unsigned int j, n, b, byte;
+	int idx;
+	uint8_t v;
+
+	s = 0;
+	if (unitsize == 1)
+		s = planes_unitsize1(data, num_samples, channel_index,
+			num_channels, planes, stride);
+
+	for (; s + 8 <= num_samples; s += 8) {
+		/*
+		 * Channels are usually sorted by index, so each byte typically
+		 * gets transposed only once.
+		 */
+		byte = unitsize;
+		x = 0;
+		for (j = 0; j < num_channels; j++) {
+			idx = channel_index[j];
+			b = idx / 8;
+			if (b != byte) {
+				byte = b;
+				x = transpose8(data + s * unitsize, unitsize, b);
+			}
+			planes[j * stride + s / 8] = x >> (8 * (idx % 8));
+		}
+	}
+
+	if (s < num_samples) {
+		for (j = 0; j < num_channels; j++) {
+			idx = channel_index[j];
+			v = 0;
+			for (n = 0; s + n < num_samples; n++) {
+				if (data[(s + n) * unitsize + idx / 8] & (1 << (idx % 8)))
+					v |= 1 << n;
+			}
+			planes[j * stride + s / 8] = v;
+		}
+	}
+}
+
+#if defined(__SSE2__)
+/* First element of n in which bit k * unitsize of a movemask is set. */
+static inline size_t first_match(uint32_t bits, unsigned int unitsize)
+{
+	return __builtin_ctz(bits) / unitsize;
+}
+#endif
+
+static size_t logic_find(const uint8_t *data, unsigned int unitsize,
+		size_t count, uint64_t mask, uint64_t value)
+{
+	uint64_t v;
+	size_t i;
+
+	i = 0;
+#if defined(__SSE2__)
+	if (unitsize == 1 || unitsize == 2 || unitsize == 4) {
+		const size_t per_vec = 16 / unitsize;
+		uint32_t bits;
+		__m128i m, val;
+
+		if (unitsize == 1) {
+			m = _mm_set1_epi8((char)mask);
+			val = _mm_set1_epi8((char)value);
+		} else if (unitsize == 2) {
+			m = _mm_set1_epi16((short)mask);
+			val = _mm_set1_epi16((short)value);
+		} else {
+			m = _mm_set1_epi32((int)mask);
+			val = _mm_set1_epi32((int)value);
+		}
+#if defined(__AVX2__)
+		{
+			const __m256i m2 = _mm256_broadcastsi128_si256(m);
+			const __m256i val2 = _mm256_broadcastsi128_si256(val);
+
+			for (; i + 2 * per_vec <= count; i += 2 * per_vec) {
+				__m256i x = _mm256_loadu_si256(
+					(const __m256i *)(data + i * unitsize));
+				x = _mm256_and_si256(x, m2);
+				x = _mm256_cmpeq_epi8(x, val2);
+				bits = _mm256_movemask_epi8(x);
+				/* All bytes of a sample must match. */
+				if (unitsize == 2)
+					bits &= bits >> 1;
+				else if (unitsize == 4)
+					bits &= (bits >> 1) & (bits >> 2) & (bits >> 3);
+				bits &= unitsize == 1 ? 0xffffffff :
+					unitsize == 2 ? 0x55555555 : 0x11111111;
+				if (bits)
+					return i + first_match(bits, unitsize);
+			}
+		}
+#endif
+		for (; i + per_vec <= count; i += per_vec) {
+			__m128i x = _mm_loadu_si128(
+				(const __m128i *)(data + i * unitsize));
+			x = _mm_and_si128(x, m);
+			x = _mm_cmpeq_epi8(x, val);
+			bits = _mm_movemask_epi8(x);
+			if (unitsize == 2)
+				bits &= bits >> 1;
+			else if (unitsize == 4)
+				bits &= (bits >> 1) & (bits >> 2) & (bits >> 3);
+			bits &= unitsize == 1 ? 0xffff :
+				unitsize == 2 ? 0x5555 : 0x1111;
+			if (bits)
+				return i + first_match(bits, unitsize);
+		}
+	}
+#endif
+
+	for (; i < count; i++) {
+		v = 0;
+		memcpy(&v, data + i * unitsize, unitsize);
+		if ((v & mask) == value)
+			return i;
+	}
+
+	return count;
+}
+
+SR_PRIV const struct sr_simd_kernels
+		SIMD_NAME(sr_simd_kernels_, SR_SIMD_VARIANT) = {
+	.name = G_STRINGIFY(SR_SIMD_VARIANT),
+	.int_to_float = int_to_float,
+	.logic_to_planes = logic_to_planes,
+	.logic_find = logic_find,
+};
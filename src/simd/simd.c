@@ -0,0 +1,124 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#ifdef HAVE_SIMD_NEON
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "simd"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Runtime selection of the hot-path kernels.
+ */
+
+static gboolean cpu_supports(const struct sr_simd_kernels *k)
+{
+#ifdef HAVE_SIMD_AVX2
+	if (k == &sr_simd_kernels_avx2)
+		return __builtin_cpu_supports("avx2");
+#endif
+#ifdef HAVE_SIMD_SSE42
+	if (k == &sr_simd_kernels_sse42)
+		return __builtin_cpu_supports("sse4.2");
+#endif
+#ifdef HAVE_SIMD_NEON
+	if (k == &sr_simd_kernels_neon)
+		return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+	(void)k;
+
+	return TRUE;
+}
+
+/* Best first. */
+static const struct sr_simd_kernels *const variants[] = {
+#ifdef HAVE_SIMD_AVX2
+	&sr_simd_kernels_avx2,
+#endif
+#ifdef HAVE_SIMD_SSE42
+	&sr_simd_kernels_sse42,
+#endif
+#ifdef HAVE_SIMD_NEON
+	&sr_simd_kernels_neon,
+#endif
+	&sr_simd_kernels_baseline,
+};
+
+static const struct sr_simd_kernels *select_kernels(void)
+{
+	const struct sr_simd_kernels *k;
+	const char *want;
+	unsigned int i;
+
+	/* Mostly for testing and benchmarking the variants against each other. */
+	want = g_getenv("SIGROK_SIMD");
+	if (want) {
+		for (i = 0; i < G_N_ELEMENTS(variants); i++) {
+			k = variants[i];
+			if (strcmp(k->name, want))
+				continue;
+			if (cpu_supports(k))
+				return k;
+			sr_warn("CPU doesn't support '%s' kernels.", want);
+			break;
+		}
+		if (i == G_N_ELEMENTS(variants))
+			sr_warn("Unknown SIGROK_SIMD variant '%s'.", want);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(variants); i++) {
+		if (cpu_supports(variants[i]))
+			return variants[i];
+	}
+
+	return &sr_simd_kernels_baseline;
+}
+
+/**
+ * Get the fastest set of hot-path kernels the CPU supports.
+ *
+ * The choice is made on first use, and can be overridden by setting the
+ * SIGROK_SIMD environment variable to the name of a variant.
+ *
+ * @return The kernels, never NULL.
+ *
+ * @private
+ */
+SR_PRIV const struct sr_simd_kernels *sr_simd_get(void)
+{
+	static const struct sr_simd_kernels *kernels;
+	const struct sr_simd_kernels *k;
+
+	if (g_once_init_enter(&kernels)) {
+		k = select_kernels();
+		sr_dbg("Using '%s' kernels.", k->name);
+		g_once_init_leave(&kernels, k);
+	}
+
+	return kernels;
+}
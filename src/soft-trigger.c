@@ -38,7 +38,9 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 	stl->unitsize = (g_slist_length(sdi->channels) + 7) / 8;
 	stl->prev_sample = g_malloc0(stl->unitsize);
 	stl->pre_trigger_size = stl->unitsize * pre_trigger_samples;
-	stl->pre_trigger_buffer = g_malloc(stl->pre_trigger_size);
+	stl->session = sdi->session;
+	stl->pre_trigger_buffer = sr_session_malloc(stl->session,
+			stl->pre_trigger_size);
 	stl->pre_trigger_head = stl->pre_trigger_buffer;
 
 	if (stl->pre_trigger_size > 0 && !stl->pre_trigger_buffer) {
@@ -51,11 +53,21 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *stl)
 {
-	g_free(stl->pre_trigger_buffer);
+	sr_session_free(stl->session, stl->pre_trigger_buffer);
 	g_free(stl->prev_sample);
 	g_free(stl);
 }
 
+/* Re-arm the trigger, e.g. for the next frame of an acquisition. */
+SR_PRIV void soft_trigger_logic_reset(struct soft_trigger_logic *stl)
+{
+	stl->count = 0;
+	stl->cur_stage = 0;
+	memset(stl->prev_sample, 0, stl->unitsize);
+	stl->pre_trigger_head = stl->pre_trigger_buffer;
+	stl->pre_trigger_fill = 0;
+}
+
 static void pre_trigger_append(struct soft_trigger_logic *stl,
 		uint8_t *buf, int len)
 {
@@ -146,6 +158,55 @@ static gboolean logic_check_match(struct soft_trigger_logic *stl,
 	return result;
 }
 
+/*
+ * If the first stage only has level matches, get the mask and value a
+ * sample must have to match it, so that runs of samples which don't can
+ * be skipped in bulk. Samples are read in the same way the SIMD kernels
+ * read them: copied into a zeroed uint64_t.
+ */
+static gboolean first_stage_levels(struct soft_trigger_logic *stl,
+		uint64_t *mask, uint64_t *value)
+{
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	uint8_t m[sizeof(uint64_t)], v[sizeof(uint64_t)], bit;
+	GSList *l;
+	int idx;
+
+	if (stl->unitsize > (int)sizeof(uint64_t) || !stl->trigger->stages)
+		return FALSE;
+	stage = stl->trigger->stages->data;
+	if (!stage->matches)
+		return FALSE;
+
+	memset(m, 0, sizeof(m));
+	memset(v, 0, sizeof(v));
+	for (l = stage->matches; l; l = l->next) {
+		match = l->data;
+		if (!match->channel->enabled)
+			continue;
+		idx = match->channel->index;
+		if (idx / 8 >= stl->unitsize)
+			return FALSE;
+		bit = 1 << (idx % 8);
+		if (match->match == SR_TRIGGER_ZERO) {
+			if (v[idx / 8] & bit)
+				return FALSE; /* Can never match. */
+		} else if (match->match == SR_TRIGGER_ONE) {
+			if ((m[idx / 8] & bit) && !(v[idx / 8] & bit))
+				return FALSE; /* Can never match. */
+			v[idx / 8] |= bit;
+		} else {
+			return FALSE;
+		}
+		m[idx / 8] |= bit;
+	}
+	memcpy(mask, m, sizeof(*mask));
+	memcpy(value, v, sizeof(*value));
+
+	return TRUE;
+}
+
 /* Returns the offset (in samples) within buf of where the trigger
  * occurred, or -1 if not triggered. */
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
@@ -157,10 +218,28 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 	GSList *l, *l_stage;
 	int offset;
 	int i;
-	gboolean match_found;
+	gboolean match_found, levels;
+	uint64_t mask, value;
+	size_t n, skip;
+
+	levels = first_stage_levels(stl, &mask, &value);
 
 	offset = -1;
 	for (i = 0; i < len; i += stl->unitsize) {
+		if (levels && stl->cur_stage == 0 && i >= 0) {
+			/* Skip ahead to the first sample matching the first stage. */
+			n = (len - i) / stl->unitsize;
+			skip = sr_simd_get()->logic_find(buf + i, stl->unitsize,
+				n, mask, value);
+			if (skip > 0) {
+				stl->count += skip;
+				i += skip * stl->unitsize;
+				memcpy(stl->prev_sample, buf + i - stl->unitsize,
+					stl->unitsize);
+			}
+			if (skip == n)
+				break;
+		}
 		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
 		stage = l_stage->data;
 		if (!stage->matches)
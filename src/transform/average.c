@@ -0,0 +1,472 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reduces every N analog frames (data between SR_DF_FRAME_BEGIN and
+ * SR_DF_FRAME_END) to one. The values of each channel are accumulated
+ * per position within the frame. The reduced values are sent in place
+ * of the Nth frame's data, so frames are never buffered as a whole.
+ *
+ * Frames need not have the same length: the reduced frame has the
+ * length of the Nth frame, and each of its values is reduced over the
+ * frames that had a value at that position.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/average"
+
+enum average_mode {
+	MODE_MEAN,
+	MODE_MIN,
+	MODE_MAX,
+	/* Minimum and maximum, as two planes. */
+	MODE_ENVELOPE,
+	/* Exponential average, kept up across groups of frames. */
+	MODE_EMA,
+};
+
+static const char *mode_names[] = {
+	[MODE_MEAN] = "mean",
+	[MODE_MIN] = "min",
+	[MODE_MAX] = "max",
+	[MODE_ENVELOPE] = "envelope",
+	[MODE_EMA] = "ema",
+};
+
+struct channel_state {
+	/* Sum (mean), minimum (min, envelope) or average (ema). */
+	float *acc;
+	/* Maximum (max, envelope). */
+	float *acc_max;
+	/* Number of values summed up (mean). */
+	uint32_t *count;
+	/* Number of values allocated. */
+	size_t size;
+	/* Number of positions that have a value in the current group. */
+	size_t len;
+	/* Position within the current frame. */
+	size_t pos;
+};
+
+struct context {
+	enum average_mode mode;
+	uint32_t frames;
+	float alpha;
+	/* Index of the current frame within its group of frames. */
+	uint32_t frame;
+	gboolean in_frame;
+	/* The state of each channel, keyed by struct sr_channel. */
+	GHashTable *channels;
+	/* Scratch space for converting analog packets. */
+	float *fdata;
+	size_t fdata_size;
+
+	/* The reduced packet. */
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog_planar planar;
+	struct sr_datafeed_analog *planes;
+	struct sr_analog_encoding *encodings;
+	struct sr_analog_meaning *meanings;
+	struct sr_analog_spec *specs;
+	unsigned int max_planes;
+	float *data;
+	size_t data_size;
+};
+
+static void channel_state_free(struct channel_state *cs)
+{
+	g_free(cs->acc);
+	g_free(cs->acc_max);
+	g_free(cs->count);
+	g_free(cs);
+}
+
+static void channel_state_grow(const struct context *ctx,
+		struct channel_state *cs, size_t size)
+{
+	if (size <= cs->size)
+		return;
+
+	size = MAX(size, 2 * cs->size);
+	cs->acc = g_realloc(cs->acc, size * sizeof(float));
+	if (ctx->mode == MODE_MAX || ctx->mode == MODE_ENVELOPE)
+		cs->acc_max = g_realloc(cs->acc_max, size * sizeof(float));
+	if (ctx->mode == MODE_MEAN)
+		cs->count = g_realloc(cs->count, size * sizeof(uint32_t));
+	cs->size = size;
+}
+
+/*
+ * Add the next n values of a frame to a channel's state. The loops are
+ * kept free of branches and aliasing, so the compiler vectorizes them.
+ */
+static void accumulate(const struct context *ctx, struct channel_state *cs,
+		const float *restrict in, size_t n)
+{
+	float *restrict acc, *restrict acc_max;
+	uint32_t *restrict count;
+	const float alpha = ctx->alpha;
+	size_t i, seen;
+
+	channel_state_grow(ctx, cs, cs->pos + n);
+	acc = cs->acc + cs->pos;
+	acc_max = cs->acc_max ? cs->acc_max + cs->pos : NULL;
+	count = cs->count ? cs->count + cs->pos : NULL;
+
+	/* Positions that already have a value in this group. */
+	seen = cs->len > cs->pos ? MIN(n, cs->len - cs->pos) : 0;
+
+	switch (ctx->mode) {
+	case MODE_MEAN:
+		for (i = 0; i < seen; i++) {
+			acc[i] += in[i];
+			count[i]++;
+		}
+		for (i = seen; i < n; i++)
+			count[i] = 1;
+		break;
+	case MODE_MIN:
+		for (i = 0; i < seen; i++)
+			acc[i] = in[i] < acc[i] ? in[i] : acc[i];
+		break;
+	case MODE_MAX:
+		for (i = 0; i < seen; i++)
+			acc_max[i] = in[i] > acc_max[i] ? in[i] : acc_max[i];
+		break;
+	case MODE_ENVELOPE:
+		for (i = 0; i < seen; i++) {
+			acc[i] = in[i] < acc[i] ? in[i] : acc[i];
+			acc_max[i] = in[i] > acc_max[i] ? in[i] : acc_max[i];
+		}
+		break;
+	case MODE_EMA:
+		for (i = 0; i < seen; i++)
+			acc[i] += alpha * (in[i] - acc[i]);
+		break;
+	}
+
+	/* The others start out with this frame's values. */
+	memcpy(acc + seen, in + seen, (n - seen) * sizeof(float));
+	if (acc_max)
+		memcpy(acc_max + seen, in + seen, (n - seen) * sizeof(float));
+
+	cs->pos += n;
+	cs->len = MAX(cs->len, cs->pos);
+}
+
+/* Get the reduced values of the n positions before the current one. */
+static void reduce(const struct context *ctx, const struct channel_state *cs,
+		size_t n, float *restrict out, float *restrict out_max)
+{
+	const size_t start = cs->pos - n;
+	const float *restrict acc = cs->acc + start;
+	const uint32_t *restrict count;
+	size_t i;
+
+	switch (ctx->mode) {
+	case MODE_MEAN:
+		count = cs->count + start;
+		for (i = 0; i < n; i++)
+			out[i] = acc[i] / count[i];
+		break;
+	case MODE_MIN:
+	case MODE_EMA:
+		memcpy(out, acc, n * sizeof(float));
+		break;
+	case MODE_MAX:
+		memcpy(out, cs->acc_max + start, n * sizeof(float));
+		break;
+	case MODE_ENVELOPE:
+		memcpy(out, acc, n * sizeof(float));
+		memcpy(out_max, cs->acc_max + start, n * sizeof(float));
+		break;
+	}
+}
+
+static void start_frame(struct context *ctx)
+{
+	GHashTableIter iter;
+	gpointer value;
+	struct channel_state *cs;
+
+	g_hash_table_iter_init(&iter, ctx->channels);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		cs = value;
+		cs->pos = 0;
+		/* A new group starts from scratch, except for the EMA. */
+		if (ctx->frame == 0 && ctx->mode != MODE_EMA)
+			cs->len = 0;
+	}
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+	const char *mode;
+	unsigned int i;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	mode = g_variant_get_string(g_hash_table_lookup(options, "mode"), NULL);
+	for (i = 0; i < ARRAY_SIZE(mode_names); i++) {
+		if (!strcmp(mode, mode_names[i]))
+			break;
+	}
+	if (i == ARRAY_SIZE(mode_names)) {
+		sr_err("Unknown mode '%s'.", mode);
+		return SR_ERR_ARG;
+	}
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+	ctx->mode = i;
+	ctx->frames = g_variant_get_uint32(g_hash_table_lookup(options, "frames"));
+	if (!ctx->frames)
+		ctx->frames = 1;
+	ctx->alpha = 1.0 / ctx->frames;
+	ctx->channels = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+		NULL, (GDestroyNotify)channel_state_free);
+
+	return SR_OK;
+}
+
+/*
+ * Accumulate the planes of an analog packet. On the last frame of a
+ * group, returns a packet with the reduced values instead.
+ */
+static int process_planes(struct context *ctx,
+		const struct sr_datafeed_analog *in, unsigned int num_in,
+		uint32_t num_samples, gboolean planar,
+		struct sr_datafeed_packet **packet_out)
+{
+	const struct sr_analog_meaning *meaning;
+	struct channel_state *cs;
+	struct sr_datafeed_analog *out;
+	size_t n, total, offset;
+	unsigned int i, j, k, num_out, per_plane;
+	gboolean emit;
+	int ret;
+
+	emit = ctx->frame == ctx->frames - 1;
+	per_plane = ctx->mode == MODE_ENVELOPE ? 2 : 1;
+	num_out = num_in * per_plane;
+
+	if (emit) {
+		total = 0;
+		for (i = 0; i < num_in; i++)
+			total += (size_t)in[i].num_samples *
+				g_slist_length(in[i].meaning->channels);
+		total *= per_plane;
+		if (total > ctx->data_size) {
+			ctx->data = g_realloc(ctx->data, total * sizeof(float));
+			ctx->data_size = total;
+		}
+		if (num_out > ctx->max_planes) {
+			ctx->planes = g_realloc(ctx->planes,
+				num_out * sizeof(*ctx->planes));
+			ctx->encodings = g_realloc(ctx->encodings,
+				num_out * sizeof(*ctx->encodings));
+			ctx->meanings = g_realloc(ctx->meanings,
+				num_out * sizeof(*ctx->meanings));
+			ctx->specs = g_realloc(ctx->specs,
+				num_out * sizeof(*ctx->specs));
+			ctx->max_planes = num_out;
+		}
+	}
+
+	offset = 0;
+	k = 0;
+	for (i = 0; i < num_in; i++) {
+		meaning = in[i].meaning;
+		if (!meaning->channels) {
+			sr_warn("Analog data without channels, ignoring.");
+			continue;
+		}
+		n = (size_t)in[i].num_samples * g_slist_length(meaning->channels);
+		if (n > ctx->fdata_size) {
+			ctx->fdata = g_realloc(ctx->fdata, n * sizeof(float));
+			ctx->fdata_size = n;
+		}
+		if ((ret = sr_analog_to_float(&in[i], ctx->fdata)) != SR_OK)
+			return ret;
+
+		/* Interleaved channels are kept by their first channel. */
+		cs = g_hash_table_lookup(ctx->channels, meaning->channels->data);
+		if (!cs) {
+			cs = g_malloc0(sizeof(struct channel_state));
+			g_hash_table_insert(ctx->channels,
+				meaning->channels->data, cs);
+		}
+		accumulate(ctx, cs, ctx->fdata, n);
+		if (!emit)
+			continue;
+
+		reduce(ctx, cs, n, ctx->data + offset,
+			ctx->data + offset + n);
+		for (j = 0; j < per_plane; j++, k++) {
+			out = &ctx->planes[k];
+			sr_analog_init(out, &ctx->encodings[k], &ctx->meanings[k],
+				&ctx->specs[k], in[i].encoding->digits);
+			*out->meaning = *meaning;
+			*out->spec = *in[i].spec;
+			if (ctx->mode == MODE_MIN
+					|| (ctx->mode == MODE_ENVELOPE && j == 0))
+				out->meaning->mqflags |= SR_MQFLAG_MIN;
+			else if (ctx->mode == MODE_MAX || ctx->mode == MODE_ENVELOPE)
+				out->meaning->mqflags |= SR_MQFLAG_MAX;
+			else
+				out->meaning->mqflags |= SR_MQFLAG_AVG;
+			out->num_samples = in[i].num_samples;
+			out->data = ctx->data + offset;
+			offset += n;
+		}
+	}
+
+	if (!emit || !k) {
+		*packet_out = NULL;
+		return SR_OK;
+	}
+
+	if (planar || k > 1) {
+		ctx->planar.num_samples = num_samples;
+		ctx->planar.num_planes = k;
+		ctx->planar.planes = ctx->planes;
+		ctx->packet.type = SR_DF_ANALOG_PLANAR;
+		ctx->packet.payload = &ctx->planar;
+	} else {
+		ctx->packet.type = SR_DF_ANALOG;
+		ctx->packet.payload = ctx->planes;
+	}
+	*packet_out = &ctx->packet;
+
+	return SR_OK;
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_planar *planar;
+	gboolean last;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	*packet_out = packet_in;
+	last = ctx->frame == ctx->frames - 1;
+
+	switch (packet_in->type) {
+	case SR_DF_FRAME_BEGIN:
+		start_frame(ctx);
+		ctx->in_frame = TRUE;
+		/* The reduced frame goes where the group's last frame was. */
+		if (!last)
+			*packet_out = NULL;
+		break;
+	case SR_DF_FRAME_END:
+		ctx->in_frame = FALSE;
+		ctx->frame = last ? 0 : ctx->frame + 1;
+		if (!last)
+			*packet_out = NULL;
+		break;
+	case SR_DF_ANALOG:
+		/* Data outside of frames is passed on as it is. */
+		if (!ctx->in_frame)
+			break;
+		analog = packet_in->payload;
+		return process_planes(ctx, analog, 1, analog->num_samples,
+			FALSE, packet_out);
+	case SR_DF_ANALOG_PLANAR:
+		if (!ctx->in_frame)
+			break;
+		planar = packet_in->payload;
+		return process_planes(ctx, planar->planes, planar->num_planes,
+			planar->num_samples, TRUE, packet_out);
+	case SR_DF_END:
+		if (ctx->frame)
+			sr_dbg("Dropping %u frames of an incomplete group.",
+				ctx->frame);
+		ctx->frame = 0;
+		ctx->in_frame = FALSE;
+		g_hash_table_remove_all(ctx->channels);
+		break;
+	default:
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_hash_table_destroy(ctx->channels);
+	g_free(ctx->fdata);
+	g_free(ctx->planes);
+	g_free(ctx->encodings);
+	g_free(ctx->meanings);
+	g_free(ctx->specs);
+	g_free(ctx->data);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "frames", "Frames", "Number of frames to reduce to one", NULL, NULL },
+	{ "mode", "Mode", "How to reduce the frames", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	unsigned int i;
+
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_uint32(8));
+		options[1].def = g_variant_ref_sink(g_variant_new_string("mean"));
+		for (i = 0; i < ARRAY_SIZE(mode_names); i++)
+			options[1].values = g_slist_append(options[1].values,
+				g_variant_ref_sink(g_variant_new_string(mode_names[i])));
+	}
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_average = {
+	.id = "average",
+	.name = "Average",
+	.desc = "Reduce every N analog frames to their mean, minimum, "
+		"maximum, envelope or exponential average",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
@@ -24,15 +24,30 @@
 
 #define LOG_PREFIX "transform/invert"
 
+static int invert_analog(const struct sr_datafeed_analog *analog)
+{
+	int64_t p;
+	uint64_t q;
+
+	p = analog->encoding->scale.p;
+	q = analog->encoding->scale.q;
+	if (q > INT64_MAX)
+		return SR_ERR;
+	analog->encoding->scale.p = (p < 0) ? -q : q;
+	analog->encoding->scale.q = (p < 0) ? -p : p;
+
+	return SR_OK;
+}
+
 static int receive(const struct sr_transform *t,
 		struct sr_datafeed_packet *packet_in,
 		struct sr_datafeed_packet **packet_out)
 {
 	const struct sr_datafeed_logic *logic;
-	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_planar *planar;
 	uint8_t *b;
-	int64_t p;
-	uint64_t i, j, q;
+	uint64_t i, j;
+	int ret;
 
 	if (!t || !t->sdi || !packet_in || !packet_out)
 		return SR_ERR_ARG;
@@ -49,13 +64,15 @@ static int receive(const struct sr_transform *t,
 		}
 		break;
 	case SR_DF_ANALOG:
-		analog = packet_in->payload;
-		p = analog->encoding->scale.p;
-		q = analog->encoding->scale.q;
-		if (q > INT64_MAX)
-			return SR_ERR;
-		analog->encoding->scale.p = (p < 0) ? -q : q;
-		analog->encoding->scale.q = (p < 0) ? -p : p;
+		if ((ret = invert_analog(packet_in->payload)) != SR_OK)
+			return ret;
+		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet_in->payload;
+		for (i = 0; i < planar->num_planes; i++) {
+			if ((ret = invert_analog(&planar->planes[i])) != SR_OK)
+				return ret;
+		}
 		break;
 	default:
 		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
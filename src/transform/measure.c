@@ -0,0 +1,556 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replaces analog data by statistics over consecutive windows of a fixed
+ * number of samples. Each channel's window yields one value for each of
+ * the selected measurements, so the data volume shrinks by the window
+ * length.
+ *
+ * Frequency and period are derived from the rising crossings of the
+ * previous window's mean (zero for the first window). They are NAN for
+ * windows with fewer than two crossings, or when the samplerate is
+ * unknown.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/measure"
+
+enum measurement {
+	MEAS_MIN,
+	MEAS_MAX,
+	MEAS_MEAN,
+	MEAS_RMS,
+	MEAS_STDDEV,
+	MEAS_FREQUENCY,
+	MEAS_PERIOD,
+	MEAS_COUNT,
+};
+
+static const char *measurement_names[] = {
+	[MEAS_MIN] = "min",
+	[MEAS_MAX] = "max",
+	[MEAS_MEAN] = "mean",
+	[MEAS_RMS] = "rms",
+	[MEAS_STDDEV] = "stddev",
+	[MEAS_FREQUENCY] = "frequency",
+	[MEAS_PERIOD] = "period",
+};
+
+struct channel_state {
+	/* A list of just this channel, for the results' meaning. */
+	GSList *channels;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	int digits;
+
+	/* The current window. */
+	uint64_t count;
+	double sum;
+	double sum_sq;
+	float min;
+	float max;
+	float level;
+	float prev;
+	gboolean have_prev;
+	uint64_t rises;
+	uint64_t first_rise;
+	uint64_t last_rise;
+
+	/* Finished windows not sent yet, one value per measurement each. */
+	GArray *results;
+};
+
+struct context {
+	uint64_t window;
+	uint64_t samplerate;
+	enum measurement measurements[MEAS_COUNT];
+	unsigned int num_measurements;
+	gboolean crossings;
+	/* The state of each channel, keyed by struct sr_channel. */
+	GHashTable *channels;
+	/* The channels in the packet at hand, in order. */
+	GPtrArray *packet_channels;
+	float *fdata;
+	size_t fdata_size;
+
+	/* The packet with the results. */
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog_planar planar;
+	struct sr_datafeed_analog *planes;
+	struct sr_analog_encoding *encodings;
+	struct sr_analog_meaning *meanings;
+	struct sr_analog_spec *specs;
+	unsigned int max_planes;
+	float *data;
+	size_t data_size;
+};
+
+static void channel_state_free(struct channel_state *cs)
+{
+	g_slist_free(cs->channels);
+	g_array_free(cs->results, TRUE);
+	g_free(cs);
+}
+
+static void window_reset(struct channel_state *cs)
+{
+	cs->count = 0;
+	cs->sum = cs->sum_sq = 0;
+	cs->min = INFINITY;
+	cs->max = -INFINITY;
+	cs->rises = 0;
+}
+
+static void window_finish(const struct context *ctx, struct channel_state *cs)
+{
+	double mean, var, freq;
+	float value;
+	unsigned int i;
+
+	mean = cs->sum / cs->count;
+	var = MAX(cs->sum_sq / cs->count - mean * mean, 0.0);
+	freq = NAN;
+	if (cs->rises > 1 && ctx->samplerate)
+		freq = (double)(cs->rises - 1) * ctx->samplerate /
+			(cs->last_rise - cs->first_rise);
+
+	for (i = 0; i < ctx->num_measurements; i++) {
+		switch (ctx->measurements[i]) {
+		case MEAS_MIN:
+			value = cs->min;
+			break;
+		case MEAS_MAX:
+			value = cs->max;
+			break;
+		case MEAS_MEAN:
+			value = mean;
+			break;
+		case MEAS_RMS:
+			value = sqrt(cs->sum_sq / cs->count);
+			break;
+		case MEAS_STDDEV:
+			value = sqrt(var);
+			break;
+		case MEAS_FREQUENCY:
+			value = freq;
+			break;
+		case MEAS_PERIOD:
+			value = 1.0 / freq;
+			break;
+		default:
+			value = NAN;
+			break;
+		}
+		g_array_append_val(cs->results, value);
+	}
+
+	cs->level = mean;
+	window_reset(cs);
+}
+
+/*
+ * Add n values, every stride'th of in, to a channel's windows. The sums
+ * are double precision and added in sample order, so that long windows
+ * keep their precision. That, and the stride, keep the compiler from
+ * vectorizing the loop.
+ */
+static void accumulate(const struct context *ctx, struct channel_state *cs,
+		const float *in, size_t n, size_t stride)
+{
+	double sum, sum_sq;
+	float min, max, v, level, prev;
+	size_t i, len;
+
+	while (n) {
+		len = MIN(n, ctx->window - cs->count);
+
+		sum = sum_sq = 0;
+		min = cs->min;
+		max = cs->max;
+		for (i = 0; i < len; i++) {
+			v = in[i * stride];
+			sum += v;
+			sum_sq += (double)v * v;
+			min = v < min ? v : min;
+			max = v > max ? v : max;
+		}
+		cs->sum += sum;
+		cs->sum_sq += sum_sq;
+		cs->min = min;
+		cs->max = max;
+
+		if (ctx->crossings) {
+			level = cs->level;
+			prev = cs->have_prev ? cs->prev : in[0];
+			for (i = 0; i < len; i++) {
+				v = in[i * stride];
+				if (prev < level && v >= level) {
+					if (!cs->rises++)
+						cs->first_rise = cs->count + i;
+					cs->last_rise = cs->count + i;
+				}
+				prev = v;
+			}
+			cs->prev = prev;
+			cs->have_prev = TRUE;
+		}
+
+		cs->count += len;
+		if (cs->count == ctx->window)
+			window_finish(ctx, cs);
+		in += len * stride;
+		n -= len;
+	}
+}
+
+static struct channel_state *channel_state_get(struct context *ctx,
+		struct sr_channel *ch, const struct sr_datafeed_analog *analog)
+{
+	struct channel_state *cs;
+
+	if ((cs = g_hash_table_lookup(ctx->channels, ch)))
+		return cs;
+
+	cs = g_malloc0(sizeof(struct channel_state));
+	cs->channels = g_slist_append(NULL, ch);
+	cs->meaning = *analog->meaning;
+	cs->meaning.channels = cs->channels;
+	cs->spec = *analog->spec;
+	cs->digits = analog->encoding->digits;
+	cs->results = g_array_new(FALSE, FALSE, sizeof(float));
+	window_reset(cs);
+	g_hash_table_insert(ctx->channels, ch, cs);
+
+	return cs;
+}
+
+static void plane_init(struct context *ctx, unsigned int k,
+		const struct channel_state *cs, enum measurement m)
+{
+	struct sr_analog_meaning *meaning;
+	int digits;
+
+	digits = cs->digits;
+	if (m == MEAS_FREQUENCY)
+		digits = 3;
+	else if (m == MEAS_PERIOD)
+		digits = 9;
+	sr_analog_init(&ctx->planes[k], &ctx->encodings[k], &ctx->meanings[k],
+		&ctx->specs[k], digits);
+	*ctx->planes[k].spec = cs->spec;
+
+	meaning = ctx->planes[k].meaning;
+	*meaning = cs->meaning;
+	switch (m) {
+	case MEAS_MIN:
+		meaning->mqflags |= SR_MQFLAG_MIN;
+		break;
+	case MEAS_MAX:
+		meaning->mqflags |= SR_MQFLAG_MAX;
+		break;
+	case MEAS_MEAN:
+		meaning->mqflags |= SR_MQFLAG_AVG;
+		break;
+	case MEAS_RMS:
+		meaning->mqflags |= SR_MQFLAG_RMS;
+		break;
+	case MEAS_STDDEV:
+		/* The standard deviation is the RMS of the AC component. */
+		meaning->mqflags |= SR_MQFLAG_RMS | SR_MQFLAG_AC;
+		break;
+	case MEAS_FREQUENCY:
+		meaning->mq = SR_MQ_FREQUENCY;
+		meaning->unit = SR_UNIT_HERTZ;
+		meaning->mqflags = 0;
+		break;
+	case MEAS_PERIOD:
+		meaning->mq = SR_MQ_TIME;
+		meaning->unit = SR_UNIT_SECOND;
+		meaning->mqflags = 0;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Send the finished windows of the channels in the packet at hand. All
+ * planes of a packet have the same number of samples, so channels that
+ * are ahead keep their surplus results for the next packet.
+ */
+static void send_results(struct context *ctx,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct channel_state *cs;
+	const float *row;
+	float *out;
+	unsigned int i, m, k, num_planes, num_rows, rows;
+
+	num_planes = num_rows = 0;
+	for (i = 0; i < ctx->packet_channels->len; i++) {
+		cs = g_ptr_array_index(ctx->packet_channels, i);
+		rows = cs->results->len / ctx->num_measurements;
+		if (!rows)
+			continue;
+		num_rows = num_rows ? MIN(num_rows, rows) : rows;
+		num_planes += ctx->num_measurements;
+	}
+	if (!num_planes) {
+		*packet_out = NULL;
+		return;
+	}
+
+	if (num_planes > ctx->max_planes) {
+		ctx->planes = g_realloc(ctx->planes,
+			num_planes * sizeof(*ctx->planes));
+		ctx->encodings = g_realloc(ctx->encodings,
+			num_planes * sizeof(*ctx->encodings));
+		ctx->meanings = g_realloc(ctx->meanings,
+			num_planes * sizeof(*ctx->meanings));
+		ctx->specs = g_realloc(ctx->specs,
+			num_planes * sizeof(*ctx->specs));
+		ctx->max_planes = num_planes;
+	}
+	if ((size_t)num_planes * num_rows > ctx->data_size) {
+		ctx->data_size = (size_t)num_planes * num_rows;
+		ctx->data = g_realloc(ctx->data, ctx->data_size * sizeof(float));
+	}
+
+	k = 0;
+	for (i = 0; i < ctx->packet_channels->len; i++) {
+		cs = g_ptr_array_index(ctx->packet_channels, i);
+		if (!cs->results->len)
+			continue;
+		for (m = 0; m < ctx->num_measurements; m++, k++) {
+			plane_init(ctx, k, cs, ctx->measurements[m]);
+			out = ctx->data + (size_t)k * num_rows;
+			for (rows = 0; rows < num_rows; rows++) {
+				row = &g_array_index(cs->results, float,
+					rows * ctx->num_measurements);
+				out[rows] = row[m];
+			}
+			ctx->planes[k].data = out;
+			ctx->planes[k].num_samples = num_rows;
+		}
+		g_array_remove_range(cs->results, 0,
+			num_rows * ctx->num_measurements);
+	}
+
+	if (num_planes > 1) {
+		ctx->planar.num_samples = num_rows;
+		ctx->planar.num_planes = num_planes;
+		ctx->planar.planes = ctx->planes;
+		ctx->packet.type = SR_DF_ANALOG_PLANAR;
+		ctx->packet.payload = &ctx->planar;
+	} else {
+		ctx->packet.type = SR_DF_ANALOG;
+		ctx->packet.payload = ctx->planes;
+	}
+	*packet_out = &ctx->packet;
+}
+
+static int process_planes(struct context *ctx,
+		const struct sr_datafeed_analog *in, unsigned int num_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct channel_state *cs;
+	GSList *l;
+	size_t n, stride, c;
+	unsigned int i;
+	int ret;
+
+	g_ptr_array_set_size(ctx->packet_channels, 0);
+	for (i = 0; i < num_in; i++) {
+		stride = g_slist_length(in[i].meaning->channels);
+		if (!stride) {
+			sr_warn("Analog data without channels, ignoring.");
+			continue;
+		}
+		n = (size_t)in[i].num_samples * stride;
+		if (n > ctx->fdata_size) {
+			ctx->fdata = g_realloc(ctx->fdata, n * sizeof(float));
+			ctx->fdata_size = n;
+		}
+		if ((ret = sr_analog_to_float(&in[i], ctx->fdata)) != SR_OK)
+			return ret;
+
+		/* Interleaved channels get a window each. */
+		for (l = in[i].meaning->channels, c = 0; l; l = l->next, c++) {
+			cs = channel_state_get(ctx, l->data, &in[i]);
+			accumulate(ctx, cs, ctx->fdata + c, in[i].num_samples,
+				stride);
+			g_ptr_array_add(ctx->packet_channels, cs);
+		}
+	}
+
+	send_results(ctx, packet_out);
+
+	return SR_OK;
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+	GVariant *gvar;
+	char **names;
+	unsigned int i, m;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+	ctx->window = g_variant_get_uint64(g_hash_table_lookup(options, "window"));
+	if (!ctx->window)
+		ctx->window = 1;
+
+	names = g_strsplit(g_variant_get_string(g_hash_table_lookup(options,
+		"measurements"), NULL), ",", 0);
+	for (i = 0; names[i]; i++) {
+		g_strstrip(names[i]);
+		for (m = 0; m < MEAS_COUNT; m++) {
+			if (!strcmp(names[i], measurement_names[m]))
+				break;
+		}
+		if (m == MEAS_COUNT || ctx->num_measurements == MEAS_COUNT) {
+			sr_err("Invalid measurement '%s'.", names[i]);
+			g_strfreev(names);
+			g_free(ctx);
+			t->priv = NULL;
+			return SR_ERR_ARG;
+		}
+		ctx->measurements[ctx->num_measurements++] = m;
+		if (m == MEAS_FREQUENCY || m == MEAS_PERIOD)
+			ctx->crossings = TRUE;
+	}
+	g_strfreev(names);
+	if (!ctx->num_measurements) {
+		sr_err("No measurements selected.");
+		g_free(ctx);
+		t->priv = NULL;
+		return SR_ERR_ARG;
+	}
+
+	if (sr_config_get(t->sdi->driver, t->sdi, NULL, SR_CONF_SAMPLERATE,
+			&gvar) == SR_OK) {
+		ctx->samplerate = g_variant_get_uint64(gvar);
+		g_variant_unref(gvar);
+	}
+
+	ctx->channels = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+		NULL, (GDestroyNotify)channel_state_free);
+	ctx->packet_channels = g_ptr_array_new();
+
+	return SR_OK;
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_analog_planar *planar;
+	const struct sr_config *src;
+	GSList *l;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	*packet_out = packet_in;
+
+	switch (packet_in->type) {
+	case SR_DF_META:
+		meta = packet_in->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				ctx->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_ANALOG:
+		return process_planes(ctx, packet_in->payload, 1, packet_out);
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet_in->payload;
+		return process_planes(ctx, planar->planes, planar->num_planes,
+			packet_out);
+	case SR_DF_END:
+		/* Incomplete windows are dropped. */
+		g_hash_table_remove_all(ctx->channels);
+		break;
+	default:
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_hash_table_destroy(ctx->channels);
+	g_ptr_array_free(ctx->packet_channels, TRUE);
+	g_free(ctx->fdata);
+	g_free(ctx->planes);
+	g_free(ctx->encodings);
+	g_free(ctx->meanings);
+	g_free(ctx->specs);
+	g_free(ctx->data);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "window", "Window", "Number of samples per measurement", NULL, NULL },
+	{ "measurements", "Measurements", "Comma-separated list of measurements "
+		"(min, max, mean, rms, stddev, frequency, period)", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_uint64(1000));
+		options[1].def = g_variant_ref_sink(g_variant_new_string("min,max,mean,rms"));
+	}
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_measure = {
+	.id = "measure",
+	.name = "Measure",
+	.desc = "Replace analog data by windowed min/max/mean/RMS, "
+		"standard deviation, frequency and period",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
@@ -0,0 +1,571 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replaces logic data by the timing of each enabled channel's edges,
+ * sent once per interval of a fixed number of samples.
+ *
+ * In "stats" mode, every interval yields one value per channel for each
+ * of frequency, period, duty cycle and (high) pulse width. Frequency and
+ * period need two rising edges in the interval, pulse width one complete
+ * high pulse, or they are NAN.
+ *
+ * In "edges" mode, every channel's plane lists the times of its edges in
+ * seconds since the start of the first interval sent. Falling edges are
+ * negative, so their sign bit tells them apart (also for -0.0). Planes of
+ * channels with fewer edges are padded with NAN.
+ *
+ * Edges are tracked across packets; pulses may span intervals.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/pulse"
+
+/* Logic samples are scanned in words of up to 64 bits. */
+#define MAX_CHANNELS 64
+
+enum pulse_stat {
+	STAT_FREQUENCY,
+	STAT_PERIOD,
+	STAT_DUTY_CYCLE,
+	STAT_PULSE_WIDTH,
+	NUM_STATS,
+};
+
+struct channel_state {
+	struct sr_channel *ch;
+	GSList *channels;
+	gboolean high;
+	uint64_t last_edge;
+	gboolean have_rise;
+	uint64_t prev_rise;
+
+	/* The current interval. */
+	uint64_t high_samples;
+	uint64_t rises;
+	uint64_t first_rise;
+	uint64_t last_rise;
+	uint64_t width_sum;
+	uint64_t width_count;
+
+	/* Finished intervals' statistics not sent yet. */
+	GArray *results;
+	/* Edges not sent yet, as sample number << 1 | falling. */
+	GArray *edges;
+};
+
+struct context {
+	gboolean edges;
+	uint64_t interval;
+	uint64_t samplerate;
+	struct channel_state *channels;
+	unsigned int num_channels;
+	/* The channel for each bit of a sample, or -1. */
+	int bit_channel[MAX_CHANNELS];
+	uint64_t mask;
+
+	/* Absolute number of the next sample. */
+	uint64_t sample;
+	uint64_t prev;
+	gboolean have_prev;
+	uint64_t interval_start;
+	/* Start and end of the intervals not sent yet. */
+	uint64_t batch_start;
+	uint64_t batch_end;
+	unsigned int batch_intervals;
+
+	/* The packet with the results. */
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog_planar planar;
+	struct sr_datafeed_analog *planes;
+	struct sr_analog_encoding *encodings;
+	struct sr_analog_meaning *meanings;
+	struct sr_analog_spec *specs;
+	float *data;
+	size_t data_size;
+};
+
+static void channels_free(struct context *ctx)
+{
+	unsigned int i;
+
+	for (i = 0; i < ctx->num_channels; i++) {
+		g_slist_free(ctx->channels[i].channels);
+		g_array_free(ctx->channels[i].results, TRUE);
+		g_array_free(ctx->channels[i].edges, TRUE);
+	}
+	g_free(ctx->channels);
+	g_free(ctx->planes);
+	g_free(ctx->encodings);
+	g_free(ctx->meanings);
+	g_free(ctx->specs);
+	ctx->channels = NULL;
+	ctx->num_channels = 0;
+}
+
+static void channels_setup(struct context *ctx, const struct sr_dev_inst *sdi)
+{
+	struct sr_channel *const *channels;
+	struct channel_state *cs;
+	unsigned int i, count, num_planes;
+
+	channels_free(ctx);
+	memset(ctx->bit_channel, -1, sizeof(ctx->bit_channel));
+	ctx->mask = 0;
+
+	channels = sr_dev_inst_enabled_channels_get(sdi, SR_CHANNEL_LOGIC, &count);
+	ctx->channels = g_malloc0_n(MAX(count, 1), sizeof(struct channel_state));
+	for (i = 0; i < count; i++) {
+		if (channels[i]->index >= MAX_CHANNELS) {
+			sr_warn("Ignoring channel %s, only the first %d "
+				"logic channels are supported.",
+				channels[i]->name, MAX_CHANNELS);
+			continue;
+		}
+		cs = &ctx->channels[ctx->num_channels];
+		cs->ch = channels[i];
+		cs->channels = g_slist_append(NULL, channels[i]);
+		cs->results = g_array_new(FALSE, FALSE, sizeof(float));
+		cs->edges = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+		ctx->bit_channel[channels[i]->index] = ctx->num_channels++;
+		ctx->mask |= UINT64_C(1) << channels[i]->index;
+	}
+
+	num_planes = ctx->num_channels * (ctx->edges ? 1 : NUM_STATS);
+	ctx->planes = g_malloc0_n(MAX(num_planes, 1), sizeof(*ctx->planes));
+	ctx->encodings = g_malloc0_n(MAX(num_planes, 1), sizeof(*ctx->encodings));
+	ctx->meanings = g_malloc0_n(MAX(num_planes, 1), sizeof(*ctx->meanings));
+	ctx->specs = g_malloc0_n(MAX(num_planes, 1), sizeof(*ctx->specs));
+}
+
+static void acquisition_reset(struct context *ctx)
+{
+	struct channel_state *cs;
+	unsigned int i;
+
+	ctx->sample = ctx->interval_start = 0;
+	ctx->batch_start = ctx->batch_end = 0;
+	ctx->batch_intervals = 0;
+	ctx->have_prev = FALSE;
+	for (i = 0; i < ctx->num_channels; i++) {
+		cs = &ctx->channels[i];
+		cs->high = cs->have_rise = FALSE;
+		cs->last_edge = 0;
+		cs->high_samples = cs->rises = 0;
+		cs->width_sum = cs->width_count = 0;
+		g_array_set_size(cs->results, 0);
+		g_array_set_size(cs->edges, 0);
+	}
+}
+
+static void edge(struct context *ctx, struct channel_state *cs, uint64_t t)
+{
+	uint64_t e;
+
+	if (cs->high)
+		cs->high_samples += t - MAX(cs->last_edge, ctx->interval_start);
+	cs->high = !cs->high;
+	cs->last_edge = t;
+
+	if (cs->high) {
+		if (!cs->rises++)
+			cs->first_rise = t;
+		cs->last_rise = t;
+		cs->prev_rise = t;
+		cs->have_rise = TRUE;
+	} else if (cs->have_rise) {
+		cs->width_sum += t - cs->prev_rise;
+		cs->width_count++;
+	}
+
+	if (ctx->edges) {
+		e = t << 1 | !cs->high;
+		g_array_append_val(cs->edges, e);
+	}
+}
+
+static void interval_finish(struct context *ctx)
+{
+	struct channel_state *cs;
+	uint64_t end;
+	float stats[NUM_STATS];
+	double period;
+	unsigned int i;
+
+	end = ctx->interval_start + ctx->interval;
+	for (i = 0; i < ctx->num_channels; i++) {
+		cs = &ctx->channels[i];
+		if (cs->high)
+			cs->high_samples += end - MAX(cs->last_edge,
+				ctx->interval_start);
+		if (!ctx->edges) {
+			period = NAN;
+			if (cs->rises > 1 && ctx->samplerate)
+				period = (double)(cs->last_rise - cs->first_rise) /
+					(cs->rises - 1) / ctx->samplerate;
+			stats[STAT_FREQUENCY] = 1.0 / period;
+			stats[STAT_PERIOD] = period;
+			stats[STAT_DUTY_CYCLE] = 100.0 * cs->high_samples /
+				ctx->interval;
+			stats[STAT_PULSE_WIDTH] = NAN;
+			if (cs->width_count && ctx->samplerate)
+				stats[STAT_PULSE_WIDTH] = (double)cs->width_sum /
+					cs->width_count / ctx->samplerate;
+			g_array_append_vals(cs->results, stats, NUM_STATS);
+		}
+		cs->high_samples = cs->rises = 0;
+		cs->width_sum = cs->width_count = 0;
+	}
+
+	ctx->interval_start = ctx->batch_end = end;
+	ctx->batch_intervals++;
+}
+
+/* A sample, repeated over a 64-bit word. */
+static uint64_t replicate(uint64_t sample, unsigned int unitsize,
+		unsigned int per_word)
+{
+	uint64_t pattern;
+	unsigned int i;
+
+	pattern = sample;
+	for (i = 1; i < per_word; i++)
+		pattern |= sample << (i * unitsize * 8);
+
+	return pattern;
+}
+
+/*
+ * Look for transitions in a run of samples. Runs of unchanged samples
+ * are skipped a 64-bit word at a time, and only changed bits are looked
+ * at in the others.
+ */
+static void scan(struct context *ctx, const uint8_t *data,
+		unsigned int unitsize, uint64_t num_samples)
+{
+	struct channel_state *cs;
+	uint64_t i, cur, diff, pattern;
+	unsigned int bit, per_word;
+
+	per_word = unitsize <= 8 && !(8 % unitsize) ? 8 / unitsize : 0;
+	pattern = replicate(ctx->prev, unitsize, per_word);
+
+	for (i = 0; i < num_samples; i++) {
+		if (per_word && ctx->have_prev) {
+			while (i + per_word <= num_samples
+					&& RL64(data + i * unitsize) == pattern)
+				i += per_word;
+			if (i == num_samples)
+				break;
+		}
+
+		switch (unitsize) {
+		case 1:
+			cur = R8(data + i);
+			break;
+		case 2:
+			cur = RL16(data + 2 * i);
+			break;
+		case 4:
+			cur = RL32(data + 4 * i);
+			break;
+		default:
+			cur = 0;
+			memcpy(&cur, data + i * unitsize, MIN(unitsize, 8));
+			cur = GUINT64_FROM_LE(cur);
+			break;
+		}
+
+		if (!ctx->have_prev) {
+			/* The first sample sets the levels, without edges. */
+			for (diff = cur & ctx->mask; diff; diff &= diff - 1) {
+				bit = __builtin_ctzll(diff);
+				ctx->channels[ctx->bit_channel[bit]].high = TRUE;
+			}
+			ctx->have_prev = TRUE;
+		} else if (cur == ctx->prev) {
+			continue;
+		} else {
+			for (diff = (cur ^ ctx->prev) & ctx->mask; diff; diff &= diff - 1) {
+				bit = __builtin_ctzll(diff);
+				cs = &ctx->channels[ctx->bit_channel[bit]];
+				edge(ctx, cs, ctx->sample + i);
+			}
+		}
+		ctx->prev = cur;
+		pattern = replicate(cur, unitsize, per_word);
+	}
+
+	ctx->sample += num_samples;
+}
+
+static void process_logic(struct context *ctx,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *data;
+	uint64_t num_samples, len;
+
+	data = logic->data;
+	num_samples = logic->length / logic->unitsize;
+	while (num_samples) {
+		len = MIN(num_samples,
+			ctx->interval_start + ctx->interval - ctx->sample);
+		scan(ctx, data, logic->unitsize, len);
+		if (ctx->sample == ctx->interval_start + ctx->interval)
+			interval_finish(ctx);
+		data += len * logic->unitsize;
+		num_samples -= len;
+	}
+}
+
+static void plane_init(struct context *ctx, unsigned int k,
+		struct channel_state *cs, int mq, int unit, int digits,
+		uint32_t num_samples, float *data)
+{
+	struct sr_analog_meaning *meaning;
+
+	sr_analog_init(&ctx->planes[k], &ctx->encodings[k], &ctx->meanings[k],
+		&ctx->specs[k], digits);
+	meaning = ctx->planes[k].meaning;
+	meaning->mq = mq;
+	meaning->unit = unit;
+	meaning->mqflags = 0;
+	meaning->channels = cs->channels;
+	ctx->planes[k].num_samples = num_samples;
+	ctx->planes[k].data = data;
+}
+
+static void send_results(struct context *ctx,
+		struct sr_datafeed_packet **packet_out)
+{
+	static const int stat_mq[] = { SR_MQ_FREQUENCY, SR_MQ_TIME,
+		SR_MQ_DUTY_CYCLE, SR_MQ_PULSE_WIDTH };
+	static const int stat_unit[] = { SR_UNIT_HERTZ, SR_UNIT_SECOND,
+		SR_UNIT_PERCENTAGE, SR_UNIT_SECOND };
+	static const int stat_digits[] = { 3, 9, 1, 9 };
+	struct channel_state *cs;
+	const float *results;
+	const uint64_t *edges;
+	float *out;
+	double time;
+	unsigned int i, j, s, k, num_planes, num_rows, len;
+
+	*packet_out = NULL;
+	if (!ctx->batch_intervals || !ctx->num_channels)
+		return;
+
+	num_rows = 0;
+	if (ctx->edges) {
+		/* Edges past the intervals sent belong to the next batch. */
+		for (i = 0; i < ctx->num_channels; i++) {
+			cs = &ctx->channels[i];
+			edges = (const uint64_t *)cs->edges->data;
+			for (len = cs->edges->len; len; len--) {
+				if (edges[len - 1] >> 1 < ctx->batch_end)
+					break;
+			}
+			num_rows = MAX(num_rows, len);
+		}
+		num_planes = ctx->num_channels;
+		if (!num_rows) {
+			ctx->batch_start = ctx->batch_end;
+			ctx->batch_intervals = 0;
+			return;
+		}
+	} else {
+		num_rows = ctx->batch_intervals;
+		num_planes = ctx->num_channels * NUM_STATS;
+	}
+	if ((size_t)num_planes * num_rows > ctx->data_size) {
+		ctx->data_size = (size_t)num_planes * num_rows;
+		ctx->data = g_realloc(ctx->data, ctx->data_size * sizeof(float));
+	}
+
+	k = 0;
+	for (i = 0; i < ctx->num_channels; i++) {
+		cs = &ctx->channels[i];
+		results = (const float *)cs->results->data;
+		if (ctx->edges) {
+			out = ctx->data + (size_t)k * num_rows;
+			edges = (const uint64_t *)cs->edges->data;
+			for (len = 0; len < cs->edges->len; len++) {
+				if (edges[len] >> 1 >= ctx->batch_end)
+					break;
+				time = ctx->samplerate ? (double)((edges[len] >> 1)
+					- ctx->batch_start) / ctx->samplerate : NAN;
+				out[len] = edges[len] & 1 ? -time : time;
+			}
+			for (j = len; j < num_rows; j++)
+				out[j] = NAN;
+			plane_init(ctx, k++, cs, SR_MQ_TIME, SR_UNIT_SECOND, 9,
+				num_rows, out);
+			g_array_remove_range(cs->edges, 0, len);
+			continue;
+		}
+		for (s = 0; s < NUM_STATS; s++, k++) {
+			out = ctx->data + (size_t)k * num_rows;
+			for (j = 0; j < num_rows; j++)
+				out[j] = results[j * NUM_STATS + s];
+			plane_init(ctx, k, cs, stat_mq[s], stat_unit[s],
+				stat_digits[s], num_rows, out);
+		}
+		g_array_set_size(cs->results, 0);
+	}
+
+	ctx->batch_start = ctx->batch_end;
+	ctx->batch_intervals = 0;
+
+	if (num_planes > 1) {
+		ctx->planar.num_samples = num_rows;
+		ctx->planar.num_planes = num_planes;
+		ctx->planar.planes = ctx->planes;
+		ctx->packet.type = SR_DF_ANALOG_PLANAR;
+		ctx->packet.payload = &ctx->planar;
+	} else {
+		ctx->packet.type = SR_DF_ANALOG;
+		ctx->packet.payload = ctx->planes;
+	}
+	*packet_out = &ctx->packet;
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+	GVariant *gvar;
+	const char *mode;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	mode = g_variant_get_string(g_hash_table_lookup(options, "mode"), NULL);
+	if (strcmp(mode, "stats") && strcmp(mode, "edges")) {
+		sr_err("Unknown mode '%s'.", mode);
+		return SR_ERR_ARG;
+	}
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+	ctx->edges = !strcmp(mode, "edges");
+	ctx->interval = g_variant_get_uint64(g_hash_table_lookup(options,
+		"interval"));
+	if (!ctx->interval)
+		ctx->interval = 1;
+
+	if (sr_config_get(t->sdi->driver, t->sdi, NULL, SR_CONF_SAMPLERATE,
+			&gvar) == SR_OK) {
+		ctx->samplerate = g_variant_get_uint64(gvar);
+		g_variant_unref(gvar);
+	}
+
+	channels_setup(ctx, t->sdi);
+
+	return SR_OK;
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_config *src;
+	GSList *l;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	*packet_out = packet_in;
+
+	switch (packet_in->type) {
+	case SR_DF_HEADER:
+		/* Channels may have been changed since init(). */
+		channels_setup(ctx, t->sdi);
+		acquisition_reset(ctx);
+		break;
+	case SR_DF_META:
+		meta = packet_in->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				ctx->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		process_logic(ctx, packet_in->payload);
+		send_results(ctx, packet_out);
+		break;
+	case SR_DF_END:
+		acquisition_reset(ctx);
+		break;
+	default:
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	channels_free(ctx);
+	g_free(ctx->data);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "interval", "Interval", "Number of samples per interval", NULL, NULL },
+	{ "mode", "Mode", "Send statistics or edge times", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_uint64(1000000));
+		options[1].def = g_variant_ref_sink(g_variant_new_string("stats"));
+		options[1].values = g_slist_append(options[1].values,
+			g_variant_ref_sink(g_variant_new_string("stats")));
+		options[1].values = g_slist_append(options[1].values,
+			g_variant_ref_sink(g_variant_new_string("edges")));
+	}
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_pulse = {
+	.id = "pulse",
+	.name = "Pulse",
+	.desc = "Replace logic data by edge times or frequency, period, "
+		"duty cycle and pulse width statistics",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
@@ -49,6 +49,8 @@ static int receive(const struct sr_transform *t,
 {
 	struct context *ctx;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_planar *planar;
+	unsigned int i;
 
 	if (!t || !t->sdi || !packet_in || !packet_out)
 		return SR_ERR_ARG;
@@ -60,6 +62,14 @@ static int receive(const struct sr_transform *t,
 		analog->encoding->scale.p *= ctx->factor.p;
 		analog->encoding->scale.q *= ctx->factor.q;
 		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet_in->payload;
+		for (i = 0; i < planar->num_planes; i++) {
+			analog = &planar->planes[i];
+			analog->encoding->scale.p *= ctx->factor.p;
+			analog->encoding->scale.q *= ctx->factor.q;
+		}
+		break;
 	default:
 		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
 		break;
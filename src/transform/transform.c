@@ -45,12 +45,18 @@
 extern SR_PRIV struct sr_transform_module transform_nop;
 extern SR_PRIV struct sr_transform_module transform_scale;
 extern SR_PRIV struct sr_transform_module transform_invert;
+extern SR_PRIV struct sr_transform_module transform_average;
+extern SR_PRIV struct sr_transform_module transform_measure;
+extern SR_PRIV struct sr_transform_module transform_pulse;
 /* @endcond */
 
 static const struct sr_transform_module *transform_module_list[] = {
 	&transform_nop,
 	&transform_scale,
 	&transform_invert,
+	&transform_average,
+	&transform_measure,
+	&transform_pulse,
 	NULL,
 };
 
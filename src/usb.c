@@ -19,7 +19,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE /* For CPU_SET(). */
+#include <sched.h>
+#endif
 #include <config.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <memory.h>
 #include <glib.h>
@@ -37,6 +42,37 @@
 typedef int libusb_os_handle;
 #endif
 
+/* Interval at which the event thread checks whether to stop [ms]. */
+#define EVENT_THREAD_POLL_MS 100
+
+/** Thread servicing libusb events, and the packets it queued up for the
+ * session's main loop.
+ * @internal
+ */
+struct usb_event_thread {
+	struct sr_session *session;
+	struct sr_context *ctx;
+	struct libusb_context *usb_ctx;
+	GThread *thread;
+	int priority;
+	int cpu;
+	/* Set to make the thread exit. */
+	int stop;
+	/* struct deferred_packet items, in order. */
+	GAsyncQueue *queue;
+	/* Whether the main loop is passing queued packets on. */
+	gboolean draining;
+};
+
+/** A packet sent while the event thread was running.
+ * @internal
+ */
+struct deferred_packet {
+	const struct sr_dev_inst *sdi;
+	/* A copy of the packet, or NULL to remove the USB event source. */
+	struct sr_datafeed_packet *packet;
+};
+
 /** Custom GLib event source for libusb I/O.
  * @internal
  */
@@ -51,8 +87,183 @@ struct usb_source {
 
 	struct libusb_context *usb_ctx;
 	GPtrArray *pollfds;
+
+	/* The event thread servicing libusb, or NULL for polling here. */
+	struct usb_event_thread *event_thread;
 };
 
+static void usb_event_thread_setup(const struct usb_event_thread *et)
+{
+#ifdef __linux__
+	struct sched_param param;
+	cpu_set_t cpus;
+
+	/* On Linux, these apply to the calling thread only. */
+	if (et->priority > 0) {
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = et->priority;
+		if (sched_setscheduler(0, SCHED_FIFO, &param) < 0)
+			sr_warn("Failed to set real-time priority %d: %s.",
+				et->priority, g_strerror(errno));
+	}
+	if (et->cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(et->cpu, &cpus);
+		if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0)
+			sr_warn("Failed to pin USB event thread to CPU %d: %s.",
+				et->cpu, g_strerror(errno));
+	}
+#else
+	if (et->priority > 0 || et->cpu >= 0)
+		sr_warn("USB event thread priority and CPU affinity are "
+			"only supported on Linux.");
+#endif
+}
+
+static gpointer usb_event_thread_run(gpointer data)
+{
+	struct usb_event_thread *et;
+	struct timeval tv;
+
+	et = data;
+	usb_event_thread_setup(et);
+
+	while (!g_atomic_int_get(&et->stop)) {
+		tv.tv_sec = 0;
+		tv.tv_usec = EVENT_THREAD_POLL_MS * 1000;
+		libusb_handle_events_timeout_completed(et->usb_ctx, &tv,
+			&et->stop);
+	}
+
+	return NULL;
+}
+
+static void usb_event_thread_wakeup(struct sr_session *session)
+{
+	g_mutex_lock(&session->main_mutex);
+	if (session->main_context)
+		g_main_context_wakeup(session->main_context);
+	g_mutex_unlock(&session->main_mutex);
+}
+
+static struct usb_event_thread *usb_event_thread_start(
+		struct sr_session *session, struct sr_context *ctx)
+{
+	struct usb_event_thread *et;
+	GError *error;
+
+	et = g_malloc0(sizeof(struct usb_event_thread));
+	et->session = session;
+	et->ctx = ctx;
+	et->usb_ctx = sr_usb_context(ctx);
+	et->priority = session->usb_thread_priority;
+	et->cpu = session->usb_thread_cpu;
+	et->queue = g_async_queue_new();
+
+	/*
+	 * Packets get queued as soon as the thread may send them, and the
+	 * drivers' event pumps stand down.
+	 */
+	session->usb_thread = et;
+	g_atomic_int_inc(&ctx->usb_event_threads);
+
+	error = NULL;
+	et->thread = g_thread_try_new("sr-usb-events", usb_event_thread_run,
+		et, &error);
+	if (!et->thread) {
+		sr_err("Failed to start USB event thread: %s.", error->message);
+		g_error_free(error);
+		session->usb_thread = NULL;
+		g_atomic_int_add(&ctx->usb_event_threads, -1);
+		g_async_queue_unref(et->queue);
+		g_free(et);
+		return NULL;
+	}
+	sr_dbg("Started USB event thread.");
+
+	return et;
+}
+
+/*
+ * Pass the queued packets on to the session. Returns TRUE if the USB
+ * event source is to be removed.
+ */
+static gboolean usb_event_thread_drain(struct usb_event_thread *et)
+{
+	struct deferred_packet *item;
+	gboolean remove;
+
+	remove = FALSE;
+	et->draining = TRUE;
+	while ((item = g_async_queue_try_pop(et->queue))) {
+		if (item->packet) {
+			sr_session_send(item->sdi, item->packet);
+			sr_packet_free(item->packet);
+		} else {
+			remove = TRUE;
+		}
+		g_free(item);
+	}
+	et->draining = FALSE;
+
+	return remove;
+}
+
+static void usb_event_thread_stop(struct usb_event_thread *et)
+{
+	g_atomic_int_set(&et->stop, 1);
+#if (LIBUSB_API_VERSION >= 0x01000105)
+	libusb_interrupt_event_handler(et->usb_ctx);
+#endif
+	g_thread_join(et->thread);
+	g_atomic_int_add(&et->ctx->usb_event_threads, -1);
+	sr_dbg("Stopped USB event thread.");
+
+	/* Whatever is still queued goes out directly. */
+	et->session->usb_thread = NULL;
+	usb_event_thread_drain(et);
+
+	g_async_queue_unref(et->queue);
+	g_free(et);
+}
+
+/** Queue a packet for the session's main loop, if need be.
+ *
+ * While the event thread runs, all packets go through its queue, so
+ * that the session's datafeed callbacks run in the main loop and see
+ * packets in the order they were sent.
+ *
+ * @return TRUE if the packet was queued, FALSE if it is to be sent now.
+ *
+ * @private
+ */
+SR_PRIV gboolean usb_event_thread_defer(struct sr_session *session,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct usb_event_thread *et;
+	struct deferred_packet *item;
+
+	et = session->usb_thread;
+	if (g_thread_self() != et->thread && et->draining)
+		return FALSE;
+
+	item = g_malloc0(sizeof(struct deferred_packet));
+	item->sdi = sdi;
+	if (sr_packet_copy(packet, &item->packet) != SR_OK) {
+		/* It can't be sent from here, and a gap would go unnoticed. */
+		sr_err("Failed to queue packet of type %d, stopping "
+			"acquisition.", packet->type);
+		g_free(item);
+		sr_session_stop(session);
+		return TRUE;
+	}
+	g_async_queue_push(et->queue, item);
+	usb_event_thread_wakeup(session);
+
+	return TRUE;
+}
+
 /** USB event source prepare() method.
  */
 static gboolean usb_source_prepare(GSource *source, int *timeout)
@@ -65,6 +276,12 @@ static gboolean usb_source_prepare(GSource *source, int *timeout)
 
 	usource = (struct usb_source *)source;
 
+	if (usource->event_thread
+			&& g_async_queue_length(usource->event_thread->queue) > 0) {
+		*timeout = 0;
+		return TRUE;
+	}
+
 	ret = libusb_get_next_timeout(usource->usb_ctx, &usb_timeout);
 	if (G_UNLIKELY(ret < 0)) {
 		sr_err("Failed to get libusb timeout: %s",
@@ -104,6 +321,10 @@ static gboolean usb_source_check(GSource *source)
 	usource = (struct usb_source *)source;
 	revents = 0;
 
+	if (usource->event_thread
+			&& g_async_queue_length(usource->event_thread->queue) > 0)
+		return TRUE;
+
 	for (i = 0; i < usource->pollfds->len; i++) {
 		pollfd = g_ptr_array_index(usource->pollfds, i);
 		revents |= pollfd->revents;
@@ -139,6 +360,20 @@ static gboolean usb_source_dispatch(GSource *source,
 		sr_err("Callback not set, cannot dispatch event.");
 		return G_SOURCE_REMOVE;
 	}
+
+	if (usource->event_thread) {
+		if (usb_event_thread_drain(usource->event_thread)) {
+			/* The driver removed the source from the event thread. */
+			sr_session_source_remove_internal(usource->session,
+				usource->usb_ctx);
+			return G_SOURCE_REMOVE;
+		}
+		/* The driver's callback only runs on its timeout. */
+		if (usource->due_us == INT64_MAX
+				|| usource->due_us > g_source_get_time(source))
+			return G_SOURCE_CONTINUE;
+	}
+
 	keep = (*(sr_receive_data_callback)callback)(-1, revents, user_data);
 
 	if (G_LIKELY(keep) && G_LIKELY(!g_source_is_destroyed(source))) {
@@ -161,6 +396,11 @@ static void usb_source_finalize(GSource *source)
 
 	sr_spew("%s", __func__);
 
+	if (usource->event_thread) {
+		usb_event_thread_stop(usource->event_thread);
+		usource->event_thread = NULL;
+	}
+
 	libusb_set_pollfd_notifiers(usource->usb_ctx, NULL, NULL, NULL);
 
 	g_ptr_array_unref(usource->pollfds);
@@ -245,12 +485,12 @@ static void usb_source_free_pollfd(void *data)
  * event sources for their polling needs.
  *
  * @param session The session the event source belongs to.
- * @param usb_ctx The libusb context for which to handle events.
+ * @param ctx The libsigrok context whose libusb events to handle.
  * @param timeout_ms The timeout interval in ms, or -1 to wait indefinitely.
  * @return A new event source object, or NULL on failure.
  */
 static GSource *usb_source_new(struct sr_session *session,
-		struct libusb_context *usb_ctx, int timeout_ms)
+		struct sr_context *ctx, int timeout_ms)
 {
 	static GSourceFuncs usb_source_funcs = {
 		.prepare  = &usb_source_prepare,
@@ -260,8 +500,10 @@ static GSource *usb_source_new(struct sr_session *session,
 	};
 	GSource *source;
 	struct usb_source *usource;
+	struct libusb_context *usb_ctx;
 	const struct libusb_pollfd **upollfds, **upfd;
 
+	usb_ctx = sr_usb_context(ctx);
 	upollfds = libusb_get_pollfds(usb_ctx);
 	if (!upollfds) {
 		sr_err("Failed to get libusb file descriptors.");
@@ -283,6 +525,19 @@ static GSource *usb_source_new(struct sr_session *session,
 	usource->usb_ctx = usb_ctx;
 	usource->pollfds = g_ptr_array_new_full(8, &usb_source_free_pollfd);
 
+	/* With an event thread, libusb's FDs are polled there instead. */
+	if (session->usb_thread_enabled && !session->usb_thread) {
+		usource->event_thread = usb_event_thread_start(session, ctx);
+		if (usource->event_thread) {
+#if (LIBUSB_API_VERSION >= 0x01000104)
+			libusb_free_pollfds(upollfds);
+#else
+			free(upollfds);
+#endif
+			return source;
+		}
+	}
+
 	for (upfd = upollfds; *upfd != NULL; upfd++)
 		usb_pollfd_added((*upfd)->fd, (*upfd)->events, usource);
 
@@ -297,6 +552,41 @@ static GSource *usb_source_new(struct sr_session *session,
 	return source;
 }
 
+/**
+ * Get the libusb context of a libsigrok context.
+ *
+ * libusb is initialized the first time this is called, rather than by
+ * sr_init(). Programs which never look at USB devices don't pay for it.
+ *
+ * @param ctx The libsigrok context.
+ *
+ * @return The libusb context, or NULL if libusb failed to initialize.
+ */
+SR_PRIV libusb_context *sr_usb_context(struct sr_context *ctx)
+{
+	static GMutex mutex;
+	libusb_context *usb_ctx;
+	int ret;
+
+	usb_ctx = g_atomic_pointer_get(&ctx->libusb_ctx);
+	if (usb_ctx)
+		return usb_ctx;
+
+	g_mutex_lock(&mutex);
+	if (!ctx->libusb_ctx) {
+		ret = libusb_init(&usb_ctx);
+		if (ret == LIBUSB_SUCCESS)
+			g_atomic_pointer_set(&ctx->libusb_ctx, usb_ctx);
+		else
+			sr_err("libusb_init() returned %s.",
+				libusb_error_name(ret));
+	}
+	usb_ctx = ctx->libusb_ctx;
+	g_mutex_unlock(&mutex);
+
+	return usb_ctx;
+}
+
 /**
  * Find USB devices according to a connection string.
  *
@@ -455,13 +745,13 @@ SR_PRIV int usb_source_add(struct sr_session *session, struct sr_context *ctx,
 	GSource *source;
 	int ret;
 
-	source = usb_source_new(session, ctx->libusb_ctx, timeout);
+	source = usb_source_new(session, ctx, timeout);
 	if (!source)
 		return SR_ERR;
 
 	g_source_set_callback(source, (GSourceFunc)cb, cb_data, NULL);
 
-	ret = sr_session_source_add_internal(session, ctx->libusb_ctx, source);
+	ret = sr_session_source_add_internal(session, sr_usb_context(ctx), source);
 	g_source_unref(source);
 
 	return ret;
@@ -469,7 +759,43 @@ SR_PRIV int usb_source_add(struct sr_session *session, struct sr_context *ctx,
 
 SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx)
 {
-	return sr_session_source_remove_internal(session, ctx->libusb_ctx);
+	struct usb_event_thread *et;
+	struct deferred_packet *item;
+
+	/* Drivers may stop from a transfer callback, on the event thread. */
+	et = session->usb_thread;
+	if (et && g_thread_self() == et->thread) {
+		item = g_malloc0(sizeof(struct deferred_packet));
+		g_async_queue_push(et->queue, item);
+		usb_event_thread_wakeup(session);
+		return SR_OK;
+	}
+
+	return sr_session_source_remove_internal(session, sr_usb_context(ctx));
+}
+
+/**
+ * Handle pending libusb events, from a USB event source's callback.
+ *
+ * This does nothing while a session's event thread services libusb
+ * events, so that drivers' transfer callbacks only ever run there.
+ *
+ * @param ctx The libsigrok context.
+ * @param tv How long to wait for events.
+ * @param completed See libusb_handle_events_timeout_completed(), or NULL.
+ *
+ * @return A libusb error code.
+ *
+ * @private
+ */
+SR_PRIV int usb_handle_events(struct sr_context *ctx, struct timeval *tv,
+		int *completed)
+{
+	if (g_atomic_int_get(&ctx->usb_event_threads))
+		return LIBUSB_SUCCESS;
+
+	return libusb_handle_events_timeout_completed(sr_usb_context(ctx),
+		tv, completed);
 }
 
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len)
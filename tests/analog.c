@@ -123,6 +123,65 @@ START_TEST(test_analog_to_float_null)
 }
 END_TEST
 
+START_TEST(test_analog_planar_to_float)
+{
+	int ret;
+	unsigned int i;
+	float fout[4];
+	uint8_t raw[4];
+	struct sr_channel ch1, ch2;
+	struct sr_datafeed_analog_planar planar;
+	struct sr_datafeed_analog analog[2];
+	struct sr_analog_encoding encoding[2];
+	struct sr_analog_meaning meaning[2];
+	struct sr_analog_spec spec[2];
+	const float f[] = {3.1415, -29.7};
+	const float expected[] = {3.1415, -29.7, 25.6, -0.1};
+
+	/* Plane 0: native floats. */
+	sr_analog_init_(&analog[0], &encoding[0], &meaning[0], &spec[0], 3);
+	analog[0].num_samples = 2;
+	analog[0].data = (void *)f;
+	meaning[0].channels = g_slist_append(NULL, &ch1);
+
+	/* Plane 1: little-endian int16 in units of 0.1. */
+	sr_analog_init_(&analog[1], &encoding[1], &meaning[1], &spec[1], 1);
+	encoding[1].unitsize = 2;
+	encoding[1].is_float = FALSE;
+	encoding[1].is_signed = TRUE;
+	encoding[1].is_bigendian = FALSE;
+	encoding[1].scale.q = 10;
+	analog[1].num_samples = 2;
+	raw[0] = 0x00; raw[1] = 0x01; /* 256 */
+	raw[2] = 0xff; raw[3] = 0xff; /* -1 */
+	analog[1].data = raw;
+	meaning[1].channels = g_slist_append(NULL, &ch2);
+
+	planar.num_samples = 2;
+	planar.num_planes = 2;
+	planar.planes = analog;
+
+	ret = sr_analog_planar_to_float(&planar, fout);
+	fail_unless(ret == SR_OK, "sr_analog_planar_to_float() failed: %d.", ret);
+	for (i = 0; i < ARRAY_SIZE(expected); i++)
+		fail_unless(fabs(expected[i] - fout[i]) <= 0.001, "%f != %f",
+			expected[i], fout[i]);
+
+	/* All planes must have the packet's sample count. */
+	analog[1].num_samples = 1;
+	ret = sr_analog_planar_to_float(&planar, fout);
+	fail_unless(ret == SR_ERR_ARG);
+
+	ret = sr_analog_planar_to_float(NULL, fout);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_analog_planar_to_float(&planar, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	g_slist_free(meaning[0].channels);
+	g_slist_free(meaning[1].channels);
+}
+END_TEST
+
 START_TEST(test_analog_si_prefix)
 {
 	struct {
@@ -384,6 +443,7 @@ Suite *suite_analog(void)
 	tc = tcase_create("analog_to_float");
 	tcase_add_test(tc, test_analog_to_float);
 	tcase_add_test(tc, test_analog_to_float_null);
+	tcase_add_test(tc, test_analog_planar_to_float);
 	tcase_add_test(tc, test_analog_si_prefix);
 	tcase_add_test(tc, test_analog_si_prefix_null);
 	tcase_add_test(tc, test_analog_unit_to_string);
@@ -0,0 +1,248 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks. They report timings rather than pass or fail, as those
+ * depend on the machine and its load. Run them with "make bench", or
+ * pass the names of the ones to run. "make pgo" trains on them too, so
+ * they should exercise the hot paths the way acquisitions do.
+ *
+ * This program is linked against the library's objects, as some of the
+ * hot paths are private.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define STARTUP_CYCLES 100
+
+/* Samples per call, and calls per throughput benchmark. */
+#define BUFFER_SAMPLES (1 << 20)
+#define ROUNDS 64
+
+struct benchmark {
+	const char *name;
+	void (*run)(void);
+};
+
+static void report(const char *what, int64_t elapsed_us, uint64_t count,
+		const char *unit)
+{
+	printf("%-40s %12.3f us per %s\n", what,
+		(double)elapsed_us / count, unit);
+}
+
+static void report_rate(const char *what, int64_t elapsed_us)
+{
+	printf("%-40s %12.3f Msamples/s\n", what,
+		(double)BUFFER_SAMPLES * ROUNDS / MAX(elapsed_us, 1));
+}
+
+static void fail(const char *what, int ret)
+{
+	fprintf(stderr, "%s failed: %s.\n", what, sr_strerror(ret));
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Short-lived frontend invocations pay for sr_init() and sr_exit()
+ * every time.
+ */
+static void bench_startup(void)
+{
+	struct sr_context *ctx;
+	int64_t start;
+	int ret, i;
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < STARTUP_CYCLES; i++) {
+		if ((ret = sr_init(&ctx)) != SR_OK)
+			fail("sr_init()", ret);
+		if ((ret = sr_exit(ctx)) != SR_OK)
+			fail("sr_exit()", ret);
+	}
+	report("sr_init() + sr_exit()", g_get_monotonic_time() - start,
+		STARTUP_CYCLES, "cycle");
+}
+
+/* Conversion of integer samples, the common case for scopes. */
+static void bench_analog(void)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	unsigned int unitsize, round;
+	uint8_t *data;
+	float *outbuf;
+	int64_t start;
+	char *what;
+	size_t i;
+	int ret;
+
+	data = g_malloc(BUFFER_SAMPLES * 4);
+	for (i = 0; i < BUFFER_SAMPLES * 4; i++)
+		data[i] = i * 7;
+	outbuf = g_malloc(BUFFER_SAMPLES * sizeof(float));
+
+	sr_analog_init(&analog, &encoding, &meaning, &spec, 3);
+	analog.data = data;
+	analog.num_samples = BUFFER_SAMPLES;
+	meaning.channels = g_slist_append(NULL, NULL);
+	encoding.is_float = FALSE;
+	encoding.is_signed = TRUE;
+	encoding.scale.p = 1;
+	encoding.scale.q = 1000;
+
+	for (unitsize = 1; unitsize <= 4; unitsize *= 2) {
+		encoding.unitsize = unitsize;
+		start = g_get_monotonic_time();
+		for (round = 0; round < ROUNDS; round++) {
+			if ((ret = sr_analog_to_float(&analog, outbuf)) != SR_OK)
+				fail("sr_analog_to_float()", ret);
+		}
+		what = g_strdup_printf("sr_analog_to_float(), %u byte%s",
+			unitsize, unitsize > 1 ? "s" : "");
+		report_rate(what, g_get_monotonic_time() - start);
+		g_free(what);
+	}
+
+	g_slist_free(meaning.channels);
+	g_free(outbuf);
+	g_free(data);
+}
+
+/* Splitting samples into per-channel bit planes, as the outputs do. */
+static void bench_planes(void)
+{
+	static const int channel_index[] = {
+		0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	};
+	unsigned int unitsize, round;
+	uint8_t *data, *planes;
+	size_t stride, i;
+	int64_t start;
+	char *what;
+
+	data = g_malloc(BUFFER_SAMPLES * 2);
+	for (i = 0; i < BUFFER_SAMPLES * 2; i++)
+		data[i] = i * 7;
+	stride = BUFFER_SAMPLES / 8;
+	planes = g_malloc(G_N_ELEMENTS(channel_index) * stride);
+
+	for (unitsize = 1; unitsize <= 2; unitsize++) {
+		start = g_get_monotonic_time();
+		for (round = 0; round < ROUNDS; round++)
+			sr_output_logic_to_planes(data, unitsize,
+				BUFFER_SAMPLES, channel_index, 8 * unitsize,
+				planes, stride);
+		what = g_strdup_printf("logic to planes, %u channels",
+			8 * unitsize);
+		report_rate(what, g_get_monotonic_time() - start);
+		g_free(what);
+	}
+
+	g_free(planes);
+	g_free(data);
+}
+
+/*
+ * Scanning for a trigger which doesn't fire: level matches are skipped
+ * through in bulk, edge matches are checked sample by sample.
+ */
+static void bench_trigger(void)
+{
+	static const struct {
+		const char *what;
+		int channel;
+		int match;
+	} triggers[] = {
+		{ "soft trigger, level", 3, SR_TRIGGER_ONE },
+		{ "soft trigger, edge", 3, SR_TRIGGER_RISING },
+	};
+	struct sr_dev_inst *sdi;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct soft_trigger_logic *stl;
+	unsigned int t, round;
+	uint8_t *data;
+	int64_t start;
+	char name[8];
+	GSList *l;
+	int i;
+
+	sdi = sr_dev_inst_user_new("Bench", "Logic", "1");
+	for (i = 0; i < 8; i++) {
+		g_snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	/* Nothing ever matches on channel 3. */
+	data = g_malloc(BUFFER_SAMPLES);
+	for (i = 0; i < BUFFER_SAMPLES; i++)
+		data[i] = (i * 7) & ~(1 << 3);
+
+	for (t = 0; t < G_N_ELEMENTS(triggers); t++) {
+		trigger = sr_trigger_new(NULL);
+		stage = sr_trigger_stage_add(trigger);
+		l = g_slist_nth(sdi->channels, triggers[t].channel);
+		sr_trigger_match_add(stage, l->data, triggers[t].match, 0);
+		stl = soft_trigger_logic_new(sdi, trigger, 0);
+		start = g_get_monotonic_time();
+		for (round = 0; round < ROUNDS; round++) {
+			if (soft_trigger_logic_check(stl, data,
+					BUFFER_SAMPLES, NULL) != -1) {
+				fprintf(stderr, "The trigger fired.\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		report_rate(triggers[t].what, g_get_monotonic_time() - start);
+		soft_trigger_logic_free(stl);
+		sr_trigger_free(trigger);
+	}
+
+	g_free(data);
+	sr_dev_inst_free(sdi);
+}
+
+static const struct benchmark benchmarks[] = {
+	{ "startup", bench_startup },
+	{ "analog", bench_analog },
+	{ "planes", bench_planes },
+	{ "trigger", bench_trigger },
+};
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int arg;
+
+	for (i = 0; i < G_N_ELEMENTS(benchmarks); i++) {
+		for (arg = 1; arg < argc; arg++)
+			if (!strcmp(argv[arg], benchmarks[i].name))
+				break;
+		if (argc > 1 && arg == argc)
+			continue;
+		benchmarks[i].run();
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -28,8 +28,6 @@
  *
  *  - Check whether an sr_init() call with a proper sr_ctx works.
  *    If it returns != SR_OK (or segfaults) this test will fail.
- *    The sr_init() call (among other things) also runs sanity checks on
- *    all libsigrok hardware drivers and errors out upon issues.
  *
  *  - Check whether a subsequent sr_exit() with that sr_ctx works.
  *    If it returns != SR_OK (or segfaults) this test will fail.
@@ -162,6 +160,59 @@ START_TEST(test_exit_null)
 }
 END_TEST
 
+/*
+ * Check whether sr_sanity_check() finds no issues in any of the libsigrok
+ * hardware drivers and input, output and transform modules.
+ */
+START_TEST(test_sanity_check)
+{
+	int ret;
+	struct sr_context *sr_ctx;
+
+	ret = sr_init(&sr_ctx);
+	fail_unless(ret == SR_OK, "sr_init() failed: %d.", ret);
+	ret = sr_sanity_check(sr_ctx);
+	fail_unless(ret == SR_OK, "sr_sanity_check() failed: %d.", ret);
+	ret = sr_exit(sr_ctx);
+	fail_unless(ret == SR_OK, "sr_exit() failed: %d.", ret);
+}
+END_TEST
+
+/* Check whether sr_driver_get() rejects unknown driver names. */
+START_TEST(test_driver_get_unknown)
+{
+	int ret;
+	struct sr_context *sr_ctx;
+
+	ret = sr_init(&sr_ctx);
+	fail_unless(ret == SR_OK, "sr_init() failed: %d.", ret);
+	fail_unless(sr_driver_get(sr_ctx, "no-such-driver") == NULL,
+		"sr_driver_get() found a nonexistent driver.");
+	fail_unless(sr_driver_get(sr_ctx, NULL) == NULL,
+		"sr_driver_get(NULL) should have failed.");
+	ret = sr_exit(sr_ctx);
+	fail_unless(ret == SR_OK, "sr_exit() failed: %d.", ret);
+}
+END_TEST
+
+/*
+ * Short-lived frontend invocations pay for sr_init() and sr_exit() every
+ * time. Check that many cycles in a row work.
+ */
+START_TEST(test_init_exit_repeated)
+{
+	int ret, i;
+	struct sr_context *sr_ctx;
+
+	for (i = 0; i < 100; i++) {
+		ret = sr_init(&sr_ctx);
+		fail_unless(ret == SR_OK, "sr_init() failed: %d.", ret);
+		ret = sr_exit(sr_ctx);
+		fail_unless(ret == SR_OK, "sr_exit() failed: %d.", ret);
+	}
+}
+END_TEST
+
 Suite *suite_core(void)
 {
 	Suite *s;
@@ -177,6 +228,12 @@ Suite *suite_core(void)
 	tcase_add_test(tc, test_init_exit_3_reverse);
 	tcase_add_test(tc, test_init_null);
 	tcase_add_test(tc, test_exit_null);
+	tcase_add_test(tc, test_sanity_check);
+	tcase_add_test(tc, test_driver_get_unknown);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("startup");
+	tcase_add_test(tc, test_init_exit_repeated);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -0,0 +1,558 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <algorithm>
+#include <cstdlib>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <check.h>
+#include <libsigrokcxx/libsigrokcxx.hpp>
+
+using namespace sigrok;
+using std::shared_ptr;
+using std::vector;
+
+#define NUM_SAMPLES 1000
+#define STREAM_SAMPLES 100000
+
+static shared_ptr<Context> context;
+
+static void setup(void)
+{
+	context = Context::create();
+}
+
+static void teardown(void)
+{
+	context.reset();
+}
+
+/*
+ * Channels 0 and 9 change every now and then, channel 4 never does. The
+ * runs are long enough to let next_transition() skip whole words.
+ */
+static uint64_t sample_value(size_t i)
+{
+	return ((i / 50) & 1) | (((i / 130) & 1) << 9) | (1 << 4);
+}
+
+/* Logic samples in memory, little-endian, of the given unit size. */
+static vector<uint8_t> logic_data(unsigned int unit_size)
+{
+	vector<uint8_t> data(NUM_SAMPLES * unit_size);
+
+	for (size_t i = 0; i < NUM_SAMPLES; i++)
+		for (unsigned int b = 0; b < unit_size; b++)
+			data[i * unit_size + b] = sample_value(i) >> (8 * b);
+
+	return data;
+}
+
+static shared_ptr<Logic> logic_payload(vector<uint8_t> &data,
+	unsigned int unit_size)
+{
+	auto packet = context->create_logic_packet(data.data(), data.size(),
+		unit_size);
+
+	return std::dynamic_pointer_cast<Logic>(packet->payload());
+}
+
+/* Compare a view against the samples it was made from. */
+struct CheckView
+{
+	unsigned int unit_size;
+
+	/* The sample, cut to the unit size. */
+	uint64_t expected(size_t i) const
+	{
+		if (unit_size >= sizeof(uint64_t))
+			return sample_value(i);
+		return sample_value(i) & ((1ULL << (8 * unit_size)) - 1);
+	}
+
+	template <typename View> void operator()(const View &view) const
+	{
+		fail_unless(sizeof(view[0]) == unit_size, "Wrong sample type.");
+		fail_unless(view.size() == NUM_SAMPLES, "Wrong view size.");
+
+		size_t i = 0;
+		for (auto sample : view) {
+			fail_unless(sample == expected(i), "Wrong sample %zu.", i);
+			fail_unless(view.bit(i, 0) == (expected(i) & 1));
+			i++;
+		}
+		fail_unless(i == NUM_SAMPLES);
+
+		check_transitions(view, 0x0001);
+		check_transitions(view, 0x0200);
+		check_transitions(view, 0x0010);
+		check_transitions(view, 0x0211);
+	}
+
+	template <typename View> void check_transitions(const View &view,
+		uint64_t mask) const
+	{
+		vector<size_t> indices;
+
+		for (size_t i = 1; i < NUM_SAMPLES; i++)
+			if ((expected(i) ^ expected(i - 1)) & mask)
+				indices.push_back(i);
+
+		size_t n = 0;
+		for (auto t : view.transitions(mask)) {
+			fail_unless(n < indices.size(), "Too many transitions "
+				"for mask 0x%04x.", (unsigned int)mask);
+			fail_unless(t.index == indices[n], "Transition at %zu, "
+				"expected %zu.", t.index, indices[n]);
+			fail_unless(t.value == expected(t.index));
+			fail_unless(t.changed == ((expected(t.index) ^
+				expected(t.index - 1)) & mask));
+			n++;
+		}
+		fail_unless(n == indices.size(), "Got %zu transitions for "
+			"mask 0x%04x, expected %zu.", n, (unsigned int)mask,
+			indices.size());
+	}
+};
+
+START_TEST(test_logic_view)
+{
+	static const unsigned int unit_sizes[] = {1, 2, 4, 8};
+
+	for (auto unit_size : unit_sizes) {
+		auto data = logic_data(unit_size);
+		auto logic = logic_payload(data, unit_size);
+		CheckView check = {unit_size};
+
+		logic_dispatch(logic, check);
+	}
+}
+END_TEST
+
+START_TEST(test_logic_view_unit_size)
+{
+	auto data = logic_data(2);
+	auto logic = logic_payload(data, 2);
+	bool thrown;
+
+	/* The view's sample type must match the unit size. */
+	thrown = false;
+	try {
+		LogicView<uint32_t> view(logic);
+	} catch (const Error &e) {
+		thrown = (e.result == SR_ERR_ARG);
+	}
+	fail_unless(thrown, "Mismatched unit size was accepted.");
+
+	/* There is no view for three byte samples. */
+	data = logic_data(3);
+	logic = logic_payload(data, 3);
+	thrown = false;
+	try {
+		logic_dispatch(logic, CheckView{3});
+	} catch (const Error &e) {
+		thrown = (e.result == SR_ERR_NA);
+	}
+	fail_unless(thrown, "Unit size 3 was dispatched.");
+}
+END_TEST
+
+/* The view iterators work with algorithms which need random access. */
+START_TEST(test_view_iterators)
+{
+	auto data = logic_data(2);
+	LogicView<uint16_t> view(data.data(), NUM_SAMPLES);
+	auto begin = view.begin(), end = view.end();
+	LogicView<uint16_t>::iterator it;
+
+	fail_unless(end - begin == NUM_SAMPLES);
+	fail_unless(std::distance(begin, end) == NUM_SAMPLES);
+	fail_unless(begin < end && end > begin && begin <= begin && end >= end);
+	fail_unless(!(end < begin) && !(end <= begin) && !(begin >= end));
+
+	it = begin;
+	fail_unless(*it++ == sample_value(0) && *it == sample_value(1));
+	fail_unless(*it-- == sample_value(1) && it == begin);
+	it = 10 + begin;
+	fail_unless(it == begin + 10 && it - 10 == begin);
+	it -= 5;
+	fail_unless(it - begin == 5 && it[2] == sample_value(7));
+
+	/* Backwards, with the reverse iterator's postfix decrement. */
+	size_t i = NUM_SAMPLES;
+	for (auto r = std::reverse_iterator<LogicView<uint16_t>::iterator>(end);
+			r != std::reverse_iterator<LogicView<uint16_t>::iterator>(begin);
+			r++)
+		fail_unless(*r == sample_value(--i), "Wrong sample %zu.", i);
+	fail_unless(i == 0);
+
+	/* Channel 0 first goes low again at sample 100. */
+	fail_unless(std::is_sorted_until(begin, end) - begin == 100);
+
+	const float values[] = {1, 2, 3, 4, 5};
+	AnalogView<float> analog(values, 5, 2, 1);
+	auto pos = std::lower_bound(analog.begin(), analog.end(), 6.5f);
+	fail_unless(pos - analog.begin() == 2 && *pos == 7);
+	fail_unless(*(analog.end() - 1) == 11 && *--analog.end() == 11);
+}
+END_TEST
+
+START_TEST(test_channel_bits)
+{
+	vector<unsigned int> channels;
+
+	for (auto channel : ChannelBits(0x8000000000000205ULL))
+		channels.push_back(channel);
+	fail_unless(channels == vector<unsigned int>({0, 2, 9, 63}),
+		"Wrong channel indices.");
+
+	for (auto channel : ChannelBits(0))
+		fail("Empty mask yielded channel %u.", channel);
+}
+END_TEST
+
+#ifdef HAVE_HW_DEMO
+
+/* A session on a demo device which sends STREAM_SAMPLES samples. */
+static shared_ptr<Session> demo_session(void)
+{
+	auto driver = context->drivers()["demo"];
+	auto devices = driver->scan();
+	fail_unless(!devices.empty(), "No demo device found.");
+	auto device = devices.front();
+	device->open();
+	device->config_set(ConfigKey::LIMIT_SAMPLES,
+		Glib::Variant<guint64>::create(STREAM_SAMPLES));
+
+	auto session = context->create_session();
+	session->add_device(device);
+
+	return session;
+}
+
+static size_t logic_samples(const PacketStream::Item &item)
+{
+	if (item.packet->type() != PacketType::LOGIC)
+		return 0;
+
+	auto logic = std::dynamic_pointer_cast<Logic>(item.packet->payload());
+	return logic->data_length() / logic->unit_size();
+}
+
+/*
+ * A callback which removes itself is not run again, neither later on in
+ * the same run nor in the next one, while the others keep running.
+ */
+START_TEST(test_remove_datafeed_callback)
+{
+	auto session = demo_session();
+	unsigned int id, removed_calls = 0, calls = 0;
+
+	id = session->add_datafeed_callback([&](shared_ptr<Device>,
+			shared_ptr<Packet>) {
+		removed_calls++;
+		session->remove_datafeed_callback(id);
+	});
+	session->add_datafeed_callback([&](shared_ptr<Device>,
+			shared_ptr<Packet>) { calls++; });
+
+	session->start();
+	session->run();
+	fail_unless(removed_calls == 1, "Removed callback ran %u times.",
+		removed_calls);
+	fail_unless(calls > 1, "Callback ran %u times.", calls);
+
+	calls = 0;
+	session->start();
+	session->run();
+	fail_unless(removed_calls == 1, "Removed callback ran again.");
+	fail_unless(calls > 1, "Callback ran %u times on restart.", calls);
+}
+END_TEST
+
+START_TEST(test_stream_iterate)
+{
+	auto session = demo_session();
+	auto stream = session->stream(4, PacketStream::BLOCK);
+	size_t samples = 0, items = 0;
+	bool seen_end = false;
+
+	stream->start();
+	for (const auto &item : *stream) {
+		if (items++ == 0)
+			fail_unless(item.packet->type() == PacketType::HEADER,
+				"The first packet is not a header.");
+		fail_unless(!seen_end, "Packet after the end.");
+		seen_end = (item.packet->type() == PacketType::END);
+		samples += logic_samples(item);
+	}
+
+	fail_unless(seen_end, "No end packet.");
+	fail_unless(samples == STREAM_SAMPLES, "Got %zu logic samples.",
+		samples);
+	fail_unless(stream->dropped() == 0, "Packets were dropped.");
+	fail_unless(stream->finished());
+}
+END_TEST
+
+/*
+ * Streams which were let go of take their datafeed callbacks along, the
+ * session only feeds the one left.
+ */
+START_TEST(test_stream_destroyed)
+{
+	auto session = demo_session();
+	size_t samples = 0;
+
+	for (int i = 0; i < 100; i++)
+		session->stream();
+	auto stream = session->stream(4, PacketStream::BLOCK);
+	stream->start();
+	for (const auto &item : *stream)
+		samples += logic_samples(item);
+
+	fail_unless(samples == STREAM_SAMPLES, "Got %zu logic samples.",
+		samples);
+}
+END_TEST
+
+START_TEST(test_stream_drop_oldest)
+{
+	auto session = demo_session();
+	auto stream = session->stream(1, PacketStream::DROP_OLDEST);
+	auto stopped = std::make_shared<std::promise<void>>();
+	size_t data_items = 0;
+	bool seen_end = false;
+
+	session->set_stopped_callback([stopped] { stopped->set_value(); });
+	stream->start();
+	stopped->get_future().wait();
+
+	/* Nothing was pulled, so all but one data packet were dropped. */
+	auto future = stream->next();
+	fail_unless(future.get().packet->type() == PacketType::HEADER);
+	for (;;) {
+		auto batch = stream->pop_batch(16);
+		if (batch.empty())
+			break;
+		for (const auto &item : batch) {
+			if (item.packet->type() == PacketType::END)
+				seen_end = true;
+			else if (logic_samples(item)
+					|| item.packet->type() == PacketType::ANALOG)
+				data_items++;
+		}
+	}
+
+	fail_unless(seen_end, "No end packet.");
+	fail_unless(data_items == 1, "%zu data packets queued.", data_items);
+	fail_unless(stream->dropped() > 0, "No packets were dropped.");
+}
+END_TEST
+
+/*
+ * Let go of the stream in a datafeed callback, i.e. on the session
+ * thread. The session must still run to its end.
+ */
+static std::mutex holder_mutex;
+static shared_ptr<PacketStream> holder;
+
+START_TEST(test_stream_release_on_session_thread)
+{
+	auto session = demo_session();
+	auto stopped = std::make_shared<std::promise<void>>();
+	std::weak_ptr<PacketStream> weak_stream;
+	std::weak_ptr<Session> weak_session = session;
+
+	session->add_datafeed_callback([](shared_ptr<Device>,
+			shared_ptr<Packet>) {
+		shared_ptr<PacketStream> last;
+		{
+			std::lock_guard<std::mutex> lock(holder_mutex);
+			last.swap(holder);
+		}
+	});
+	session->set_stopped_callback([stopped] { stopped->set_value(); });
+
+	/* Nothing pulls from the stream, it must not hold up the session. */
+	auto stream = session->stream(64, PacketStream::DROP_NEWEST);
+	weak_stream = stream;
+	stream->start();
+	{
+		std::lock_guard<std::mutex> lock(holder_mutex);
+		holder = std::move(stream);
+	}
+
+	fail_unless(stopped->get_future().wait_for(std::chrono::seconds(10))
+		== std::future_status::ready, "The session did not stop.");
+	fail_unless(weak_stream.expired(), "The stream is still alive.");
+
+	/* The session thread holds the last reference, wait for it. */
+	session.reset();
+	for (int i = 0; i < 1000 && !weak_session.expired(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	fail_unless(weak_session.expired(), "The session thread is stuck.");
+}
+END_TEST
+
+#ifdef LIBSIGROKCXX_COROUTINES
+
+/* A coroutine which starts right away and cleans up after itself. */
+struct Task
+{
+	struct promise_type
+	{
+		Task get_return_object() { return Task(); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+/* Tasks posted by the stream's executor, run by the test thread. */
+struct TaskQueue
+{
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<std::function<void()>> tasks;
+
+	void post(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(std::move(task));
+		}
+		ready.notify_one();
+	}
+
+	void run_one()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		ready.wait(lock, [this] { return !tasks.empty(); });
+		auto task = std::move(tasks.front());
+		tasks.pop_front();
+		lock.unlock();
+		task();
+	}
+};
+
+static Task consume(PacketStream &stream, std::thread::id thread_id,
+	size_t &samples, bool &done)
+{
+	for (;;) {
+		auto item = co_await stream;
+		fail_unless(std::this_thread::get_id() == thread_id,
+			"Resumed on the wrong thread.");
+		if (!item.packet)
+			break;
+		samples += logic_samples(item);
+	}
+	done = true;
+}
+
+START_TEST(test_stream_coroutine)
+{
+	auto session = demo_session();
+	auto stream = session->stream(4, PacketStream::BLOCK);
+	TaskQueue queue;
+	size_t samples = 0;
+	bool done = false;
+
+	stream->set_executor([&queue](std::function<void()> task) {
+		queue.post(std::move(task));
+	});
+	stream->start();
+	consume(*stream, std::this_thread::get_id(), samples, done);
+	while (!done)
+		queue.run_one();
+
+	fail_unless(samples == STREAM_SAMPLES, "Got %zu logic samples.",
+		samples);
+}
+END_TEST
+
+#endif
+
+#endif
+
+static Suite *suite_cxx_views(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("cxx-views");
+
+	tc = tcase_create("logic");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_logic_view);
+	tcase_add_test(tc, test_logic_view_unit_size);
+	tcase_add_test(tc, test_channel_bits);
+	tcase_add_test(tc, test_view_iterators);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
+
+static Suite *suite_cxx_stream(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("cxx-stream");
+
+	tc = tcase_create("demo");
+	tcase_add_checked_fixture(tc, setup, teardown);
+#ifdef HAVE_HW_DEMO
+	tcase_add_test(tc, test_remove_datafeed_callback);
+	tcase_add_test(tc, test_stream_iterate);
+	tcase_add_test(tc, test_stream_drop_oldest);
+	tcase_add_test(tc, test_stream_destroyed);
+	tcase_add_test(tc, test_stream_release_on_session_thread);
+#ifdef LIBSIGROKCXX_COROUTINES
+	tcase_add_test(tc, test_stream_coroutine);
+#endif
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}
+
+int main(void)
+{
+	int ret;
+	Suite *s;
+	SRunner *srunner;
+
+	s = suite_create("mastersuite");
+	srunner = srunner_create(s);
+
+	srunner_add_suite(srunner, suite_cxx_views());
+	srunner_add_suite(srunner, suite_cxx_stream());
+
+	srunner_run_all(srunner, CK_VERBOSE);
+	ret = srunner_ntests_failed(srunner);
+	srunner_free(srunner);
+
+	return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -61,6 +61,41 @@ START_TEST(test_channel_add)
 }
 END_TEST
 
+START_TEST(test_enabled_channels)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_channel *const *channels;
+	const int *indices;
+	const uint8_t *mask;
+	unsigned int count, size;
+	GSList *l;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_LOGIC, "D0");
+	sr_dev_inst_channel_add(sdi, 9, SR_CHANNEL_LOGIC, "D9");
+	sr_dev_inst_channel_add(sdi, 10, SR_CHANNEL_ANALOG, "A0");
+
+	channels = sr_dev_inst_enabled_channels_get(sdi, 0, &count);
+	fail_unless(count == 3, "%u channels enabled.", count);
+	channels = sr_dev_inst_enabled_channels_get(sdi, SR_CHANNEL_ANALOG,
+		&count);
+	fail_unless(count == 1 && !strcmp(channels[0]->name, "A0"));
+	mask = sr_dev_inst_enabled_logic_mask_get(sdi, &size);
+	fail_unless(size == 2 && mask[0] == 0x01 && mask[1] == 0x02);
+
+	/* Disabling a channel shows in the next query. */
+	l = sr_dev_inst_channels_get(sdi);
+	sr_dev_channel_enable(l->data, FALSE);
+	channels = sr_dev_inst_enabled_channels_get(sdi, SR_CHANNEL_LOGIC,
+		&count);
+	fail_unless(count == 1 && !strcmp(channels[0]->name, "D9"));
+	indices = sr_dev_inst_enabled_logic_indices_get(sdi, &count);
+	fail_unless(count == 1 && indices[0] == 9);
+	mask = sr_dev_inst_enabled_logic_mask_get(sdi, &size);
+	fail_unless(size == 2 && mask[0] == 0x00 && mask[1] == 0x02);
+}
+END_TEST
+
 Suite *suite_device(void)
 {
 	Suite *s;
@@ -76,5 +111,9 @@ Suite *suite_device(void)
 	tcase_add_test(tc, test_channel_add);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("sr_dev_inst_enabled_channels_get");
+	tcase_add_test(tc, test_enabled_channels);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
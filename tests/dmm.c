@@ -0,0 +1,153 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+#define NUM_PACKETS 6
+
+/* Segments of the digits 0-9 on an FS9721 display. */
+static const uint8_t fs9721_digits[] = {
+	0x7d, 0x05, 0x5b, 0x1f, 0x27, 0x3e, 0x7e, 0x15, 0x7f, 0x3f,
+};
+
+/*
+ * An FS9721 packet showing four digits, or "OL" for NULL, with the
+ * decimal point after the given digit (0 for none). The flags are the
+ * low nibbles of bytes 0 and 9 to 13.
+ */
+static void fs9721_packet(uint8_t *buf, const char *digits, int point,
+		gboolean negative, const uint8_t *flags)
+{
+	static const uint8_t ol[] = { 0x00, 0x7d, 0x68, 0x00 };
+	uint8_t seg;
+	int i;
+
+	memset(buf, 0, FS9721_PACKET_SIZE);
+	for (i = 0; i < 4; i++) {
+		seg = digits ? fs9721_digits[digits[i] - '0'] : ol[i];
+		buf[1 + 2 * i] = seg >> 4;
+		buf[2 + 2 * i] = seg & 0x0f;
+	}
+	if (negative)
+		buf[1] |= 1 << 3;
+	if (point)
+		buf[1 + 2 * point] |= 1 << 3;
+	buf[0] = flags[0];
+	for (i = 0; i < 5; i++)
+		buf[9 + i] = flags[1 + i];
+	for (i = 0; i < FS9721_PACKET_SIZE; i++)
+		buf[i] |= (i + 1) << 4;
+}
+
+/*
+ * Decode a buffer of FS9721 packets in one pass, and compare with the
+ * packets decoded one at a time, the way drivers used to.
+ */
+START_TEST(test_dmm_parse_batch)
+{
+	const uint8_t volt_dc[] = { 0x7, 0, 0, 0, 0x4, 0 };
+	const uint8_t millivolt_ac[] = { 0x9, 0, 0x8, 0, 0x4, 0 };
+	const uint8_t kiloohm_hold[] = { 0x3, 0x2, 0, 0x5, 0, 0 };
+	const uint8_t ohm[] = { 0x1, 0, 0, 0x4, 0, 0 };
+	const uint8_t temp[] = { 0x1, 0, 0, 0, 0, 0x1 };
+	const uint8_t none[] = { 0x1, 0, 0, 0, 0, 0 };
+	const float expected[NUM_PACKETS] = {
+		0.123, 0.015, -42000, INFINITY, 25.5, 0,
+	};
+	const enum sr_mq expected_mq[NUM_PACKETS] = {
+		SR_MQ_VOLTAGE, SR_MQ_VOLTAGE, SR_MQ_RESISTANCE,
+		SR_MQ_RESISTANCE, SR_MQ_TEMPERATURE, 0,
+	};
+	uint8_t buf[NUM_PACKETS * FS9721_PACKET_SIZE];
+	float values[NUM_PACKETS], value;
+	struct sr_dmm_reading readings[NUM_PACKETS];
+	struct fs9721_info info;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	unsigned int i, num_readings;
+
+	fs9721_packet(buf + 0 * FS9721_PACKET_SIZE, "0123", 1, FALSE, volt_dc);
+	fs9721_packet(buf + 1 * FS9721_PACKET_SIZE, "1500", 2, FALSE,
+		millivolt_ac);
+	fs9721_packet(buf + 2 * FS9721_PACKET_SIZE, "0042", 0, TRUE,
+		kiloohm_hold);
+	fs9721_packet(buf + 3 * FS9721_PACKET_SIZE, NULL, 0, FALSE, ohm);
+	fs9721_packet(buf + 4 * FS9721_PACKET_SIZE, "0255", 3, FALSE, temp);
+	fs9721_packet(buf + 5 * FS9721_PACKET_SIZE, "0000", 0, FALSE, none);
+	for (i = 0; i < NUM_PACKETS; i++)
+		fail_unless(sr_fs9721_packet_valid(buf + i * FS9721_PACKET_SIZE),
+			"Packet %u is invalid.", i);
+
+	num_readings = sr_dmm_parse_batch(buf, FS9721_PACKET_SIZE, NUM_PACKETS,
+		sr_fs9721_parse, sr_fs9721_00_temp_c, &info, values, readings);
+	fail_unless(num_readings == NUM_PACKETS - 1,
+		"%u packets held a reading.", num_readings);
+
+	for (i = 0; i < NUM_PACKETS; i++) {
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
+		analog.num_samples = 1;
+		analog.meaning->mq = 0;
+		value = 0;
+		sr_fs9721_parse(buf + i * FS9721_PACKET_SIZE, &value, &analog,
+			&info);
+		sr_fs9721_00_temp_c(&analog, &info);
+
+		fail_unless(values[i] == value, "Packet %u: %g, not %g.",
+			i, values[i], value);
+		fail_unless(readings[i].mq == analog.meaning->mq);
+		fail_unless(readings[i].unit == analog.meaning->unit);
+		fail_unless(readings[i].mqflags == analog.meaning->mqflags);
+		fail_unless(readings[i].digits == analog.encoding->digits);
+		fail_unless(readings[i].spec_digits == analog.spec->spec_digits);
+
+		fail_unless(readings[i].mq == expected_mq[i],
+			"Packet %u measures %d.", i, readings[i].mq);
+		if (isinf(expected[i]))
+			fail_unless(isinf(values[i]), "Packet %u: %g.",
+				i, values[i]);
+		else
+			fail_unless(fabsf(values[i] - expected[i]) <=
+				fabsf(expected[i]) * 1e-6, "Packet %u: %g, "
+				"not %g.", i, values[i], expected[i]);
+	}
+	fail_unless(readings[1].mqflags == SR_MQFLAG_AC);
+	fail_unless(readings[2].mqflags ==
+		(SR_MQFLAG_AUTORANGE | SR_MQFLAG_HOLD));
+}
+END_TEST
+
+Suite *suite_dmm(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("dmm");
+
+	tc = tcase_create("batch");
+	tcase_add_test(tc, test_dmm_parse_batch);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -29,6 +29,7 @@ enum {
 	CHECK_ALL_LOW,
 	CHECK_ALL_HIGH,
 	CHECK_HELLO_WORLD,
+	CHECK_COUNTER,
 };
 
 static uint64_t df_packet_counter = 0, sample_counter = 0;
@@ -76,6 +77,19 @@ static void check_hello_world(const struct sr_datafeed_logic *logic)
 	}
 }
 
+static void check_counter(const struct sr_datafeed_logic *logic)
+{
+	uint64_t i, offset;
+	uint8_t *data;
+
+	data = logic->data;
+	offset = sample_counter * logic->unitsize;
+	for (i = 0; i < logic->length; i++) {
+		if (data[i] != (uint8_t)(offset + i))
+			fail("Logic data was not a byte counter.");
+	}
+}
+
 static void datafeed_in(const struct sr_dev_inst *sdi,
 	const struct sr_datafeed_packet *packet, void *cb_data)
 {
@@ -158,6 +172,8 @@ static void datafeed_in(const struct sr_dev_inst *sdi,
 			check_all_high(logic);
 		else if (check_to_perform == CHECK_HELLO_WORLD)
 			check_hello_world(logic);
+		else if (check_to_perform == CHECK_COUNTER)
+			check_counter(logic);
 
 		sample_counter += logic->length / logic->unitsize;
 
@@ -308,6 +324,64 @@ START_TEST(test_input_binary_hello_world)
 }
 END_TEST
 
+/*
+ * Feed the data in pieces that don't line up with the samples, so that
+ * the input module has to carry leftovers from one piece to the next.
+ */
+START_TEST(test_input_binary_pieces)
+{
+	struct sr_input *in;
+	const struct sr_input_module *imod;
+	struct sr_session *session;
+	GHashTable *options;
+	GString *gbuf;
+	uint8_t *buf;
+	unsigned int i, len, pos;
+	int ret;
+
+	buf = g_malloc(BUFSIZE);
+	for (i = 0; i < BUFSIZE; i++)
+		buf[i] = i;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("numchannels"),
+			g_variant_ref_sink(g_variant_new_int32(24)));
+
+	df_packet_counter = sample_counter = 0;
+	have_seen_df_end = FALSE;
+	logic_channellist = NULL;
+	check_to_perform = CHECK_COUNTER;
+	expected_samples = BUFSIZE / 3;
+	expected_samplerate = NULL;
+
+	imod = sr_input_find("binary");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+
+	for (pos = 0, len = 1; pos < BUFSIZE; pos += len, len = len * 7 % 4096) {
+		len = MIN(len, BUFSIZE - pos);
+		gbuf = g_string_new_len((gchar *)buf + pos, len);
+		ret = sr_input_send(in, gbuf);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+		g_string_free(gbuf, TRUE);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	fail_unless(have_seen_df_end, "No SR_DF_END was received.");
+	sr_input_free(in);
+
+	sr_session_destroy(session);
+	g_hash_table_destroy(options);
+	g_free(buf);
+}
+END_TEST
+
 Suite *suite_input_binary(void)
 {
 	Suite *s;
@@ -321,6 +395,7 @@ Suite *suite_input_binary(void)
 	tcase_add_test(tc, test_input_binary_all_high);
 	tcase_add_loop_test(tc, test_input_binary_all_high_loop, 1, 10);
 	tcase_add_test(tc, test_input_binary_hello_world);
+	tcase_add_test(tc, test_input_binary_pieces);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -0,0 +1,48 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs the tests of private functions. This program is linked against
+ * the library's objects, as the shared library does not export them.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+int main(void)
+{
+	int ret;
+	Suite *s;
+	SRunner *srunner;
+
+	s = suite_create("internalsuite");
+	srunner = srunner_create(s);
+
+	srunner_add_suite(srunner, suite_dmm());
+	srunner_add_suite(srunner, suite_usb());
+	srunner_add_suite(srunner, suite_simd());
+	srunner_add_suite(srunner, suite_soft_trigger());
+
+	srunner_run_all(srunner, CK_VERBOSE);
+	ret = srunner_ntests_failed(srunner);
+	srunner_free(srunner);
+
+	return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -53,5 +53,13 @@ Suite *suite_version(void);
 Suite *suite_device(void);
 Suite *suite_trigger(void);
 Suite *suite_analog(void);
+Suite *suite_stream(void);
+Suite *suite_modbus(void);
+
+/* Suites of tests/internal, which sees the private functions. */
+Suite *suite_dmm(void);
+Suite *suite_usb(void);
+Suite *suite_simd(void);
+Suite *suite_soft_trigger(void);
 
 #endif
@@ -45,6 +45,8 @@ int main(void)
 	srunner_add_suite(srunner, suite_device());
 	srunner_add_suite(srunner, suite_trigger());
 	srunner_add_suite(srunner, suite_analog());
+	srunner_add_suite(srunner, suite_stream());
+	srunner_add_suite(srunner, suite_modbus());
 
 	srunner_run_all(srunner, CK_VERBOSE);
 	ret = srunner_ntests_failed(srunner);
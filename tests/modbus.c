@@ -0,0 +1,307 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#if defined(HAVE_HW_MAYNUO_M97) && !defined(_WIN32)
+
+#define MBAP_SIZE 7
+#define MAX_REQUESTS 16
+
+/* Holding registers of the fake load, from 0x0A00 on. */
+#define REG_BASE 0x0A00
+#define REG_COUNT 0x0110
+#define REG_UFIX 0x0A03
+#define REG_IFIX 0x0A01
+#define REG_MODEL 0x0B06
+#define REG_EDITION 0x0B07
+
+struct fake_server {
+	int fd;
+	int connections;
+	/* Answer read requests for this address with an exception. */
+	int fail_address;
+	/* Answer pipelined requests last one first. */
+	gboolean reverse;
+	uint8_t registers[2 * REG_COUNT];
+};
+
+static void set_register(struct fake_server *server, int address,
+		uint16_t value)
+{
+	server->registers[2 * (address - REG_BASE) + 0] = value >> 8;
+	server->registers[2 * (address - REG_BASE) + 1] = value & 0xff;
+}
+
+static void set_float(struct fake_server *server, int address, float value)
+{
+	uint32_t u;
+
+	memcpy(&u, &value, sizeof(u));
+	set_register(server, address + 0, u >> 16);
+	set_register(server, address + 1, u & 0xffff);
+}
+
+static gboolean recv_all(int fd, uint8_t *buf, int len)
+{
+	int ret;
+
+	while (len > 0) {
+		if ((ret = recv(fd, buf, len, 0)) <= 0)
+			return FALSE;
+		buf += ret;
+		len -= ret;
+	}
+
+	return TRUE;
+}
+
+static gboolean more_requests(int fd)
+{
+	struct timeval tv;
+	fd_set fds;
+
+	tv.tv_sec = 0;
+	tv.tv_usec = 100 * 1000;
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+
+	return select(fd + 1, &fds, NULL, NULL, &tv) > 0;
+}
+
+/* Turn a request (MBAP header and PDU) into its reply, in place. */
+static int handle_request(struct fake_server *server, uint8_t *frame)
+{
+	uint8_t *pdu;
+	int address, count, len;
+
+	pdu = frame + MBAP_SIZE;
+	address = (pdu[1] << 8) | pdu[2];
+	count = (pdu[3] << 8) | pdu[4];
+
+	switch (pdu[0]) {
+	case 0x03:
+		if (address == server->fail_address || address < REG_BASE
+		    || address + count > REG_BASE + REG_COUNT) {
+			pdu[0] |= 0x80;
+			pdu[1] = 0x02;
+			len = 2;
+			break;
+		}
+		pdu[1] = 2 * count;
+		memcpy(pdu + 2, server->registers + 2 * (address - REG_BASE),
+			2 * count);
+		len = 2 + 2 * count;
+		break;
+	case 0x05:
+		/* The reply to write single coil is an echo. */
+		len = 5;
+		break;
+	default:
+		pdu[0] |= 0x80;
+		pdu[1] = 0x01;
+		len = 2;
+		break;
+	}
+
+	frame[4] = (len + 1) >> 8;
+	frame[5] = (len + 1) & 0xff;
+
+	return MBAP_SIZE + len;
+}
+
+static gpointer server_thread(gpointer data)
+{
+	struct fake_server *server;
+	uint8_t frames[MAX_REQUESTS][MBAP_SIZE + 256];
+	int lens[MAX_REQUESTS];
+	int fd, n, i, len;
+
+	server = data;
+
+	while (server->connections-- > 0) {
+		if ((fd = accept(server->fd, NULL, NULL)) < 0)
+			break;
+		while (TRUE) {
+			/* Collect everything that was pipelined. */
+			n = 0;
+			do {
+				if (!recv_all(fd, frames[n], MBAP_SIZE))
+					break;
+				len = ((frames[n][4] << 8) | frames[n][5]) - 1;
+				if (len < 1 || len > 253
+				    || !recv_all(fd, frames[n] + MBAP_SIZE, len))
+					break;
+				lens[n] = handle_request(server, frames[n]);
+				n++;
+			} while (n < MAX_REQUESTS && more_requests(fd));
+			for (i = 0; i < n; i++) {
+				len = server->reverse ? n - 1 - i : i;
+				send(fd, frames[len], lens[len], 0);
+			}
+			if (n == 0)
+				break;
+		}
+		close(fd);
+	}
+
+	return NULL;
+}
+
+static GThread *server_start(struct fake_server *server, int *port)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+
+	set_register(server, REG_MODEL, 101);
+	set_register(server, REG_EDITION, 12);
+	set_float(server, REG_UFIX, 12.5);
+	set_float(server, REG_IFIX, 1.25);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	server->fd = socket(AF_INET, SOCK_STREAM, 0);
+	fail_unless(server->fd >= 0, "socket() failed.");
+	fail_unless(bind(server->fd, (struct sockaddr *)&addr,
+		sizeof(addr)) == 0, "bind() failed.");
+	fail_unless(listen(server->fd, 1) == 0, "listen() failed.");
+	addrlen = sizeof(addr);
+	fail_unless(getsockname(server->fd, (struct sockaddr *)&addr,
+		&addrlen) == 0, "getsockname() failed.");
+	*port = ntohs(addr.sin_port);
+
+	return g_thread_new("modbus-server", server_thread, server);
+}
+
+/*
+ * Scan for a Maynuo M97 load behind a fake Modbus TCP server, open it,
+ * and read back its settings. The first query reads several register
+ * blocks in a pipeline, whose replies the server sends in reverse order,
+ * and which it optionally answers in part with an exception.
+ */
+static void check_maynuo(struct fake_server *server)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_config src;
+	GSList *options, *devices;
+	GThread *thread;
+	GVariant *gvar;
+	char *conn;
+	int port, ret;
+
+	server->connections = 2;
+	thread = server_start(server, &port);
+
+	driver = srtest_driver_get("maynuo-m97");
+	srtest_driver_init(srtest_ctx, driver);
+
+	conn = g_strdup_printf("tcp/127.0.0.1/%d", port);
+	src.key = SR_CONF_CONN;
+	src.data = g_variant_new_string(conn);
+	options = g_slist_append(NULL, &src);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src.data);
+	g_free(conn);
+
+	fail_unless(g_slist_length(devices) == 1, "Device not found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+	fail_unless(!strcmp(sr_dev_inst_model_get(sdi), "M9812"));
+	fail_unless(!strcmp(sr_dev_inst_version_get(sdi), "v1.2"));
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "sr_dev_open() error: %d", ret);
+	gvar = NULL;
+	ret = sr_config_get(driver, sdi, NULL, SR_CONF_VOLTAGE_TARGET, &gvar);
+	fail_unless(ret == SR_OK, "sr_config_get() error: %d", ret);
+	fail_unless(g_variant_get_double(gvar) == 12.5,
+		"Wrong voltage target: %f.", g_variant_get_double(gvar));
+	g_variant_unref(gvar);
+	gvar = NULL;
+	ret = sr_config_get(driver, sdi, NULL, SR_CONF_CURRENT_LIMIT, &gvar);
+	if (server->fail_address == REG_IFIX) {
+		fail_unless(ret != SR_OK, "Failed register was read.");
+	} else {
+		fail_unless(ret == SR_OK, "sr_config_get() error: %d", ret);
+		fail_unless(g_variant_get_double(gvar) == 1.25,
+			"Wrong current limit: %f.", g_variant_get_double(gvar));
+		g_variant_unref(gvar);
+	}
+	ret = sr_dev_close(sdi);
+	fail_unless(ret == SR_OK, "sr_dev_close() error: %d", ret);
+
+	g_thread_join(thread);
+	close(server->fd);
+}
+
+START_TEST(test_pipelined)
+{
+	struct fake_server server;
+
+	memset(&server, 0, sizeof(server));
+	server.fail_address = -1;
+	server.reverse = TRUE;
+	check_maynuo(&server);
+}
+END_TEST
+
+START_TEST(test_pipelined_error)
+{
+	struct fake_server server;
+
+	memset(&server, 0, sizeof(server));
+	server.fail_address = REG_IFIX;
+	server.reverse = FALSE;
+	check_maynuo(&server);
+}
+END_TEST
+
+#endif
+
+Suite *suite_modbus(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("modbus");
+
+	tc = tcase_create("tcp");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+#if defined(HAVE_HW_MAYNUO_M97) && !defined(_WIN32)
+	tcase_add_test(tc, test_pipelined);
+	tcase_add_test(tc, test_pipelined_error);
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}
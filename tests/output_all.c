@@ -19,6 +19,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -96,6 +97,397 @@ START_TEST(test_output_options)
 }
 END_TEST
 
+/*
+ * Straightforward renderer of the "bits" and "ascii" line formats, one
+ * sample and channel at a time, to check the modules against.
+ */
+struct ref_render {
+	const char *charset;
+	gboolean bits;
+	int spl;
+	int spl_cnt;
+	int trigger;
+	unsigned int num_channels;
+	int index[64];
+	GString *lines[64];
+	uint8_t prev_sample[8];
+	GString *out;
+};
+
+static void ref_logic(struct ref_render *r, const uint8_t *data,
+		uint64_t length, unsigned int unitsize)
+{
+	uint64_t i;
+	unsigned int j;
+	int idx, offset, curbit, prevbit, charidx;
+
+	for (i = 0; i + unitsize <= length; i += unitsize) {
+		r->spl_cnt++;
+		for (j = 0; j < r->num_channels; j++) {
+			idx = r->index[j];
+			curbit = (data[i + idx / 8] >> (idx % 8)) & 1;
+			prevbit = (r->prev_sample[idx / 8] >> (idx % 8)) & 1;
+			charidx = curbit;
+			if (!r->bits && strlen(r->charset) >= 4
+			    && r->spl_cnt > 1 && curbit != prevbit)
+				charidx += 2;
+			g_string_append_c(r->lines[j], r->charset[charidx]);
+			if (r->spl_cnt == r->spl) {
+				g_string_append_printf(r->out, "%s\n",
+					r->lines[j]->str);
+				if (j == r->num_channels - 1 && r->trigger > -1) {
+					offset = r->trigger + r->trigger / 8;
+					g_string_append_printf(r->out,
+						"T:%*s^ %d\n", offset, "",
+						r->trigger);
+					r->trigger = -1;
+				}
+				g_string_printf(r->lines[j], "D%d:", idx);
+			} else if (r->bits && (r->spl_cnt & 7) == 0) {
+				g_string_append_c(r->lines[j], ' ');
+			}
+		}
+		if (r->spl_cnt == r->spl)
+			r->spl_cnt = 0;
+		memcpy(r->prev_sample, data + i, unitsize);
+	}
+}
+
+static void ref_end(struct ref_render *r)
+{
+	unsigned int j;
+
+	if (!r->spl_cnt)
+		return;
+	for (j = 0; j < r->num_channels; j++)
+		g_string_append_printf(r->out, "%s\n", r->lines[j]->str);
+}
+
+static void output_append(const struct sr_output *o, uint16_t type,
+		const void *payload, GString *all)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	int ret;
+
+	packet.type = type;
+	packet.payload = payload;
+	out = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() error: %d", ret);
+	if (!out)
+		return;
+	g_string_append_len(all, out->str, out->len);
+	g_string_free(out, TRUE);
+}
+
+/*
+ * Render random data with a random channel layout, line width and
+ * packet split through the module, and compare the lines (without the
+ * header) against the reference renderer.
+ */
+static void check_render_random(char *module, GRand *rand,
+		int round)
+{
+	static const char *charsets[] = { ".\"\\/", "01", "_-^v" };
+	struct ref_render r;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_logic logic;
+	const struct sr_output *o;
+	GHashTable *options;
+	GString *all;
+	GSList *l;
+	uint8_t *data;
+	unsigned int num_channels, unitsize, num_samples, s, n, j;
+	const char *lines;
+	char name[8];
+	int i;
+
+	memset(&r, 0, sizeof(r));
+	r.bits = !strcmp(module, "bits");
+	r.charset = r.bits ? "01" : charsets[g_rand_int_range(rand, 0, 3)];
+	r.spl = g_rand_boolean(rand) ? g_rand_int_range(rand, 0, 20)
+		: g_rand_int_range(rand, 0, 100);
+	r.trigger = -1;
+	r.out = g_string_new(NULL);
+
+	num_channels = g_rand_int_range(rand, 1, 25);
+	unitsize = (num_channels + 7) / 8 + g_rand_int_range(rand, 0, 2);
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "1.0");
+	for (i = 0; i < (int)num_channels; i++) {
+		snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	for (l = sr_dev_inst_channels_get(sdi), i = 0; l; l = l->next, i++) {
+		if (g_rand_int_range(rand, 0, 4) == 0) {
+			sr_dev_channel_enable(l->data, FALSE);
+			continue;
+		}
+		r.index[r.num_channels] = i;
+		r.lines[r.num_channels] = g_string_new(NULL);
+		g_string_printf(r.lines[r.num_channels], "D%d:", i);
+		r.num_channels++;
+	}
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("width"),
+			g_variant_ref_sink(g_variant_new_uint32(r.spl)));
+	if (!r.bits)
+		g_hash_table_insert(options, g_strdup("charset"),
+			g_variant_ref_sink(g_variant_new_string(r.charset)));
+	o = sr_output_new(sr_output_find(module), options, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create output instance.");
+	g_hash_table_destroy(options);
+
+	num_samples = g_rand_int_range(rand, 1, 400);
+	data = g_malloc(num_samples * unitsize);
+	for (s = 0; s < num_samples * unitsize; s++) {
+		/* Mostly long runs, so that edges stay rare. */
+		if (s < unitsize || g_rand_int_range(rand, 0, 4) == 0)
+			data[s] = g_rand_int(rand);
+		else
+			data[s] = data[s - unitsize];
+	}
+
+	all = g_string_new(NULL);
+	logic.unitsize = unitsize;
+	for (s = 0; s < num_samples; s += n) {
+		n = MIN(num_samples - s, (unsigned int)g_rand_int_range(rand, 1, 70));
+		if (s && g_rand_int_range(rand, 0, 5) == 0) {
+			output_append(o, SR_DF_TRIGGER, NULL, all);
+			r.trigger = r.spl_cnt;
+		}
+		logic.data = data + s * unitsize;
+		logic.length = n * unitsize;
+		output_append(o, SR_DF_LOGIC, &logic, all);
+		ref_logic(&r, logic.data, logic.length, unitsize);
+	}
+	output_append(o, SR_DF_END, NULL, all);
+	ref_end(&r);
+
+	/* Skip the two header lines. */
+	lines = strchr(all->str, '\n');
+	fail_unless(lines != NULL, "No header.");
+	lines = strchr(lines + 1, '\n');
+	fail_unless(lines != NULL, "No header.");
+	lines++;
+	fail_unless(!strcmp(lines, r.out->str), "%s output differs in round "
+		"%d (%u of %u channels, unit size %u, width %d).", module,
+		round, r.num_channels, num_channels, unitsize, r.spl);
+
+	sr_output_free(o);
+	for (j = 0; j < r.num_channels; j++)
+		g_string_free(r.lines[j], TRUE);
+	g_string_free(r.out, TRUE);
+	g_string_free(all, TRUE);
+	g_free(data);
+}
+
+START_TEST(test_output_bits_random)
+{
+	GRand *rand;
+	int i;
+
+	rand = g_rand_new_with_seed(79);
+	for (i = 0; i < 200; i++)
+		check_render_random("bits", rand, i);
+	g_rand_free(rand);
+}
+END_TEST
+
+START_TEST(test_output_ascii_random)
+{
+	GRand *rand;
+	int i;
+
+	rand = g_rand_new_with_seed(79);
+	for (i = 0; i < 200; i++)
+		check_render_random("ascii", rand, i);
+	g_rand_free(rand);
+}
+END_TEST
+
+static void csv_analog_init(struct sr_datafeed_analog *analog,
+		struct sr_analog_encoding *encoding,
+		struct sr_analog_meaning *meaning, struct sr_analog_spec *spec)
+{
+	memset(analog, 0, sizeof(*analog));
+	memset(encoding, 0, sizeof(*encoding));
+	memset(meaning, 0, sizeof(*meaning));
+	memset(spec, 0, sizeof(*spec));
+	encoding->unitsize = sizeof(float);
+	encoding->is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding->is_bigendian = TRUE;
+#endif
+	encoding->digits = 3;
+	encoding->is_digits_decimal = TRUE;
+	encoding->scale.p = encoding->scale.q = 1;
+	encoding->offset.q = 1;
+	meaning->mq = SR_MQ_VOLTAGE;
+	meaning->unit = SR_UNIT_VOLT;
+	analog->encoding = encoding;
+	analog->meaning = meaning;
+	analog->spec = spec;
+}
+
+/*
+ * Write random captures as CSV: random logic channel layouts, an
+ * optional analog column, separators and trigger positions, with the
+ * logic and analog data split into packets independently of each
+ * other. The rows must come out whole and in order, the same as
+ * formatting them one at a time.
+ */
+static void check_csv_random(GRand *rand, int round)
+{
+	static const char *separators[] = { ",", ";", " | " };
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	const struct sr_output *o;
+	GHashTable *options;
+	GString *all, *ref;
+	GSList *l;
+	uint8_t *data;
+	float *values;
+	const char *sep;
+	unsigned int num_channels, unitsize, num_samples, s, a, n;
+	int trigger, enabled[24], i;
+	gboolean do_trigger, has_analog;
+	char name[8];
+
+	num_channels = g_rand_int_range(rand, 1, 25);
+	unitsize = (num_channels + 7) / 8 + g_rand_int_range(rand, 0, 2);
+	has_analog = g_rand_boolean(rand);
+	do_trigger = g_rand_boolean(rand);
+	sep = separators[g_rand_int_range(rand, 0, 3)];
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "1.0");
+	for (i = 0; i < (int)num_channels; i++) {
+		snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	if (has_analog)
+		sr_dev_inst_channel_add(sdi, num_channels, SR_CHANNEL_ANALOG,
+			"A0");
+	for (l = sr_dev_inst_channels_get(sdi), i = 0; l; l = l->next, i++) {
+		if (i >= (int)num_channels)
+			break;
+		/* Keep the first one, the trigger goes with the logic data. */
+		enabled[i] = i == 0 || g_rand_int_range(rand, 0, 4) != 0;
+		if (!enabled[i])
+			sr_dev_channel_enable(l->data, FALSE);
+	}
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("header"),
+			g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+	g_hash_table_insert(options, g_strdup("label"),
+			g_variant_ref_sink(g_variant_new_string("off")));
+	g_hash_table_insert(options, g_strdup("time"),
+			g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+	g_hash_table_insert(options, g_strdup("trigger"),
+			g_variant_ref_sink(g_variant_new_boolean(do_trigger)));
+	g_hash_table_insert(options, g_strdup("value"),
+			g_variant_ref_sink(g_variant_new_string(sep)));
+	o = sr_output_new(sr_output_find("csv"), options, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create output instance.");
+	g_hash_table_destroy(options);
+
+	num_samples = g_rand_int_range(rand, 1, 400);
+	data = g_malloc(num_samples * unitsize);
+	values = g_malloc(num_samples * sizeof(float));
+	for (s = 0; s < num_samples * unitsize; s++)
+		data[s] = g_rand_int(rand);
+	for (s = 0; s < num_samples; s++)
+		values[s] = g_rand_int_range(rand, -1000, 1000) / 4.0;
+	trigger = g_rand_boolean(rand) ?
+		g_rand_int_range(rand, 1, num_samples + 1) : -1;
+
+	/* Every row, one cell at a time. */
+	ref = g_string_new(NULL);
+	for (s = 0; s < num_samples; s++) {
+		for (i = 0; i < (int)num_channels; i++)
+			if (enabled[i])
+				g_string_append_printf(ref, "%d%s",
+					(data[s * unitsize + i / 8] >> (i % 8)) & 1,
+					sep);
+		if (has_analog)
+			g_string_append_printf(ref, "%g%s", values[s], sep);
+		if (do_trigger)
+			g_string_append_printf(ref, "%d%s",
+				(int)s == trigger, sep);
+		g_string_truncate(ref, ref->len - strlen(sep));
+		g_string_append_c(ref, '\n');
+	}
+
+	/*
+	 * Send the logic and analog data in random chunks, taking turns at
+	 * random. The trigger goes with the logic data.
+	 */
+	all = g_string_new(NULL);
+	csv_analog_init(&analog, &encoding, &meaning, &spec);
+	if (has_analog)
+		meaning.channels = g_slist_append(NULL,
+			g_slist_last(sr_dev_inst_channels_get(sdi))->data);
+	logic.unitsize = unitsize;
+	s = a = 0;
+	while (s < num_samples || (has_analog && a < num_samples)) {
+		if (s < num_samples && (!has_analog || a == num_samples
+		    || g_rand_boolean(rand))) {
+			n = MIN(num_samples - s,
+				(unsigned int)g_rand_int_range(rand, 1, 70));
+			if ((int)s < trigger && trigger < (int)(s + n)) {
+				/* Split the chunk at the trigger. */
+				n = trigger - s;
+			}
+			if ((int)s == trigger)
+				output_append(o, SR_DF_TRIGGER, NULL, all);
+			logic.data = data + s * unitsize;
+			logic.length = n * unitsize;
+			output_append(o, SR_DF_LOGIC, &logic, all);
+			s += n;
+		} else {
+			n = MIN(num_samples - a,
+				(unsigned int)g_rand_int_range(rand, 1, 70));
+			analog.data = values + a;
+			analog.num_samples = n;
+			output_append(o, SR_DF_ANALOG, &analog, all);
+			a += n;
+		}
+	}
+	output_append(o, SR_DF_END, NULL, all);
+
+	fail_unless(!strcmp(all->str, ref->str), "CSV output differs in "
+		"round %d (%u channels, unit size %u, analog %d, "
+		"trigger %d).", round, num_channels, unitsize, has_analog,
+		trigger);
+
+	sr_output_free(o);
+	g_slist_free(meaning.channels);
+	g_string_free(ref, TRUE);
+	g_string_free(all, TRUE);
+	g_free(values);
+	g_free(data);
+}
+
+START_TEST(test_output_csv_random)
+{
+	GRand *rand;
+	int i;
+
+	rand = g_rand_new_with_seed(80);
+	for (i = 0; i < 200; i++)
+		check_csv_random(rand, i);
+	g_rand_free(rand);
+}
+END_TEST
+
 Suite *suite_output_all(void)
 {
 	Suite *s;
@@ -112,5 +504,12 @@ Suite *suite_output_all(void)
 	tcase_add_test(tc, test_output_options);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("render");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_bits_random);
+	tcase_add_test(tc, test_output_ascii_random);
+	tcase_add_test(tc, test_output_csv_random);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -0,0 +1,100 @@
+##
+## This file is part of the libsigrok project.
+##
+## This program is free software; you can redistribute it and/or modify
+## it under the terms of the GNU General Public License as published by
+## the Free Software Foundation; either version 2 of the License, or
+## (at your option) any later version.
+##
+## This program is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program; if not, see <http://www.gnu.org/licenses/>.
+##
+
+# Tests for the native datafeed stream of the Python bindings.
+
+import sys
+import unittest
+
+try:
+    import sigrok.core as sr
+except ImportError:
+    # Exit code 77 marks the test as skipped.
+    sys.exit(77)
+
+SAMPLES = 10000
+
+context = sr.Context.create()
+
+def demo_session():
+    """A session on a demo device which sends SAMPLES samples."""
+    devices = context.drivers['demo'].scan()
+    device = devices[0]
+    device.open()
+    device.config_set(sr.ConfigKey.LIMIT_SAMPLES, SAMPLES)
+    session = context.create_session()
+    session.add_device(device)
+    return session
+
+def logic_samples(chunk):
+    if chunk.type != sr.PacketType.LOGIC:
+        return 0
+    return chunk.data.shape[0]
+
+class StreamTest(unittest.TestCase):
+
+    def test_iterate(self):
+        session = demo_session()
+        stream = session.stream(batch_size=1000)
+        stream.start()
+        chunks = list(stream)
+        self.assertEqual(chunks[-1].type, sr.PacketType.END)
+        self.assertEqual(sum(logic_samples(c) for c in chunks), SAMPLES)
+        self.assertEqual(stream.dropped(), 0)
+
+    def test_close(self):
+        session = demo_session()
+        stream = session.stream()
+        stream.close()
+        # A closed stream ends, and no longer gets any packets.
+        self.assertRaises(StopIteration, stream.get, 0)
+        session.start()
+        session.run()
+        self.assertRaises(StopIteration, stream.get, 0)
+
+    def test_async(self):
+        import asyncio
+        session = demo_session()
+        stream = session.stream(batch_size=1000)
+        async def consume():
+            samples = 0
+            async for chunk in stream:
+                samples += logic_samples(chunk)
+            return samples
+        stream.start()
+        self.assertEqual(asyncio.run(consume()), SAMPLES)
+
+    def test_async_cancel(self):
+        import asyncio
+        session = demo_session()
+        stream = session.stream(batch_size=1000)
+        async def consume():
+            # Nothing arrives before the session starts, give up waiting.
+            with self.assertRaises(asyncio.TimeoutError):
+                await asyncio.wait_for(stream.__anext__(), 0.2)
+            stream.start()
+            samples = 0
+            async for chunk in stream:
+                samples += logic_samples(chunk)
+            return samples
+        # No chunk was lost to the cancelled wait.
+        self.assertEqual(asyncio.run(consume()), SAMPLES)
+
+if __name__ == '__main__':
+    if 'demo' not in context.drivers:
+        sys.exit(77)
+    unittest.main()
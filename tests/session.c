@@ -18,11 +18,17 @@
  */
 
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
+/* The recorder keeps logic data in segments of this size. */
+#define SEGMENT_SIZE (1024 * 1024)
+
 /*
  * Check whether sr_session_new() works.
  * If it returns != SR_OK (or segfaults) this test will fail.
@@ -185,6 +191,930 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+static void count_packets(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	(void)sdi;
+	(void)packet;
+
+	(*(int *)cb_data)++;
+}
+
+/* Check enabling and disabling the flight recorder. */
+START_TEST(test_session_recorder_set)
+{
+	int ret, count;
+	struct sr_session *sess;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	count = 0;
+	ret = sr_session_recorder_snapshot(sess, count_packets, &count);
+	fail_unless(ret == SR_ERR_NA, "Snapshot without recorder: %d.", ret);
+	ret = sr_session_recorder_save(sess, "unused.sr");
+	fail_unless(ret == SR_ERR_NA, "Save without recorder: %d.", ret);
+
+	ret = sr_session_recorder_set(sess, 1024 * 1024, 1000);
+	fail_unless(ret == SR_OK, "Enabling the recorder failed: %d.", ret);
+	ret = sr_session_recorder_set(sess, 0, 5000);
+	fail_unless(ret == SR_OK, "Changing the limits failed: %d.", ret);
+
+	/* Nothing was recorded yet, so there are no devices to replay. */
+	ret = sr_session_recorder_snapshot(sess, count_packets, &count);
+	fail_unless(ret == SR_OK, "Snapshot failed: %d.", ret);
+	fail_unless(count == 0, "Snapshot of nothing sent %d packets.", count);
+
+	ret = sr_session_recorder_set(sess, 0, 0);
+	fail_unless(ret == SR_OK, "Disabling the recorder failed: %d.", ret);
+	ret = sr_session_recorder_snapshot(sess, count_packets, &count);
+	fail_unless(ret == SR_ERR_NA, "Snapshot after disabling: %d.", ret);
+
+	/* Destroying the session frees an enabled recorder. */
+	sr_session_recorder_set(sess, 4096, 0);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+START_TEST(test_session_recorder_null)
+{
+	int ret;
+
+	ret = sr_session_recorder_set(NULL, 1024, 0);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_recorder_snapshot(NULL, count_packets, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_recorder_save(NULL, "unused.sr");
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_recorder_trigger_save_set(NULL, NULL, 0);
+	fail_unless(ret == SR_ERR_ARG);
+}
+END_TEST
+
+/*
+ * Collect the logic data, analog values (if analog is set) and samplerate,
+ * and count the packets of a recorder snapshot.
+ */
+struct snapshot_data {
+	GString *logic;
+	GArray *analog;
+	uint64_t samplerate;
+	int headers, ends, triggers;
+};
+
+static void collect_logic(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct snapshot_data *sd;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_config *src;
+	float *values;
+	GSList *l;
+
+	(void)sdi;
+
+	sd = cb_data;
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		sd->headers++;
+		break;
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				sd->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_TRIGGER:
+		sd->triggers++;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		g_string_append_len(sd->logic, logic->data, logic->length);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		if (!sd->analog)
+			break;
+		values = g_malloc0_n(MAX(analog->num_samples, 1), sizeof(float));
+		fail_unless(sr_analog_to_float(analog, values) == SR_OK);
+		g_array_append_vals(sd->analog, values, analog->num_samples);
+		g_free(values);
+		break;
+	case SR_DF_END:
+		sd->ends++;
+		break;
+	}
+}
+
+/* Fill a buffer with data that differs from one segment to the next. */
+static uint8_t *logic_data_new(size_t len)
+{
+	uint8_t *data;
+	size_t i;
+
+	data = g_malloc(len);
+	for (i = 0; i < len; i++)
+		data[i] = i / 4096 + i;
+
+	return data;
+}
+
+/* Send logic data to a session through the "binary" input module. */
+static struct sr_input *feed_logic(struct sr_session *sess,
+		const uint8_t *data, size_t len)
+{
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	GString *buf;
+	int ret;
+
+	imod = sr_input_find("binary");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	ret = sr_session_dev_add(sess, sr_input_dev_inst_get(in));
+	fail_unless(ret == SR_OK, "sr_session_dev_add() error: %d", ret);
+
+	buf = g_string_new_len((const char *)data, len);
+	ret = sr_input_send(in, buf);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	g_string_free(buf, TRUE);
+
+	return in;
+}
+
+/* Check that a snapshot holds the most recent data, in order. */
+static void check_recent(const struct snapshot_data *sd,
+		const uint8_t *data, size_t len)
+{
+	fail_unless(sd->headers == 1 && sd->ends == 1,
+		"%d headers, %d ends.", sd->headers, sd->ends);
+	fail_unless(sd->logic->len <= len, "Recorded %zu of %zu bytes.",
+		sd->logic->len, len);
+	fail_unless(!memcmp(sd->logic->str, data + len - sd->logic->len,
+		sd->logic->len), "Not the most recent data, or out of order.");
+}
+
+/* The ring drops the oldest data beyond its size limit. */
+START_TEST(test_session_recorder_ring)
+{
+	struct sr_session *sess;
+	struct sr_input *in;
+	struct snapshot_data sd;
+	uint8_t *data;
+	size_t len;
+
+	len = 5 * SEGMENT_SIZE;
+	data = logic_data_new(len);
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_recorder_set(sess, 2 * SEGMENT_SIZE, 0);
+	in = feed_logic(sess, data, len);
+
+	memset(&sd, 0, sizeof(sd));
+	sd.logic = g_string_new(NULL);
+	sr_session_recorder_snapshot(sess, collect_logic, &sd);
+	fail_unless(sd.logic->len > SEGMENT_SIZE
+		&& sd.logic->len <= 2 * SEGMENT_SIZE,
+		"Recorded %zu bytes.", sd.logic->len);
+	check_recent(&sd, data, len);
+
+	g_string_free(sd.logic, TRUE);
+	sr_session_destroy(sess);
+	sr_input_free(in);
+	g_free(data);
+}
+END_TEST
+
+/* Saved data loads back as it was recorded. */
+START_TEST(test_session_recorder_save)
+{
+	struct sr_session *sess, *loaded;
+	struct sr_input *in;
+	struct snapshot_data sd, saved;
+	uint8_t *data;
+	char *dir, *path;
+	size_t len;
+	int ret;
+
+	len = 3 * SEGMENT_SIZE;
+	data = logic_data_new(len);
+	dir = g_dir_make_tmp("srtest-XXXXXX", NULL);
+	fail_unless(dir != NULL);
+	path = g_build_filename(dir, "recorder.sr", NULL);
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_recorder_set(sess, 2 * SEGMENT_SIZE, 0);
+	in = feed_logic(sess, data, len);
+
+	memset(&sd, 0, sizeof(sd));
+	sd.logic = g_string_new(NULL);
+	sr_session_recorder_snapshot(sess, collect_logic, &sd);
+	check_recent(&sd, data, len);
+
+	ret = sr_session_recorder_save(sess, path);
+	fail_unless(ret == SR_OK, "sr_session_recorder_save() error: %d", ret);
+
+	ret = sr_session_load(srtest_ctx, path, &loaded);
+	fail_unless(ret == SR_OK, "sr_session_load() error: %d", ret);
+	memset(&saved, 0, sizeof(saved));
+	saved.logic = g_string_new(NULL);
+	sr_session_datafeed_callback_add(loaded, collect_logic, &saved);
+	ret = sr_session_start(loaded);
+	fail_unless(ret == SR_OK, "sr_session_start() error: %d", ret);
+	ret = sr_session_run(loaded);
+	fail_unless(ret == SR_OK, "sr_session_run() error: %d", ret);
+	fail_unless(saved.logic->len == sd.logic->len,
+		"Loaded %zu of %zu bytes.", saved.logic->len, sd.logic->len);
+	fail_unless(!memcmp(saved.logic->str, sd.logic->str, sd.logic->len),
+		"Loaded data differs.");
+
+	sr_session_destroy(loaded);
+	g_string_free(saved.logic, TRUE);
+	g_string_free(sd.logic, TRUE);
+	sr_session_destroy(sess);
+	sr_input_free(in);
+	g_unlink(path);
+	g_rmdir(dir);
+	g_free(path);
+	g_free(dir);
+	g_free(data);
+}
+END_TEST
+
+/*
+ * Segments that don't fit into the memory budget fail to allocate: the
+ * recorder drops its oldest data to make room, and can't hold more than
+ * the budget.
+ */
+START_TEST(test_session_recorder_budget)
+{
+	struct sr_session *sess;
+	struct sr_input *in;
+	struct snapshot_data sd;
+	uint8_t *data;
+	uint64_t used, budget;
+	size_t len;
+
+	len = 4 * SEGMENT_SIZE;
+	data = logic_data_new(len);
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_memory_budget_set(sess, 2 * SEGMENT_SIZE + SEGMENT_SIZE / 2);
+	sr_session_recorder_set(sess, 0, 3600 * 1000);
+	in = feed_logic(sess, data, len);
+
+	sr_session_memory_usage_get(sess, &used, &budget);
+	fail_unless(used > 0, "Nothing was accounted.");
+	fail_unless(used <= budget, "Over budget: %" PRIu64 " bytes used.",
+		used);
+
+	memset(&sd, 0, sizeof(sd));
+	sd.logic = g_string_new(NULL);
+	sr_session_recorder_snapshot(sess, collect_logic, &sd);
+	fail_unless(sd.logic->len <= 2 * SEGMENT_SIZE,
+		"Recorded %zu bytes.", sd.logic->len);
+	fail_unless(sd.logic->len >= SEGMENT_SIZE,
+		"Only %zu bytes recorded.", sd.logic->len);
+	check_recent(&sd, data, len);
+
+	g_string_free(sd.logic, TRUE);
+	sr_session_destroy(sess);
+	sr_input_free(in);
+	g_free(data);
+}
+END_TEST
+
+/*
+ * With a spill directory, segments beyond the memory budget are backed
+ * by files and not accounted against it.
+ */
+START_TEST(test_session_recorder_spill)
+{
+	struct sr_session *sess;
+	struct sr_input *in;
+	struct snapshot_data sd;
+	uint8_t *data;
+	uint64_t used, budget;
+	char *dir;
+	size_t len;
+	int ret;
+
+	in = NULL;
+	len = 4 * SEGMENT_SIZE;
+	data = logic_data_new(len);
+	dir = g_dir_make_tmp("srtest-XXXXXX", NULL);
+	fail_unless(dir != NULL);
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_memory_budget_set(sess, 2 * SEGMENT_SIZE + SEGMENT_SIZE / 2);
+	ret = sr_session_memory_spill_dir_set(sess, dir);
+#ifdef _WIN32
+	fail_unless(ret == SR_ERR_NA, "Spilling on Windows: %d.", ret);
+#else
+	fail_unless(ret == SR_OK, "sr_session_memory_spill_dir_set() error: "
+		"%d", ret);
+	sr_session_recorder_set(sess, 0, 3600 * 1000);
+	in = feed_logic(sess, data, len);
+
+	sr_session_memory_usage_get(sess, &used, &budget);
+	fail_unless(used <= budget, "Over budget: %" PRIu64 " bytes used.",
+		used);
+
+	memset(&sd, 0, sizeof(sd));
+	sd.logic = g_string_new(NULL);
+	sr_session_recorder_snapshot(sess, collect_logic, &sd);
+	fail_unless(sd.logic->len == len, "Recorded %zu of %zu bytes.",
+		sd.logic->len, len);
+	fail_unless(!memcmp(sd.logic->str, data, len), "Data differs.");
+	g_string_free(sd.logic, TRUE);
+#endif
+
+	/* The spill files are already unlinked. */
+	sr_session_destroy(sess);
+	if (in)
+		sr_input_free(in);
+	fail_unless(g_rmdir(dir) == 0, "Spill directory not empty.");
+	g_free(dir);
+	g_free(data);
+}
+END_TEST
+
+/*
+ * A device which sends to a session as the test goes, through the
+ * "stream" output and input modules, so that packets arrive whenever the
+ * test sends them.
+ */
+struct live_source {
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_input *in;
+};
+
+static void live_send(struct live_source *ls, uint16_t type,
+		const void *payload)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	int ret;
+
+	packet.type = type;
+	packet.payload = payload;
+	out = NULL;
+	ret = sr_output_send(ls->o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() error: %d", ret);
+	if (!out)
+		return;
+	ret = sr_input_send(ls->in, out);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	g_string_free(out, TRUE);
+}
+
+static void live_open(struct live_source *ls, struct sr_session *sess,
+		int channel_type, uint64_t samplerate)
+{
+	struct sr_datafeed_header header;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	int ret;
+
+	ls->sdi = sr_dev_inst_user_new("Vendor", "Model", "1.0");
+	sr_dev_inst_channel_add(ls->sdi, 0, channel_type, "CH0");
+	ls->o = sr_output_new(sr_output_find("stream"), NULL, ls->sdi, NULL);
+	fail_unless(ls->o != NULL, "Failed to create output instance.");
+	ls->in = sr_input_new(sr_input_find("stream"), NULL);
+	fail_unless(ls->in != NULL, "Failed to create input instance.");
+
+	/* The input knows the device after the first packet. */
+	header.feed_version = 1;
+	header.starttime.tv_sec = 0;
+	header.starttime.tv_usec = 0;
+	live_send(ls, SR_DF_HEADER, &header);
+	fail_unless(sr_input_dev_inst_get(ls->in) != NULL, "No device.");
+	ret = sr_session_dev_add(sess, sr_input_dev_inst_get(ls->in));
+	fail_unless(ret == SR_OK, "sr_session_dev_add() error: %d", ret);
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(samplerate));
+	meta.config = g_slist_append(NULL, &src);
+	live_send(ls, SR_DF_META, &meta);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+}
+
+static void live_logic(struct live_source *ls, const uint8_t *data,
+		uint64_t length)
+{
+	struct sr_datafeed_logic logic;
+
+	logic.length = length;
+	logic.unitsize = 1;
+	logic.data = (void *)data;
+	live_send(ls, SR_DF_LOGIC, &logic);
+}
+
+static void live_analog(struct live_source *ls, const float *data,
+		unsigned int num_samples)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = sizeof(float);
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.channels = sr_dev_inst_channels_get(ls->sdi);
+	analog.data = (void *)data;
+	analog.num_samples = num_samples;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	live_send(ls, SR_DF_ANALOG, &analog);
+}
+
+/* Call after destroying the session. */
+static void live_close(struct live_source *ls)
+{
+	sr_output_free(ls->o);
+	sr_input_free(ls->in);
+}
+
+/*
+ * Data older than the time limit is dropped, but the settings it came
+ * with are kept.
+ */
+START_TEST(test_session_recorder_time)
+{
+	struct sr_session *sess;
+	struct live_source ls;
+	struct snapshot_data sd;
+	uint8_t data[200];
+
+	memset(data, 0x01, 100);
+	memset(data + 100, 0x02, 100);
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_recorder_set(sess, 0, 200);
+	live_open(&ls, sess, SR_CHANNEL_LOGIC, SR_KHZ(10));
+	live_logic(&ls, data, 100);
+	g_usleep(300 * 1000);
+	live_logic(&ls, data + 100, 100);
+
+	memset(&sd, 0, sizeof(sd));
+	sd.logic = g_string_new(NULL);
+	sr_session_recorder_snapshot(sess, collect_logic, &sd);
+	fail_unless(sd.logic->len == 100, "Recorded %zu bytes.",
+		sd.logic->len);
+	check_recent(&sd, data, sizeof(data));
+	fail_unless(sd.samplerate == SR_KHZ(10), "Samplerate was lost.");
+
+	g_string_free(sd.logic, TRUE);
+	sr_session_destroy(sess);
+	live_close(&ls);
+}
+END_TEST
+
+/*
+ * Analog packets are kept as copies, and dropped whole beyond the size
+ * limit. The samplerate from the first, dropped, packets is kept.
+ */
+START_TEST(test_session_recorder_analog)
+{
+	struct sr_session *sess;
+	struct live_source ls;
+	struct snapshot_data sd;
+	float data[1000];
+	unsigned int i, n;
+
+	for (i = 0; i < G_N_ELEMENTS(data); i++)
+		data[i] = i;
+
+	sr_session_new(srtest_ctx, &sess);
+	/* Room for a few packets of 100 samples, but not all of them. */
+	sr_session_recorder_set(sess, 3000, 0);
+	live_open(&ls, sess, SR_CHANNEL_ANALOG, SR_MHZ(1));
+	for (i = 0; i < G_N_ELEMENTS(data); i += 100)
+		live_analog(&ls, data + i, 100);
+
+	memset(&sd, 0, sizeof(sd));
+	sd.logic = g_string_new(NULL);
+	sd.analog = g_array_new(FALSE, FALSE, sizeof(float));
+	sr_session_recorder_snapshot(sess, collect_logic, &sd);
+	n = sd.analog->len;
+	fail_unless(sd.headers == 1 && sd.ends == 1,
+		"%d headers, %d ends.", sd.headers, sd.ends);
+	fail_unless(n > 0 && n < G_N_ELEMENTS(data) && n % 100 == 0,
+		"Recorded %u samples.", n);
+	fail_unless(!memcmp(sd.analog->data, data + G_N_ELEMENTS(data) - n,
+		n * sizeof(float)), "Not the most recent data, or out of order.");
+	fail_unless(sd.samplerate == SR_MHZ(1), "Samplerate was lost.");
+
+	g_array_free(sd.analog, TRUE);
+	g_string_free(sd.logic, TRUE);
+	sr_session_destroy(sess);
+	live_close(&ls);
+}
+END_TEST
+
+static gint name_cmp(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Names of the files in a directory, sorted. */
+static GPtrArray *dir_list(const char *path)
+{
+	GPtrArray *names;
+	const char *name;
+	GDir *dir;
+
+	names = g_ptr_array_new_with_free_func(g_free);
+	dir = g_dir_open(path, 0, NULL);
+	fail_unless(dir != NULL, "Failed to open %s.", path);
+	while ((name = g_dir_read_name(dir)))
+		g_ptr_array_add(names, g_strdup(name));
+	g_dir_close(dir);
+	g_ptr_array_sort(names, name_cmp);
+
+	return names;
+}
+
+/* Load a session file, and collect its logic data. */
+static GString *load_logic(const char *path)
+{
+	struct sr_session *loaded;
+	struct snapshot_data sd;
+	int ret;
+
+	ret = sr_session_load(srtest_ctx, path, &loaded);
+	fail_unless(ret == SR_OK, "sr_session_load() error: %d", ret);
+	memset(&sd, 0, sizeof(sd));
+	sd.logic = g_string_new(NULL);
+	sr_session_datafeed_callback_add(loaded, collect_logic, &sd);
+	ret = sr_session_start(loaded);
+	fail_unless(ret == SR_OK, "sr_session_start() error: %d", ret);
+	ret = sr_session_run(loaded);
+	fail_unless(ret == SR_OK, "sr_session_run() error: %d", ret);
+	sr_session_destroy(loaded);
+
+	return sd.logic;
+}
+
+/*
+ * A trigger saves the recorded data in the background, once the
+ * post-trigger time has passed, or the acquisition ended.
+ */
+START_TEST(test_session_recorder_trigger_save)
+{
+	struct sr_session *sess;
+	struct live_source ls;
+	GPtrArray *names;
+	GString *logic;
+	uint8_t data[300];
+	char *dir, *path;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i;
+	dir = g_dir_make_tmp("srtest-XXXXXX", NULL);
+	fail_unless(dir != NULL);
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_recorder_trigger_save_set(sess, dir, 1000);
+	fail_unless(ret == SR_ERR_NA, "Saving without recorder: %d.", ret);
+	sr_session_recorder_set(sess, 0, 3600 * 1000);
+	ret = sr_session_recorder_trigger_save_set(sess, dir, 1000);
+	fail_unless(ret == SR_OK, "Enabling saving failed: %d.", ret);
+	live_open(&ls, sess, SR_CHANNEL_LOGIC, SR_KHZ(10));
+
+	live_logic(&ls, data, 100);
+	live_send(&ls, SR_DF_TRIGGER, NULL);
+	live_logic(&ls, data + 100, 100);
+	names = dir_list(dir);
+	fail_unless(names->len == 0, "Saved before the post-trigger time.");
+	g_ptr_array_free(names, TRUE);
+	g_usleep(1100 * 1000);
+	live_logic(&ls, data + 200, 100);
+
+	/* The end of the acquisition doesn't wait for post-trigger data. */
+	live_send(&ls, SR_DF_TRIGGER, NULL);
+	live_send(&ls, SR_DF_END, NULL);
+
+	/* This waits for the saves to finish. */
+	sr_session_destroy(sess);
+	live_close(&ls);
+
+	names = dir_list(dir);
+	fail_unless(names->len == 2, "%u files were saved.", names->len);
+	for (i = 0; i < names->len; i++) {
+		fail_unless(g_str_has_prefix(names->pdata[i], "recorder-")
+			&& g_str_has_suffix(names->pdata[i],
+			i == 0 ? "-1.sr" : "-2.sr"), "Unexpected file %s.",
+			(char *)names->pdata[i]);
+		path = g_build_filename(dir, names->pdata[i], NULL);
+		logic = load_logic(path);
+		fail_unless(logic->len == sizeof(data), "Loaded %zu bytes "
+			"from %s.", logic->len, (char *)names->pdata[i]);
+		fail_unless(!memcmp(logic->str, data, sizeof(data)),
+			"Loaded data differs.");
+		g_string_free(logic, TRUE);
+		g_unlink(path);
+		g_free(path);
+	}
+	g_ptr_array_free(names, TRUE);
+
+	g_rmdir(dir);
+	g_free(dir);
+}
+END_TEST
+
+/* Check setting and getting the memory budget. */
+START_TEST(test_session_memory_budget)
+{
+	struct sr_session *sess;
+	uint64_t used, budget;
+	int ret;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	ret = sr_session_memory_usage_get(sess, &used, &budget);
+	fail_unless(ret == SR_OK, "sr_session_memory_usage_get() error: %d", ret);
+	fail_unless(used == 0 && budget == 0, "Unexpected defaults.");
+
+	ret = sr_session_memory_budget_set(sess, 123456);
+	fail_unless(ret == SR_OK, "sr_session_memory_budget_set() error: %d", ret);
+	ret = sr_session_memory_usage_get(sess, NULL, &budget);
+	fail_unless(ret == SR_OK);
+	fail_unless(budget == 123456, "Wrong budget: %" PRIu64 ".", budget);
+
+	fail_unless(sr_session_memory_budget_set(NULL, 1) == SR_ERR_ARG);
+	fail_unless(sr_session_memory_spill_dir_set(NULL, NULL) == SR_ERR_ARG);
+	fail_unless(sr_session_memory_usage_get(NULL, &used, NULL) == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+static void csv_send(const struct sr_output *o, uint16_t type,
+		const void *payload, int *rows)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	unsigned int i;
+	int ret;
+
+	packet.type = type;
+	packet.payload = payload;
+	out = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() error: %d", ret);
+	*rows = 0;
+	if (!out)
+		return;
+	for (i = 0; i < out->len; i++)
+		*rows += out->str[i] == '\n';
+	g_string_free(out, TRUE);
+}
+
+/*
+ * The CSV output module accounts the rows that wait for their analog
+ * columns, and doesn't cut them short while over the budget.
+ */
+START_TEST(test_session_memory_csv)
+{
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ach;
+	const struct sr_output *o;
+	struct sr_datafeed_header header;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	GHashTable *options;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	uint8_t ldata[100];
+	float adata[100];
+	uint64_t used;
+	int rows, i;
+
+	for (i = 0; i < 100; i++) {
+		ldata[i] = i & 1;
+		adata[i] = i;
+	}
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_memory_budget_set(sess, 64);
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "1.0");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_LOGIC, "D0");
+	sr_dev_inst_channel_add(sdi, 1, SR_CHANNEL_ANALOG, "A0");
+	ach = g_slist_nth_data(sr_dev_inst_channels_get(sdi), 1);
+	sr_session_dev_add(sess, sdi);
+
+	/* No label row, so every line is a row of values. */
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("label"),
+			g_variant_ref_sink(g_variant_new_string("off")));
+	o = sr_output_new(sr_output_find("csv"), options, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create output instance.");
+	g_hash_table_destroy(options);
+
+	header.feed_version = 1;
+	header.starttime.tv_sec = 0;
+	header.starttime.tv_usec = 0;
+	csv_send(o, SR_DF_HEADER, &header, &rows);
+
+	logic.length = sizeof(ldata);
+	logic.unitsize = 1;
+	logic.data = ldata;
+	csv_send(o, SR_DF_LOGIC, &logic, &rows);
+	fail_unless(rows == 0, "%d incomplete rows written.", rows);
+	sr_session_memory_usage_get(sess, &used, NULL);
+	fail_unless(used == sizeof(ldata), "%" PRIu64 " bytes accounted.",
+		used);
+
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = sizeof(float);
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.digits = 3;
+	encoding.is_digits_decimal = TRUE;
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.channels = g_slist_append(NULL, ach);
+	analog.data = adata;
+	analog.num_samples = 100;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	csv_send(o, SR_DF_ANALOG, &analog, &rows);
+	fail_unless(rows == 100, "%d rows written.", rows);
+	sr_session_memory_usage_get(sess, &used, NULL);
+	fail_unless(used == 0, "%" PRIu64 " bytes still accounted.", used);
+
+	csv_send(o, SR_DF_END, NULL, &rows);
+	sr_output_free(o);
+	g_slist_free(meaning.channels);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+static void srzip_send(const struct sr_output *o, uint16_t type,
+		const void *payload)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	int ret;
+
+	packet.type = type;
+	packet.payload = payload;
+	out = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() error: %d", ret);
+	fail_unless(out == NULL);
+}
+
+static void check_file_info(const char *path, uint64_t total_samples,
+		int64_t trigger_pos, unsigned int *num_chunks)
+{
+	struct sr_session_file_info *info;
+	const struct sr_session_file_channel *ch;
+	const struct sr_session_file_chunk *chunk;
+	uint64_t samples;
+	GSList *l;
+	char name[8];
+	int ret, i;
+
+	ret = sr_session_file_info(path, &info);
+	fail_unless(ret == SR_OK, "sr_session_file_info() error: %d", ret);
+	fail_unless(info->samplerate == SR_MHZ(1), "Wrong samplerate: %"
+		PRIu64 ".", info->samplerate);
+	fail_unless(info->unitsize == 1, "Wrong unitsize: %u.", info->unitsize);
+	fail_unless(info->total_samples == total_samples, "Got %" PRIu64
+		" samples, expected %" PRIu64 ".", info->total_samples,
+		total_samples);
+	fail_unless(info->trigger_pos == trigger_pos, "Trigger at %" PRIi64
+		", expected %" PRIi64 ".", info->trigger_pos, trigger_pos);
+
+	fail_unless(g_slist_length(info->channels) == 8);
+	for (l = info->channels, i = 0; l; l = l->next, i++) {
+		ch = l->data;
+		snprintf(name, sizeof(name), "D%d", i);
+		fail_unless(ch->index == i && ch->type == SR_CHANNEL_LOGIC
+			&& !strcmp(ch->name, name), "Wrong channel %d.", i);
+	}
+
+	samples = 0;
+	for (l = info->chunks; l; l = l->next) {
+		chunk = l->data;
+		fail_unless(chunk->name != NULL);
+		samples += chunk->num_samples;
+	}
+	fail_unless(samples == total_samples, "Chunks hold %" PRIu64
+		" samples.", samples);
+	*num_chunks = g_slist_length(info->chunks);
+
+	sr_session_file_info_free(info);
+}
+
+/*
+ * Write a session file with the "srzip" output module, and read its
+ * summary back: first from the index, then, after more data dropped the
+ * index, from the metadata and the archive directory.
+ */
+START_TEST(test_session_file_info)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_header header;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_config src;
+	uint8_t *data;
+	unsigned int indexed_chunks, chunks;
+	char *dir, *path, name[8];
+	size_t len;
+	int i;
+
+	len = SEGMENT_SIZE;
+	data = logic_data_new(len);
+	dir = g_dir_make_tmp("srtest-XXXXXX", NULL);
+	fail_unless(dir != NULL);
+	path = g_build_filename(dir, "info.sr", NULL);
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "1.0");
+	for (i = 0; i < 8; i++) {
+		snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	o = sr_output_new(sr_output_find("srzip"), NULL, sdi, path);
+	fail_unless(o != NULL, "Failed to create output instance.");
+
+	header.feed_version = 1;
+	header.starttime.tv_sec = 0;
+	header.starttime.tv_usec = 0;
+	srzip_send(o, SR_DF_HEADER, &header);
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(1)));
+	meta.config = g_slist_append(NULL, &src);
+	srzip_send(o, SR_DF_META, &meta);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	logic.unitsize = 1;
+	logic.length = len / 4;
+	logic.data = data;
+	srzip_send(o, SR_DF_LOGIC, &logic);
+	srzip_send(o, SR_DF_TRIGGER, NULL);
+	logic.length = len / 2;
+	logic.data = data + len / 4;
+	srzip_send(o, SR_DF_LOGIC, &logic);
+	srzip_send(o, SR_DF_END, NULL);
+
+	/* The index knows the trigger position. */
+	check_file_info(path, len / 4 + len / 2, len / 4, &indexed_chunks);
+	fail_unless(indexed_chunks > 0, "No chunks listed.");
+
+	/* Data after the end makes the index stale, it gets dropped. */
+	logic.length = len / 4;
+	logic.data = data + len / 4 + len / 2;
+	srzip_send(o, SR_DF_LOGIC, &logic);
+	check_file_info(path, len, -1, &chunks);
+	fail_unless(chunks > indexed_chunks, "%u chunks, %u before.",
+		chunks, indexed_chunks);
+
+	sr_output_free(o);
+	g_unlink(path);
+	g_rmdir(dir);
+	g_free(path);
+	g_free(dir);
+	g_free(data);
+}
+END_TEST
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -209,5 +1139,29 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("recorder");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_recorder_set);
+	tcase_add_test(tc, test_session_recorder_null);
+	tcase_add_test(tc, test_session_recorder_ring);
+	tcase_add_test(tc, test_session_recorder_save);
+	tcase_add_test(tc, test_session_recorder_budget);
+	tcase_add_test(tc, test_session_recorder_spill);
+	tcase_add_test(tc, test_session_recorder_time);
+	tcase_add_test(tc, test_session_recorder_analog);
+	tcase_add_test(tc, test_session_recorder_trigger_save);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("memory");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_memory_budget);
+	tcase_add_test(tc, test_session_memory_csv);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("file");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_file_info);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -0,0 +1,256 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#ifdef HAVE_SIMD_NEON
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+/* Long enough for the widest vector loop, a scalar tail, and an offset. */
+#define MAX_SAMPLES 97
+#define MAX_UNITSIZE 4
+
+/* Every variant that was built, the baseline first. */
+static const struct sr_simd_kernels *const variants[] = {
+	&sr_simd_kernels_baseline,
+#ifdef HAVE_SIMD_SSE42
+	&sr_simd_kernels_sse42,
+#endif
+#ifdef HAVE_SIMD_AVX2
+	&sr_simd_kernels_avx2,
+#endif
+#ifdef HAVE_SIMD_NEON
+	&sr_simd_kernels_neon,
+#endif
+};
+
+/* Same as in src/simd/simd.c, variants the CPU can't run are skipped. */
+static gboolean cpu_supports(const struct sr_simd_kernels *k)
+{
+#ifdef HAVE_SIMD_AVX2
+	if (k == &sr_simd_kernels_avx2)
+		return __builtin_cpu_supports("avx2");
+#endif
+#ifdef HAVE_SIMD_SSE42
+	if (k == &sr_simd_kernels_sse42)
+		return __builtin_cpu_supports("sse4.2");
+#endif
+#ifdef HAVE_SIMD_NEON
+	if (k == &sr_simd_kernels_neon)
+		return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+	(void)k;
+
+	return TRUE;
+}
+
+static const struct sr_simd_kernels *variant_get(unsigned int i)
+{
+	if (i >= G_N_ELEMENTS(variants) || !cpu_supports(variants[i]))
+		return NULL;
+
+	return variants[i];
+}
+
+/*
+ * Samples which each differ from value in one bit of mask, so that a
+ * sample with only some of its bytes matching is never taken for a
+ * match. The sample at match_pos (if within count) matches.
+ */
+static void find_data(GRand *rand, uint8_t *data, unsigned int unitsize,
+		size_t count, uint64_t mask, uint64_t value, size_t match_pos)
+{
+	uint64_t v;
+	size_t i;
+	int bit;
+
+	for (i = 0; i < count; i++) {
+		v = value | ((uint64_t)g_rand_int(rand) & ~mask);
+		if (i != match_pos) {
+			do {
+				bit = g_rand_int_range(rand, 0, 8 * unitsize);
+			} while (!(mask & ((uint64_t)1 << bit)));
+			v ^= (uint64_t)1 << bit;
+		}
+		memcpy(data + i * unitsize, &v, unitsize);
+	}
+}
+
+/*
+ * Look for a match at every position of every length up to MAX_SAMPLES,
+ * and for one that isn't there, with every variant. The lengths cover
+ * the vector loops as well as odd scalar tails.
+ */
+START_TEST(test_logic_find)
+{
+	static const uint64_t masks[] = { 0, 0x5b, 0xf00f, 0, 0x80ff0001 };
+	static const uint64_t values[] = { 0, 0x4a, 0x3005, 0, 0x00a50001 };
+	const struct sr_simd_kernels *k;
+	uint8_t data[MAX_SAMPLES * MAX_UNITSIZE];
+	unsigned int unitsize, i;
+	size_t count, pos, found;
+	GRand *rand;
+
+	rand = g_rand_new_with_seed(1);
+	for (unitsize = 1; unitsize <= MAX_UNITSIZE; unitsize *= 2) {
+		for (count = 0; count <= MAX_SAMPLES; count++) {
+			for (pos = 0; pos <= count; pos++) {
+				find_data(rand, data, unitsize, count,
+					masks[unitsize], values[unitsize], pos);
+				for (i = 0; i < G_N_ELEMENTS(variants); i++) {
+					if (!(k = variant_get(i)))
+						continue;
+					found = k->logic_find(data, unitsize, count,
+						masks[unitsize], values[unitsize]);
+					fail_unless(found == pos, "'%s' found %zu "
+						"instead of %zu, unitsize %u, "
+						"count %zu.", k->name, found, pos,
+						unitsize, count);
+				}
+			}
+		}
+	}
+	g_rand_free(rand);
+}
+END_TEST
+
+/* The plane of channel idx, bit by bit. */
+static void plane_expected(const uint8_t *data, unsigned int unitsize,
+		size_t num_samples, int idx, uint8_t *plane)
+{
+	size_t s;
+
+	memset(plane, 0, (num_samples + 7) / 8);
+	for (s = 0; s < num_samples; s++) {
+		if (data[s * unitsize + idx / 8] & (1 << (idx % 8)))
+			plane[s / 8] |= 1 << (s % 8);
+	}
+}
+
+/*
+ * Compare the planes of every variant with the expected ones, for every
+ * length up to MAX_SAMPLES. With a unitsize of 1 those cover the 32 and
+ * 16 sample blocks of the vector loops, and every tail after them.
+ */
+static void check_planes(unsigned int unitsize, const int *channel_index,
+		unsigned int num_channels)
+{
+	const struct sr_simd_kernels *k;
+	uint8_t data[MAX_SAMPLES * MAX_UNITSIZE];
+	uint8_t planes[8 * ((MAX_SAMPLES + 7) / 8)];
+	uint8_t expected[(MAX_SAMPLES + 7) / 8];
+	unsigned int i, j;
+	size_t num_samples, stride;
+	GRand *rand;
+
+	rand = g_rand_new_with_seed(unitsize);
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = g_rand_int(rand);
+	g_rand_free(rand);
+
+	for (num_samples = 1; num_samples <= MAX_SAMPLES; num_samples++) {
+		stride = (num_samples + 7) / 8;
+		for (i = 0; i < G_N_ELEMENTS(variants); i++) {
+			if (!(k = variant_get(i)))
+				continue;
+			memset(planes, 0xff, sizeof(planes));
+			k->logic_to_planes(data, unitsize, num_samples,
+				channel_index, num_channels, planes, stride);
+			for (j = 0; j < num_channels; j++) {
+				plane_expected(data, unitsize, num_samples,
+					channel_index[j], expected);
+				fail_unless(!memcmp(planes + j * stride,
+					expected, stride), "'%s' plane %u "
+					"differs, unitsize %u, %zu samples.",
+					k->name, j, unitsize, num_samples);
+			}
+		}
+	}
+}
+
+START_TEST(test_logic_to_planes_unitsize1)
+{
+	static const int all[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+	static const int unsorted[] = { 7, 0, 5 };
+
+	check_planes(1, all, G_N_ELEMENTS(all));
+	check_planes(1, unsorted, G_N_ELEMENTS(unsorted));
+}
+END_TEST
+
+START_TEST(test_logic_to_planes_unitsize3)
+{
+	static const int channels[] = { 1, 8, 9, 23, 16, 4 };
+
+	check_planes(3, channels, G_N_ELEMENTS(channels));
+}
+END_TEST
+
+START_TEST(test_int_to_float)
+{
+	const struct sr_simd_kernels *k;
+	uint8_t data[MAX_SAMPLES * MAX_UNITSIZE];
+	float expected[MAX_SAMPLES], dst[MAX_SAMPLES];
+	unsigned int unitsize, i;
+	int is_signed;
+	GRand *rand;
+
+	rand = g_rand_new_with_seed(1);
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = g_rand_int(rand);
+	g_rand_free(rand);
+
+	for (unitsize = 1; unitsize <= MAX_UNITSIZE; unitsize *= 2) {
+		for (is_signed = 0; is_signed <= 1; is_signed++) {
+			sr_simd_kernels_baseline.int_to_float(data, unitsize,
+				is_signed, expected, MAX_SAMPLES, 0.25, -3);
+			for (i = 1; i < G_N_ELEMENTS(variants); i++) {
+				if (!(k = variant_get(i)))
+					continue;
+				k->int_to_float(data, unitsize, is_signed, dst,
+					MAX_SAMPLES, 0.25, -3);
+				fail_unless(!memcmp(dst, expected, sizeof(dst)),
+					"'%s' differs, unitsize %u, signed %d.",
+					k->name, unitsize, is_signed);
+			}
+		}
+	}
+}
+END_TEST
+
+Suite *suite_simd(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("simd");
+
+	tc = tcase_create("kernels");
+	tcase_add_test(tc, test_logic_find);
+	tcase_add_test(tc, test_logic_to_planes_unitsize1);
+	tcase_add_test(tc, test_logic_to_planes_unitsize3);
+	tcase_add_test(tc, test_int_to_float);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
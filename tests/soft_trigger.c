@@ -0,0 +1,195 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+#define NUM_CHANNELS 16
+#define NUM_SAMPLES 100
+/* Samples per frame, the pre-trigger samples included. */
+#define FRAME_SAMPLES 15
+#define PRE_TRIGGER_SAMPLES 4
+
+/* Where channel 0 goes high in the buffer, for 3 samples each time. */
+static const int edges[] = { 10, 40, 53 };
+
+/* The index of each sample that was sent, and where the triggers were. */
+static GArray *received;
+static GArray *triggers;
+
+/* Samples carry their index in the bits above channels 0 and 1. */
+static void received_append(const uint16_t *data, int count)
+{
+	uint16_t index;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		index = data[i] >> 2;
+		g_array_append_val(received, index);
+	}
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		/* Pre-trigger samples. */
+		logic = packet->payload;
+		received_append(logic->data, logic->length / logic->unitsize);
+		break;
+	case SR_DF_TRIGGER:
+		g_array_append_val(triggers, received->len);
+		break;
+	}
+}
+
+/*
+ * Run a frame acquisition over one buffer the way fx2lafw's transfer
+ * callback does: after each frame of FRAME_SAMPLES, re-arm the trigger
+ * in place, and look for the next trigger in the rest of the buffer.
+ */
+static void check_frames(int match)
+{
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct soft_trigger_logic *stl;
+	uint16_t buf[NUM_SAMPLES], *data;
+	int left, sent, offset, pre_trigger_samples, num_samples;
+	unsigned int e, i, pos;
+	int s;
+	gboolean fired;
+	char *name;
+
+	for (s = 0; s < NUM_SAMPLES; s++) {
+		buf[s] = s << 2;
+		for (e = 0; e < G_N_ELEMENTS(edges); e++)
+			if (s >= edges[e] && s < edges[e] + 3)
+				buf[s] |= 1;
+	}
+
+	sr_session_new(srtest_ctx, &session);
+	sdi = sr_dev_inst_user_new("Test", "Logic", "1");
+	for (i = 0; i < NUM_CHANNELS; i++) {
+		name = g_strdup_printf("D%u", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+		g_free(name);
+	}
+	sr_session_dev_add(session, sdi);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	sr_trigger_match_add(stage, sdi->channels->data, match, 0);
+	stl = soft_trigger_logic_new(sdi, trigger, PRE_TRIGGER_SAMPLES);
+	fail_unless(stl != NULL, "soft_trigger_logic_new() failed.");
+
+	received = g_array_new(FALSE, FALSE, sizeof(uint16_t));
+	triggers = g_array_new(FALSE, FALSE, sizeof(guint));
+	data = buf;
+	left = NUM_SAMPLES;
+	sent = 0;
+	fired = FALSE;
+	while (left > 0) {
+		if (!fired) {
+			offset = soft_trigger_logic_check(stl, (uint8_t *)data,
+				left * sizeof(uint16_t), &pre_trigger_samples);
+			if (offset < 0)
+				break;
+			sent += pre_trigger_samples;
+			data += offset;
+			left -= offset;
+			fired = TRUE;
+		}
+		num_samples = MIN(left, FRAME_SAMPLES - sent);
+		received_append(data, num_samples);
+		sent += num_samples;
+		data += num_samples;
+		left -= num_samples;
+		if (sent < FRAME_SAMPLES)
+			break;
+		sent = 0;
+		soft_trigger_logic_reset(stl);
+		fired = FALSE;
+	}
+
+	/*
+	 * Each frame has up to PRE_TRIGGER_SAMPLES from after the end of the
+	 * previous one, the pre-trigger buffer doesn't carry over.
+	 */
+	fail_unless(triggers->len == G_N_ELEMENTS(edges),
+		"%u triggers fired.", triggers->len);
+	pos = 0;
+	s = 0;
+	for (e = 0; e < G_N_ELEMENTS(edges); e++) {
+		s = MAX(edges[e] - PRE_TRIGGER_SAMPLES, s);
+		fail_unless(g_array_index(triggers, guint, e)
+			== pos + edges[e] - s, "Trigger %u is misplaced.", e);
+		for (i = 0; i < FRAME_SAMPLES; i++, pos++, s++)
+			fail_unless(pos < received->len
+				&& g_array_index(received, uint16_t, pos) == s,
+				"Frame %u: sample %u isn't sample %d.", e, i, s);
+	}
+	fail_unless(received->len == pos, "%u samples were sent.",
+		received->len);
+
+	g_array_free(triggers, TRUE);
+	g_array_free(received, TRUE);
+	soft_trigger_logic_free(stl);
+	sr_trigger_free(trigger);
+	sr_session_destroy(session);
+	sr_dev_inst_free(sdi);
+}
+
+/* An edge trigger re-arms without remembering the previous frame. */
+START_TEST(test_soft_trigger_rearm_edge)
+{
+	check_frames(SR_TRIGGER_RISING);
+}
+END_TEST
+
+/* A level trigger skips ahead with logic_find(), also after re-arming. */
+START_TEST(test_soft_trigger_rearm_level)
+{
+	check_frames(SR_TRIGGER_ONE);
+}
+END_TEST
+
+Suite *suite_soft_trigger(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("soft-trigger");
+
+	tc = tcase_create("frames");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_soft_trigger_rearm_edge);
+	tcase_add_test(tc, test_soft_trigger_rearm_level);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,219 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+#include <check.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define NUM_SAMPLES 4096
+
+#ifndef _WIN32
+
+static gboolean seen_header, seen_end;
+static GString *received;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		fail_unless(!seen_header, "Got a second SR_DF_HEADER.");
+		seen_header = TRUE;
+		break;
+	case SR_DF_LOGIC:
+		fail_unless(seen_header, "Logic data before SR_DF_HEADER.");
+		logic = packet->payload;
+		fail_unless(logic->unitsize == 1);
+		g_string_append_len(received, logic->data, logic->length);
+		break;
+	case SR_DF_END:
+		seen_end = TRUE;
+		break;
+	}
+}
+
+static int listen_unix(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	fail_unless(strlen(path) < sizeof(addr.sun_path));
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	fail_unless(fd >= 0, "socket() failed.");
+	fail_unless(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0,
+		"bind() failed.");
+	fail_unless(listen(fd, 1) == 0, "listen() failed.");
+
+	return fd;
+}
+
+static void send_packet(const struct sr_output *o, uint16_t type,
+		const void *payload)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	int ret;
+
+	packet.type = type;
+	packet.payload = payload;
+	out = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() error: %d", ret);
+	/* Everything goes to the socket. */
+	fail_unless(out == NULL);
+}
+
+/*
+ * Send a datafeed through the "stream" output module to a Unix socket,
+ * and replay what comes out at the other end through the "stream" input
+ * module.
+ */
+START_TEST(test_stream_socket)
+{
+	const struct sr_output_module *omod;
+	const struct sr_output *o;
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_header header;
+	struct sr_datafeed_logic logic;
+	GHashTable *options;
+	GString *wire;
+	char *dir, *path, *spec;
+	uint8_t data[NUM_SAMPLES], buf[1024];
+	int lfd, fd, ret, i;
+	ssize_t len;
+
+	for (i = 0; i < NUM_SAMPLES; i++)
+		data[i] = i * 7;
+
+	dir = g_dir_make_tmp("srtest-XXXXXX", NULL);
+	fail_unless(dir != NULL);
+	path = g_build_filename(dir, "sock", NULL);
+	lfd = listen_unix(path);
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "1.0");
+	for (i = 0; i < 8; i++) {
+		spec = g_strdup_printf("D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, spec);
+		g_free(spec);
+	}
+
+	omod = sr_output_find("stream");
+	fail_unless(omod != NULL, "Failed to find output module.");
+	spec = g_strdup_printf("unix/%s", path);
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("socket"),
+			g_variant_ref_sink(g_variant_new_string(spec)));
+	o = sr_output_new(omod, options, sdi, NULL);
+	fail_unless(o != NULL, "Failed to connect to the socket.");
+	g_hash_table_destroy(options);
+	g_free(spec);
+
+	fd = accept(lfd, NULL, NULL);
+	fail_unless(fd >= 0, "accept() failed.");
+
+	header.feed_version = 1;
+	header.starttime.tv_sec = 0;
+	header.starttime.tv_usec = 0;
+	send_packet(o, SR_DF_HEADER, &header);
+	/* Uneven pieces, so batching and direct sends both get used. */
+	for (i = 0; i < NUM_SAMPLES; i += logic.length) {
+		logic.length = MIN(NUM_SAMPLES - i, 1 + i % 1500);
+		logic.unitsize = 1;
+		logic.data = data + i;
+		send_packet(o, SR_DF_LOGIC, &logic);
+	}
+	send_packet(o, SR_DF_END, NULL);
+	sr_output_free(o);
+
+	wire = g_string_new(NULL);
+	while ((len = read(fd, buf, sizeof(buf))) > 0)
+		g_string_append_len(wire, (const char *)buf, len);
+	fail_unless(len == 0, "read() failed.");
+	close(fd);
+	close(lfd);
+
+	seen_header = seen_end = FALSE;
+	received = g_string_new(NULL);
+	imod = sr_input_find("stream");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+	ret = sr_input_send(in, wire);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+
+	fail_unless(seen_header, "No SR_DF_HEADER was received.");
+	fail_unless(seen_end, "No SR_DF_END was received.");
+	fail_unless(received->len == NUM_SAMPLES, "Expected %d samples, "
+		"got %u.", NUM_SAMPLES, (unsigned int)received->len);
+	fail_unless(!memcmp(received->str, data, NUM_SAMPLES),
+		"Logic data differs.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_string_free(received, TRUE);
+	g_string_free(wire, TRUE);
+	g_unlink(path);
+	g_rmdir(dir);
+	g_free(path);
+	g_free(dir);
+}
+END_TEST
+
+#endif
+
+Suite *suite_stream(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("stream");
+
+	tc = tcase_create("socket");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+#ifndef _WIN32
+	tcase_add_test(tc, test_stream_socket);
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}
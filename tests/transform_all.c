@@ -18,11 +18,19 @@
  */
 
 #include <config.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #include <check.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
+#define INVERT_SIZE (256 * 1024)
+
 /* Check whether at least one transform module is available. */
 START_TEST(test_transform_available)
 {
@@ -96,6 +104,731 @@ START_TEST(test_transform_options)
 }
 END_TEST
 
+#ifndef _WIN32
+
+static GString *received;
+
+static void collect_logic(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+	logic = packet->payload;
+	g_string_append_len(received, logic->data, logic->length);
+}
+
+static void check_inverted(const uint8_t *data, size_t offset, size_t len)
+{
+	size_t i;
+	uint8_t inverted;
+
+	for (i = 0; i < len; i++) {
+		inverted = ~data[i];
+		if ((uint8_t)received->str[offset + i] != inverted)
+			fail("Byte %zu was not inverted.", offset + i);
+	}
+}
+
+/*
+ * Run the "invert" transform over data which the "binary" input module
+ * parses in place: a memory-mapped file, and a caller's buffer. Neither
+ * the file nor the buffer may change.
+ */
+START_TEST(test_transform_invert_in_place)
+{
+	const struct sr_transform *t;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_input *in;
+	GError *error;
+	gboolean eof;
+	gchar *path, *contents;
+	gsize contents_len;
+	uint8_t *data, *copy;
+	size_t i;
+	int fd, ret;
+
+	data = g_malloc(INVERT_SIZE);
+	for (i = 0; i < INVERT_SIZE; i++)
+		data[i] = i * 7 + i / 1024;
+	copy = g_memdup(data, INVERT_SIZE);
+
+	error = NULL;
+	fd = g_file_open_tmp("srtest-XXXXXX", &path, &error);
+	fail_unless(fd >= 0, "Failed to create a file: %s.",
+		error ? error->message : "");
+	fail_unless(write(fd, data, INVERT_SIZE) == INVERT_SIZE);
+	fail_unless(lseek(fd, 0, SEEK_SET) == 0);
+
+	in = sr_input_new(sr_input_find("binary"), NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	sdi = sr_input_dev_inst_get(in);
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sdi);
+	sr_session_datafeed_callback_add(session, collect_logic, NULL);
+	t = sr_transform_new(sr_transform_find("invert"), NULL, sdi);
+	fail_unless(t != NULL, "Failed to create transform instance.");
+	received = g_string_new(NULL);
+
+	do {
+		ret = sr_input_send_fd(in, fd, &eof);
+		fail_unless(ret == SR_OK, "sr_input_send_fd() error: %d", ret);
+	} while (!eof);
+	ret = sr_input_send_data(in, data, INVERT_SIZE);
+	fail_unless(ret == SR_OK, "sr_input_send_data() error: %d", ret);
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+
+	fail_unless(received->len == 2 * INVERT_SIZE, "Got %u bytes.",
+		(unsigned int)received->len);
+	check_inverted(copy, 0, INVERT_SIZE);
+	check_inverted(copy, INVERT_SIZE, INVERT_SIZE);
+	fail_unless(!memcmp(data, copy, INVERT_SIZE),
+		"The caller's buffer was modified.");
+	fail_unless(g_file_get_contents(path, &contents, &contents_len, NULL));
+	fail_unless(contents_len == INVERT_SIZE
+		&& !memcmp(contents, copy, INVERT_SIZE),
+		"The file was modified.");
+
+	sr_session_destroy(session);
+	sr_transform_free(t);
+	sr_input_free(in);
+	g_string_free(received, TRUE);
+	g_free(contents);
+	close(fd);
+	g_unlink(path);
+	g_free(path);
+	g_free(copy);
+	g_free(data);
+}
+END_TEST
+
+#endif
+
+/*
+ * Transforms are run on packets replayed through the "stream" input
+ * module. The packets are written by the "stream" output module for a
+ * device with the channels at hand.
+ */
+static GString *wire;
+
+/* An analog plane that a transform sent. */
+struct plane {
+	int index;
+	enum sr_mq mq;
+	uint64_t mqflags;
+	unsigned int num_samples;
+	float *values;
+};
+
+static GPtrArray *planes;
+static int frames;
+
+static void plane_free(struct plane *p)
+{
+	g_free(p->values);
+	g_free(p);
+}
+
+static void collect_analog(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_analog *analog;
+	const struct sr_channel *ch;
+	struct plane *p;
+	int ret;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_FRAME_BEGIN:
+		frames++;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		ch = analog->meaning->channels->data;
+		p = g_malloc0(sizeof(struct plane));
+		p->index = ch->index;
+		p->mq = analog->meaning->mq;
+		p->mqflags = analog->meaning->mqflags;
+		p->num_samples = analog->num_samples;
+		p->values = g_malloc0_n(MAX(p->num_samples, 1) *
+			g_slist_length(analog->meaning->channels), sizeof(float));
+		ret = sr_analog_to_float(analog, p->values);
+		fail_unless(ret == SR_OK, "sr_analog_to_float() error: %d", ret);
+		g_ptr_array_add(planes, p);
+		break;
+	}
+}
+
+static struct sr_dev_inst *source_new(int num_logic, int num_analog)
+{
+	struct sr_dev_inst *sdi;
+	char *name;
+	int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "1.0");
+	for (i = 0; i < num_logic; i++) {
+		name = g_strdup_printf("D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+		g_free(name);
+	}
+	for (i = 0; i < num_analog; i++) {
+		name = g_strdup_printf("A%d", i);
+		sr_dev_inst_channel_add(sdi, num_logic + i, SR_CHANNEL_ANALOG,
+			name);
+		g_free(name);
+	}
+
+	return sdi;
+}
+
+static void source_send(const struct sr_output *o, uint16_t type,
+		const void *payload)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	int ret;
+
+	packet.type = type;
+	packet.payload = payload;
+	out = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() error: %d", ret);
+	if (out) {
+		g_string_append_len(wire, out->str, out->len);
+		g_string_free(out, TRUE);
+	}
+}
+
+/* Start writing a datafeed for the device. */
+static const struct sr_output *source_open(const struct sr_dev_inst *sdi)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_header header;
+
+	o = sr_output_new(sr_output_find("stream"), NULL, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create output instance.");
+	wire = g_string_new(NULL);
+
+	header.feed_version = 1;
+	header.starttime.tv_sec = 0;
+	header.starttime.tv_usec = 0;
+	source_send(o, SR_DF_HEADER, &header);
+
+	return o;
+}
+
+/* Send samples of the analog channels, interleaved if there are several. */
+static void source_analog(const struct sr_output *o, GSList *channels,
+		const float *data, unsigned int num_samples)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = sizeof(float);
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.digits = 3;
+	encoding.is_digits_decimal = TRUE;
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.channels = channels;
+	analog.data = (void *)data;
+	analog.num_samples = num_samples;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	source_send(o, SR_DF_ANALOG, &analog);
+}
+
+static void source_logic(const struct sr_output *o, const uint8_t *data,
+		uint64_t length, uint16_t unitsize)
+{
+	struct sr_datafeed_logic logic;
+
+	logic.length = length;
+	logic.unitsize = unitsize;
+	logic.data = (void *)data;
+	source_send(o, SR_DF_LOGIC, &logic);
+}
+
+static void source_samplerate(const struct sr_output *o, uint64_t samplerate)
+{
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(samplerate));
+	meta.config = g_slist_append(NULL, &src);
+	source_send(o, SR_DF_META, &meta);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+}
+
+/*
+ * End the datafeed, and replay it into a session which runs it through
+ * the transform. The analog planes it sends end up in planes.
+ */
+static void replay(const struct sr_output *o, const char *id,
+		GHashTable *options)
+{
+	const struct sr_transform *t;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_input *in;
+	int ret;
+
+	source_send(o, SR_DF_END, NULL);
+	sr_output_free(o);
+
+	in = sr_input_new(sr_input_find("stream"), NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	/* This returns once the device is known. */
+	ret = sr_input_send(in, wire);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	sdi = sr_input_dev_inst_get(in);
+	fail_unless(sdi != NULL, "No device in the stream.");
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sdi);
+	sr_session_datafeed_callback_add(session, collect_analog, NULL);
+	t = sr_transform_new(sr_transform_find(id), options, sdi);
+	fail_unless(t != NULL, "Failed to create transform instance.");
+
+	planes = g_ptr_array_new_with_free_func((GDestroyNotify)plane_free);
+	frames = 0;
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+
+	sr_session_destroy(session);
+	sr_transform_free(t);
+	sr_input_free(in);
+	g_string_free(wire, TRUE);
+	if (options)
+		g_hash_table_destroy(options);
+}
+
+static GHashTable *options_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+}
+
+static void option_set(GHashTable *options, const char *key, GVariant *value)
+{
+	g_hash_table_insert(options, (gpointer)key, g_variant_ref_sink(value));
+}
+
+static const struct plane *plane_get(unsigned int i)
+{
+	fail_unless(i < planes->len, "Only %u planes were sent.", planes->len);
+
+	return g_ptr_array_index(planes, i);
+}
+
+static void check_values(const struct plane *p, const float *expected,
+		unsigned int n, float tolerance)
+{
+	unsigned int i;
+
+	fail_unless(p->num_samples == n, "Plane with %u values, not %u.",
+		p->num_samples, n);
+	for (i = 0; i < n; i++) {
+		if (isnan(expected[i]))
+			fail_unless(isnan(p->values[i]), "Value %u is %g, "
+				"not NAN.", i, p->values[i]);
+		else
+			fail_unless(fabsf(p->values[i] - expected[i]) <=
+				tolerance, "Value %u is %g, not %g.", i,
+				p->values[i], expected[i]);
+	}
+}
+
+/* Value of frame f at position i in the average tests. */
+static float frame_value(int f, int i)
+{
+	return (f * 7) % 5 * 10 + i - f;
+}
+
+/* Send frames of the given lengths on one analog channel. */
+static const struct sr_output *send_frames(const int *lengths, int count,
+		GSList **channels)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	float data[16];
+	int f, i;
+
+	sdi = source_new(0, 1);
+	*channels = g_slist_append(NULL, sr_dev_inst_channels_get(sdi)->data);
+	o = source_open(sdi);
+	for (f = 0; f < count; f++) {
+		for (i = 0; i < lengths[f]; i++)
+			data[i] = frame_value(f, i);
+		source_send(o, SR_DF_FRAME_BEGIN, NULL);
+		/* Two packets per frame, so reduced frames come in two too. */
+		source_analog(o, *channels, data, lengths[f] / 2);
+		source_analog(o, *channels, data + lengths[f] / 2,
+			lengths[f] - lengths[f] / 2);
+		source_send(o, SR_DF_FRAME_END, NULL);
+	}
+
+	return o;
+}
+
+/*
+ * Every three frames are reduced to their mean. The frames of the
+ * incomplete group at the end are dropped.
+ */
+START_TEST(test_transform_average_mean)
+{
+	const int lengths[] = { 5, 5, 5, 5, 5, 5, 5 };
+	const struct sr_output *o;
+	const struct plane *p;
+	GHashTable *options;
+	GSList *channels;
+	float expected[5];
+	int g, f, i;
+
+	o = send_frames(lengths, ARRAY_SIZE(lengths), &channels);
+	options = options_new();
+	option_set(options, "frames", g_variant_new_uint32(3));
+	option_set(options, "mode", g_variant_new_string("mean"));
+	replay(o, "average", options);
+
+	fail_unless(frames == 2, "%d frames were sent.", frames);
+	fail_unless(planes->len == 4, "%u planes were sent.", planes->len);
+	for (g = 0; g < 2; g++) {
+		for (i = 0; i < 5; i++) {
+			expected[i] = 0;
+			for (f = 3 * g; f < 3 * g + 3; f++)
+				expected[i] += frame_value(f, i) / 3;
+		}
+		p = plane_get(2 * g);
+		fail_unless(p->mqflags & SR_MQFLAG_AVG, "No AVG flag.");
+		check_values(p, expected, 2, 1e-4);
+		check_values(plane_get(2 * g + 1), expected + 2, 3, 1e-4);
+	}
+
+	g_ptr_array_free(planes, TRUE);
+	g_slist_free(channels);
+}
+END_TEST
+
+/*
+ * Frames of different lengths: the reduced frame has the length of the
+ * last frame of its group, and each of its values is reduced over the
+ * frames that reached that position. Envelopes come as two planes.
+ */
+START_TEST(test_transform_average_envelope)
+{
+	const int lengths[] = { 4, 7, 6, 3, 5 };
+	const struct sr_output *o;
+	const struct plane *p;
+	GHashTable *options;
+	GSList *channels;
+	float min[7], max[7], v;
+	int g, f, i, last, half;
+
+	o = send_frames(lengths, ARRAY_SIZE(lengths), &channels);
+	options = options_new();
+	option_set(options, "frames", g_variant_new_uint32(2));
+	option_set(options, "mode", g_variant_new_string("envelope"));
+	replay(o, "average", options);
+
+	fail_unless(frames == 2, "%d frames were sent.", frames);
+	fail_unless(planes->len == 8, "%u planes were sent.", planes->len);
+	for (g = 0; g < 2; g++) {
+		last = 2 * g + 1;
+		half = lengths[last] / 2;
+		for (i = 0; i < lengths[last]; i++) {
+			min[i] = INFINITY;
+			max[i] = -INFINITY;
+			for (f = 2 * g; f <= last; f++) {
+				if (i >= lengths[f])
+					continue;
+				v = frame_value(f, i);
+				min[i] = MIN(min[i], v);
+				max[i] = MAX(max[i], v);
+			}
+		}
+		p = plane_get(4 * g);
+		fail_unless(p->mqflags & SR_MQFLAG_MIN, "No MIN flag.");
+		check_values(p, min, half, 0);
+		p = plane_get(4 * g + 1);
+		fail_unless(p->mqflags & SR_MQFLAG_MAX, "No MAX flag.");
+		check_values(p, max, half, 0);
+		check_values(plane_get(4 * g + 2), min + half,
+			lengths[last] - half, 0);
+		check_values(plane_get(4 * g + 3), max + half,
+			lengths[last] - half, 0);
+	}
+
+	g_ptr_array_free(planes, TRUE);
+	g_slist_free(channels);
+}
+END_TEST
+
+/* Analog data outside of frames is passed on as it is. */
+START_TEST(test_transform_average_unframed)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GSList *channels;
+	float data[10];
+	int i;
+
+	for (i = 0; i < 10; i++)
+		data[i] = i * 0.5;
+	sdi = source_new(0, 1);
+	channels = g_slist_append(NULL, sr_dev_inst_channels_get(sdi)->data);
+	o = source_open(sdi);
+	source_analog(o, channels, data, 10);
+	options = options_new();
+	option_set(options, "frames", g_variant_new_uint32(4));
+	replay(o, "average", options);
+
+	fail_unless(planes->len == 1, "%u planes were sent.", planes->len);
+	check_values(plane_get(0), data, 10, 0);
+
+	g_ptr_array_free(planes, TRUE);
+	g_slist_free(channels);
+}
+END_TEST
+
+static float measure_value(int c, int i)
+{
+	return c ? (i * i) % 7 - 3 : i * 0.5 - 1;
+}
+
+/*
+ * Statistics over windows of four samples of two interleaved channels,
+ * which span packets. The incomplete window at the end is dropped.
+ */
+START_TEST(test_transform_measure_stats)
+{
+	const uint64_t flags[] = { SR_MQFLAG_MIN, SR_MQFLAG_MAX, SR_MQFLAG_AVG,
+		SR_MQFLAG_RMS, SR_MQFLAG_RMS | SR_MQFLAG_AC };
+	const struct sr_output *o;
+	const struct plane *p;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	float data[2 * 10], expected[5][2], v;
+	double sum, sum_sq, mean;
+	int c, w, m, i;
+
+	for (i = 0; i < 10; i++)
+		for (c = 0; c < 2; c++)
+			data[2 * i + c] = measure_value(c, i);
+	sdi = source_new(0, 2);
+	o = source_open(sdi);
+	source_analog(o, sr_dev_inst_channels_get(sdi), data, 3);
+	source_analog(o, sr_dev_inst_channels_get(sdi), data + 2 * 3, 7);
+	options = options_new();
+	option_set(options, "window", g_variant_new_uint64(4));
+	option_set(options, "measurements",
+		g_variant_new_string("min, max,mean,rms,stddev"));
+	replay(o, "measure", options);
+
+	fail_unless(planes->len == 2 * 5, "%u planes were sent.", planes->len);
+	for (c = 0; c < 2; c++) {
+		for (w = 0; w < 2; w++) {
+			expected[0][w] = INFINITY;
+			expected[1][w] = -INFINITY;
+			sum = sum_sq = 0;
+			for (i = 4 * w; i < 4 * w + 4; i++) {
+				v = measure_value(c, i);
+				expected[0][w] = MIN(expected[0][w], v);
+				expected[1][w] = MAX(expected[1][w], v);
+				sum += v;
+				sum_sq += v * v;
+			}
+			mean = sum / 4;
+			expected[2][w] = mean;
+			expected[3][w] = sqrt(sum_sq / 4);
+			expected[4][w] = sqrt(MAX(sum_sq / 4 - mean * mean, 0));
+		}
+		for (m = 0; m < 5; m++) {
+			p = plane_get(5 * c + m);
+			fail_unless(p->index == c, "Plane %d of channel %d.",
+				5 * c + m, p->index);
+			fail_unless(p->mqflags == flags[m], "Plane %d has "
+				"flags 0x%" PRIx64 ".", 5 * c + m, p->mqflags);
+			check_values(p, expected[m], 2, 1e-4);
+		}
+	}
+
+	g_ptr_array_free(planes, TRUE);
+}
+END_TEST
+
+/*
+ * Frequency and period from the rising crossings of a square wave, with
+ * the samplerate from the datafeed. A window without crossings has none.
+ */
+START_TEST(test_transform_measure_frequency)
+{
+	const float frequency[] = { 100, 100 }, period[] = { 0.01, 0.01 };
+	const float none[] = { NAN };
+	const struct sr_output *o;
+	const struct plane *p;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	float data[300];
+	int i;
+
+	for (i = 0; i < 300; i++)
+		data[i] = i < 200 && i % 10 < 5 ? -1 : 1;
+	sdi = source_new(0, 1);
+	o = source_open(sdi);
+	source_samplerate(o, 1000);
+	source_analog(o, sr_dev_inst_channels_get(sdi), data, 37);
+	source_analog(o, sr_dev_inst_channels_get(sdi), data + 37, 163);
+	source_analog(o, sr_dev_inst_channels_get(sdi), data + 200, 100);
+	options = options_new();
+	option_set(options, "window", g_variant_new_uint64(100));
+	option_set(options, "measurements",
+		g_variant_new_string("frequency,period"));
+	replay(o, "measure", options);
+
+	fail_unless(planes->len == 4, "%u planes were sent.", planes->len);
+	p = plane_get(0);
+	fail_unless(p->mq == SR_MQ_FREQUENCY, "Not a frequency.");
+	check_values(p, frequency, 2, 1e-3);
+	p = plane_get(1);
+	fail_unless(p->mq == SR_MQ_TIME, "Not a period.");
+	check_values(p, period, 2, 1e-7);
+	check_values(plane_get(2), none, 1, 0);
+	check_values(plane_get(3), none, 1, 0);
+
+	g_ptr_array_free(planes, TRUE);
+}
+END_TEST
+
+/*
+ * D0 has a 40 ms period and a 20 ms pulse, rising at 10, 50, 90, ...
+ * milliseconds. D1 has a single 1 ms pulse at 25 ms.
+ */
+static uint8_t pulse_sample(int i)
+{
+	return ((i + 30) % 40 < 20) | (i == 25) << 1;
+}
+
+static const struct sr_output *send_pulses(int length)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	uint8_t *data;
+	int i;
+
+	data = g_malloc(length);
+	for (i = 0; i < length; i++)
+		data[i] = pulse_sample(i);
+	sdi = source_new(2, 0);
+	o = source_open(sdi);
+	source_samplerate(o, 1000);
+	/* Split pulses and intervals across packets. */
+	source_logic(o, data, 37, 1);
+	source_logic(o, data + 37, length - 37, 1);
+	g_free(data);
+
+	return o;
+}
+
+/*
+ * Statistics of two intervals of 100 ms. D0's pulse spans them, D1 has
+ * a pulse but no period in the first, and none in the second.
+ */
+START_TEST(test_transform_pulse_stats)
+{
+	const enum sr_mq mq[] = { SR_MQ_FREQUENCY, SR_MQ_TIME,
+		SR_MQ_DUTY_CYCLE, SR_MQ_PULSE_WIDTH };
+	const float expected[2][4][2] = {
+		{ { 25, 25 }, { 0.04, 0.04 }, { 50, 50 }, { 0.02, 0.02 } },
+		{ { NAN, NAN }, { NAN, NAN }, { 1, 0 }, { 0.001, NAN } },
+	};
+	const struct sr_output *o;
+	const struct plane *p;
+	GHashTable *options;
+	int c, s;
+
+	o = send_pulses(200);
+	options = options_new();
+	option_set(options, "interval", g_variant_new_uint64(100));
+	option_set(options, "mode", g_variant_new_string("stats"));
+	replay(o, "pulse", options);
+
+	fail_unless(planes->len == 2 * 4, "%u planes were sent.", planes->len);
+	for (c = 0; c < 2; c++) {
+		for (s = 0; s < 4; s++) {
+			p = plane_get(4 * c + s);
+			fail_unless(p->index == c, "Plane %d of channel %d.",
+				4 * c + s, p->index);
+			fail_unless(p->mq == mq[s], "Plane %d has mq %d.",
+				4 * c + s, p->mq);
+			check_values(p, expected[c][s], 2, 1e-5);
+		}
+	}
+
+	g_ptr_array_free(planes, TRUE);
+}
+END_TEST
+
+/*
+ * Signed edge times, per batch of intervals since the batch's start. The
+ * planes of channels with fewer edges are padded.
+ */
+START_TEST(test_transform_pulse_edges)
+{
+	const float d0[] = { 0.01, -0.03, 0.05, -0.07, 0.09, -0.11, 0.13,
+		-0.15, 0.17, -0.19 };
+	const float d1[] = { 0.025, -0.026, NAN, NAN, NAN, NAN, NAN, NAN,
+		NAN, NAN };
+	const float d0_next[] = { 0.01, -0.03, 0.05, -0.07, 0.09 };
+	const float d1_next[] = { NAN, NAN, NAN, NAN, NAN };
+	const struct sr_output *o;
+	GHashTable *options;
+	uint8_t data[100];
+	int i;
+
+	o = send_pulses(200);
+	for (i = 0; i < 100; i++)
+		data[i] = pulse_sample(200 + i) & 1;
+	source_logic(o, data, 100, 1);
+	options = options_new();
+	option_set(options, "interval", g_variant_new_uint64(100));
+	option_set(options, "mode", g_variant_new_string("edges"));
+	replay(o, "pulse", options);
+
+	fail_unless(planes->len == 4, "%u planes were sent.", planes->len);
+	check_values(plane_get(0), d0, ARRAY_SIZE(d0), 1e-6);
+	check_values(plane_get(1), d1, ARRAY_SIZE(d1), 1e-6);
+	check_values(plane_get(2), d0_next, ARRAY_SIZE(d0_next), 1e-6);
+	check_values(plane_get(3), d1_next, ARRAY_SIZE(d1_next), 0);
+	for (i = 0; i < 4; i++)
+		fail_unless(plane_get(i)->index == i % 2,
+			"Plane %d of channel %d.", i, plane_get(i)->index);
+
+	g_ptr_array_free(planes, TRUE);
+}
+END_TEST
+
 Suite *suite_transform_all(void)
 {
 	Suite *s;
@@ -112,5 +845,31 @@ Suite *suite_transform_all(void)
 	tcase_add_test(tc, test_transform_options);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("in-place");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+#ifndef _WIN32
+	tcase_add_test(tc, test_transform_invert_in_place);
+#endif
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("average");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_transform_average_mean);
+	tcase_add_test(tc, test_transform_average_envelope);
+	tcase_add_test(tc, test_transform_average_unframed);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("measure");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_transform_measure_stats);
+	tcase_add_test(tc, test_transform_measure_frequency);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("pulse");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_transform_pulse_stats);
+	tcase_add_test(tc, test_transform_pulse_edges);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -0,0 +1,205 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+#ifdef HAVE_LIBUSB_1_0
+
+#define NUM_PACKETS 100
+
+static GThread *session_thread;
+static unsigned int received;
+static gboolean in_order;
+static gboolean stopped;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (g_thread_self() != session_thread)
+		in_order = FALSE;
+	if (packet->type != SR_DF_LOGIC) {
+		in_order = FALSE;
+		return;
+	}
+	logic = packet->payload;
+	if (logic->length != 1 || ((uint8_t *)logic->data)[0] != received)
+		in_order = FALSE;
+	received++;
+}
+
+static int usb_receive(int fd, int revents, void *cb_data)
+{
+	(void)fd;
+	(void)revents;
+	(void)cb_data;
+
+	return G_SOURCE_CONTINUE;
+}
+
+static int fake_acquisition_stop(struct sr_dev_inst *sdi)
+{
+	(void)sdi;
+
+	stopped = TRUE;
+
+	return SR_OK;
+}
+
+/* Send packets from a thread other than the session's, like a driver's
+ * transfer callbacks do on the event thread. */
+static gpointer send_thread(gpointer data)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint8_t sample;
+	int ret;
+
+	sdi = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = logic.unitsize = 1;
+	logic.data = &sample;
+	for (sample = 0; sample < NUM_PACKETS; sample++) {
+		ret = sr_session_send(sdi, &packet);
+		if (ret != SR_OK)
+			return GINT_TO_POINTER(ret);
+	}
+
+	return GINT_TO_POINTER(SR_OK);
+}
+
+/* A packet type sr_packet_copy() does not know. */
+static gpointer send_bad_thread(gpointer data)
+{
+	struct sr_datafeed_packet packet;
+
+	packet.type = 0xffff;
+	packet.payload = NULL;
+
+	return GINT_TO_POINTER(sr_session_send(data, &packet));
+}
+
+static void run_pending(GMainContext *context)
+{
+	int i;
+
+	for (i = 0; i < 100 && g_main_context_pending(context); i++)
+		g_main_context_iteration(context, FALSE);
+}
+
+/*
+ * With the event thread, packets sent off the session thread are queued,
+ * and reach the datafeed callbacks in order on the session thread. The
+ * drivers' event pumps stand down while it runs. A packet which can't be
+ * queued stops the acquisition.
+ */
+START_TEST(test_usb_event_thread)
+{
+	static struct sr_dev_driver fake_driver = {
+		.name = "fake",
+		.dev_acquisition_stop = fake_acquisition_stop,
+	};
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct timeval tv;
+	GThread *thread;
+	int ret;
+
+	if (!sr_usb_context(srtest_ctx))
+		return;
+
+	sr_session_new(srtest_ctx, &session);
+	ret = sr_session_usb_event_thread_set(session, TRUE, 0, -1);
+	fail_unless(ret == SR_OK, "sr_session_usb_event_thread_set() "
+		"error: %d", ret);
+	sdi = sr_dev_inst_user_new("Test", "USB", "1");
+	sr_session_dev_add(session, sdi);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	/* Stand in for sr_session_start(). */
+	session_thread = g_thread_self();
+	session->main_context = g_main_context_new();
+	ret = usb_source_add(session, srtest_ctx, -1, usb_receive, NULL);
+	fail_unless(ret == SR_OK, "usb_source_add() error: %d", ret);
+	fail_unless(session->usb_thread != NULL, "No event thread.");
+	fail_unless(g_atomic_int_get(&srtest_ctx->usb_event_threads) == 1);
+	tv.tv_sec = 10;
+	tv.tv_usec = 0;
+	fail_unless(usb_handle_events(srtest_ctx, &tv, NULL) == LIBUSB_SUCCESS);
+
+	received = 0;
+	in_order = TRUE;
+	thread = g_thread_new("send", send_thread, sdi);
+	ret = GPOINTER_TO_INT(g_thread_join(thread));
+	fail_unless(ret == SR_OK, "sr_session_send() error: %d", ret);
+	fail_unless(received == 0, "%u packets were not queued.", received);
+	run_pending(session->main_context);
+	fail_unless(received == NUM_PACKETS, "%u packets arrived.", received);
+	fail_unless(in_order, "Packets arrived out of order, or elsewhere.");
+
+	session->running = TRUE;
+	sdi->driver = &fake_driver;
+	stopped = FALSE;
+	thread = g_thread_new("send", send_bad_thread, sdi);
+	g_thread_join(thread);
+	run_pending(session->main_context);
+	fail_unless(stopped, "The acquisition was not stopped.");
+	fail_unless(received == NUM_PACKETS, "A bad packet arrived.");
+	sdi->driver = NULL;
+	session->running = FALSE;
+
+	ret = usb_source_remove(session, srtest_ctx);
+	fail_unless(ret == SR_OK, "usb_source_remove() error: %d", ret);
+	fail_unless(session->usb_thread == NULL, "The event thread runs.");
+	fail_unless(g_atomic_int_get(&srtest_ctx->usb_event_threads) == 0);
+	run_pending(session->main_context);
+
+	g_main_context_unref(session->main_context);
+	session->main_context = NULL;
+	sr_session_destroy(session);
+	sr_dev_inst_free(sdi);
+}
+END_TEST
+
+#endif
+
+Suite *suite_usb(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("usb");
+
+	tc = tcase_create("event-thread");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+#ifdef HAVE_LIBUSB_1_0
+	tcase_add_test(tc, test_usb_event_thread);
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}